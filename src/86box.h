@@ -69,11 +69,20 @@ extern int	force_debug;			/* (O) force debug output */
 extern int	video_fps;			/* (O) render speed in fps */
 #endif
 extern int	settings_only;			/* (O) show only the settings dialog */
+extern int	headless;			/* (O) run unthrottled, no display */
+extern int	turbo_mode;			/* (O) run slices back to back */
+extern int	frames_max;			/* (O) exit after this many frames */
+extern int	hdd_overlays;			/* (O) throwaway hard disk overlays */
+#ifdef USE_KVM
+extern int	force_kvm;			/* (O) run the cpu under KVM */
+#endif
 #ifdef _WIN32
 extern uint64_t	unique_id;
 extern uint64_t	source_hwnd;
 #endif
 extern wchar_t	log_path[1024];			/* (O) full path of logfile */
+extern wchar_t	snap_load_path[1024];		/* (O) snapshot to start from */
+extern wchar_t	snap_save_path[1024];		/* (O) snapshot to write on exit */
 
 
 extern int	window_w, window_h,		/* (C) window size and */
@@ -105,6 +114,7 @@ extern uint32_t	mem_size;			/* (C) memory size */
 extern int	cpu_manufacturer,		/* (C) cpu manufacturer */
 		cpu,				/* (C) cpu type */
 		cpu_use_dynarec,		/* (C) cpu uses/needs Dyna */
+		cpu_use_kvm,			/* (C) cpu runs under KVM */
 		enable_external_fpu;		/* (C) enable external FPU */
 extern int	time_sync;			/* (C) enable time sync */
 extern int	network_type;			/* (C) net provider type */
@@ -134,6 +144,7 @@ extern int	scrnsz_x,			/* current screen size, X */
 		scrnsz_y;			/* current screen size, Y */
 extern int	efscrnsz_y;
 extern int	config_changed;			/* config has changed */
+extern int	framecount_total;		/* frames run since start */
 
 
 /* Function prototypes. */
@@ -163,6 +174,9 @@ extern void	pc_send_cab(void);
 extern void	pc_thread(void *param);
 extern void	pc_start(void);
 extern void	pc_onesec(void);
+extern void	pc_set_turbo(int on);
+extern int	pc_snapshot_save(wchar_t *fn);
+extern int	pc_snapshot_load(wchar_t *fn);
 
 #ifdef __cplusplus
 }
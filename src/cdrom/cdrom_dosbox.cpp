@@ -54,35 +54,144 @@ using namespace std;
 
 #define safe_strncpy(a,b,n) do { strncpy((a),(b),(n)-1); (a)[(n)-1] = 0; } while (0)
 
-CDROM_Interface_Image::BinaryFile::BinaryFile(const char *filename, bool &error)
+CDROM_Interface_Image::BlockCache::BlockCache()
+{
+	memset(blocks, 0, sizeof(blocks));
+	stamp = 0;
+	hits = misses = 0;
+	lastFile = NULL;
+	lastBlock = 0;
+	lock = thread_create_mutex(L"86Box.CDCacheMutex");
+}
+
+CDROM_Interface_Image::BlockCache::~BlockCache()
+{
+	for (int i = 0; i < CACHE_BLOCKS; i++)
+		delete[] blocks[i].data;
+	thread_close_mutex(lock);
+}
+
+CDROM_Interface_Image::BlockCache::Block *CDROM_Interface_Image::BlockCache::lookup(FILE *file, uint64_t block)
+{
+	for (int i = 0; i < CACHE_BLOCKS; i++) {
+		if ((blocks[i].file == file) && (blocks[i].block == block)) {
+			blocks[i].used = ++stamp;
+			return &blocks[i];
+		}
+	}
+	return NULL;
+}
+
+// Read a block into the least recently used slot.
+CDROM_Interface_Image::BlockCache::Block *CDROM_Interface_Image::BlockCache::fill(FILE *file, uint64_t length, uint64_t block)
+{
+	Block *b = &blocks[0];
+	uint64_t pos = block * CACHE_BLOCK_SIZE;
+	size_t len = 0;
+
+	for (int i = 1; i < CACHE_BLOCKS; i++) {
+		if (blocks[i].used < b->used) b = &blocks[i];
+	}
+
+	if (b->data == NULL) b->data = new Bit8u[CACHE_BLOCK_SIZE];
+	b->file = file;
+	b->block = block;
+	b->used = ++stamp;
+
+	if (pos < length) {
+		fseeko64(file, pos, SEEK_SET);
+		len = fread(b->data, 1, CACHE_BLOCK_SIZE, file);
+	}
+	if (len < CACHE_BLOCK_SIZE) memset(b->data + len, 0, CACHE_BLOCK_SIZE - len);
+
+	return b;
+}
+
+void CDROM_Interface_Image::BlockCache::read(FILE *file, uint64_t length, Bit8u *buffer, uint64_t seek, uint64_t count)
+{
+	thread_wait_mutex(lock);
+	while (count > 0) {
+		uint64_t block = seek / CACHE_BLOCK_SIZE;
+		uint64_t offset = seek % CACHE_BLOCK_SIZE;
+		uint64_t n = CACHE_BLOCK_SIZE - offset;
+		if (n > count) n = count;
+
+		Block *b = lookup(file, block);
+		if (b != NULL) hits++;
+		else {
+			misses++;
+			b = fill(file, length, block);
+			// Streaming reads get the next few blocks in one go.
+			if ((file == lastFile) && (block == (lastBlock + 1))) {
+				for (uint64_t i = 1; i < CACHE_READAHEAD; i++) {
+					uint64_t next = block + i;
+					if ((next * CACHE_BLOCK_SIZE) >= length) break;
+					if (lookup(file, next) != NULL) break;
+					fill(file, length, next);
+				}
+				b->used = ++stamp;
+			}
+		}
+		lastFile = file;
+		lastBlock = block;
+
+		memcpy(buffer, b->data + offset, n);
+		buffer += n;
+		seek += n;
+		count -= n;
+	}
+	thread_release_mutex(lock);
+}
+
+// Drop the blocks of a file that is about to be closed.
+void CDROM_Interface_Image::BlockCache::invalidate(FILE *file)
+{
+	thread_wait_mutex(lock);
+	for (int i = 0; i < CACHE_BLOCKS; i++) {
+		if (blocks[i].file == file) {
+			blocks[i].file = NULL;
+			blocks[i].used = 0;
+		}
+	}
+	if (lastFile == file) lastFile = NULL;
+	thread_release_mutex(lock);
+}
+
+CDROM_Interface_Image::BinaryFile::BinaryFile(const char *filename, bool &error, BlockCache *cache)
 {
 	memset(fn, 0, sizeof(fn));
 	strcpy(fn, filename);
+	this->cache = cache;
+	length = 0;
 	file = fopen64(fn, "rb");
 	if (file == NULL)
 		error = true;
-	else
+	else {
 		error = false;
+		fseeko64(file, 0, SEEK_END);
+		length = ftello64(file);
+	}
 }
 
 CDROM_Interface_Image::BinaryFile::~BinaryFile()
 {
-	fclose(file);
+	if (file != NULL) {
+		cache->invalidate(file);
+		fclose(file);
+	}
 	file = NULL;
 	memset(fn, 0, sizeof(fn));
 }
 
 bool CDROM_Interface_Image::BinaryFile::read(Bit8u *buffer, uint64_t seek, uint64_t count)
 {
-	fseeko64(file, seek, SEEK_SET);
-	fread(buffer, 1, count, file);
+	cache->read(file, length, buffer, seek, count);
 	return 1;
 }
 
 uint64_t CDROM_Interface_Image::BinaryFile::getLength()
 {
-	fseeko64(file, 0, SEEK_END);
-	return ftello64(file);
+	return length;
 }
 
 CDROM_Interface_Image::CDROM_Interface_Image()
@@ -204,6 +313,12 @@ int CDROM_Interface_Image::GetTrack(unsigned int sector)
 	return -1;
 }
 
+void CDROM_Interface_Image::GetCacheStats(uint64_t& hits, uint64_t& misses)
+{
+	hits = cache.hits;
+	misses = cache.misses;
+}
+
 bool CDROM_Interface_Image::ReadSector(Bit8u *buffer, bool raw, unsigned long sector)
 {
 	uint64_t length;
@@ -274,7 +389,7 @@ bool CDROM_Interface_Image::LoadIsoFile(char* filename)
 	// data track
 	Track track = {0, 0, 0, 0, 0, 0, 0, 0, false, NULL};
 	bool error;
-	track.file = new BinaryFile(filename, error);
+	track.file = new BinaryFile(filename, error, &cache);
 	if (error) {
 		delete track.file;
 		return false;
@@ -464,7 +579,7 @@ bool CDROM_Interface_Image::LoadCueSheet(char *cuefile)
 			track.file = NULL;
 			bool error = true;
 			if (type == "BINARY") {
-				track.file = new BinaryFile(filename.c_str(), error);
+				track.file = new BinaryFile(filename.c_str(), error, &cache);
 			}
 			if (error) {
 				delete track.file;
@@ -46,6 +46,11 @@ typedef size_t PhysPt;
 #define DATA_TRACK 0x14
 #define AUDIO_TRACK 0x10
 
+/* The image block cache. */
+#define CACHE_BLOCK_SIZE	65536		/* bytes per block */
+#define CACHE_BLOCKS		64		/* blocks per image */
+#define CACHE_READAHEAD		4		/* blocks read on a sequential miss */
+
 #define CD_FPS  75
 #define FRAMES_TO_MSF(f, M,S,F) {                                       \
         int value = f;                                                  \
@@ -97,6 +102,31 @@ public:
 class CDROM_Interface_Image : public CDROM_Interface
 {
 private:
+	// LRU cache of file blocks, shared by all the files of an image
+	// and by the CPU and CD audio threads, hence the lock
+	class BlockCache {
+	public:
+		BlockCache();
+		~BlockCache();
+		void read(FILE *file, uint64_t length, Bit8u *buffer, uint64_t seek, uint64_t count);
+		void invalidate(FILE *file);
+		uint64_t hits, misses;
+	private:
+		struct Block {
+			FILE		*file;
+			uint64_t	block;
+			uint64_t	used;
+			Bit8u		*data;
+		};
+		Block *lookup(FILE *file, uint64_t block);
+		Block *fill(FILE *file, uint64_t length, uint64_t block);
+		Block blocks[CACHE_BLOCKS];
+		mutex_t *lock;
+		uint64_t stamp;
+		FILE *lastFile;
+		uint64_t lastBlock;
+	};
+
 	class TrackFile {
 	public:
 		virtual bool read(Bit8u *buffer, uint64_t seek, uint64_t count) = 0;
@@ -106,7 +136,7 @@ private:
 	
 	class BinaryFile : public TrackFile {
 	public:
-		BinaryFile(const char *filename, bool &error);
+		BinaryFile(const char *filename, bool &error, BlockCache *cache);
 		~BinaryFile();
 		bool read(Bit8u *buffer, uint64_t seek, uint64_t count);
 		uint64_t getLength();
@@ -114,6 +144,8 @@ private:
 		BinaryFile();
 		char fn[260];
 		FILE *file;
+		uint64_t length;
+		BlockCache *cache;
 	};
 	
 	struct Track {
@@ -151,6 +183,7 @@ public:
         bool    HasAudioTracks          (void);
 	
         int     GetTrack                (unsigned int sector);
+	void	GetCacheStats		(uint64_t& hits, uint64_t& misses);
 
 private:
 	// player
@@ -167,6 +200,7 @@ static	void	CDAudioCallBack(Bitu len);
 	bool	GetCueString(std::string &str, std::istream &in);
 	bool	AddTrack(Track &curr, uint64_t &shift, uint64_t prestart, uint64_t &totalPregap, uint64_t currPregap);
 
+	BlockCache	cache;
 	std::vector<Track>	tracks;
 typedef	std::vector<Track>::iterator	track_it;
 	std::string	mcn;
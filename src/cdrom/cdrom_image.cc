@@ -21,6 +21,8 @@
 #define __USE_LARGEFILE64
 #define _LARGEFILE_SOURCE
 #define _LARGEFILE64_SOURCE
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -213,11 +215,15 @@ static void
 image_exit(cdrom_t *dev)
 {
     CDROM_Interface_Image *img = (CDROM_Interface_Image *)dev->image;
+    uint64_t hits, misses;
 
 cdrom_image_log("CDROM: image_exit(%ls)\n", dev->image_path);
     dev->cd_status = CD_STATUS_EMPTY;
 
     if (img) {
+	img->GetCacheStats(hits, misses);
+	cdrom_image_log("CDROM: image cache %" PRIu64 " hits, %" PRIu64 " misses\n",
+			hits, misses);
 	delete img;
 	dev->image = NULL;
     }
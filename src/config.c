@@ -535,6 +535,8 @@ load_machine(void)
 
     cpu_use_dynarec = !!config_get_int(cat, "cpu_use_dynarec", 0);
 
+    cpu_use_kvm = !!config_get_int(cat, "cpu_use_kvm", 0);
+
     enable_external_fpu = !!config_get_int(cat, "cpu_enable_fpu", 0);
 
     p = config_get_string(cat, "time_sync", NULL);
@@ -938,6 +940,14 @@ load_hard_disks(void)
 #endif
 	wcsncpy(hdd[c].fn, wp, sizeof_w(hdd[c].fn));
 
+	sprintf(temp, "hdd_%02i_overlay", c+1);
+	hdd[c].overlay = config_get_int(cat, temp, HDD_OVERLAY_NONE);
+	if (hdd[c].overlay > HDD_OVERLAY_COMMIT)
+		hdd[c].overlay = HDD_OVERLAY_NONE;
+
+	sprintf(temp, "hdd_%02i_mmap", c+1);
+	hdd[c].mmap = !!config_get_int(cat, temp, 0);
+
 	/* If disk is empty or invalid, mark it for deletion. */
 	if (! hdd_is_valid(c)) {
 		sprintf(temp, "hdd_%02i_parameters", c+1);
@@ -954,6 +964,12 @@ load_hard_disks(void)
 
 		sprintf(temp, "hdd_%02i_fn", c+1);
 		config_delete_var(cat, temp);
+
+		sprintf(temp, "hdd_%02i_overlay", c+1);
+		config_delete_var(cat, temp);
+
+		sprintf(temp, "hdd_%02i_mmap", c+1);
+		config_delete_var(cat, temp);
 	}
 
 	sprintf(temp, "hdd_%02i_mfm_channel", c+1);
@@ -1422,6 +1438,11 @@ save_machine(void)
 
     config_set_int(cat, "cpu_use_dynarec", cpu_use_dynarec);
 
+    if (cpu_use_kvm == 0)
+	config_delete_var(cat, "cpu_use_kvm");
+      else
+	config_set_int(cat, "cpu_use_kvm", cpu_use_kvm);
+
     if (enable_external_fpu == 0)
 	config_delete_var(cat, "cpu_enable_fpu");
       else
@@ -1746,6 +1767,18 @@ save_hard_disks(void)
 		config_set_wstring(cat, temp, hdd[c].fn);
 	else
 		config_delete_var(cat, temp);
+
+	sprintf(temp, "hdd_%02i_overlay", c+1);
+	if (hdd_is_valid(c) && (hdd[c].overlay != HDD_OVERLAY_NONE))
+		config_set_int(cat, temp, hdd[c].overlay);
+	else
+		config_delete_var(cat, temp);
+
+	sprintf(temp, "hdd_%02i_mmap", c+1);
+	if (hdd_is_valid(c) && hdd[c].mmap)
+		config_set_int(cat, temp, hdd[c].mmap);
+	else
+		config_delete_var(cat, temp);
     }
 
     delete_section_if_empty(cat);
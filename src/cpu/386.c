@@ -129,14 +129,227 @@ x386_log(const char *fmt, ...)
 #endif
 
 
+/*
+ * Predecoded instruction cache.
+ *
+ * The first time an instruction is fetched from a page, its handler,
+ * the bytes that follow the opcode and the effect of any operand size,
+ * address size or segment override prefixes are stored in a per-page
+ * record, indexed by the offset of the instruction in the page. The
+ * next time the same address is executed, exec386() applies the folded
+ * prefixes and calls the stored handler directly, without the fetch,
+ * the table lookups and the calls through the prefix handlers.
+ *
+ * Pages are keyed on their physical address. RAM pages are tracked
+ * through their page_t, whose write handlers drop the records of any
+ * bytes that change; plain ROM pages cannot change, so only a memory
+ * remap (which flushes everything) makes them stale. Anything else,
+ * such as flash or device memory, is not cached.
+ */
+#define PDC_SLOTS       64
+#define PDC_PREFIX_MAX  4
+
+typedef struct
+{
+        OpFn            fn;             /* handler after the prefixes */
+        uint32_t        dat;            /* bytes after the final opcode */
+        uint16_t        tag;            /* owner, 0 = invalid */
+        uint16_t        use32;          /* code size it was decoded for */
+        uint16_t        op32;           /* op32 after the prefixes */
+        uint8_t         opcode;         /* first byte */
+        uint8_t         len;            /* prefixes + final opcode */
+        uint8_t         cyc;            /* cycles taken by the prefixes */
+        uint8_t         seg;            /* segment override + 1, or 0 */
+} pdc_ent_t;
+
+typedef struct x386_pdc_t
+{
+        uint32_t        phys;           /* physical page, or -1 */
+        uint16_t        tag;            /* tag of the live records */
+        page_t          *page;          /* RAM page, NULL for ROM */
+        pdc_ent_t       ent[4096];
+} x386_pdc_t;
+
+static x386_pdc_t       *pdc_slots[PDC_SLOTS];
+static x386_pdc_t       *pdc_cur;       /* page of the current instruction */
+static uint32_t         pdc_lin = 0xffffffff;
+static uint8_t          *pdc_host;
+static const OpFn       *pdc_opcodes;
+static x86seg * const   pdc_segs[6] = { &_es, &_cs, &_ss, &_ds, &_fs, &_gs };
+
+int pdc_hits, pdc_misses;
+
+
+static void x386_pdc_release(x386_pdc_t *pdc)
+{
+        if (pdc->page)
+                pdc->page->pdc = NULL;
+        pdc->page = NULL;
+        pdc->phys = 0xffffffff;
+
+        /*Retire all records at once; only clear them when the tag wraps*/
+        if (!++pdc->tag)
+        {
+                memset(pdc->ent, 0, sizeof(pdc->ent));
+                pdc->tag = 1;
+        }
+}
+
+/*Called from the RAM write handlers when bytes of a predecoded page change*/
+void x386_pdc_invalidate(x386_pdc_t *pdc, uint32_t addr, int len)
+{
+        int start = (addr & 0xfff) - (PDC_PREFIX_MAX + 3);
+        int end = (addr & 0xfff) + len;
+        int c;
+
+        /*A record covers its prefixes and up to 3 bytes after the opcode*/
+        if (start < 0)
+                start = 0;
+        if (end > 0x1000)
+                end = 0x1000;
+        for (c = start; c < end; c++)
+                pdc->ent[c].tag = 0;
+}
+
+void x386_pdc_flush(void)
+{
+        int c;
+
+        for (c = 0; c < PDC_SLOTS; c++)
+        {
+                if (pdc_slots[c])
+                        x386_pdc_release(pdc_slots[c]);
+        }
+        pdc_cur = NULL;
+        pdc_lin = 0xffffffff;
+}
+
+/*Find or claim the record for the page holding linear address 'addr'.
+  Only called right after the instruction fetch from that page, so
+  pccache2 points at the memory the instruction was read from.*/
+static x386_pdc_t *x386_pdc_lookup(uint32_t addr)
+{
+        x386_pdc_t *pdc;
+        page_t *page = NULL;
+        uint32_t phys;
+        uint8_t *host;
+        int ro;
+
+        phys = get_phys_noabrt(addr);
+        if (phys == 0xffffffff)
+                return NULL;
+        phys &= ~0xfff;
+
+        pdc = pdc_slots[(phys >> 12) & (PDC_SLOTS - 1)];
+        if (pdc && pdc->phys == phys)
+                return pdc;
+
+        host = mem_page_host(phys, &ro);
+        if (!host || host != &pccache2[addr & ~0xfff])
+                return NULL;
+        if ((phys >> 12) < pages_sz && pages[phys >> 12].mem == host)
+                page = &pages[phys >> 12];
+        else if (!ro || (host >= ram && host < (ram + (mem_size << 10))))
+                return NULL;
+
+        if (!pdc)
+        {
+                pdc = malloc(sizeof(x386_pdc_t));
+                if (!pdc)
+                        return NULL;
+                memset(pdc, 0, sizeof(x386_pdc_t));
+                pdc->tag = 1;
+                pdc_slots[(phys >> 12) & (PDC_SLOTS - 1)] = pdc;
+        }
+        else
+                x386_pdc_release(pdc);
+
+        pdc->phys = phys;
+        if (page)
+        {
+                /*Route all writes to the page through its write handlers*/
+                pdc->page = page;
+                page->pdc = pdc;
+                mem_flush_write_page(phys, addr);
+        }
+
+        return pdc;
+}
+
+/*Decode the instruction at 'p', which has 'room' bytes left in its page
+  beyond the 4 the plain fetch reads.*/
+static void x386_pdc_decode(pdc_ent_t *ent, uint8_t *p, int room)
+{
+        int op32 = cpu_state.op32;
+        int len = 0, cyc = 0, seg = 0;
+
+        while (len < room && len < PDC_PREFIX_MAX)
+        {
+                switch (p[len])
+                {
+                        case 0x26: seg = 1; cyc += 4; break;
+                        case 0x2e: seg = 2; cyc += 4; break;
+                        case 0x36: seg = 3; cyc += 4; break;
+                        case 0x3e: seg = 4; cyc += 4; break;
+                        case 0x64: if (!is386) goto done; seg = 5; cyc += 4; break;
+                        case 0x65: if (!is386) goto done; seg = 6; cyc += 4; break;
+                        case 0x66:
+                        if (!is386) goto done;
+                        op32 = ((use32 & 0x100) ^ 0x100) | (op32 & 0x200);
+                        cyc += 2;
+                        break;
+                        case 0x67:
+                        if (!is386) goto done;
+                        op32 = ((use32 & 0x200) ^ 0x200) | (op32 & 0x100);
+                        cyc += 2;
+                        break;
+                        default:
+                        goto done;
+                }
+                len++;
+        }
+done:
+        ent->fn = x86_opcodes[p[len] | op32];
+        ent->dat = *(uint32_t *)&p[len] >> 8;
+        ent->use32 = cpu_state.op32;
+        ent->op32 = op32;
+        ent->opcode = p[0];
+        ent->len = len + 1;
+        ent->cyc = cyc;
+        ent->seg = seg;
+}
+
+/*Apply the effects of the prefixes folded into a record*/
+static void x386_pdc_prefixes(pdc_ent_t *ent)
+{
+        cpu_state.op32 = ent->op32;
+        cycles -= ent->cyc;
+        if (cpu_prefetch_cycles)
+                prefetch_prefixes += ent->len - 1;
+        if (ent->seg)
+        {
+                cpu_state.ea_seg = pdc_segs[ent->seg - 1];
+                cpu_state.ssegs = 1;
+        }
+}
+
+
 void exec386(int cycs)
 {
+        pdc_ent_t *ent;
         uint8_t temp;
         uint32_t addr;
         int tempi;
         int cycdiff;
         int oldcyc;
 
+        /*The handler tables change with the CPU type*/
+        if (x86_opcodes != pdc_opcodes)
+        {
+                x386_pdc_flush();
+                pdc_opcodes = x86_opcodes;
+        }
+
         cycles+=cycs;
         /* output=3; */
         while (cycles>0)
@@ -165,20 +378,63 @@ dontprint=0;
 
                 cpu_state.ea_seg = &_ds;
                 cpu_state.ssegs = 0;
-                
-                fetchdat = fastreadl(cs + cpu_state.pc);
 
-                if (!cpu_state.abrt)
-                {               
+                addr = cs + cpu_state.pc;
+                ent = NULL;
+                if ((addr >> 12) == pdc_lin && pccache == pdc_lin && pccache2 == pdc_host && pdc_cur)
+                {
+                        ent = &pdc_cur->ent[addr & 0xfff];
+                        if (ent->tag != pdc_cur->tag || ent->use32 != cpu_state.op32)
+                                ent = NULL;
+                }
+
+                if (ent)
+                {
+                        pdc_hits++;
                         trap = flags & T_FLAG;
-                        opcode = fetchdat & 0xFF;
-                        fetchdat >>= 8;
+                        opcode = ent->opcode;
+                        fetchdat = ent->dat;
 
-                        cpu_state.pc++;
-                        x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                        cpu_state.pc += ent->len;
+                        if (ent->len > 1)
+                                x386_pdc_prefixes(ent);
+                        ent->fn(fetchdat);
 			if (x86_was_reset)
 				break;
-			if(x86_was_reset) break;
+                }
+                else
+                {
+                        fetchdat = fastreadl(addr);
+
+                        if (!cpu_state.abrt)
+                        {
+                                trap = flags & T_FLAG;
+                                opcode = fetchdat & 0xFF;
+                                fetchdat >>= 8;
+
+                                pdc_misses++;
+                                if ((addr & 0xfff) <= 0xffc)
+                                {
+                                        if ((addr >> 12) != pdc_lin || pccache2 != pdc_host)
+                                        {
+                                                /*Also remember pages that cannot be cached*/
+                                                pdc_cur = x386_pdc_lookup(addr);
+                                                pdc_lin = addr >> 12;
+                                                pdc_host = pccache2;
+                                        }
+                                        if (pdc_cur)
+                                        {
+                                                ent = &pdc_cur->ent[addr & 0xfff];
+                                                x386_pdc_decode(ent, &pccache2[addr], 0xffc - (addr & 0xfff));
+                                                ent->tag = pdc_cur->tag;
+                                        }
+                                }
+
+                                cpu_state.pc++;
+                                x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                                if (x86_was_reset)
+                                        break;
+                        }
                 }
 
                 if (!use32) cpu_state.pc &= 0xffff;
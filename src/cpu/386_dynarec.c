@@ -37,6 +37,9 @@ int cpu_notreps, cpu_notreps_latched;
 int inrecomp = 0;
 int cpu_recomp_blocks, cpu_recomp_full_ins, cpu_new_blocks;
 int cpu_recomp_blocks_latched, cpu_recomp_ins_latched, cpu_recomp_full_ins_latched, cpu_new_blocks_latched;
+int cpu_recomp_deferred, cpu_recomp_deferred_latched;
+
+int codegen_compile_budget;
 
 int cpu_block_end = 0;
 
@@ -373,7 +376,7 @@ void x86illegal()
   internal cache on 486+ CPUs is enabled.
 */
 static int prefetch_bytes = 0;
-static int prefetch_prefixes = 0;
+int prefetch_prefixes = 0;
 
 static void prefetch_run(int instr_cycles, int bytes, int modrm, int reads, int reads_l, int writes, int writes_l, int ea32)
 {
@@ -547,6 +550,51 @@ int dontprint=0;
 #ifdef USE_DYNAREC
 static int cycles_main = 0;
 
+/*Interpret from the current PC to the end of the block, without touching
+  the code cache*/
+static void exec386_dynarec_int()
+{
+        cpu_block_end = 0;
+        x86_was_reset = 0;
+        while (!cpu_block_end)
+        {
+                oldcs=CS;
+                cpu_state.oldpc = cpu_state.pc;
+                oldcpl=CPL;
+                cpu_state.op32 = use32;
+
+                cpu_state.ea_seg = &_ds;
+                cpu_state.ssegs = 0;
+
+                fetchdat = fastreadl(cs + cpu_state.pc);
+                if (!cpu_state.abrt)
+                {               
+                        trap = flags & T_FLAG;
+                        opcode = fetchdat & 0xFF;
+                        fetchdat >>= 8;
+
+                        cpu_state.pc++;
+                        x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                }
+
+                if (!use32) cpu_state.pc &= 0xffff;
+
+                if (((cs + cpu_state.pc) >> 12) != pccache)
+                        CPU_BLOCK_END();
+
+                if (cpu_state.abrt)
+                        CPU_BLOCK_END();
+                if (trap)
+                        CPU_BLOCK_END();
+
+                if (nmi && nmi_enable && nmi_mask)
+                        CPU_BLOCK_END();
+
+                ins++;
+        }
+}
+
+
 void exec386_dynarec(int cycs)
 {
         uint8_t temp;
@@ -559,6 +607,7 @@ void exec386_dynarec(int cycs)
         int cyc_period = cycs / 2000; /*5us*/
 
         cycles_main += cycs;
+        codegen_compile_budget = CODEGEN_COMPILE_BUDGET;
         while (cycles_main > 0)
         {
                 int cycles_start;
@@ -579,55 +628,8 @@ void exec386_dynarec(int cycs)
                 oldcyc=cycles;
                 if (!CACHE_ON()) /*Interpret block*/
                 {
-                        cpu_block_end = 0;
-			x86_was_reset = 0;
-                        while (!cpu_block_end)
-                        {
-                                oldcs=CS;
-                                cpu_state.oldpc = cpu_state.pc;
-                                oldcpl=CPL;
-                                cpu_state.op32 = use32;
-
-                                cpu_state.ea_seg = &_ds;
-                                cpu_state.ssegs = 0;
-                
-                                fetchdat = fastreadl(cs + cpu_state.pc);
-                                if (!cpu_state.abrt)
-                                {               
-                                        trap = flags & T_FLAG;
-                                        opcode = fetchdat & 0xFF;
-                                        fetchdat >>= 8;
-
-                                        cpu_state.pc++;
-                                        x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
-                                }
-
-                                if (!use32) cpu_state.pc &= 0xffff;
-
-                                if (((cs + cpu_state.pc) >> 12) != pccache)
-                                        CPU_BLOCK_END();
-
-/*                                if (ssegs)
-                                {
-                                        ds=oldds;
-                                        ss=oldss;
-                                        ssegs=0;
-                                }*/
-                                if (cpu_state.abrt)
-                                        CPU_BLOCK_END();
-                                if (trap)
-                                        CPU_BLOCK_END();
-
-                                if (nmi && nmi_enable && nmi_mask)
-                                        CPU_BLOCK_END();
-
-                                ins++;
-                                
-/*                                if ((cs + pc) == 4)
-                                        fatal("4\n");*/
-/*                                if (ins >= 141400000)
-                                        output = 3;*/
-                        }
+                        codegen_exit_link = NULL;
+                        exec386_dynarec_int();
                 }
                 else
                 {
@@ -709,6 +711,10 @@ void exec386_dynarec(int cycs)
                         void (*code)() = (void *)&block->data[BLOCK_START];
 
                         codeblock_hash[hash] = block;
+                        block->hits++;
+                        if (codegen_exit_link)
+                                codegen_block_link(codegen_exit_link, block);
+                        codegen_exit_link = NULL;
 
 inrecomp=1;
                         code();
@@ -716,8 +722,19 @@ inrecomp=0;
                         if (!use32) cpu_state.pc &= 0xffff;
                         cpu_recomp_blocks++;
                 }
+                else if (valid_block && !cpu_state.abrt &&
+                         (block->hits < CODEGEN_HOT_VISITS || codegen_compile_budget <= 0))
+                {
+                        /*Not hot yet, or over the compile budget*/
+                        if (block->hits >= CODEGEN_HOT_VISITS)
+                                cpu_recomp_deferred++;
+                        block->hits++;
+                        codegen_exit_link = NULL;
+                        exec386_dynarec_int();
+                }
                 else if (valid_block && !cpu_state.abrt)
                 {
+                        codegen_compile_budget--;
                         start_pc = cpu_state.pc;
                         
                         cpu_block_end = 0;
@@ -863,6 +880,7 @@ inrecomp=0;
                 
                 if (cpu_state.abrt)
                 {
+                        codegen_exit_link = NULL;
                         flags_rebuild();
                         tempi = cpu_state.abrt;
                         cpu_state.abrt = 0;
@@ -890,7 +908,7 @@ inrecomp=0;
                 
                 if (trap)
                 {
-
+                        codegen_exit_link = NULL;
                         flags_rebuild();
                         if (msw&1)
                         {
@@ -911,6 +929,7 @@ inrecomp=0;
                 }
                 else if (nmi && nmi_enable && nmi_mask)
                 {
+                        codegen_exit_link = NULL;
                         cpu_state.oldpc = cpu_state.pc;
                         oldcs = CS;
                         x86_int(2);
@@ -927,6 +946,7 @@ inrecomp=0;
                         if (temp!=0xFF)
                         {
                                 CPU_BLOCK_END();
+                                codegen_exit_link = NULL;
                                 flags_rebuild();
                                 if (msw&1)
                                 {
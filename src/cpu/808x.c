@@ -114,11 +114,18 @@ uint8_t readmemb(uint32_t a)
         else return *(uint8_t *)(readlookup2[(a) >> 12] + (a));
 }
 
+/*Instruction fetch. Code running from the BIOS misses readlookup2 on
+  every byte, so take it straight from the ROM image rather than going
+  through the mapping handlers.*/
 uint8_t readmembf(uint32_t a)
 {
+        uint8_t *host;
+
         if (readlookup2 == NULL)  return readmembl(a);
-        if (readlookup2[(a)>>12]==-1) return readmembl(a);
-        else return *(uint8_t *)(readlookup2[(a) >> 12] + (a));
+        if (readlookup2[(a)>>12]!=-1) return *(uint8_t *)(readlookup2[(a) >> 12] + (a));
+        host=mem_fetch_host(a);
+        if (host) return host[a&0xfff];
+        return readmembl(a);
 }
 
 uint16_t readmemw(uint32_t s, uint16_t a)
@@ -183,9 +190,17 @@ int ins=0;
 
 int fetchcycles=0,memcycs,fetchclocks;
 
-uint8_t prefetchqueue[6];
+/*The prefetch queue is a ring, so taking a byte off the front does not
+  have to move the rest of it down. prefetchr is the head, prefetchw the
+  number of bytes queued.*/
+#define PREFETCH_MASK 7
+uint8_t prefetchqueue[PREFETCH_MASK+1];
 uint16_t prefetchpc;
+int prefetchr=0;
 int prefetchw=0;
+#define PREFETCHPUSH()  { prefetchqueue[(prefetchr+prefetchw)&PREFETCH_MASK]=readmembf(cs+prefetchpc); \
+                          prefetchpc++;                                                                  \
+                          prefetchw++; }
 static __inline uint8_t FETCH()
 {
         uint8_t temp;
@@ -198,22 +213,12 @@ static __inline uint8_t FETCH()
                 temp=readmembf(cs+cpu_state.pc);
                 prefetchpc = cpu_state.pc = cpu_state.pc + 1;
                 if (is8086 && (cpu_state.pc&1))
-                {
-                        prefetchqueue[0]=readmembf(cs+cpu_state.pc);
-                        prefetchpc++;
-                        prefetchw++;
-                }
+                        PREFETCHPUSH();
         }
         else
         {
-                temp=prefetchqueue[0];
-                prefetchqueue[0]=prefetchqueue[1];
-                prefetchqueue[1]=prefetchqueue[2];
-                prefetchqueue[2]=prefetchqueue[3];
-		if (is8086) {
-               		prefetchqueue[3]=prefetchqueue[4];
-               		prefetchqueue[4]=prefetchqueue[5];
-		}
+                temp=prefetchqueue[prefetchr];
+                prefetchr=(prefetchr+1)&PREFETCH_MASK;
                 prefetchw--;
                 fetchcycles-=4;
                 cpu_state.pc++;
@@ -231,17 +236,9 @@ static __inline void FETCHADD(int c)
         {
                 d-=4;
                 if (is8086 && !(prefetchpc&1))
-                {
-                        prefetchqueue[prefetchw]=readmembf(cs+prefetchpc);
-                        prefetchpc++;
-                        prefetchw++;
-                }
+                        PREFETCHPUSH();
 		if (prefetchw<((is8086)?6:4))
-                {
-                        prefetchqueue[prefetchw]=readmembf(cs+prefetchpc);
-                        prefetchpc++;
-                        prefetchw++;
-                }
+                        PREFETCHPUSH();
         }
         fetchcycles+=c;
         if (fetchcycles>16) fetchcycles=16;
@@ -255,23 +252,16 @@ void FETCHCOMPLETE()
         cycles-=(4-(fetchcycles&3));
         fetchclocks+=(4-(fetchcycles&3));
                 if (is8086 && !(prefetchpc&1))
-                {
-                        prefetchqueue[prefetchw]=readmembf(cs+prefetchpc);
-                        prefetchpc++;
-                        prefetchw++;
-                }
+                        PREFETCHPUSH();
 		if (prefetchw<((is8086)?6:4))
-                {
-                        prefetchqueue[prefetchw]=readmembf(cs+prefetchpc);
-                        prefetchpc++;
-                        prefetchw++;
-                }
+                        PREFETCHPUSH();
                 fetchcycles+=(4-(fetchcycles&3));
 }
 
 static __inline void FETCHCLEAR()
 {
         prefetchpc=cpu_state.pc;
+        prefetchr=0;
         prefetchw=0;
         memcycs=cycdiff-cycles;
         fetchclocks=0;
@@ -73,6 +73,70 @@
   same page).
 */
 
+/*Code cache :
+
+  Codeblock metadata lives in a fixed table of BLOCK_SIZE entries, while the
+  host code itself is placed in a separate arena of CODE_SEGS segments, each
+  CODE_SEG_SIZE bytes. A block is only given arena space when it is actually
+  recompiled (see below), and only keeps as much as it used, so short blocks
+  no longer tie up a full BLOCK_DATA_SIZE slot.
+
+  New code is appended to the current segment. When the arena is full, the
+  coldest segment is reclaimed as a whole and all blocks in it drop back to
+  the 'marked but not recompiled' state. Coldness is the sum of the hit
+  counters of the blocks in the segment; the counters are halved on every
+  reclaim so that they reflect recent use, and the CODE_NURSERY most recently
+  filled segments are never picked, so new code gets a chance to warm up.
+
+  Metadata slots are handed out by a clock hand that skips (and ages) blocks
+  with a non-zero hit count, rather than strictly round-robin.
+*/
+
+/*Tiered compilation :
+
+  A block is marked on its first execution, then interpreted for another
+  CODEGEN_HOT_VISITS executions (counted in hits) before it is recompiled.
+  Recompilation runs alongside interpretation on the CPU thread, so each
+  call of exec386_dynarec() (10ms of emulated time) may only recompile
+  CODEGEN_COMPILE_BUDGET blocks; hot blocks over the budget keep being
+  interpreted and are picked up by a later call. Bursts of new code, such as
+  a program being loaded, then cost a bounded amount of host time per call
+  instead of stalling the emulator (and audio) until they are all compiled.
+*/
+#define CODEGEN_HOT_VISITS 2
+#define CODEGEN_COMPILE_BUDGET 256
+
+extern int codegen_compile_budget;
+
+/*Block chaining (x86-64 hosts only) :
+
+  Every compiled block has two exits that can be chained to a successor -
+  the shared exit at BLOCK_EXIT_OFFSET (taken branches, aborts) and the
+  fall-through at the end of the block. Each exit loads its codeblock_link_t
+  into RDX and jumps to a common stub, either the chain check (when linked)
+  or the plain return to exec386_dynarec() (when not).
+
+  The chain check re-does the dispatcher's work against the linked block :
+  no abort, cycles left, no pending interrupt/NMI/trap, CS:PC, status and
+  dirty mask match, and no MMU flush since the link was made. If any of these
+  fail, the block returns to the dispatcher with codegen_exit_link set, and
+  the dispatcher links that exit to whatever block it runs next.
+
+  Links are undone when the target block is deleted, evicted from the code
+  arena, or recompiled. Blocks spanning two pages are never linked to.
+*/
+struct codeblock_t;
+
+typedef struct codeblock_link_t
+{
+        struct codeblock_t *owner, *to;
+        /*List of links into the same target block*/
+        struct codeblock_link_t *prev, *next;
+        /*JMP rel32 in the owner's code that is patched to link and unlink*/
+        uint8_t *site;
+        uint32_t epoch;
+} codeblock_link_t;
+
 typedef struct codeblock_t
 {
         uint64_t page_mask, page_mask2;
@@ -104,7 +168,16 @@ typedef struct codeblock_t
         uint32_t status;
         uint32_t flags;
 
-        uint8_t data[2048];
+        /*Number of times the compiled code has been run, halved whenever an
+          arena segment is reclaimed*/
+        uint32_t hits;
+
+        /*Host code, in the code arena. Only valid if was_recompiled is set*/
+        uint8_t *data;
+
+        codeblock_link_t link[2];
+        /*Links from other blocks into this one*/
+        codeblock_link_t *link_in;
 } codeblock_t;
 
 /*Code block uses FPU*/
@@ -304,6 +377,10 @@ void codegen_generate_seg_restore();
 void codegen_set_op32();
 void codegen_flush();
 void codegen_check_flush(page_t *page, uint64_t mask, uint32_t phys_addr);
+void codegen_block_link(codeblock_link_t *link, codeblock_t *block);
+
+/*Exit the last compiled block left through, set by the generated code*/
+extern codeblock_link_t *codegen_exit_link;
 
 extern int cpu_block_end;
 extern uint32_t codegen_endpc;
@@ -314,6 +391,9 @@ extern int cpu_recomp_flushes, cpu_recomp_flushes_latched;
 extern int cpu_recomp_evicted, cpu_recomp_evicted_latched;
 extern int cpu_recomp_reuse, cpu_recomp_reuse_latched;
 extern int cpu_recomp_removed, cpu_recomp_removed_latched;
+extern int cpu_recomp_misses, cpu_recomp_misses_latched;
+extern int cpu_recomp_purged, cpu_recomp_purged_latched;
+extern int cpu_recomp_deferred, cpu_recomp_deferred_latched;
 
 extern int cpu_reps, cpu_reps_latched;
 extern int cpu_notreps, cpu_notreps_latched;
@@ -503,10 +503,13 @@ static inline void STORE_IMM_ADDR_L(uintptr_t addr, uint32_t val)
 {
         if (addr >= (uintptr_t)&cpu_state && addr < ((uintptr_t)&cpu_state)+0x100)
         {
+                int pos = block_pos;
+
                 addbyte(0xC7); /*MOVL [addr],val*/
                 addbyte(0x45);
                 addbyte(addr - (uintptr_t)&cpu_state - 128);
                 addlong(val);
+                codegen_store_note(addr, pos);
         }
         else if (addr < 0x100000000)
         {
@@ -1725,9 +1728,12 @@ static inline void STORE_HOST_REG_ADDR_BL(uintptr_t addr, int host_reg)
         }
         if (addr >= (uintptr_t)&cpu_state && addr < ((uintptr_t)&cpu_state)+0x100)
         {
+                int pos = block_pos;
+
                 addbyte(0x89); /*MOV addr, temp_reg*/
                 addbyte(0x45 | (temp_reg << 3));
                 addbyte((uint32_t)addr - (uint32_t)(uintptr_t)&cpu_state - 128);
+                codegen_store_note(addr, pos);
         }
         else if (IS_32_ADDR(addr))
         {
@@ -1759,9 +1765,12 @@ static inline void STORE_HOST_REG_ADDR_WL(uintptr_t addr, int host_reg)
         addbyte(0xc0 | (temp_reg << 3) | (host_reg & 7));
         if (addr >= (uintptr_t)&cpu_state && addr < ((uintptr_t)&cpu_state)+0x100)
         {
+                int pos = block_pos;
+
                 addbyte(0x89); /*MOV addr, temp_reg*/
                 addbyte(0x45 | (temp_reg << 3));
                 addbyte((uint32_t)addr - (uint32_t)(uintptr_t)&cpu_state - 128);
+                codegen_store_note(addr, pos);
         }
         else if (IS_32_ADDR(addr))
         {
@@ -1817,11 +1826,14 @@ static inline void STORE_HOST_REG_ADDR(uintptr_t addr, int host_reg)
 {
         if (addr >= (uintptr_t)&cpu_state && addr < ((uintptr_t)&cpu_state)+0x100)
         {
+                int pos = block_pos;
+
                 if (host_reg & 8)
                         addbyte(0x44);
                 addbyte(0x89); /*MOVL [addr],host_reg*/
                 addbyte(0x45 | ((host_reg & 7) << 3));
                 addbyte((uint32_t)addr - (uint32_t)(uintptr_t)&cpu_state - 128);
+                codegen_store_note(addr, pos);
         }
         else if (IS_32_ADDR(addr))
         {
@@ -3,7 +3,9 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #define HAVE_STDARG_H
 #include "../86box.h"
 #include "cpu.h"
@@ -12,6 +14,8 @@
 #include "x86_ops.h"
 #include "x87.h"
 #include "../mem.h"
+#include "../nmi.h"
+#include "../pic.h"
 
 #include "386_common.h"
 
@@ -46,12 +50,27 @@ int codegen_mmx_entered = 0;
 
 int block_current = 0;
 static int block_num;
+static int block_hand = 0;
 int block_pos;
 
+static uint8_t *code_arena;
+static int code_seg;
+static int code_seg_pos;
+static int code_segs_used;
+static uint32_t code_gen;
+static uint32_t code_seg_gen[CODE_SEGS];
+
+codeblock_link_t *codegen_exit_link;
+static uint32_t codegen_link_epoch;
+static int codegen_link_ok;
+static uint8_t *codegen_link_check, *codegen_link_out;
+
 int cpu_recomp_flushes, cpu_recomp_flushes_latched;
 int cpu_recomp_evicted, cpu_recomp_evicted_latched;
 int cpu_recomp_reuse, cpu_recomp_reuse_latched;
 int cpu_recomp_removed, cpu_recomp_removed_latched;
+int cpu_recomp_misses, cpu_recomp_misses_latched;
+int cpu_recomp_purged, cpu_recomp_purged_latched;
 
 uint32_t codegen_endpc;
 
@@ -63,6 +82,378 @@ static uint32_t last_op32;
 static x86seg *last_ea_seg;
 static int last_ssegs;
 
+/*Dead store elimination :
+
+  Recompiled instructions write cpu_state.pc and the lazy flag state to
+  memory as they go. In a run of register/immediate instructions that can
+  not fault, leave the block or read the flags, only the last of these
+  writes is ever seen. codegen_store_note() records where each one was
+  emitted, and once a later instruction in the run has rewritten a field the
+  earlier store is overwritten with a NOP of the same length.*/
+enum
+{
+        STORE_PC = 0,
+        STORE_FLAGS_OP,
+        STORE_FLAGS_RES,
+        STORE_FLAGS_OP1,
+        STORE_FLAGS_OP2,
+        STORE_MAX
+};
+
+enum
+{
+        STORE_CLASS_NONE = 0, /*May observe or leave the block*/
+        STORE_CLASS_NEUTRAL,  /*Does not touch the flags*/
+        STORE_CLASS_FLAGS     /*Rewrites all of the lazy flag state*/
+};
+
+/*Stores from earlier instructions in the run, and from the current one*/
+static int store_pending[STORE_MAX], store_pending_len[STORE_MAX];
+static int store_new[STORE_MAX], store_new_len[STORE_MAX];
+
+static void codegen_store_reset()
+{
+        int c;
+
+        for (c = 0; c < STORE_MAX; c++)
+                store_pending[c] = store_new[c] = -1;
+}
+
+#ifdef ENABLE_CODEGEN_LOG
+int codegen_do_log = ENABLE_CODEGEN_LOG;
+
+
+static void
+codegen_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (codegen_do_log) {
+	va_start(ap, fmt);
+	pclog_ex(fmt, ap);
+	va_end(ap);
+    }
+}
+#else
+#define codegen_log(fmt, ...)
+#endif
+
+static void codegen_arena_reset()
+{
+        code_seg = 0;
+        code_seg_pos = 0;
+        code_segs_used = 1;
+        code_gen = 0;
+        memset(code_seg_gen, 0, sizeof(code_seg_gen));
+}
+
+/*Offset of a global from RBP, which points 128 bytes into cpu_state*/
+static int64_t codegen_rbp_offset(void *p)
+{
+        return (int64_t)((intptr_t)p - ((intptr_t)&cpu_state + 128));
+}
+
+static void codegen_addrbp(void *p)
+{
+        addlong((uint32_t)codegen_rbp_offset(p));
+}
+
+/*Generate the two stubs shared by all block exits. On entry RDX points to
+  the codeblock_link_t of the exit being taken.*/
+static void codegen_link_init()
+{
+        void *globals[] = {&codegen_link_epoch, &pic_intpending, &nmi, &flags, &cr0, &_cs, &cpu_cur_status, &oldcs, &oldcpl, &codegen_exit_link};
+        uint8_t *jump_out[16];
+        int nr_jumps = 0;
+        int c;
+
+        codegen_link_ok = 1;
+        for (c = 0; c < (int)(sizeof(globals) / sizeof(globals[0])); c++)
+        {
+                int64_t offset = codegen_rbp_offset(globals[c]);
+
+                if (offset < -0x7fffff00 || offset > 0x7fffff00)
+                        codegen_link_ok = 0;
+        }
+
+        block_pos = 0;
+        codegen_link_check = &codeblock[block_current].data[block_pos];
+
+        addbyte(0x48); /*MOV RAX, [RDX+to]*/
+        addbyte(0x8b);
+        addbyte(0x82);
+        addlong(offsetof(codeblock_link_t, to));
+        addbyte(0x80); /*CMP abrt, 0*/
+        addbyte(0x7d);
+        addbyte((uint8_t)cpu_state_offset(abrt));
+        addbyte(0);
+        addbyte(0x0f); /*JNE out*/
+        addbyte(0x85);
+        jump_out[nr_jumps++] = &codeblock[block_current].data[block_pos];
+        addlong(0);
+        addbyte(0x83); /*CMP cycles, 0*/
+        addbyte(0x7d);
+        addbyte((uint8_t)cpu_state_offset(_cycles));
+        addbyte(0);
+        addbyte(0x0f); /*JLE out*/
+        addbyte(0x8e);
+        jump_out[nr_jumps++] = &codeblock[block_current].data[block_pos];
+        addlong(0);
+        addbyte(0x8b); /*MOV ECX, codegen_link_epoch*/
+        addbyte(0x8d);
+        codegen_addrbp(&codegen_link_epoch);
+        addbyte(0x3b); /*CMP ECX, [RDX+epoch]*/
+        addbyte(0x8a);
+        addlong(offsetof(codeblock_link_t, epoch));
+        addbyte(0x0f); /*JNE out*/
+        addbyte(0x85);
+        jump_out[nr_jumps++] = &codeblock[block_current].data[block_pos];
+        addlong(0);
+        addbyte(0x8b); /*MOV ECX, pic_intpending*/
+        addbyte(0x8d);
+        codegen_addrbp(&pic_intpending);
+        addbyte(0x0b); /*OR ECX, nmi*/
+        addbyte(0x8d);
+        codegen_addrbp(&nmi);
+        addbyte(0x0f); /*JNZ out*/
+        addbyte(0x85);
+        jump_out[nr_jumps++] = &codeblock[block_current].data[block_pos];
+        addlong(0);
+        addbyte(0x66); /*TEST flags, T_FLAG*/
+        addbyte(0xf7);
+        addbyte(0x85);
+        codegen_addrbp(&flags);
+        addword(T_FLAG);
+        addbyte(0x0f); /*JNZ out*/
+        addbyte(0x85);
+        jump_out[nr_jumps++] = &codeblock[block_current].data[block_pos];
+        addlong(0);
+        addbyte(0xf7); /*TEST cr0, CD*/
+        addbyte(0x85);
+        codegen_addrbp(&cr0);
+        addlong(1 << 30);
+        addbyte(0x0f); /*JNZ out*/
+        addbyte(0x85);
+        jump_out[nr_jumps++] = &codeblock[block_current].data[block_pos];
+        addlong(0);
+        addbyte(0xf7); /*TEST cpu_cur_status, CPU_STATUS_USE32*/
+        addbyte(0x85);
+        codegen_addrbp(&cpu_cur_status);
+        addlong(CPU_STATUS_USE32);
+        addbyte(0x75); /*JNZ +7*/
+        addbyte(7);
+        addbyte(0x0f); /*MOVZX ECX, pc*/
+        addbyte(0xb7);
+        addbyte(0x4d);
+        addbyte((uint8_t)cpu_state_offset(pc));
+        addbyte(0x89); /*MOV pc, ECX*/
+        addbyte(0x4d);
+        addbyte((uint8_t)cpu_state_offset(pc));
+        addbyte(0x8b); /*MOV ECX, cs*/
+        addbyte(0x8d);
+        codegen_addrbp(&_cs.base);
+        addbyte(0x3b); /*CMP ECX, [RAX+_cs]*/
+        addbyte(0x88);
+        addlong(offsetof(codeblock_t, _cs));
+        addbyte(0x0f); /*JNE out*/
+        addbyte(0x85);
+        jump_out[nr_jumps++] = &codeblock[block_current].data[block_pos];
+        addlong(0);
+        addbyte(0x03); /*ADD ECX, pc*/
+        addbyte(0x4d);
+        addbyte((uint8_t)cpu_state_offset(pc));
+        addbyte(0x3b); /*CMP ECX, [RAX+pc]*/
+        addbyte(0x88);
+        addlong(offsetof(codeblock_t, pc));
+        addbyte(0x0f); /*JNE out*/
+        addbyte(0x85);
+        jump_out[nr_jumps++] = &codeblock[block_current].data[block_pos];
+        addlong(0);
+        addbyte(0x8b); /*MOV ECX, cpu_cur_status*/
+        addbyte(0x8d);
+        codegen_addrbp(&cpu_cur_status);
+        addbyte(0x3b); /*CMP ECX, [RAX+status]*/
+        addbyte(0x88);
+        addlong(offsetof(codeblock_t, status));
+        addbyte(0x0f); /*JNE out*/
+        addbyte(0x85);
+        jump_out[nr_jumps++] = &codeblock[block_current].data[block_pos];
+        addlong(0);
+        addbyte(0x48); /*MOV RCX, [RAX+dirty_mask]*/
+        addbyte(0x8b);
+        addbyte(0x88);
+        addlong(offsetof(codeblock_t, dirty_mask));
+        addbyte(0x48); /*MOV RCX, [RCX]*/
+        addbyte(0x8b);
+        addbyte(0x09);
+        addbyte(0x48); /*TEST RCX, [RAX+page_mask]*/
+        addbyte(0x85);
+        addbyte(0x88);
+        addlong(offsetof(codeblock_t, page_mask));
+        addbyte(0x0f); /*JNZ out*/
+        addbyte(0x85);
+        jump_out[nr_jumps++] = &codeblock[block_current].data[block_pos];
+        addlong(0);
+
+        /*Chaining to the block - do what exec386_dynarec() does before
+          running a block*/
+        addbyte(0xff); /*INC [RAX+hits]*/
+        addbyte(0x80);
+        addlong(offsetof(codeblock_t, hits));
+        addbyte(0x66); /*MOV CX, CS*/
+        addbyte(0x8b);
+        addbyte(0x8d);
+        codegen_addrbp(&_cs.seg);
+        addbyte(0x66); /*MOV oldcs, CX*/
+        addbyte(0x89);
+        addbyte(0x8d);
+        codegen_addrbp(&oldcs);
+        addbyte(0x0f); /*MOVZX ECX, _cs.access*/
+        addbyte(0xb6);
+        addbyte(0x8d);
+        codegen_addrbp(&_cs.access);
+        addbyte(0xc1); /*SHR ECX, 5*/
+        addbyte(0xe9);
+        addbyte(5);
+        addbyte(0x83); /*AND ECX, 3*/
+        addbyte(0xe1);
+        addbyte(3);
+        addbyte(0x89); /*MOV oldcpl, ECX*/
+        addbyte(0x8d);
+        codegen_addrbp(&oldcpl);
+        addbyte(0x8b); /*MOV ECX, pc*/
+        addbyte(0x4d);
+        addbyte((uint8_t)cpu_state_offset(pc));
+        addbyte(0x89); /*MOV oldpc, ECX*/
+        addbyte(0x4d);
+        addbyte((uint8_t)cpu_state_offset(oldpc));
+        addbyte(0x48); /*MOV RCX, [RAX+data]*/
+        addbyte(0x8b);
+        addbyte(0x88);
+        addlong(offsetof(codeblock_t, data));
+        addbyte(0x48); /*ADD RCX, BLOCK_BODY*/
+        addbyte(0x81);
+        addbyte(0xc1);
+        addlong(BLOCK_BODY);
+        addbyte(0xff); /*JMP RCX*/
+        addbyte(0xe1);
+
+        block_pos = (block_pos + 15) & ~15;
+        codegen_link_out = &codeblock[block_current].data[block_pos];
+        for (c = 0; c < nr_jumps; c++)
+                *(uint32_t *)jump_out[c] = (uint32_t)(codegen_link_out - (jump_out[c] + 4));
+
+        addbyte(0x48); /*MOV codegen_exit_link, RDX*/
+        addbyte(0x89);
+        addbyte(0x95);
+        codegen_addrbp(&codegen_exit_link);
+        addbyte(0x48); /*ADDL $40,%rsp*/
+        addbyte(0x83);
+        addbyte(0xC4);
+        addbyte(0x28);
+        addbyte(0x41); /*POP R15*/
+        addbyte(0x5f);
+        addbyte(0x41); /*POP R14*/
+        addbyte(0x5e);
+        addbyte(0x41); /*POP R13*/
+        addbyte(0x5d);
+        addbyte(0x41); /*POP R12*/
+        addbyte(0x5c);
+        addbyte(0x5f); /*POP RDI*/
+        addbyte(0x5e); /*POP RSI*/
+        addbyte(0x5d); /*POP RBP*/
+        addbyte(0x5b); /*POP RDX*/
+        addbyte(0xC3); /*RET*/
+
+        if (block_pos > BLOCK_DATA_SIZE)
+                fatal("Link stubs over limit!\n");
+}
+
+/*Emit a chainable exit for block. It starts out unlinked.*/
+static void codegen_link_slot(codeblock_t *block, int slot)
+{
+        codeblock_link_t *link = &block->link[slot];
+
+        link->owner = block;
+        link->to = NULL;
+        link->prev = link->next = NULL;
+
+        addbyte(0x48); /*MOV RDX, link*/
+        addbyte(0xba);
+        addquad((uintptr_t)link);
+        addbyte(0xe9); /*JMP codegen_link_out*/
+        link->site = &block->data[block_pos];
+        addlong((uint32_t)(codegen_link_out - &block->data[block_pos + 4]));
+}
+
+static void codegen_link_remove(codeblock_link_t *link)
+{
+        if (link->prev)
+                link->prev->next = link->next;
+        else
+                link->to->link_in = link->next;
+        if (link->next)
+                link->next->prev = link->prev;
+
+        link->to = NULL;
+        link->prev = link->next = NULL;
+}
+
+static void codegen_unlink(codeblock_link_t *link)
+{
+        codegen_link_remove(link);
+        *(uint32_t *)link->site = (uint32_t)(codegen_link_out - (link->site + 4));
+}
+
+/*Called when the code of block is about to go away. Links into it are
+  pointed back at the dispatcher; its own exits only need to come off their
+  target lists, as nothing will run them again.*/
+static void codegen_block_unlink(codeblock_t *block)
+{
+        int c;
+
+        while (block->link_in)
+                codegen_unlink(block->link_in);
+
+        for (c = 0; c < 2; c++)
+        {
+                if (block->link[c].to)
+                        codegen_link_remove(&block->link[c]);
+        }
+}
+
+void codegen_block_link(codeblock_link_t *link, codeblock_t *block)
+{
+        codeblock_t *owner = link->owner;
+
+        if (!codegen_link_ok || !owner->valid || !owner->was_recompiled)
+                return;
+        /*The chain check only looks at the first page*/
+        if (block->page_mask2 || (block->flags & CODEBLOCK_STATIC_TOP))
+                return;
+
+        link->epoch = codegen_link_epoch;
+        if (link->to == block)
+                return;
+        if (link->to)
+                codegen_link_remove(link);
+        else
+        {
+                /*Only patch the owner's code when it goes from unlinked to
+                  linked; an exit that moves between targets is already
+                  routed through the check stub, and rewriting code that has
+                  just run is expensive on the host*/
+                *(uint32_t *)link->site = (uint32_t)(codegen_link_check - (link->site + 4));
+        }
+
+        link->to = block;
+        link->prev = NULL;
+        link->next = block->link_in;
+        if (block->link_in)
+                block->link_in->prev = link;
+        block->link_in = link;
+}
+
 void codegen_init()
 {
         int c;
@@ -74,28 +465,37 @@ void codegen_init()
 	long pagemask = ~(pagesize - 1);
 #endif
         
+        codeblock = malloc((BLOCK_SIZE+1) * sizeof(codeblock_t));
+        /*The arena is followed by room for the block chaining stubs, which
+          live in the extra codeblock at BLOCK_SIZE*/
 #if WIN64
-        codeblock = VirtualAlloc(NULL, BLOCK_SIZE * sizeof(codeblock_t), MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+        code_arena = VirtualAlloc(NULL, (CODE_SEGS * CODE_SEG_SIZE) + BLOCK_DATA_SIZE, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
 #else
-        codeblock = malloc(BLOCK_SIZE * sizeof(codeblock_t));
+        code_arena = malloc((CODE_SEGS * CODE_SEG_SIZE) + BLOCK_DATA_SIZE);
 #endif
         codeblock_hash = malloc(HASH_SIZE * sizeof(codeblock_t *));
 
-        memset(codeblock, 0, BLOCK_SIZE * sizeof(codeblock_t));
+        memset(codeblock, 0, (BLOCK_SIZE+1) * sizeof(codeblock_t));
         memset(codeblock_hash, 0, HASH_SIZE * sizeof(codeblock_t *));
 
         for (c = 0; c < BLOCK_SIZE; c++)
                 codeblock[c].valid = 0;
 
 #if defined(__linux__) || defined(__APPLE__)
-	start = (void *)((long)codeblock & pagemask);
-	len = ((BLOCK_SIZE * sizeof(codeblock_t)) + pagesize) & pagemask;
+	start = (void *)((long)code_arena & pagemask);
+	len = (((CODE_SEGS * CODE_SEG_SIZE) + BLOCK_DATA_SIZE) + pagesize) & pagemask;
 	if (mprotect(start, len, PROT_READ | PROT_WRITE | PROT_EXEC) != 0)
 	{
 		perror("mprotect");
 		exit(-1);
 	}
 #endif
+
+        codegen_arena_reset();
+
+        block_current = BLOCK_SIZE;
+        codeblock[block_current].data = &code_arena[CODE_SEGS * CODE_SEG_SIZE];
+        codegen_link_init();
 }
 
 void codegen_reset()
@@ -108,6 +508,9 @@ void codegen_reset()
 
         for (c = 0; c < BLOCK_SIZE; c++)
                 codeblock[c].valid = 0;
+
+        codegen_arena_reset();
+        codegen_exit_link = NULL;
 }
 
 void dump_block()
@@ -210,6 +613,7 @@ static void delete_block(codeblock_t *block)
                 fatal("Deleting deleted block\n");
         block->valid = 0;
 
+        codegen_block_unlink(block);
         codeblock_tree_delete(block);
         remove_from_block_list(block, old_pc);
 }
@@ -245,6 +649,101 @@ void codegen_check_flush(page_t *page, uint64_t mask, uint32_t phys_addr)
         }
 }
 
+/*Pick the metadata slot for a new block. Up to 16 slots are looked at; the
+  first free or cold one is taken, and any hot ones passed over are aged, so
+  a block has to keep running to keep its slot.*/
+static int codegen_block_victim()
+{
+        uint32_t best_hits = 0xffffffff;
+        int best = block_hand;
+        int c;
+
+        for (c = 0; c < 16; c++)
+        {
+                codeblock_t *block;
+
+                block_hand = (block_hand + 1) & BLOCK_MASK;
+                block = &codeblock[block_hand];
+
+                if (!block->valid || !block->hits)
+                        return block_hand;
+                if (block->hits < best_hits)
+                {
+                        best_hits = block->hits;
+                        best = block_hand;
+                }
+                block->hits >>= 1;
+        }
+
+        return best;
+}
+
+/*Reclaim the coldest arena segment outside the nursery. Every block with code
+  in it goes back to being marked but not recompiled.*/
+static int codegen_arena_reclaim()
+{
+        uint32_t heat[CODE_SEGS];
+        uint8_t *start, *end;
+        int c, victim = -1;
+
+        memset(heat, 0, sizeof(heat));
+        for (c = 0; c < BLOCK_SIZE; c++)
+        {
+                codeblock_t *block = &codeblock[c];
+
+                if (block->valid && block->data)
+                        heat[(block->data - code_arena) / CODE_SEG_SIZE] += block->hits;
+                block->hits >>= 1;
+        }
+
+        for (c = 0; c < CODE_SEGS; c++)
+        {
+                if ((code_gen - code_seg_gen[c]) < CODE_NURSERY)
+                        continue;
+                if (victim == -1 || heat[c] < heat[victim])
+                        victim = c;
+        }
+
+        start = &code_arena[victim * CODE_SEG_SIZE];
+        end = start + CODE_SEG_SIZE;
+        for (c = 0; c < BLOCK_SIZE; c++)
+        {
+                codeblock_t *block = &codeblock[c];
+
+                if (block->data >= start && block->data < end)
+                {
+                        if (block->valid && block->was_recompiled)
+                                cpu_recomp_purged++;
+                        if (block->valid)
+                                codegen_block_unlink(block);
+                        block->data = NULL;
+                        block->was_recompiled = 0;
+                }
+        }
+
+        codegen_log("CODEGEN: reclaimed segment %i (heat %u), hits %i misses %i reuse %i purged %i\n",
+                    victim, heat[victim], cpu_recomp_blocks, cpu_recomp_misses, cpu_recomp_reuse, cpu_recomp_purged);
+
+        return victim;
+}
+
+/*Reserve BLOCK_DATA_SIZE bytes of arena for the block about to be recompiled.
+  codegen_block_end_recompile() only commits what was actually used.*/
+static uint8_t *codegen_arena_alloc()
+{
+        if ((code_seg_pos + BLOCK_DATA_SIZE) > CODE_SEG_SIZE)
+        {
+                if (code_segs_used < CODE_SEGS)
+                        code_seg = code_segs_used++;
+                else
+                        code_seg = codegen_arena_reclaim();
+                code_seg_gen[code_seg] = ++code_gen;
+                code_seg_pos = 0;
+        }
+
+        return &code_arena[(code_seg * CODE_SEG_SIZE) + code_seg_pos];
+}
+
 void codegen_block_init(uint32_t phys_addr)
 {
         codeblock_t *block;
@@ -253,7 +752,7 @@ void codegen_block_init(uint32_t phys_addr)
         if (!page->block[(phys_addr >> 10) & 3])
                 mem_flush_write_page(phys_addr, cs+cpu_state.pc);
 
-        block_current = (block_current + 1) & BLOCK_MASK;
+        block_current = codegen_block_victim();
         block = &codeblock[block_current];
 
         if (block->valid != 0)
@@ -264,8 +763,13 @@ void codegen_block_init(uint32_t phys_addr)
         block_num = HASH(phys_addr);
         codeblock_hash[block_num] = &codeblock[block_current];
 
+        cpu_recomp_misses++;
+        codegen_exit_link = NULL;
+
 	block->valid = 1;
         block->ins = 0;
+        block->hits = 0;
+        block->data = NULL;
         block->pc = cs + cpu_state.pc;
         block->_cs = cs;
         block->pnt = block_current;
@@ -299,7 +803,10 @@ void codegen_block_start_recompile(codeblock_t *block)
                 fatal("Recompile to used block!\n");
 
         block->status = cpu_cur_status;
-        
+        codegen_exit_link = NULL;
+        codegen_block_unlink(block);
+        block->data = codegen_arena_alloc();
+
         block_pos = BLOCK_GPF_OFFSET;
 #if WIN64
         addbyte(0x48); /*XOR RCX, RCX*/
@@ -318,25 +825,9 @@ void codegen_block_start_recompile(codeblock_t *block)
 	while (block_pos < BLOCK_EXIT_OFFSET)
 	       addbyte(0x90); /*NOP*/
         block_pos = BLOCK_EXIT_OFFSET; /*Exit code*/
-        addbyte(0x48); /*ADDL $40,%rsp*/
-        addbyte(0x83);
-        addbyte(0xC4);
-        addbyte(0x28);
-        addbyte(0x41); /*POP R15*/
-        addbyte(0x5f);
-        addbyte(0x41); /*POP R14*/
-        addbyte(0x5e);
-        addbyte(0x41); /*POP R13*/
-        addbyte(0x5d);
-        addbyte(0x41); /*POP R12*/
-        addbyte(0x5c);
-        addbyte(0x5f); /*POP RDI*/
-        addbyte(0x5e); /*POP RSI*/
-        addbyte(0x5d); /*POP RBP*/
-        addbyte(0x5b); /*POP RDX*/
-        addbyte(0xC3); /*RET*/
+        codegen_link_slot(block, 0);
         cpu_block_end = 0;
-        block_pos = 0; /*Entry code*/
+        block_pos = BLOCK_START; /*Entry code*/
         addbyte(0x53); /*PUSH RBX*/
         addbyte(0x55); /*PUSH RBP*/
         addbyte(0x56); /*PUSH RSI*/
@@ -356,10 +847,13 @@ void codegen_block_start_recompile(codeblock_t *block)
         addbyte(0x48); /*MOVL RBP, &cpu_state*/
         addbyte(0xBD);
         addquad(((uintptr_t)&cpu_state) + 128);
+        if (block_pos != BLOCK_BODY)
+                fatal("Bad block entry size\n");
 
         last_op32 = -1;
         last_ea_seg = NULL;
         last_ssegs = -1;
+        codegen_store_reset();
         
         codegen_block_cycles = 0;
         codegen_timing_block_start();
@@ -491,26 +985,11 @@ void codegen_block_end_recompile(codeblock_t *block)
                 addlong(codegen_block_full_ins);
         }
 #endif
-        addbyte(0x48); /*ADDL $40,%rsp*/
-        addbyte(0x83);
-        addbyte(0xC4);
-        addbyte(0x28);
-        addbyte(0x41); /*POP R15*/
-        addbyte(0x5f);
-        addbyte(0x41); /*POP R14*/
-        addbyte(0x5e);
-        addbyte(0x41); /*POP R13*/
-        addbyte(0x5d);
-        addbyte(0x41); /*POP R12*/
-        addbyte(0x5c);
-        addbyte(0x5f); /*POP RDI*/
-        addbyte(0x5e); /*POP RSI*/
-        addbyte(0x5d); /*POP RBP*/
-        addbyte(0x5b); /*POP RDX*/
-        addbyte(0xC3); /*RET*/
+        codegen_link_slot(block, 1);
         
-        if (block_pos > BLOCK_GPF_OFFSET)
+        if (block_pos > BLOCK_DATA_SIZE)
                 fatal("Over limit!\n");
+        code_seg_pos += (block_pos + 15) & ~15;
 
         remove_from_block_list(block, block->pc);
         block->next = block->prev = NULL;
@@ -519,9 +998,11 @@ void codegen_block_end_recompile(codeblock_t *block)
         add_to_block_list(block);
 }
 
+/*Called on MMU flushes; chained exits made before now are no longer
+  trusted to reach the right physical page*/
 void codegen_flush()
 {
-        return;
+        codegen_link_epoch++;
 }
 
 static int opcode_modrm[256] =
@@ -899,6 +1380,130 @@ static x86seg *codegen_generate_ea_32_long(x86seg *op_ea_seg, uint32_t fetchdat,
         return op_ea_seg;
 }
 //#endif
+void codegen_store_note(uintptr_t addr, int pos)
+{
+        int field;
+
+        if (addr == (uintptr_t)&cpu_state.pc)
+                field = STORE_PC;
+        else if (addr == (uintptr_t)&cpu_state.flags_op)
+                field = STORE_FLAGS_OP;
+        else if (addr == (uintptr_t)&cpu_state.flags_res)
+                field = STORE_FLAGS_RES;
+        else if (addr == (uintptr_t)&cpu_state.flags_op1)
+                field = STORE_FLAGS_OP1;
+        else if (addr == (uintptr_t)&cpu_state.flags_op2)
+                field = STORE_FLAGS_OP2;
+        else
+                return;
+
+        store_new[field] = pos;
+        store_new_len[field] = block_pos - pos;
+}
+
+static void codegen_store_kill(int field)
+{
+        uint8_t *p = &codeblock[block_current].data[store_pending[field]];
+
+        switch (store_pending_len[field])
+        {
+                case 3:
+                p[0] = 0x0f; p[1] = 0x1f; p[2] = 0x00; /*NOP [RAX]*/
+                break;
+                case 4:
+                p[0] = 0x0f; p[1] = 0x1f; p[2] = 0x40; p[3] = 0x00; /*NOP [RAX+0]*/
+                break;
+                case 7:
+                p[0] = 0x0f; p[1] = 0x1f; p[2] = 0x80; /*NOP [RAX+0]*/
+                p[3] = p[4] = p[5] = p[6] = 0x00;
+                break;
+                default:
+                return;
+        }
+        store_pending[field] = -1;
+}
+
+/*Classify an instruction that is about to be recompiled. Only the forms
+  that can not touch memory are considered; ADC/SBB/INC/DEC read the carry
+  and so are left out.*/
+static int codegen_store_class(const OpFn *op_table, uint8_t opcode, uint32_t fetchdat)
+{
+        int is_reg = ((fetchdat & 0xc0) == 0xc0);
+
+        if (op_table != (OpFn *)x86_dynarec_opcodes)
+                return STORE_CLASS_NONE;
+
+        if (opcode < 0x40 && (opcode & 7) < 6)
+        {
+                /*ADD, OR, AND, SUB, XOR, CMP*/
+                if ((opcode & 0x38) == 0x10 || (opcode & 0x38) == 0x18)
+                        return STORE_CLASS_NONE;
+                if ((opcode & 7) < 4 && !is_reg)
+                        return STORE_CLASS_NONE;
+                return STORE_CLASS_FLAGS;
+        }
+
+        switch (opcode)
+        {
+                case 0x80: case 0x81: case 0x83:
+                if (!is_reg || (fetchdat & 0x30) == 0x10)
+                        return STORE_CLASS_NONE;
+                return STORE_CLASS_FLAGS;
+
+                case 0x84: case 0x85: /*TEST*/
+                return is_reg ? STORE_CLASS_FLAGS : STORE_CLASS_NONE;
+                case 0xa8: case 0xa9:
+                return STORE_CLASS_FLAGS;
+
+                case 0x88: case 0x89: case 0x8a: case 0x8b: /*MOV*/
+                return is_reg ? STORE_CLASS_NEUTRAL : STORE_CLASS_NONE;
+                case 0x8d: /*LEA*/
+                return is_reg ? STORE_CLASS_NONE : STORE_CLASS_NEUTRAL;
+                case 0xb0: case 0xb1: case 0xb2: case 0xb3:
+                case 0xb4: case 0xb5: case 0xb6: case 0xb7:
+                case 0xb8: case 0xb9: case 0xba: case 0xbb:
+                case 0xbc: case 0xbd: case 0xbe: case 0xbf:
+                return STORE_CLASS_NEUTRAL;
+        }
+
+        return STORE_CLASS_NONE;
+}
+
+/*Called once an instruction has been generated*/
+static void codegen_store_end(int class)
+{
+        int c;
+
+        if (class == STORE_CLASS_NONE)
+        {
+                codegen_store_reset();
+                return;
+        }
+
+        if (store_new[STORE_PC] != -1 && store_pending[STORE_PC] != -1)
+                codegen_store_kill(STORE_PC);
+        if (class == STORE_CLASS_FLAGS && store_new[STORE_FLAGS_OP] != -1 && store_new[STORE_FLAGS_RES] != -1)
+        {
+                /*Logical ops set FLAGS_ZN, which never reads op1/op2, so
+                  those are dead whether or not this instruction wrote them*/
+                for (c = STORE_FLAGS_OP; c < STORE_MAX; c++)
+                {
+                        if (store_pending[c] != -1)
+                                codegen_store_kill(c);
+                }
+        }
+
+        for (c = 0; c < STORE_MAX; c++)
+        {
+                if (store_new[c] != -1)
+                {
+                        store_pending[c] = store_new[c];
+                        store_pending_len[c] = store_new_len[c];
+                        store_new[c] = -1;
+                }
+        }
+}
+
 void codegen_generate_call(uint8_t opcode, OpFn op, uint32_t fetchdat, uint32_t new_pc, uint32_t old_pc)
 {
         codeblock_t *block = &codeblock[block_current];
@@ -1102,11 +1707,17 @@ generate_call:
 
         if (recomp_op_table && recomp_op_table[(opcode | op_32) & 0x1ff])
         {
-                uint32_t new_pc = recomp_op_table[(opcode | op_32) & 0x1ff](opcode, fetchdat, op_32, op_pc, block);
+                int store_class = codegen_store_class(op_table, opcode, fetchdat);
+                uint32_t new_pc;
+
+                if (store_class == STORE_CLASS_NONE)
+                        codegen_store_reset();
+                new_pc = recomp_op_table[(opcode | op_32) & 0x1ff](opcode, fetchdat, op_32, op_pc, block);
                 if (new_pc)
                 {
                         if (new_pc != -1)
                                 STORE_IMM_ADDR_L((uintptr_t)&cpu_state.pc, new_pc);
+                        codegen_store_end(store_class);
 
                         codegen_block_ins++;
                         block->ins++;
@@ -1117,6 +1728,7 @@ generate_call:
                 }
         }
 
+        codegen_store_reset();
         op = op_table[((opcode >> opcode_shift) | op_32) & opcode_mask];
         if (op_ssegs != last_ssegs)
         {
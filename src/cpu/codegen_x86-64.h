@@ -1,22 +1,36 @@
-#define BLOCK_SIZE 0x4000
-#define BLOCK_MASK 0x3fff
-#define BLOCK_START 0
+#define BLOCK_SIZE 0x10000
+#define BLOCK_MASK 0xffff
+#define BLOCK_START 0x30
+/*Start of the block body, after the entry code that saves registers and
+  loads RBP. Chained exits jump straight here.*/
+#define BLOCK_BODY (BLOCK_START + 26)
 
 #define HASH_SIZE 0x20000
 #define HASH_MASK 0x1ffff
 
 #define HASH(l) ((l) & 0x1ffff)
 
-#define BLOCK_EXIT_OFFSET 0x7e0
-#define BLOCK_GPF_OFFSET (BLOCK_EXIT_OFFSET - 20)
+/*The GPF and exit stubs sit in front of the entry code, so that a block can
+  be trimmed to the size it actually used*/
+#define BLOCK_GPF_OFFSET 0
+#define BLOCK_EXIT_OFFSET 0x14
 
 #define BLOCK_MAX 1620
+/*Arena space reserved while a block is being recompiled*/
+#define BLOCK_DATA_SIZE 0x800
+
+#define CODE_SEG_SIZE (512 << 10)
+#define CODE_SEGS 64
+#define CODE_NURSERY 8
 
 enum
 {
         OP_RET = 0xc3
 };
 
+/*Record a store to cpu_state emitted at pos, for dead store elimination*/
+void codegen_store_note(uintptr_t addr, int pos);
+
 #define NR_HOST_REGS 4
 extern int host_reg_mapping[NR_HOST_REGS];
 #define NR_HOST_XMM_REGS 8
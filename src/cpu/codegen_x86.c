@@ -38,11 +38,13 @@
  */
 #if defined i386 || defined __i386 || defined __i386__ || defined _X86_ || defined _WIN32
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <wchar.h>
+#define HAVE_STDARG_H
 #include "../86box.h"
 #include "cpu.h"
 #include "../mem.h"
@@ -85,12 +87,22 @@ codeblock_t **codeblock_hash;
 
 int block_current = 0;
 static int block_num;
+static int block_hand = 0;
 int block_pos;
 
+static uint8_t *code_arena;
+static int code_seg;
+static int code_seg_pos;
+static int code_segs_used;
+static uint32_t code_gen;
+static uint32_t code_seg_gen[CODE_SEGS];
+
 int cpu_recomp_flushes, cpu_recomp_flushes_latched;
 int cpu_recomp_evicted, cpu_recomp_evicted_latched;
 int cpu_recomp_reuse, cpu_recomp_reuse_latched;
 int cpu_recomp_removed, cpu_recomp_removed_latched;
+int cpu_recomp_misses, cpu_recomp_misses_latched;
+int cpu_recomp_purged, cpu_recomp_purged_latched;
 
 uint32_t codegen_endpc;
 
@@ -102,6 +114,25 @@ static uint32_t last_op32;
 static x86seg *last_ea_seg;
 static int last_ssegs;
 
+#ifdef ENABLE_CODEGEN_LOG
+int codegen_do_log = ENABLE_CODEGEN_LOG;
+
+
+static void
+codegen_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (codegen_do_log) {
+	va_start(ap, fmt);
+	pclog_ex(fmt, ap);
+	va_end(ap);
+    }
+}
+#else
+#define codegen_log(fmt, ...)
+#endif
+
 static uint32_t mem_abrt_rout;
 uint32_t mem_load_addr_ea_b;
 uint32_t mem_load_addr_ea_w;
@@ -1158,6 +1189,15 @@ static uint32_t gen_MEM_CHECK_WRITE_L()
         return addr;
 }
 
+static void codegen_arena_reset()
+{
+        code_seg = 0;
+        code_seg_pos = 0;
+        code_segs_used = 1;
+        code_gen = 0;
+        memset(code_seg_gen, 0, sizeof(code_seg_gen));
+}
+
 void codegen_init()
 {
 #ifdef __linux__
@@ -1167,10 +1207,13 @@ void codegen_init()
 	long pagemask = ~(pagesize - 1);
 #endif
         
+        codeblock = malloc((BLOCK_SIZE+1) * sizeof(codeblock_t));
+        /*The arena is followed by room for the memory access helpers, which
+          live in the extra codeblock at BLOCK_SIZE*/
 #ifdef _WIN32
-        codeblock = VirtualAlloc(NULL, (BLOCK_SIZE+1) * sizeof(codeblock_t), MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+        code_arena = VirtualAlloc(NULL, (CODE_SEGS * CODE_SEG_SIZE) + BLOCK_DATA_SIZE, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
 #else
-        codeblock = malloc((BLOCK_SIZE+1) * sizeof(codeblock_t));
+        code_arena = malloc((CODE_SEGS * CODE_SEG_SIZE) + BLOCK_DATA_SIZE);
 #endif
         codeblock_hash = malloc(HASH_SIZE * sizeof(codeblock_t *));
 
@@ -1178,8 +1221,8 @@ void codegen_init()
         memset(codeblock_hash, 0, HASH_SIZE * sizeof(codeblock_t *));
 
 #ifdef __linux__
-	start = (void *)((long)codeblock & pagemask);
-	len = (((BLOCK_SIZE+1) * sizeof(codeblock_t)) + pagesize) & pagemask;
+	start = (void *)((long)code_arena & pagemask);
+	len = (((CODE_SEGS * CODE_SEG_SIZE) + BLOCK_DATA_SIZE) + pagesize) & pagemask;
 	if (mprotect(start, len, PROT_READ | PROT_WRITE | PROT_EXEC) != 0)
 	{
 		perror("mprotect");
@@ -1187,7 +1230,10 @@ void codegen_init()
 	}
 #endif
 
+        codegen_arena_reset();
+
         block_current = BLOCK_SIZE;
+        codeblock[block_current].data = &code_arena[CODE_SEGS * CODE_SEG_SIZE];
         block_pos = 0;
         mem_abrt_rout = (uint32_t)&codeblock[block_current].data[block_pos];        
         addbyte(0x83); /*ADDL $16+4,%esp*/
@@ -1251,6 +1297,8 @@ void codegen_reset()
         memset(codeblock, 0, BLOCK_SIZE * sizeof(codeblock_t));
         memset(codeblock_hash, 0, HASH_SIZE * sizeof(codeblock_t *));
         mem_reset_page_blocks();
+
+        codegen_arena_reset();
 }
 
 void dump_block()
@@ -1388,6 +1436,99 @@ void codegen_check_flush(page_t *page, uint64_t mask, uint32_t phys_addr)
         }
 }
 
+/*Pick the metadata slot for a new block. Up to 16 slots are looked at; the
+  first free or cold one is taken, and any hot ones passed over are aged, so
+  a block has to keep running to keep its slot.*/
+static int codegen_block_victim()
+{
+        uint32_t best_hits = 0xffffffff;
+        int best = block_hand;
+        int c;
+
+        for (c = 0; c < 16; c++)
+        {
+                codeblock_t *block;
+
+                block_hand = (block_hand + 1) & BLOCK_MASK;
+                block = &codeblock[block_hand];
+
+                if (!block->valid || !block->hits)
+                        return block_hand;
+                if (block->hits < best_hits)
+                {
+                        best_hits = block->hits;
+                        best = block_hand;
+                }
+                block->hits >>= 1;
+        }
+
+        return best;
+}
+
+/*Reclaim the coldest arena segment outside the nursery. Every block with code
+  in it goes back to being marked but not recompiled.*/
+static int codegen_arena_reclaim()
+{
+        uint32_t heat[CODE_SEGS];
+        uint8_t *start, *end;
+        int c, victim = -1;
+
+        memset(heat, 0, sizeof(heat));
+        for (c = 0; c < BLOCK_SIZE; c++)
+        {
+                codeblock_t *block = &codeblock[c];
+
+                if (block->valid && block->data)
+                        heat[(block->data - code_arena) / CODE_SEG_SIZE] += block->hits;
+                block->hits >>= 1;
+        }
+
+        for (c = 0; c < CODE_SEGS; c++)
+        {
+                if ((code_gen - code_seg_gen[c]) < CODE_NURSERY)
+                        continue;
+                if (victim == -1 || heat[c] < heat[victim])
+                        victim = c;
+        }
+
+        start = &code_arena[victim * CODE_SEG_SIZE];
+        end = start + CODE_SEG_SIZE;
+        for (c = 0; c < BLOCK_SIZE; c++)
+        {
+                codeblock_t *block = &codeblock[c];
+
+                if (block->data >= start && block->data < end)
+                {
+                        if (block->valid && block->was_recompiled)
+                                cpu_recomp_purged++;
+                        block->data = NULL;
+                        block->was_recompiled = 0;
+                }
+        }
+
+        codegen_log("CODEGEN: reclaimed segment %i (heat %u), hits %i misses %i reuse %i purged %i\n",
+                    victim, heat[victim], cpu_recomp_blocks, cpu_recomp_misses, cpu_recomp_reuse, cpu_recomp_purged);
+
+        return victim;
+}
+
+/*Reserve BLOCK_DATA_SIZE bytes of arena for the block about to be recompiled.
+  codegen_block_end_recompile() only commits what was actually used.*/
+static uint8_t *codegen_arena_alloc()
+{
+        if ((code_seg_pos + BLOCK_DATA_SIZE) > CODE_SEG_SIZE)
+        {
+                if (code_segs_used < CODE_SEGS)
+                        code_seg = code_segs_used++;
+                else
+                        code_seg = codegen_arena_reclaim();
+                code_seg_gen[code_seg] = ++code_gen;
+                code_seg_pos = 0;
+        }
+
+        return &code_arena[(code_seg * CODE_SEG_SIZE) + code_seg_pos];
+}
+
 void codegen_block_init(uint32_t phys_addr)
 {
         codeblock_t *block;
@@ -1396,7 +1537,7 @@ void codegen_block_init(uint32_t phys_addr)
         if (!page->block[(phys_addr >> 10) & 3])
                 mem_flush_write_page(phys_addr, cs+cpu_state.pc);
 
-        block_current = (block_current + 1) & BLOCK_MASK;
+        block_current = codegen_block_victim();
         block = &codeblock[block_current];
 
         if (block->valid != 0)
@@ -1407,8 +1548,12 @@ void codegen_block_init(uint32_t phys_addr)
         block_num = HASH(phys_addr);
         codeblock_hash[block_num] = &codeblock[block_current];
 
+        cpu_recomp_misses++;
+
 	block->valid = 1;
         block->ins = 0;
+        block->hits = 0;
+        block->data = NULL;
         block->pc = cs + cpu_state.pc;
         block->_cs = cs;
         block->pnt = block_current;
@@ -1442,6 +1587,7 @@ void codegen_block_start_recompile(codeblock_t *block)
                 fatal("Recompile to used block!\n");
 
         block->status = cpu_cur_status;
+        block->data = codegen_arena_alloc();
 
         block_pos = BLOCK_GPF_OFFSET;
         addbyte(0xc7); /*MOV [ESP],0*/
@@ -1465,7 +1611,7 @@ void codegen_block_start_recompile(codeblock_t *block)
         addbyte(0x5b); /*POP EDX*/
         addbyte(0xC3); /*RET*/
         cpu_block_end = 0;
-        block_pos = 0; /*Entry code*/
+        block_pos = BLOCK_START; /*Entry code*/
         addbyte(0x53); /*PUSH EBX*/
         addbyte(0x55); /*PUSH EBP*/
         addbyte(0x56); /*PUSH ESI*/
@@ -1618,8 +1764,9 @@ void codegen_block_end_recompile(codeblock_t *block)
         addbyte(0x5b); /*POP EDX*/
         addbyte(0xC3); /*RET*/
         
-        if (block_pos > BLOCK_GPF_OFFSET)
+        if (block_pos > BLOCK_DATA_SIZE)
                 fatal("Over limit!\n");
+        code_seg_pos += (block_pos + 15) & ~15;
 
         remove_from_block_list(block, block->pc);
         block->next = block->prev = NULL;
@@ -1636,6 +1783,14 @@ void codegen_flush()
         return;
 }
 
+/*Block chaining is only implemented by the x86-64 backend; every exit here
+  goes back through the dispatcher*/
+codeblock_link_t *codegen_exit_link;
+
+void codegen_block_link(codeblock_link_t *link, codeblock_t *block)
+{
+}
+
 static int opcode_modrm[256] =
 {
         1, 1, 1, 1,  0, 0, 0, 0,  1, 1, 1, 1,  0, 0, 0, 0,  /*00*/
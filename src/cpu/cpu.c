@@ -49,7 +49,9 @@
 #include "../io.h"
 #include "x86_ops.h"
 #include "../mem.h"
+#include "../nmi.h"
 #include "../pci.h"
+#include "../snapshot.h"
 #ifdef USE_DYNAREC
 # include "codegen.h"
 #endif
@@ -2275,3 +2277,163 @@ cpu_update_waitstates(void)
         if (cpu_s->rspeed <= 8000000)
                 cpu_rom_prefetch_cycles = cpu_mem_prefetch_cycles;
 }
+
+
+/* Bits of CPU state owned by the execution cores. */
+extern int	use32, stack32;
+extern uint32_t	x87_pc_off, x87_op_off;
+extern uint16_t	x87_pc_seg, x87_op_seg;
+
+
+/* Save the CPU state, including the FPU/MMX registers. */
+void
+cpu_state_save(snapshot_t *s)
+{
+#ifdef USE_KVM
+    /* The registers live in the vCPU while KVM runs the guest. */
+    if (cpu_kvm_active)
+	kvm_state_get();
+#endif
+
+    snapshot_write_var(s, cpu_state);
+    snapshot_write_var(s, flags);
+    snapshot_write_var(s, eflags);
+    snapshot_write_var(s, CR0);
+    snapshot_write_var(s, cr2);
+    snapshot_write_var(s, cr3);
+    snapshot_write_var(s, cr4);
+    snapshot_write_var(s, dr);
+    snapshot_write_var(s, gdt);
+    snapshot_write_var(s, ldt);
+    snapshot_write_var(s, idt);
+    snapshot_write_var(s, tr);
+    snapshot_write_var(s, _cs);
+    snapshot_write_var(s, _ds);
+    snapshot_write_var(s, _es);
+    snapshot_write_var(s, _ss);
+    snapshot_write_var(s, _fs);
+    snapshot_write_var(s, _gs);
+    snapshot_write_var(s, _oldds);
+    snapshot_write_var(s, oldds);
+    snapshot_write_var(s, oldss);
+    snapshot_write_var(s, olddslimit);
+    snapshot_write_var(s, oldsslimit);
+    snapshot_write_var(s, olddslimitw);
+    snapshot_write_var(s, oldsslimitw);
+    snapshot_write_var(s, use32);
+    snapshot_write_var(s, stack32);
+    snapshot_write_var(s, cpu_cur_status);
+    snapshot_write_var(s, x87_pc_off);
+    snapshot_write_var(s, x87_op_off);
+    snapshot_write_var(s, x87_pc_seg);
+    snapshot_write_var(s, x87_op_seg);
+    snapshot_write_var(s, nmi);
+    snapshot_write_var(s, nmi_mask);
+    snapshot_write_var(s, cpu_cache_int_enabled);
+    snapshot_write_var(s, cpu_cache_ext_enabled);
+    snapshot_write_var(s, tsc);
+    snapshot_write_var(s, msr);
+    snapshot_write_var(s, pmc);
+    snapshot_write_var(s, ccr0);
+    snapshot_write_var(s, ccr1);
+    snapshot_write_var(s, ccr2);
+    snapshot_write_var(s, ccr3);
+    snapshot_write_var(s, ccr4);
+    snapshot_write_var(s, ccr5);
+    snapshot_write_var(s, ccr6);
+
+    /* Optional parts go last, a build without them reads zeroes. */
+#if defined(DEV_BRANCH) && defined(USE_I686)
+    snapshot_write_var(s, cs_msr);
+    snapshot_write_var(s, esp_msr);
+    snapshot_write_var(s, eip_msr);
+    snapshot_write_var(s, apic_base_msr);
+    snapshot_write_var(s, mtrr_physbase_msr);
+    snapshot_write_var(s, mtrr_physmask_msr);
+    snapshot_write_var(s, mtrr_fix64k_8000_msr);
+    snapshot_write_var(s, mtrr_fix16k_8000_msr);
+    snapshot_write_var(s, mtrr_fix16k_a000_msr);
+    snapshot_write_var(s, mtrr_fix4k_msr);
+    snapshot_write_var(s, pat_msr);
+    snapshot_write_var(s, mtrr_deftype_msr);
+    snapshot_write_var(s, msr_ia32_pmc);
+#endif
+}
+
+
+void
+cpu_state_load(snapshot_t *s)
+{
+    snapshot_read_var(s, cpu_state);
+    snapshot_read_var(s, flags);
+    snapshot_read_var(s, eflags);
+    snapshot_read_var(s, CR0);
+    snapshot_read_var(s, cr2);
+    snapshot_read_var(s, cr3);
+    snapshot_read_var(s, cr4);
+    snapshot_read_var(s, dr);
+    snapshot_read_var(s, gdt);
+    snapshot_read_var(s, ldt);
+    snapshot_read_var(s, idt);
+    snapshot_read_var(s, tr);
+    snapshot_read_var(s, _cs);
+    snapshot_read_var(s, _ds);
+    snapshot_read_var(s, _es);
+    snapshot_read_var(s, _ss);
+    snapshot_read_var(s, _fs);
+    snapshot_read_var(s, _gs);
+    snapshot_read_var(s, _oldds);
+    snapshot_read_var(s, oldds);
+    snapshot_read_var(s, oldss);
+    snapshot_read_var(s, olddslimit);
+    snapshot_read_var(s, oldsslimit);
+    snapshot_read_var(s, olddslimitw);
+    snapshot_read_var(s, oldsslimitw);
+    snapshot_read_var(s, use32);
+    snapshot_read_var(s, stack32);
+    snapshot_read_var(s, cpu_cur_status);
+    snapshot_read_var(s, x87_pc_off);
+    snapshot_read_var(s, x87_op_off);
+    snapshot_read_var(s, x87_pc_seg);
+    snapshot_read_var(s, x87_op_seg);
+    snapshot_read_var(s, nmi);
+    snapshot_read_var(s, nmi_mask);
+    snapshot_read_var(s, cpu_cache_int_enabled);
+    snapshot_read_var(s, cpu_cache_ext_enabled);
+    snapshot_read_var(s, tsc);
+    snapshot_read_var(s, msr);
+    snapshot_read_var(s, pmc);
+    snapshot_read_var(s, ccr0);
+    snapshot_read_var(s, ccr1);
+    snapshot_read_var(s, ccr2);
+    snapshot_read_var(s, ccr3);
+    snapshot_read_var(s, ccr4);
+    snapshot_read_var(s, ccr5);
+    snapshot_read_var(s, ccr6);
+
+#if defined(DEV_BRANCH) && defined(USE_I686)
+    snapshot_read_var(s, cs_msr);
+    snapshot_read_var(s, esp_msr);
+    snapshot_read_var(s, eip_msr);
+    snapshot_read_var(s, apic_base_msr);
+    snapshot_read_var(s, mtrr_physbase_msr);
+    snapshot_read_var(s, mtrr_physmask_msr);
+    snapshot_read_var(s, mtrr_fix64k_8000_msr);
+    snapshot_read_var(s, mtrr_fix16k_8000_msr);
+    snapshot_read_var(s, mtrr_fix16k_a000_msr);
+    snapshot_read_var(s, mtrr_fix4k_msr);
+    snapshot_read_var(s, pat_msr);
+    snapshot_read_var(s, mtrr_deftype_msr);
+    snapshot_read_var(s, msr_ia32_pmc);
+#endif
+
+    /* This one is a pointer, and so is meaningless in a file. */
+    cpu_state.ea_seg = &_ds;
+
+    cpu_update_waitstates();
+
+#ifdef USE_KVM
+    if (cpu_kvm_active)
+	kvm_state_set();
+#endif
+}
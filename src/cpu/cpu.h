@@ -141,6 +141,7 @@ extern CPU	cpus_Pentium2D[];
 #define CR4_VME		(1 << 0)
 #define CR4_PVI		(1 << 1)
 #define CR4_PSE		(1 << 4)
+#define CR4_PGE		(1 << 7)
 
 #define CPL ((_cs.access>>5)&3)
 
@@ -392,6 +393,7 @@ extern x86seg	_oldds;
 
 extern int	cpu_cycles_read, cpu_cycles_read_l, cpu_cycles_write, cpu_cycles_write_l;
 extern int	cpu_prefetch_cycles, cpu_prefetch_width, cpu_mem_prefetch_cycles, cpu_rom_prefetch_cycles;
+extern int	prefetch_prefixes;
 extern int	cpu_waitstates;
 extern int	cpu_cache_int_enabled, cpu_cache_ext_enabled;
 extern int	cpu_pci_speed;
@@ -423,6 +425,8 @@ extern CPU	cpus_acer[];		// FIXME: should be in machine file!
 
 
 /* Functions. */
+struct x386_pdc_t;
+
 extern void	cyrix_write(uint16_t addr, uint8_t val, void *priv);
 extern uint8_t	cyrix_read(uint16_t addr, void *priv);
 extern void	loadseg(uint16_t seg, x86seg *s);
@@ -446,6 +450,17 @@ extern void	dumpregs(int __force);
 extern void	execx86(int cycs);
 extern void	exec386(int cycs);
 extern void	exec386_dynarec(int cycs);
+extern void	x386_pdc_invalidate(struct x386_pdc_t *pdc, uint32_t addr, int len);
+extern void	x386_pdc_flush(void);
+#ifdef USE_KVM
+extern int	cpu_kvm_active;
+extern void	exec386_kvm(int cycs);
+extern void	kvm_reset(void);
+extern void	kvm_remap(void);
+extern void	kvm_close(void);
+extern void	kvm_state_get(void);
+extern void	kvm_state_set(void);
+#endif
 extern int	idivl(int32_t val);
 extern void	loadcscall(uint16_t seg);
 extern void	loadcsjmp(uint16_t seg, uint32_t oxpc);
@@ -0,0 +1,912 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Hardware-assisted CPU backend using the Linux KVM API.
+ *
+ *		When enabled (cpu_use_kvm) on a 486 or better machine, the
+ *		guest CPU runs natively under /dev/kvm instead of in the
+ *		interpreter or the recompiler.  Everything else stays in
+ *		the emulator: port I/O exits go to the handlers in io.c,
+ *		accesses to memory without host backing (video memory,
+ *		device windows) go to the mem_mapping_t handlers, and
+ *		interrupts are taken from the emulated PIC.
+ *
+ *		Guest RAM, and any page whose read mapping has host memory
+ *		behind it (ROM, shadow RAM), is given to KVM as memory
+ *		slots built from the physical page descriptors.  The slots
+ *		are rebuilt whenever the memory mappings change.  ROM that
+ *		is not page-aligned in host memory is mapped from a
+ *		read-only copy.
+ *
+ *		Time is kept by charging the emulated clock for the host
+ *		time spent in the guest, so the emulated timers fire when
+ *		they are due; a POSIX timer kicks the vCPU out of KVM_RUN
+ *		when the next timer event comes up.  Slices are never made
+ *		shorter than KVM_SLICE_MIN, as entering the guest costs
+ *		more than that many nanoseconds of emulated time would
+ *		buy; timers that fall inside a slice fire late, in order.
+ *		A HLT skips ahead to the next timer event.
+ *
+ *		The A20 gate is not emulated under KVM; the guest always
+ *		sees the full address space.  The guest sees the host CPU
+ *		through CPUID, as reported by KVM.
+ *
+ *		If KVM is not available, or the machine is not a 486 or
+ *		better, the regular CPU cores are used.
+ *
+ *		For snapshots, the vCPU registers, segments and FPU are
+ *		copied to the emulated CPU before it is saved, and back
+ *		after it is loaded, so snapshots move freely between KVM
+ *		and the regular cores. Debug registers, MSRs and events
+ *		that KVM has pending in the vCPU are not carried over.
+ *
+ * Version:	@(#)kvm.c	1.0.0	2026/10/18
+ *
+ * Author:	agent, <agent@local>
+ *
+ *		Copyright 2026 agent.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/kvm.h>
+#define HAVE_STDARG_H
+#include "../86box.h"
+#include "cpu.h"
+#include "x86.h"
+#include "386.h"
+#include "../machine/machine.h"
+#include "../io.h"
+#include "../mem.h"
+#include "../nmi.h"
+#include "../pic.h"
+#include "../timer.h"
+
+
+/* x87 registers are kept as the host's long double. */
+#if !defined(__i386__) && !defined(__x86_64__)
+# error KVM needs an x86 host
+#endif
+
+/* These clash with the segment registers in struct kvm_sregs. */
+#undef cs
+#undef ds
+#undef es
+#undef ss
+#undef gs
+#undef cr0
+
+#ifndef sigev_notify_thread_id
+# define sigev_notify_thread_id	_sigev_un._tid
+#endif
+
+#define KVM_SLOTS_MAX	256			/* memory slots we manage */
+#define KVM_EXIT_CYCLES	100			/* minimum charge per exit */
+#define KVM_SLICE_MIN	50000			/* shortest slice, in ns */
+#define KVM_TSS_ADDR	0xfffbd000		/* 3 pages, for VMX */
+#define KVM_IDMAP_ADDR	0xfffbc000		/* 1 page, for VMX */
+
+
+typedef struct {
+    uint32_t	base,				/* guest physical address */
+		size;
+    uint8_t	*host;				/* host memory */
+    int		copy;				/* host is our own copy */
+} kvm_slot_t;
+
+static struct {
+    int		fd,				/* /dev/kvm */
+		vm,
+		vcpu;
+    struct kvm_run *run;
+    int		run_size;
+
+    kvm_slot_t	slots[KVM_SLOTS_MAX];
+    int		nslots;
+    int		remap;				/* mappings changed */
+
+    double	speed;				/* emulated cycles per ns */
+    int		nmi;				/* NMI already delivered */
+
+    int		timer_ok;
+    timer_t	timer;
+} kvm = { -1, -1, -1 };
+
+int		cpu_kvm_active = 0;
+
+extern uint32_t	x87_pc_off, x87_op_off;
+
+
+#ifdef ENABLE_KVM_LOG
+int kvm_do_log = ENABLE_KVM_LOG;
+
+
+static void
+kvm_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (kvm_do_log) {
+	va_start(ap, fmt);
+	pclog_ex(fmt, ap);
+	va_end(ap);
+    }
+}
+#else
+#define kvm_log(fmt, ...)
+#endif
+
+
+/* The slice timer went off; make KVM_RUN return as soon as it can. */
+static void
+kvm_kick(int sig)
+{
+    if (kvm.run != NULL)
+	kvm.run->immediate_exit = 1;
+}
+
+
+/* Set up the slice timer, for the thread that runs the guest. */
+static int
+kvm_timer_init(void)
+{
+    struct sigaction sa;
+    struct sigevent sev;
+
+    memset(&sa, 0x00, sizeof(sa));
+    sa.sa_handler = kvm_kick;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGRTMIN, &sa, NULL) < 0)
+	return(0);
+
+    memset(&sev, 0x00, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGRTMIN;
+    sev.sigev_notify_thread_id = syscall(SYS_gettid);
+    if (timer_create(CLOCK_MONOTONIC, &sev, &kvm.timer) < 0)
+	return(0);
+
+    return(1);
+}
+
+
+static void
+kvm_timer_set(int64_t ns)
+{
+    struct itimerspec its;
+
+    memset(&its, 0x00, sizeof(its));
+    its.it_value.tv_sec = ns / 1000000000;
+    its.it_value.tv_nsec = ns % 1000000000;
+    timer_settime(kvm.timer, 0, &its, NULL);
+}
+
+
+static int64_t
+kvm_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return(((int64_t)ts.tv_sec * 1000000000) + ts.tv_nsec);
+}
+
+
+static void
+kvm_slots_clear(void)
+{
+    struct kvm_userspace_memory_region r;
+    int c;
+
+    for (c = 0; c < kvm.nslots; c++) {
+	memset(&r, 0x00, sizeof(r));
+	r.slot = c;
+	r.guest_phys_addr = kvm.slots[c].base;
+	r.memory_size = 0;
+	(void)ioctl(kvm.vm, KVM_SET_USER_MEMORY_REGION, &r);
+
+	if (kvm.slots[c].copy)
+		munmap(kvm.slots[c].host, kvm.slots[c].size);
+    }
+
+    kvm.nslots = 0;
+}
+
+
+static void
+kvm_slot_add(uint32_t base, uint32_t size, uint8_t *host, int ro)
+{
+    struct kvm_userspace_memory_region r;
+    kvm_slot_t *s;
+    uint8_t *p = host;
+
+    if (kvm.nslots == KVM_SLOTS_MAX) {
+	kvm_log("KVM: out of memory slots at %08X\n", base);
+	return;
+    }
+
+    /* Slots need page-aligned host memory; copy ROM that is not. */
+    if ((uintptr_t)host & 0xfff) {
+	p = mmap(NULL, size, PROT_READ|PROT_WRITE,
+		 MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return;
+	memcpy(p, host, size);
+    }
+
+    memset(&r, 0x00, sizeof(r));
+    r.slot = kvm.nslots;
+    r.flags = ro ? KVM_MEM_READONLY : 0;
+    r.guest_phys_addr = base;
+    r.memory_size = size;
+    r.userspace_addr = (uintptr_t)p;
+    if (ioctl(kvm.vm, KVM_SET_USER_MEMORY_REGION, &r) < 0) {
+	kvm_log("KVM: unable to map %08X-%08X\n", base, base + size - 1);
+	if (p != host)
+		munmap(p, size);
+	return;
+    }
+
+    s = &kvm.slots[kvm.nslots++];
+    s->base = base;
+    s->size = size;
+    s->host = p;
+    s->copy = (p != host);
+}
+
+
+/*
+ * Rebuild the memory slots from the physical page descriptors. Runs
+ * of pages with contiguous host memory and the same access become one
+ * slot; pages where writes go elsewhere (ROM, shadow RAM set up for
+ * read only) are mapped read-only, so writes to them still reach the
+ * write handlers.
+ */
+static void
+kvm_slots_build(void)
+{
+    uint32_t page, start = 0;
+    uint8_t *host, *run = NULL;
+    int ro, run_ro = 0, aligned, run_aligned = 0;
+    int n = 0;
+
+    kvm_slots_clear();
+
+    for (page = 0; page <= 0xfffff; page++) {
+	host = mem_page_host(page << 12, &ro);
+
+	/* Leave our VMX pages alone. */
+	if ((page << 12) >= KVM_IDMAP_ADDR && (page << 12) < (KVM_TSS_ADDR + 0x3000))
+		host = NULL;
+
+	aligned = !((uintptr_t)host & 0xfff);
+	if ((run != NULL) && (host == (run + (n << 12))) &&
+	    (ro == run_ro) && (aligned == run_aligned)) {
+		n++;
+		continue;
+	}
+
+	if (run != NULL)
+		kvm_slot_add(start << 12, n << 12, run, run_ro || !run_aligned);
+
+	run = host;
+	run_ro = ro;
+	run_aligned = aligned;
+	start = page;
+	n = 1;
+    }
+    if (run != NULL)
+	kvm_slot_add(start << 12, n << 12, run, run_ro || !run_aligned);
+
+    kvm_log("KVM: %i memory slots\n", kvm.nslots);
+
+    kvm.remap = 0;
+}
+
+
+static void
+kvm_seg_set(struct kvm_segment *k, x86seg *s, int code)
+{
+    memset(k, 0x00, sizeof(struct kvm_segment));
+    k->base = s->base;
+    k->limit = 0xffff;
+    k->selector = s->seg;
+    k->type = code ? 0x0b : 0x03;
+    k->present = 1;
+    k->s = 1;
+}
+
+
+/* Copy a protected mode segment from the vCPU to the emulated CPU. */
+static void
+kvm_seg_get(x86seg *s, struct kvm_segment *k)
+{
+    s->base = (uint32_t)k->base;
+    s->limit = k->limit;
+    s->seg = k->selector;
+    s->access = (k->present << 7) | (k->dpl << 5) | (k->s << 4) | k->type;
+    s->checked = 0;
+
+    if (k->s && ((k->type & 0x0c) == 0x04)) {
+	/* Expand-down data segment. */
+	s->limit_high = k->db ? 0xffffffff : 0xffff;
+	s->limit_low = s->limit + 1;
+    } else {
+	s->limit_high = s->limit;
+	s->limit_low = 0;
+    }
+}
+
+
+/* And back; the D/B bit only exists in use32/stack32 and the limits. */
+static void
+kvm_seg_put(struct kvm_segment *k, x86seg *s, int db)
+{
+    memset(k, 0x00, sizeof(struct kvm_segment));
+    k->base = s->base;
+    k->limit = s->limit;
+    k->selector = s->seg;
+    k->type = s->access & 0x0f;
+    k->s = (s->access >> 4) & 1;
+    k->dpl = (s->access >> 5) & 3;
+    k->present = (s->access >> 7) & 1;
+    k->db = db;
+    k->g = (s->limit > 0xfffff);
+    k->unusable = !k->present;
+}
+
+
+static int
+kvm_seg_db(x86seg *s)
+{
+    return((s->limit_low != 0) && (s->limit_high == 0xffffffff));
+}
+
+
+/*
+ * Load the vCPU from the emulated CPU after a reset, which always
+ * leaves it in real mode at the reset vector.
+ */
+static int
+kvm_cpu_reset(void)
+{
+    struct kvm_sregs sregs;
+    struct kvm_regs regs;
+
+    if (ioctl(kvm.vcpu, KVM_GET_SREGS, &sregs) < 0)
+	return(0);
+
+    kvm_seg_set(&sregs.cs, &_cs, 1);
+    kvm_seg_set(&sregs.ds, &_ds, 0);
+    kvm_seg_set(&sregs.es, &_es, 0);
+    kvm_seg_set(&sregs.ss, &_ss, 0);
+    kvm_seg_set(&sregs.fs, &_fs, 0);
+    kvm_seg_set(&sregs.gs, &_gs, 0);
+    sregs.idt.base = idt.base;
+    sregs.idt.limit = idt.limit;
+    sregs.gdt.base = 0;
+    sregs.gdt.limit = 0xffff;
+    sregs.cr0 = CR0.l | 0x10;
+    sregs.cr2 = sregs.cr3 = sregs.cr4 = 0;
+    sregs.efer = 0;
+    memset(sregs.interrupt_bitmap, 0x00, sizeof(sregs.interrupt_bitmap));
+    if (ioctl(kvm.vcpu, KVM_SET_SREGS, &sregs) < 0)
+	return(0);
+
+    memset(&regs, 0x00, sizeof(regs));
+    regs.rax = EAX;
+    regs.rbx = EBX;
+    regs.rcx = ECX;
+    regs.rdx = EDX;
+    regs.rsi = ESI;
+    regs.rdi = EDI;
+    regs.rsp = ESP;
+    regs.rbp = EBP;
+    regs.rip = cpu_state.pc;
+    regs.rflags = flags | 2;
+    if (ioctl(kvm.vcpu, KVM_SET_REGS, &regs) < 0)
+	return(0);
+
+    kvm.nmi = 0;
+
+    return(1);
+}
+
+
+/* Copy the vCPU state to the emulated CPU, so it can be saved. */
+void
+kvm_state_get(void)
+{
+    struct kvm_sregs sregs;
+    struct kvm_regs regs;
+    struct kvm_fpu fpu;
+    long double ld;
+    int c, r;
+
+    if ((ioctl(kvm.vcpu, KVM_GET_REGS, &regs) < 0) ||
+	(ioctl(kvm.vcpu, KVM_GET_SREGS, &sregs) < 0) ||
+	(ioctl(kvm.vcpu, KVM_GET_FPU, &fpu) < 0))
+	fatal("KVM: unable to read the vCPU state (%i)\n", errno);
+
+    EAX = (uint32_t)regs.rax;
+    EBX = (uint32_t)regs.rbx;
+    ECX = (uint32_t)regs.rcx;
+    EDX = (uint32_t)regs.rdx;
+    ESI = (uint32_t)regs.rsi;
+    EDI = (uint32_t)regs.rdi;
+    ESP = (uint32_t)regs.rsp;
+    EBP = (uint32_t)regs.rbp;
+    cpu_state.pc = (uint32_t)regs.rip;
+    flags = (uint16_t)regs.rflags;
+    eflags = (uint16_t)(regs.rflags >> 16);
+    cpu_386_flags_extract();
+
+    kvm_seg_get(&_cs, &sregs.cs);
+    kvm_seg_get(&_ds, &sregs.ds);
+    kvm_seg_get(&_es, &sregs.es);
+    kvm_seg_get(&_ss, &sregs.ss);
+    kvm_seg_get(&_fs, &sregs.fs);
+    kvm_seg_get(&_gs, &sregs.gs);
+    kvm_seg_get(&ldt, &sregs.ldt);
+    kvm_seg_get(&tr, &sregs.tr);
+    gdt.base = (uint32_t)sregs.gdt.base;
+    gdt.limit = sregs.gdt.limit;
+    idt.base = (uint32_t)sregs.idt.base;
+    idt.limit = sregs.idt.limit;
+    CR0.l = (uint32_t)sregs.cr0;
+    cr2 = (uint32_t)sregs.cr2;
+    cr3 = (uint32_t)sregs.cr3;
+    cr4 = (uint32_t)sregs.cr4;
+
+    use32 = sregs.cs.db ? 0x300 : 0;
+    stack32 = sregs.ss.db;
+    cpu_cur_status = 0;
+    if (use32)
+	cpu_cur_status |= CPU_STATUS_USE32;
+    if (stack32)
+	cpu_cur_status |= CPU_STATUS_STACK32;
+    if (CR0.l & 1)
+	cpu_cur_status |= CPU_STATUS_PMODE;
+    if (eflags & VM_FLAG)
+	cpu_cur_status |= CPU_STATUS_V86;
+    if ((_ds.base != 0) || (_ds.limit_low != 0) || (_ds.limit_high != 0xffffffff))
+	cpu_cur_status |= CPU_STATUS_NOTFLATDS;
+    if ((_ss.base != 0) || (_ss.limit_low != 0) || (_ss.limit_high != 0xffffffff))
+	cpu_cur_status |= CPU_STATUS_NOTFLATSS;
+
+    /* FXSAVE order: fpr[] is ST(i), the abridged tags are physical. */
+    cpu_state.npxc = fpu.fcw;
+    cpu_state.npxs = fpu.fsw;
+    cpu_state.TOP = (fpu.fsw >> 11) & 7;
+    cpu_state.ismmx = 0;
+    for (c = 0; c < 8; c++) {
+	r = (cpu_state.TOP + c) & 7;
+	memcpy(&cpu_state.MM[r].q, &fpu.fpr[c][0], 8);
+	memcpy(&cpu_state.MM_w4[r], &fpu.fpr[c][8], 2);
+	ld = 0;
+	memcpy(&ld, &fpu.fpr[c][0], 10);
+	cpu_state.ST[r] = (double)ld;
+	if (! (fpu.ftwx & (1 << r)))
+		cpu_state.tag[r] = 3;
+	else
+		cpu_state.tag[r] = (cpu_state.ST[r] == 0.0) ? 1 : 0;
+    }
+    x87_pc_off = (uint32_t)fpu.last_ip;
+    x87_op_off = (uint32_t)fpu.last_dp;
+}
+
+
+/* Load the vCPU from the emulated CPU, after a snapshot was loaded. */
+void
+kvm_state_set(void)
+{
+    struct kvm_sregs sregs;
+    struct kvm_regs regs;
+    struct kvm_fpu fpu;
+    long double ld;
+    int c, r;
+
+    if (! (CR0.l & 1) || (eflags & VM_FLAG)) {
+	/* Real and V86 mode segments are just selector << 4. */
+	if (! kvm_cpu_reset())
+		fatal("KVM: unable to load the vCPU state (%i)\n", errno);
+	if (eflags & VM_FLAG) {
+		if (ioctl(kvm.vcpu, KVM_GET_SREGS, &sregs) < 0)
+			fatal("KVM: unable to load the vCPU state (%i)\n", errno);
+		sregs.cr0 = CR0.l | 0x10;
+		sregs.cr3 = cr3;
+		sregs.cr4 = cr4;
+		sregs.cs.type = 0x03;
+		sregs.cs.dpl = sregs.ds.dpl = sregs.es.dpl = 3;
+		sregs.ss.dpl = sregs.fs.dpl = sregs.gs.dpl = 3;
+		sregs.gdt.base = gdt.base;
+		sregs.gdt.limit = gdt.limit;
+		kvm_seg_put(&sregs.ldt, &ldt, 0);
+		kvm_seg_put(&sregs.tr, &tr, 0);
+		if (ioctl(kvm.vcpu, KVM_SET_SREGS, &sregs) < 0)
+			fatal("KVM: unable to load the vCPU state (%i)\n", errno);
+	}
+    } else {
+	if (ioctl(kvm.vcpu, KVM_GET_SREGS, &sregs) < 0)
+		fatal("KVM: unable to load the vCPU state (%i)\n", errno);
+	kvm_seg_put(&sregs.cs, &_cs, !!use32);
+	kvm_seg_put(&sregs.ss, &_ss, !!stack32);
+	kvm_seg_put(&sregs.ds, &_ds, kvm_seg_db(&_ds));
+	kvm_seg_put(&sregs.es, &_es, kvm_seg_db(&_es));
+	kvm_seg_put(&sregs.fs, &_fs, kvm_seg_db(&_fs));
+	kvm_seg_put(&sregs.gs, &_gs, kvm_seg_db(&_gs));
+	/* Keep KVM's own LDT and TR if the guest never loaded them. */
+	if (ldt.access & 0x80)
+		kvm_seg_put(&sregs.ldt, &ldt, 0);
+	if (tr.access & 0x80)
+		kvm_seg_put(&sregs.tr, &tr, 0);
+	sregs.gdt.base = gdt.base;
+	sregs.gdt.limit = gdt.limit;
+	sregs.idt.base = idt.base;
+	sregs.idt.limit = idt.limit;
+	sregs.cr0 = CR0.l | 0x10;
+	sregs.cr2 = cr2;
+	sregs.cr3 = cr3;
+	sregs.cr4 = cr4;
+	sregs.efer = 0;
+	memset(sregs.interrupt_bitmap, 0x00, sizeof(sregs.interrupt_bitmap));
+	if (ioctl(kvm.vcpu, KVM_SET_SREGS, &sregs) < 0)
+		fatal("KVM: unable to load the vCPU state (%i)\n", errno);
+    }
+
+    /* The interpreters keep the flags lazily. */
+    cpu_386_flags_rebuild();
+
+    memset(&regs, 0x00, sizeof(regs));
+    regs.rax = EAX;
+    regs.rbx = EBX;
+    regs.rcx = ECX;
+    regs.rdx = EDX;
+    regs.rsi = ESI;
+    regs.rdi = EDI;
+    regs.rsp = ESP;
+    regs.rbp = EBP;
+    regs.rip = cpu_state.pc;
+    regs.rflags = flags | ((uint32_t)eflags << 16) | 2;
+    if (ioctl(kvm.vcpu, KVM_SET_REGS, &regs) < 0)
+	fatal("KVM: unable to load the vCPU state (%i)\n", errno);
+
+    memset(&fpu, 0x00, sizeof(fpu));
+    fpu.fcw = cpu_state.npxc;
+    fpu.fsw = (cpu_state.npxs & ~0x3800) | ((cpu_state.TOP & 7) << 11);
+    for (c = 0; c < 8; c++) {
+	r = (cpu_state.TOP + c) & 7;
+	if (cpu_state.ismmx) {
+		memcpy(&fpu.fpr[c][0], &cpu_state.MM[r].q, 8);
+		fpu.fpr[c][8] = fpu.fpr[c][9] = 0xff;
+	} else {
+		ld = cpu_state.ST[r];
+		memcpy(&fpu.fpr[c][0], &ld, 10);
+	}
+	if (cpu_state.tag[r] != 3)
+		fpu.ftwx |= (1 << r);
+    }
+    fpu.last_ip = x87_pc_off;
+    fpu.last_dp = x87_op_off;
+    if (ioctl(kvm.vcpu, KVM_SET_FPU, &fpu) < 0)
+	fatal("KVM: unable to load the vCPU state (%i)\n", errno);
+
+    kvm.nmi = 0;
+    kvm_remap();
+}
+
+
+static int
+kvm_open(void)
+{
+    struct kvm_cpuid2 *cpuid;
+    uint64_t idmap = KVM_IDMAP_ADDR;
+
+    kvm.fd = open("/dev/kvm", O_RDWR | O_CLOEXEC);
+    if (kvm.fd < 0) {
+	kvm_log("KVM: /dev/kvm not available\n");
+	return(0);
+    }
+
+    if (ioctl(kvm.fd, KVM_GET_API_VERSION, 0) != KVM_API_VERSION) {
+	kvm_log("KVM: unsupported API version\n");
+	return(0);
+    }
+
+    kvm.vm = ioctl(kvm.fd, KVM_CREATE_VM, 0);
+    if (kvm.vm < 0)
+	return(0);
+
+    if (ioctl(kvm.vm, KVM_CHECK_EXTENSION, KVM_CAP_IMMEDIATE_EXIT) <= 0 ||
+	ioctl(kvm.vm, KVM_CHECK_EXTENSION, KVM_CAP_READONLY_MEM) <= 0) {
+	kvm_log("KVM: host kernel is too old\n");
+	return(0);
+    }
+
+    /* Intel hosts need these for real mode; harmless elsewhere. */
+    (void)ioctl(kvm.vm, KVM_SET_TSS_ADDR, KVM_TSS_ADDR);
+    (void)ioctl(kvm.vm, KVM_SET_IDENTITY_MAP_ADDR, &idmap);
+
+    kvm.vcpu = ioctl(kvm.vm, KVM_CREATE_VCPU, 0);
+    if (kvm.vcpu < 0)
+	return(0);
+
+    kvm.run_size = ioctl(kvm.fd, KVM_GET_VCPU_MMAP_SIZE, 0);
+    if (kvm.run_size <= 0)
+	return(0);
+    kvm.run = mmap(NULL, kvm.run_size, PROT_READ|PROT_WRITE,
+		   MAP_SHARED, kvm.vcpu, 0);
+    if (kvm.run == MAP_FAILED) {
+	kvm.run = NULL;
+	return(0);
+    }
+
+    cpuid = calloc(1, sizeof(struct kvm_cpuid2) +
+		      (100 * sizeof(struct kvm_cpuid_entry2)));
+    cpuid->nent = 100;
+    if (ioctl(kvm.fd, KVM_GET_SUPPORTED_CPUID, cpuid) == 0)
+	(void)ioctl(kvm.vcpu, KVM_SET_CPUID2, cpuid);
+    free(cpuid);
+
+    return(1);
+}
+
+
+void
+kvm_close(void)
+{
+    cpu_kvm_active = 0;
+
+    if (kvm.vm >= 0)
+	kvm_slots_clear();
+
+    if (kvm.run != NULL)
+	munmap(kvm.run, kvm.run_size);
+    kvm.run = NULL;
+
+    if (kvm.vcpu >= 0)
+	close(kvm.vcpu);
+    if (kvm.vm >= 0)
+	close(kvm.vm);
+    if (kvm.fd >= 0)
+	close(kvm.fd);
+    kvm.fd = kvm.vm = kvm.vcpu = -1;
+}
+
+
+/* Called on a hard reset, once the machine has been set up. */
+void
+kvm_reset(void)
+{
+    cpu_kvm_active = 0;
+
+    if (!cpu_use_kvm && !force_kvm)
+	return;
+
+    if (! is486) {
+	kvm_log("KVM: not used for this CPU, using the regular core\n");
+	return;
+    }
+
+    if ((kvm.vm < 0) && !kvm_open()) {
+	kvm_log("KVM: unable to start, using the regular core\n");
+	kvm_close();
+	return;
+    }
+
+    kvm_slots_build();
+    if (! kvm_cpu_reset()) {
+	kvm_log("KVM: unable to reset the vCPU, using the regular core\n");
+	kvm_close();
+	return;
+    }
+
+    kvm.speed = (double)machines[machine].cpu[cpu_manufacturer].cpus[cpu_effective].rspeed / 1000000000.0;
+
+    cpu_kvm_active = 1;
+}
+
+
+/* The memory mappings changed; rebuild the slots before running again. */
+void
+kvm_remap(void)
+{
+    kvm.remap = 1;
+}
+
+
+static void
+kvm_io(struct kvm_run *run)
+{
+    uint8_t *p = (uint8_t *)run + run->io.data_offset;
+    uint32_t c;
+
+    for (c = 0; c < run->io.count; c++, p += run->io.size) {
+	if (run->io.direction == KVM_EXIT_IO_OUT) switch (run->io.size) {
+		case 1:
+			outb(run->io.port, *p);
+			break;
+
+		case 2:
+			outw(run->io.port, *(uint16_t *)p);
+			break;
+
+		case 4:
+			outl(run->io.port, *(uint32_t *)p);
+			break;
+	} else switch (run->io.size) {
+		case 1:
+			*p = inb(run->io.port);
+			break;
+
+		case 2:
+			*(uint16_t *)p = inw(run->io.port);
+			break;
+
+		case 4:
+			*(uint32_t *)p = inl(run->io.port);
+			break;
+	}
+    }
+}
+
+
+static void
+kvm_irq(struct kvm_run *run)
+{
+    struct kvm_interrupt irq;
+    uint8_t temp;
+
+    if (nmi && !kvm.nmi) {
+	(void)ioctl(kvm.vcpu, KVM_NMI);
+	kvm.nmi = 1;
+	if (nmi_auto_clear) {
+		nmi_auto_clear = 0;
+		nmi = 0;
+	}
+    } else if (! nmi)
+	kvm.nmi = 0;
+
+    run->request_interrupt_window = 0;
+    if (! pic_intpending)
+	return;
+
+    if (run->ready_for_interrupt_injection && run->if_flag) {
+	temp = picinterrupt();
+	if (temp != 0xff) {
+		irq.irq = temp;
+		(void)ioctl(kvm.vcpu, KVM_INTERRUPT, &irq);
+	}
+    }
+
+    /* Come back as soon as the guest can take the next one. */
+    if (pic_intpending)
+	run->request_interrupt_window = 1;
+}
+
+
+/*
+ * Run the guest until the next exit, or until the given number of
+ * cycles worth of host time has passed. Returns the cycles used,
+ * which can be more than were asked for.
+ */
+static int
+kvm_run_slice(int cyc)
+{
+    struct kvm_run *run = kvm.run;
+    int64_t start, ns;
+    int used;
+
+    if (kvm.remap)
+	kvm_slots_build();
+
+    kvm_irq(run);
+
+    ns = (int64_t)(cyc / kvm.speed);
+    if (ns < KVM_SLICE_MIN)
+	ns = KVM_SLICE_MIN;
+
+    run->immediate_exit = 0;
+    kvm_timer_set(ns);
+    start = kvm_time();
+
+    if (ioctl(kvm.vcpu, KVM_RUN, 0) < 0) {
+	kvm_timer_set(0);
+	if (errno != EINTR && errno != EAGAIN)
+		fatal("KVM: KVM_RUN failed (%i)\n", errno);
+
+	/* The slice is over. */
+	used = (int)((kvm_time() - start) * kvm.speed);
+	return((used < cyc) ? cyc : used);
+    }
+
+    kvm_timer_set(0);
+    used = (int)((kvm_time() - start) * kvm.speed);
+    if (used < KVM_EXIT_CYCLES)
+	used = KVM_EXIT_CYCLES;
+
+    x86_was_reset = 0;
+
+    switch (run->exit_reason) {
+	case KVM_EXIT_IO:
+		kvm_io(run);
+		break;
+
+	case KVM_EXIT_MMIO:
+		if (run->mmio.is_write)
+			mem_write_phys(run->mmio.data, (uint32_t)run->mmio.phys_addr, run->mmio.len);
+		else
+			mem_read_phys(run->mmio.data, (uint32_t)run->mmio.phys_addr, run->mmio.len);
+		break;
+
+	case KVM_EXIT_HLT:
+		/* Nothing to do until the next timer event. */
+		if (used < cyc)
+			used = cyc;
+		break;
+
+	case KVM_EXIT_IRQ_WINDOW_OPEN:
+	case KVM_EXIT_INTR:
+		break;
+
+	case KVM_EXIT_SHUTDOWN:
+		kvm_log("KVM: triple fault - reset\n");
+		softresetx86();
+		cpu_set_edx();
+		break;
+
+	default:
+		fatal("KVM: unhandled exit %i\n", run->exit_reason);
+    }
+
+    /* A device (keyboard controller, port 92) reset the CPU. */
+    if (x86_was_reset) {
+	(void)kvm_cpu_reset();
+	run->immediate_exit = 0;
+    }
+
+    return(used);
+}
+
+
+void
+exec386_kvm(int cycs)
+{
+    int cycle_period, cycdiff;
+
+    if (! kvm.timer_ok) {
+	kvm.timer_ok = kvm_timer_init();
+	if (! kvm.timer_ok)
+		fatal("KVM: unable to set up the slice timer\n");
+    }
+
+    cycles += cycs;
+    while (cycles > 0) {
+	cycle_period = (timer_count >> TIMER_SHIFT) + 1;
+
+	timer_start_period(cycles << TIMER_SHIFT);
+
+	cycdiff = kvm_run_slice((cycle_period < cycles) ? cycle_period : cycles);
+	cycles -= cycdiff;
+	tsc += cycdiff;
+
+	timer_end_period(cycles << TIMER_SHIFT);
+    }
+}
@@ -1,8 +1,16 @@
+/*With SSE2 on the host each MMX lane operation is a single instruction
+  on the low half of an XMM register, otherwise it is done lane by lane.*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+# define MMX_SSE2
+# include <emmintrin.h>
+#endif
+
 #define SSATB(val) (((val) < -128) ? -128 : (((val) > 127) ? 127 : (val)))
 #define SSATW(val) (((val) < -32768) ? -32768 : (((val) > 32767) ? 32767 : (val)))
 #define USATB(val) (((val) < 0) ? 0 : (((val) > 255) ? 255 : (val)))
 #define USATW(val) (((val) < 0) ? 0 : (((val) > 65535) ? 65535 : (val)))
 
+/*A fault on the memory operand returns 1, so the handler is aborted.*/
 #define MMX_GETSRC()                                                            \
         if (cpu_mod == 3)                                                           \
         {                                                                       \
@@ -46,3 +54,263 @@ static int opEMMS(uint32_t fetchdat)
         CLOCK_CYCLES(100); /*Guess*/
         return 0;
 }
+
+#ifdef MMX_SSE2
+#define MMX_LOAD(r)     _mm_loadl_epi64((__m128i *)(r))
+#define MMX_STORE(r, v) _mm_storel_epi64((__m128i *)(r), v)
+
+#define MMX_LANES(name, sse_op)                                         \
+static __inline void mmx_ ## name(MMX_REG *dst, MMX_REG *src)          \
+{                                                                       \
+        MMX_STORE(dst, sse_op(MMX_LOAD(dst), MMX_LOAD(src)));           \
+}
+#else
+#define MMX_LANES(name, lanes, type, expr)                              \
+static __inline void mmx_ ## name(MMX_REG *dst, MMX_REG *src)          \
+{                                                                       \
+        int c;                                                          \
+                                                                        \
+        for (c = 0; c < lanes; c++)                                     \
+                dst->type[c] = expr;                                    \
+}
+#endif
+
+#ifdef MMX_SSE2
+MMX_LANES(paddb,   _mm_add_epi8)
+MMX_LANES(paddw,   _mm_add_epi16)
+MMX_LANES(paddd,   _mm_add_epi32)
+MMX_LANES(paddsb,  _mm_adds_epi8)
+MMX_LANES(paddsw,  _mm_adds_epi16)
+MMX_LANES(paddusb, _mm_adds_epu8)
+MMX_LANES(paddusw, _mm_adds_epu16)
+MMX_LANES(psubb,   _mm_sub_epi8)
+MMX_LANES(psubw,   _mm_sub_epi16)
+MMX_LANES(psubd,   _mm_sub_epi32)
+MMX_LANES(psubsb,  _mm_subs_epi8)
+MMX_LANES(psubsw,  _mm_subs_epi16)
+MMX_LANES(psubusb, _mm_subs_epu8)
+MMX_LANES(psubusw, _mm_subs_epu16)
+MMX_LANES(pmaddwd, _mm_madd_epi16)
+MMX_LANES(pmullw,  _mm_mullo_epi16)
+MMX_LANES(pmulhw,  _mm_mulhi_epi16)
+MMX_LANES(pcmpeqb, _mm_cmpeq_epi8)
+MMX_LANES(pcmpeqw, _mm_cmpeq_epi16)
+MMX_LANES(pcmpeqd, _mm_cmpeq_epi32)
+MMX_LANES(pcmpgtb, _mm_cmpgt_epi8)
+MMX_LANES(pcmpgtw, _mm_cmpgt_epi16)
+MMX_LANES(pcmpgtd, _mm_cmpgt_epi32)
+MMX_LANES(punpcklbw, _mm_unpacklo_epi8)
+MMX_LANES(punpcklwd, _mm_unpacklo_epi16)
+
+/*The high unpacks and the packs work on both operands side by side in
+  one register and keep the half that MMX wants.*/
+static __inline void mmx_punpckhbw(MMX_REG *dst, MMX_REG *src)
+{
+        MMX_STORE(dst, _mm_srli_si128(_mm_unpacklo_epi8(MMX_LOAD(dst), MMX_LOAD(src)), 8));
+}
+static __inline void mmx_punpckhwd(MMX_REG *dst, MMX_REG *src)
+{
+        MMX_STORE(dst, _mm_srli_si128(_mm_unpacklo_epi16(MMX_LOAD(dst), MMX_LOAD(src)), 8));
+}
+static __inline void mmx_punpckhdq(MMX_REG *dst, MMX_REG *src)
+{
+        MMX_STORE(dst, _mm_srli_si128(_mm_unpacklo_epi32(MMX_LOAD(dst), MMX_LOAD(src)), 8));
+}
+static __inline void mmx_packsswb(MMX_REG *dst, MMX_REG *src)
+{
+        __m128i t = _mm_unpacklo_epi64(MMX_LOAD(dst), MMX_LOAD(src));
+
+        MMX_STORE(dst, _mm_packs_epi16(t, t));
+}
+static __inline void mmx_packuswb(MMX_REG *dst, MMX_REG *src)
+{
+        __m128i t = _mm_unpacklo_epi64(MMX_LOAD(dst), MMX_LOAD(src));
+
+        MMX_STORE(dst, _mm_packus_epi16(t, t));
+}
+static __inline void mmx_packssdw(MMX_REG *dst, MMX_REG *src)
+{
+        __m128i t = _mm_unpacklo_epi64(MMX_LOAD(dst), MMX_LOAD(src));
+
+        MMX_STORE(dst, _mm_packs_epi32(t, t));
+}
+
+/*SSE2 shifts zero (or sign fill) lanes on counts past the lane width,
+  exactly as MMX does.*/
+#define MMX_SHIFT(name, sse_op)                                         \
+static __inline void mmx_ ## name(MMX_REG *dst, int shift)             \
+{                                                                       \
+        MMX_STORE(dst, sse_op(MMX_LOAD(dst), _mm_cvtsi32_si128(shift))); \
+}
+MMX_SHIFT(psllw, _mm_sll_epi16)
+MMX_SHIFT(psrlw, _mm_srl_epi16)
+MMX_SHIFT(psraw, _mm_sra_epi16)
+MMX_SHIFT(pslld, _mm_sll_epi32)
+MMX_SHIFT(psrld, _mm_srl_epi32)
+MMX_SHIFT(psrad, _mm_sra_epi32)
+#else
+MMX_LANES(paddb,   8, b,  dst->b[c] + src->b[c])
+MMX_LANES(paddw,   4, w,  dst->w[c] + src->w[c])
+MMX_LANES(paddd,   2, l,  dst->l[c] + src->l[c])
+MMX_LANES(paddsb,  8, sb, SSATB(dst->sb[c] + src->sb[c]))
+MMX_LANES(paddsw,  4, sw, SSATW(dst->sw[c] + src->sw[c]))
+MMX_LANES(paddusb, 8, b,  USATB(dst->b[c] + src->b[c]))
+MMX_LANES(paddusw, 4, w,  USATW(dst->w[c] + src->w[c]))
+MMX_LANES(psubb,   8, b,  dst->b[c] - src->b[c])
+MMX_LANES(psubw,   4, w,  dst->w[c] - src->w[c])
+MMX_LANES(psubd,   2, l,  dst->l[c] - src->l[c])
+MMX_LANES(psubsb,  8, sb, SSATB(dst->sb[c] - src->sb[c]))
+MMX_LANES(psubsw,  4, sw, SSATW(dst->sw[c] - src->sw[c]))
+MMX_LANES(psubusb, 8, b,  USATB(dst->b[c] - src->b[c]))
+MMX_LANES(psubusw, 4, w,  USATW(dst->w[c] - src->w[c]))
+MMX_LANES(pmullw,  4, w,  dst->w[c] * src->w[c])
+MMX_LANES(pmulhw,  4, w,  ((int32_t)dst->sw[c] * (int32_t)src->sw[c]) >> 16)
+MMX_LANES(pcmpeqb, 8, b,  (dst->b[c] == src->b[c]) ? 0xff : 0)
+MMX_LANES(pcmpeqw, 4, w,  (dst->w[c] == src->w[c]) ? 0xffff : 0)
+MMX_LANES(pcmpeqd, 2, l,  (dst->l[c] == src->l[c]) ? 0xffffffff : 0)
+MMX_LANES(pcmpgtb, 8, b,  (dst->sb[c] > src->sb[c]) ? 0xff : 0)
+MMX_LANES(pcmpgtw, 4, w,  (dst->sw[c] > src->sw[c]) ? 0xffff : 0)
+MMX_LANES(pcmpgtd, 2, l,  (dst->sl[c] > src->sl[c]) ? 0xffffffff : 0)
+
+static __inline void mmx_pmaddwd(MMX_REG *dst, MMX_REG *src)
+{
+        int c;
+
+        for (c = 0; c < 2; c++)
+        {
+                if (dst->l[c] == 0x80008000 && src->l[c] == 0x80008000)
+                        dst->l[c] = 0x80000000;
+                else
+                        dst->sl[c] = ((int32_t)dst->sw[c*2] * (int32_t)src->sw[c*2]) + ((int32_t)dst->sw[c*2+1] * (int32_t)src->sw[c*2+1]);
+        }
+}
+
+/*The unpacks and packs write lanes that are still to be read, so they
+  work from copies of both operands.*/
+static __inline void mmx_punpcklbw(MMX_REG *dst, MMX_REG *src)
+{
+        MMX_REG d = *dst, s = *src;
+        int c;
+
+        for (c = 0; c < 4; c++)
+        {
+                dst->b[c*2] = d.b[c];
+                dst->b[c*2+1] = s.b[c];
+        }
+}
+static __inline void mmx_punpcklwd(MMX_REG *dst, MMX_REG *src)
+{
+        MMX_REG d = *dst, s = *src;
+        int c;
+
+        for (c = 0; c < 2; c++)
+        {
+                dst->w[c*2] = d.w[c];
+                dst->w[c*2+1] = s.w[c];
+        }
+}
+static __inline void mmx_punpckhbw(MMX_REG *dst, MMX_REG *src)
+{
+        MMX_REG d = *dst, s = *src;
+        int c;
+
+        for (c = 0; c < 4; c++)
+        {
+                dst->b[c*2] = d.b[c+4];
+                dst->b[c*2+1] = s.b[c+4];
+        }
+}
+static __inline void mmx_punpckhwd(MMX_REG *dst, MMX_REG *src)
+{
+        MMX_REG d = *dst, s = *src;
+        int c;
+
+        for (c = 0; c < 2; c++)
+        {
+                dst->w[c*2] = d.w[c+2];
+                dst->w[c*2+1] = s.w[c+2];
+        }
+}
+static __inline void mmx_punpckhdq(MMX_REG *dst, MMX_REG *src)
+{
+        MMX_REG d = *dst, s = *src;
+
+        dst->l[0] = d.l[1];
+        dst->l[1] = s.l[1];
+}
+static __inline void mmx_packsswb(MMX_REG *dst, MMX_REG *src)
+{
+        MMX_REG d = *dst, s = *src;
+        int c;
+
+        for (c = 0; c < 4; c++)
+        {
+                dst->sb[c] = SSATB(d.sw[c]);
+                dst->sb[c+4] = SSATB(s.sw[c]);
+        }
+}
+static __inline void mmx_packuswb(MMX_REG *dst, MMX_REG *src)
+{
+        MMX_REG d = *dst, s = *src;
+        int c;
+
+        for (c = 0; c < 4; c++)
+        {
+                dst->b[c] = USATB(d.sw[c]);
+                dst->b[c+4] = USATB(s.sw[c]);
+        }
+}
+static __inline void mmx_packssdw(MMX_REG *dst, MMX_REG *src)
+{
+        MMX_REG d = *dst, s = *src;
+
+        dst->sw[0] = SSATW(d.sl[0]);
+        dst->sw[1] = SSATW(d.sl[1]);
+        dst->sw[2] = SSATW(s.sl[0]);
+        dst->sw[3] = SSATW(s.sl[1]);
+}
+
+#define MMX_SHIFT(name, bits, type, op, over)                           \
+static __inline void mmx_ ## name(MMX_REG *dst, int shift)             \
+{                                                                       \
+        int c;                                                          \
+                                                                        \
+        if (shift > (bits - 1))                                         \
+        {                                                               \
+                over;                                                   \
+        }                                                               \
+        for (c = 0; c < (64 / bits); c++)                               \
+                dst->type[c] op shift;                                  \
+}
+MMX_SHIFT(psllw, 16, w,  <<=, dst->q = 0; return)
+MMX_SHIFT(psrlw, 16, w,  >>=, dst->q = 0; return)
+MMX_SHIFT(psraw, 16, sw, >>=, shift = 15)
+MMX_SHIFT(pslld, 32, l,  <<=, dst->q = 0; return)
+MMX_SHIFT(psrld, 32, l,  >>=, dst->q = 0; return)
+MMX_SHIFT(psrad, 32, sl, >>=, shift = 31)
+#endif
+
+/*Register or memory source, result into the register operand.*/
+#define MMX_OP(name, func)                                              \
+static int op ## name ## _a16(uint32_t fetchdat)                        \
+{                                                                       \
+        MMX_REG src;                                                    \
+        MMX_ENTER();                                                    \
+                                                                        \
+        fetch_ea_16(fetchdat);                                          \
+        MMX_GETSRC();                                                   \
+        func(&cpu_state.MM[cpu_reg], &src);                             \
+                                                                        \
+        return 0;                                                       \
+}                                                                       \
+static int op ## name ## _a32(uint32_t fetchdat)                        \
+{                                                                       \
+        MMX_REG src;                                                    \
+        MMX_ENTER();                                                    \
+                                                                        \
+        fetch_ea_32(fetchdat);                                          \
+        MMX_GETSRC();                                                   \
+        func(&cpu_state.MM[cpu_reg], &src);                             \
+                                                                        \
+        return 0;                                                       \
+}
@@ -10,6 +10,33 @@
                 CLOCK_CYCLES(2);                                        \
         }
 
+/*Register or memory shift count, register operand shifted.*/
+#define MMX_SHIFT_OP(name, func)                                        \
+static int op ## name ## _a16(uint32_t fetchdat)                        \
+{                                                                       \
+        int shift;                                                      \
+                                                                        \
+        MMX_ENTER();                                                    \
+                                                                        \
+        fetch_ea_16(fetchdat);                                          \
+        MMX_GETSHIFT();                                                 \
+        func(&cpu_state.MM[cpu_reg], shift);                            \
+                                                                        \
+        return 0;                                                       \
+}                                                                       \
+static int op ## name ## _a32(uint32_t fetchdat)                        \
+{                                                                       \
+        int shift;                                                      \
+                                                                        \
+        MMX_ENTER();                                                    \
+                                                                        \
+        fetch_ea_32(fetchdat);                                          \
+        MMX_GETSHIFT();                                                 \
+        func(&cpu_state.MM[cpu_reg], shift);                            \
+                                                                        \
+        return 0;                                                       \
+}
+
 static int opPSxxW_imm(uint32_t fetchdat)
 {
         int reg = fetchdat & 7;
@@ -22,34 +49,13 @@ static int opPSxxW_imm(uint32_t fetchdat)
         switch (op)
         {
                 case 0x10: /*PSRLW*/
-                if (shift > 15)
-                        cpu_state.MM[reg].q = 0;
-                else
-                {
-                        cpu_state.MM[reg].w[0] >>= shift;
-                        cpu_state.MM[reg].w[1] >>= shift;
-                        cpu_state.MM[reg].w[2] >>= shift;
-                        cpu_state.MM[reg].w[3] >>= shift;
-                }
+                mmx_psrlw(&cpu_state.MM[reg], shift);
                 break;
                 case 0x20: /*PSRAW*/
-                if (shift > 15)
-                        shift = 15;
-                cpu_state.MM[reg].sw[0] >>= shift;
-                cpu_state.MM[reg].sw[1] >>= shift;
-                cpu_state.MM[reg].sw[2] >>= shift;
-                cpu_state.MM[reg].sw[3] >>= shift;
+                mmx_psraw(&cpu_state.MM[reg], shift);
                 break;
                 case 0x30: /*PSLLW*/
-                if (shift > 15)
-                        cpu_state.MM[reg].q = 0;
-                else
-                {
-                        cpu_state.MM[reg].w[0] <<= shift;
-                        cpu_state.MM[reg].w[1] <<= shift;
-                        cpu_state.MM[reg].w[2] <<= shift;
-                        cpu_state.MM[reg].w[3] <<= shift;
-                }
+                mmx_psllw(&cpu_state.MM[reg], shift);
                 break;
                 default:
                 x386_dynarec_log("Bad PSxxW (0F 71) instruction %02X\n", op);
@@ -62,130 +68,9 @@ static int opPSxxW_imm(uint32_t fetchdat)
         return 0;
 }
 
-static int opPSLLW_a16(uint32_t fetchdat)
-{
-        int shift;
-        
-        MMX_ENTER();
-        
-        fetch_ea_16(fetchdat);
-        MMX_GETSHIFT();
-
-        if (shift > 15)
-                cpu_state.MM[cpu_reg].q = 0;
-        else
-        {
-                cpu_state.MM[cpu_reg].w[0] <<= shift;
-                cpu_state.MM[cpu_reg].w[1] <<= shift;
-                cpu_state.MM[cpu_reg].w[2] <<= shift;
-                cpu_state.MM[cpu_reg].w[3] <<= shift;
-        }
-
-        return 0;
-}
-static int opPSLLW_a32(uint32_t fetchdat)
-{
-        int shift;
-        
-        MMX_ENTER();
-        
-        fetch_ea_32(fetchdat);
-        MMX_GETSHIFT();
-
-        if (shift > 15)
-                cpu_state.MM[cpu_reg].q = 0;
-        else
-        {
-                cpu_state.MM[cpu_reg].w[0] <<= shift;
-                cpu_state.MM[cpu_reg].w[1] <<= shift;
-                cpu_state.MM[cpu_reg].w[2] <<= shift;
-                cpu_state.MM[cpu_reg].w[3] <<= shift;
-        }
-
-        return 0;
-}
-
-static int opPSRLW_a16(uint32_t fetchdat)
-{
-        int shift;
-        
-        MMX_ENTER();
-        
-        fetch_ea_16(fetchdat);
-        MMX_GETSHIFT();
-
-        if (shift > 15)
-                cpu_state.MM[cpu_reg].q = 0;
-        else
-        {
-                cpu_state.MM[cpu_reg].w[0] >>= shift;
-                cpu_state.MM[cpu_reg].w[1] >>= shift;
-                cpu_state.MM[cpu_reg].w[2] >>= shift;
-                cpu_state.MM[cpu_reg].w[3] >>= shift;
-        }
-
-        return 0;
-}
-static int opPSRLW_a32(uint32_t fetchdat)
-{
-        int shift;
-        
-        MMX_ENTER();
-        
-        fetch_ea_32(fetchdat);
-        MMX_GETSHIFT();
-
-        if (shift > 15)
-                cpu_state.MM[cpu_reg].q = 0;
-        else
-        {
-                cpu_state.MM[cpu_reg].w[0] >>= shift;
-                cpu_state.MM[cpu_reg].w[1] >>= shift;
-                cpu_state.MM[cpu_reg].w[2] >>= shift;
-                cpu_state.MM[cpu_reg].w[3] >>= shift;
-        }
-
-        return 0;
-}
-
-static int opPSRAW_a16(uint32_t fetchdat)
-{
-        int shift;
-        
-        MMX_ENTER();
-        
-        fetch_ea_16(fetchdat);
-        MMX_GETSHIFT();
-
-        if (shift > 15)
-                shift = 15;
-
-        cpu_state.MM[cpu_reg].sw[0] >>= shift;
-        cpu_state.MM[cpu_reg].sw[1] >>= shift;
-        cpu_state.MM[cpu_reg].sw[2] >>= shift;
-        cpu_state.MM[cpu_reg].sw[3] >>= shift;
-        
-        return 0;
-}
-static int opPSRAW_a32(uint32_t fetchdat)
-{
-        int shift;
-        
-        MMX_ENTER();
-        
-        fetch_ea_32(fetchdat);
-        MMX_GETSHIFT();
-
-        if (shift > 15)
-                shift = 15;
-
-        cpu_state.MM[cpu_reg].sw[0] >>= shift;
-        cpu_state.MM[cpu_reg].sw[1] >>= shift;
-        cpu_state.MM[cpu_reg].sw[2] >>= shift;
-        cpu_state.MM[cpu_reg].sw[3] >>= shift;
-        
-        return 0;
-}
+MMX_SHIFT_OP(PSLLW, mmx_psllw)
+MMX_SHIFT_OP(PSRLW, mmx_psrlw)
+MMX_SHIFT_OP(PSRAW, mmx_psraw)
 
 static int opPSxxD_imm(uint32_t fetchdat)
 {
@@ -199,28 +84,13 @@ static int opPSxxD_imm(uint32_t fetchdat)
         switch (op)
         {
                 case 0x10: /*PSRLD*/
-                if (shift > 31)
-                        cpu_state.MM[reg].q = 0;
-                else
-                {
-                        cpu_state.MM[reg].l[0] >>= shift;
-                        cpu_state.MM[reg].l[1] >>= shift;
-                }
+                mmx_psrld(&cpu_state.MM[reg], shift);
                 break;
                 case 0x20: /*PSRAD*/
-                if (shift > 31)
-                        shift = 31;
-                cpu_state.MM[reg].sl[0] >>= shift;
-                cpu_state.MM[reg].sl[1] >>= shift;
+                mmx_psrad(&cpu_state.MM[reg], shift);
                 break;
                 case 0x30: /*PSLLD*/
-                if (shift > 31)
-                        cpu_state.MM[reg].q = 0;
-                else
-                {
-                        cpu_state.MM[reg].l[0] <<= shift;
-                        cpu_state.MM[reg].l[1] <<= shift;
-                }
+                mmx_pslld(&cpu_state.MM[reg], shift);
                 break;
                 default:
                 x386_dynarec_log("Bad PSxxD (0F 72) instruction %02X\n", op);
@@ -233,118 +103,9 @@ static int opPSxxD_imm(uint32_t fetchdat)
         return 0;
 }
 
-static int opPSLLD_a16(uint32_t fetchdat)
-{
-        int shift;
-        
-        MMX_ENTER();
-        
-        fetch_ea_16(fetchdat);
-        MMX_GETSHIFT();
-
-        if (shift > 31)
-                cpu_state.MM[cpu_reg].q = 0;
-        else
-        {
-                cpu_state.MM[cpu_reg].l[0] <<= shift;
-                cpu_state.MM[cpu_reg].l[1] <<= shift;
-        }
-
-        return 0;
-}
-static int opPSLLD_a32(uint32_t fetchdat)
-{
-        int shift;
-        
-        MMX_ENTER();
-        
-        fetch_ea_32(fetchdat);
-        MMX_GETSHIFT();
-
-        if (shift > 31)
-                cpu_state.MM[cpu_reg].q = 0;
-        else
-        {
-                cpu_state.MM[cpu_reg].l[0] <<= shift;
-                cpu_state.MM[cpu_reg].l[1] <<= shift;
-        }
-
-        return 0;
-}
-
-static int opPSRLD_a16(uint32_t fetchdat)
-{
-        int shift;
-        
-        MMX_ENTER();
-        
-        fetch_ea_16(fetchdat);
-        MMX_GETSHIFT();
-
-        if (shift > 31)
-                cpu_state.MM[cpu_reg].q = 0;
-        else
-        {
-                cpu_state.MM[cpu_reg].l[0] >>= shift;
-                cpu_state.MM[cpu_reg].l[1] >>= shift;
-        }
-
-        return 0;
-}
-static int opPSRLD_a32(uint32_t fetchdat)
-{
-        int shift;
-        
-        MMX_ENTER();
-        
-        fetch_ea_32(fetchdat);
-        MMX_GETSHIFT();
-
-        if (shift > 31)
-                cpu_state.MM[cpu_reg].q = 0;
-        else
-        {
-                cpu_state.MM[cpu_reg].l[0] >>= shift;
-                cpu_state.MM[cpu_reg].l[1] >>= shift;
-        }
-
-        return 0;
-}
-
-static int opPSRAD_a16(uint32_t fetchdat)
-{
-        int shift;
-        
-        MMX_ENTER();
-        
-        fetch_ea_16(fetchdat);
-        MMX_GETSHIFT();
-
-        if (shift > 31)
-                shift = 31;
-
-        cpu_state.MM[cpu_reg].sl[0] >>= shift;
-        cpu_state.MM[cpu_reg].sl[1] >>= shift;
-        
-        return 0;
-}
-static int opPSRAD_a32(uint32_t fetchdat)
-{
-        int shift;
-        
-        MMX_ENTER();
-        
-        fetch_ea_32(fetchdat);
-        MMX_GETSHIFT();
-
-        if (shift > 31)
-                shift = 31;
-
-        cpu_state.MM[cpu_reg].sl[0] >>= shift;
-        cpu_state.MM[cpu_reg].sl[1] >>= shift;
-
-        return 0;
-}
+MMX_SHIFT_OP(PSLLD, mmx_pslld)
+MMX_SHIFT_OP(PSRLD, mmx_psrld)
+MMX_SHIFT_OP(PSRAD, mmx_psrad)
 
 static int opPSxxQ_imm(uint32_t fetchdat)
 {
@@ -119,7 +119,10 @@ static int opMOV_CRx_r_a16(uint32_t fetchdat)
         {
                 case 0:
                 if ((cpu_state.regs[cpu_rm].l ^ cr0) & 0x80000001)
+                {
                         flushmmucache();
+                        mmu_tlb_flush(1);
+                }
                 cr0 = cpu_state.regs[cpu_rm].l;
                 if (cpu_16bitbus)
                         cr0 |= 0x10;
@@ -146,6 +149,11 @@ static int opMOV_CRx_r_a16(uint32_t fetchdat)
                 case 4:
                 if (cpu_hasCR4)
                 {
+                        if ((cpu_state.regs[cpu_rm].l ^ cr4) & cpu_CR4_mask & (CR4_PSE | CR4_PGE))
+                        {
+                                flushmmucache();
+                                mmu_tlb_flush(1);
+                        }
                         cr4 = cpu_state.regs[cpu_rm].l & cpu_CR4_mask;
                         break;
                 }
@@ -175,7 +183,10 @@ static int opMOV_CRx_r_a32(uint32_t fetchdat)
         {
                 case 0:
                 if ((cpu_state.regs[cpu_rm].l ^ cr0) & 0x80000001)
+                {
                         flushmmucache();
+                        mmu_tlb_flush(1);
+                }
                 cr0 = cpu_state.regs[cpu_rm].l;
                 if (cpu_16bitbus)
                         cr0 |= 0x10;
@@ -202,6 +213,11 @@ static int opMOV_CRx_r_a32(uint32_t fetchdat)
                 case 4:
                 if (cpu_hasCR4)
                 {
+                        if ((cpu_state.regs[cpu_rm].l ^ cr4) & cpu_CR4_mask & (CR4_PSE | CR4_PGE))
+                        {
+                                flushmmucache();
+                                mmu_tlb_flush(1);
+                        }
                         cr4 = cpu_state.regs[cpu_rm].l & cpu_CR4_mask;
                         break;
                 }
@@ -354,7 +354,7 @@ static __inline uint16_t x87_compare(double a, double b)
 #else
         /* Generic C version is known to give incorrect results in some
          * situations, eg comparison of infinity (Unreal) */
-        uint32_t out = 0;
+        uint32_t result = 0;
 
 	if (is386)
 	{
@@ -49,6 +49,7 @@
 #include "device.h"
 #include "machine/machine.h"
 #include "sound/sound.h"
+#include "snapshot.h"
 
 
 #define DEVICE_MAX	256			/* max # of devices */
@@ -209,6 +210,53 @@ device_reset_all(void)
 }
 
 
+/* Save every attached device that has a save handler, tagged by slot. */
+void
+device_save_all(snapshot_t *s)
+{
+    char name[64];
+    int c;
+
+    for (c = 0; c < DEVICE_MAX; c++) {
+	if ((devices[c] == NULL) || (devices[c]->save == NULL))
+		continue;
+
+	memset(name, 0x00, sizeof(name));
+	if (devices[c]->name != NULL)
+		strncpy(name, devices[c]->name, sizeof(name) - 1);
+
+	snapshot_chunk_begin(s, "DEV ", c);
+	snapshot_write(s, name, sizeof(name));
+	devices[c]->save(device_priv[c], s);
+	snapshot_chunk_end(s);
+    }
+}
+
+
+/* Restore the device in slot inst, if it matches the one that was saved. */
+void
+device_load(snapshot_t *s, int inst)
+{
+    char name[64];
+
+    snapshot_read(s, name, sizeof(name));
+    name[sizeof(name) - 1] = '\0';
+
+    if ((inst < 0) || (inst >= DEVICE_MAX) || (devices[inst] == NULL) ||
+	(devices[inst]->name == NULL) || strcmp(devices[inst]->name, name)) {
+	device_log("Snapshot: device \"%s\" (slot %i) not present, skipped\n", name, inst);
+	return;
+    }
+
+    if (devices[inst]->load == NULL) {
+	device_log("Snapshot: device \"%s\" cannot be restored, skipped\n", name);
+	return;
+    }
+
+    devices[inst]->load(device_priv[inst], s);
+}
+
+
 /* Reset all attached PCI devices - needed for PCI turbo reset control. */
 void
 device_reset_all_pci(void)
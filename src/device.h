@@ -93,6 +93,8 @@ typedef struct {
     device_config_spinner_t spinner;
 } device_config_t;
 
+struct _snapshot_;
+
 typedef struct _device_ {
     const char	*name;
     uint32_t	flags;		/* system flags */
@@ -106,6 +108,9 @@ typedef struct _device_ {
     void	(*force_redraw)(void *priv);
 
     const device_config_t *config;
+
+    void	(*save)(void *priv, struct _snapshot_ *s);
+    void	(*load)(void *priv, struct _snapshot_ *s);
 } device_t;
 
 typedef struct {
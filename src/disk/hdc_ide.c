@@ -42,6 +42,7 @@
 #include "../cdrom/cdrom.h"
 #include "../plat.h"
 #include "../ui.h"
+#include "../snapshot.h"
 #include "hdc.h"
 #include "hdc_ide.h"
 #include "hdd.h"
@@ -653,6 +654,23 @@ ide_next_sector(ide_t *ide)
 }
 
 
+/**
+ * Start reading the sectors of a read command in the background, to
+ * be collected by the callback once the command's time is up
+ */
+static void
+ide_read_ahead(ide_t *ide)
+{
+    if ((ide->type != IDE_HDD) || (ide->cfg_spt == 0))
+	return;
+
+    if (ide->secount)
+	hdd_image_read_async(ide->hdd_num, ide_get_sector(ide), ide->secount, ide->sector_buffer);
+    else
+	hdd_image_read_async(ide->hdd_num, ide_get_sector(ide), 256, ide->sector_buffer);
+}
+
+
 static void
 loadhd(ide_t *ide, int d, const wchar_t *fn)
 {
@@ -1462,6 +1480,10 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
 		if (ide->type == IDE_NONE)
 			return;
 
+		/* Do not let a background read race the new command. */
+		if (ide->type == IDE_HDD)
+			hdd_image_wait(ide->hdd_num);
+
 		ide_irq_lower(ide);
 		ide->command=val;
 
@@ -1533,6 +1555,7 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
 					ide_set_callback(ide->board, 200LL * IDE_TIME);
 				timer_update_outstanding();
 				ide->do_initial_read = 1;
+				ide_read_ahead(ide);
 				return;
 
 			case WIN_WRITE_MULTIPLE:
@@ -2059,9 +2082,9 @@ ide_callback(void *priv)
 			ide->do_initial_read = 0;
 			ide->sector_pos = 0;
 			if (ide->secount)
-				hdd_image_read(ide->hdd_num, ide_get_sector(ide), ide->secount, ide->sector_buffer);
+				hdd_image_read_complete(ide->hdd_num, ide_get_sector(ide), ide->secount, ide->sector_buffer);
 			else
-				hdd_image_read(ide->hdd_num, ide_get_sector(ide), 256, ide->sector_buffer);
+				hdd_image_read_complete(ide->hdd_num, ide_get_sector(ide), 256, ide->sector_buffer);
 		}
 
 		memcpy(ide->buffer, &ide->sector_buffer[ide->sector_pos*512], 512);
@@ -2092,7 +2115,7 @@ ide_callback(void *priv)
 			ide->sector_pos = ide->secount;
 		else
 			ide->sector_pos = 256;
-		hdd_image_read(ide->hdd_num, ide_get_sector(ide), ide->sector_pos, ide->sector_buffer);
+		hdd_image_read_complete(ide->hdd_num, ide_get_sector(ide), ide->sector_pos, ide->sector_buffer);
 
 		ide->pos=0;
 
@@ -2141,9 +2164,9 @@ ide_callback(void *priv)
 			ide->do_initial_read = 0;
 			ide->sector_pos = 0;
 			if (ide->secount)
-				hdd_image_read(ide->hdd_num, ide_get_sector(ide), ide->secount, ide->sector_buffer);
+				hdd_image_read_complete(ide->hdd_num, ide_get_sector(ide), ide->secount, ide->sector_buffer);
 			else
-				hdd_image_read(ide->hdd_num, ide_get_sector(ide), 256, ide->sector_buffer);
+				hdd_image_read_complete(ide->hdd_num, ide_get_sector(ide), 256, ide->sector_buffer);
 		}
 
 		memcpy(ide->buffer, &ide->sector_buffer[ide->sector_pos*512], 512);
@@ -2522,6 +2545,141 @@ ide_ter_init(const device_t *info)
 }
 
 
+/* Save the task file and buffers of the primary and secondary channels. */
+static void
+ide_drive_save(ide_t *ide, snapshot_t *s)
+{
+    snapshot_write_var(s, ide->atastat);
+    snapshot_write_var(s, ide->error);
+    snapshot_write_var(s, ide->command);
+    snapshot_write_var(s, ide->fdisk);
+    snapshot_write_var(s, ide->irqstat);
+    snapshot_write_var(s, ide->service);
+    snapshot_write_var(s, ide->blocksize);
+    snapshot_write_var(s, ide->blockcount);
+    snapshot_write_var(s, ide->pos);
+    snapshot_write_var(s, ide->sector_pos);
+    snapshot_write_var(s, ide->lba);
+    snapshot_write_var(s, ide->skip512);
+    snapshot_write_var(s, ide->reset);
+    snapshot_write_var(s, ide->mdma_mode);
+    snapshot_write_var(s, ide->secount);
+    snapshot_write_var(s, ide->sector);
+    snapshot_write_var(s, ide->cylinder);
+    snapshot_write_var(s, ide->head);
+    snapshot_write_var(s, ide->drive);
+    snapshot_write_var(s, ide->cylprecomp);
+    snapshot_write_var(s, ide->lba_addr);
+    snapshot_write_var(s, ide->spt);
+    snapshot_write_var(s, ide->hpc);
+    /* Empty slots have no buffer; the type is checked on load. */
+    if (ide->buffer != NULL)
+	snapshot_write(s, ide->buffer, 65536 * sizeof(uint16_t));
+    if (ide->type == IDE_HDD)
+	hdd_image_wait(ide->hdd_num);
+    if ((ide->type == IDE_HDD) && (ide->sector_buffer != NULL))
+	snapshot_write(s, ide->sector_buffer, 256 * 512);
+}
+
+
+static void
+ide_drive_load(ide_t *ide, snapshot_t *s)
+{
+    snapshot_read_var(s, ide->atastat);
+    snapshot_read_var(s, ide->error);
+    snapshot_read_var(s, ide->command);
+    snapshot_read_var(s, ide->fdisk);
+    snapshot_read_var(s, ide->irqstat);
+    snapshot_read_var(s, ide->service);
+    snapshot_read_var(s, ide->blocksize);
+    snapshot_read_var(s, ide->blockcount);
+    snapshot_read_var(s, ide->pos);
+    snapshot_read_var(s, ide->sector_pos);
+    snapshot_read_var(s, ide->lba);
+    snapshot_read_var(s, ide->skip512);
+    snapshot_read_var(s, ide->reset);
+    snapshot_read_var(s, ide->mdma_mode);
+    snapshot_read_var(s, ide->secount);
+    snapshot_read_var(s, ide->sector);
+    snapshot_read_var(s, ide->cylinder);
+    snapshot_read_var(s, ide->head);
+    snapshot_read_var(s, ide->drive);
+    snapshot_read_var(s, ide->cylprecomp);
+    snapshot_read_var(s, ide->lba_addr);
+    snapshot_read_var(s, ide->spt);
+    snapshot_read_var(s, ide->hpc);
+    if (ide->buffer != NULL)
+	snapshot_read(s, ide->buffer, 65536 * sizeof(uint16_t));
+    if ((ide->type == IDE_HDD) && (ide->sector_buffer != NULL))
+	snapshot_read(s, ide->sector_buffer, 256 * 512);
+}
+
+
+static void
+ide_save(void *priv, snapshot_t *s)
+{
+    uint8_t present;
+    int b, d;
+
+    for (b = 0; b < 2; b++) {
+	present = (ide_boards[b] != NULL);
+	snapshot_write_var(s, present);
+	if (!present)
+		continue;
+
+	snapshot_write_var(s, ide_boards[b]->bit32);
+	snapshot_write_var(s, ide_boards[b]->cur_dev);
+	snapshot_write_var(s, ide_boards[b]->irq);
+	snapshot_write_var(s, ide_boards[b]->callback);
+
+	for (d = (b << 1); d < ((b << 1) + 2); d++) {
+		present = (ide_drives[d] != NULL) ? (uint8_t) (ide_drives[d]->type + 1) : 0;
+		snapshot_write_var(s, present);
+		if (present)
+			ide_drive_save(ide_drives[d], s);
+	}
+    }
+}
+
+
+/* Restore the channels; a drive of a different type is left alone. */
+static void
+ide_load(void *priv, snapshot_t *s)
+{
+    uint8_t present;
+    int b, d;
+
+    for (b = 0; b < 2; b++) {
+	snapshot_read_var(s, present);
+	if (!present)
+		continue;
+
+	if (ide_boards[b] == NULL) {
+		ide_log("IDE: board %i not present, skipping the rest\n", b);
+		return;
+	}
+
+	snapshot_read_var(s, ide_boards[b]->bit32);
+	snapshot_read_var(s, ide_boards[b]->cur_dev);
+	snapshot_read_var(s, ide_boards[b]->irq);
+	snapshot_read_var(s, ide_boards[b]->callback);
+
+	for (d = (b << 1); d < ((b << 1) + 2); d++) {
+		snapshot_read_var(s, present);
+		if (!present)
+			continue;
+
+		if ((ide_drives[d] == NULL) || ((ide_drives[d]->type + 1) != present)) {
+			ide_log("IDE: drive %i mismatch, skipping the rest\n", d);
+			return;
+		}
+
+		ide_drive_load(ide_drives[d], s);
+	}
+    }
+}
+
+
 /* Close a standalone IDE unit. */
 static void
 ide_ter_close(void *priv)
@@ -2719,6 +2877,8 @@ ide_drive_reset(int d)
 
     ide_set_signature(ide_drives[d]);
 
+    if (ide_drives[d]->type == IDE_HDD)
+	hdd_image_wait(ide_drives[d]->hdd_num);
     if (ide_drives[d]->sector_buffer)
 	memset(ide_drives[d]->sector_buffer, 0, 256*512);
 
@@ -2776,7 +2936,8 @@ const device_t ide_isa_device = {
     DEVICE_ISA | DEVICE_AT,
     0,
     ide_init, ide_close, ide_reset,
-    NULL, NULL, NULL, NULL
+    NULL, NULL, NULL, NULL,
+    ide_save, ide_load
 };
 
 const device_t ide_isa_2ch_device = {
@@ -2784,7 +2945,8 @@ const device_t ide_isa_2ch_device = {
     DEVICE_ISA | DEVICE_AT,
     2,
     ide_init, ide_close, ide_reset,
-    NULL, NULL, NULL, NULL
+    NULL, NULL, NULL, NULL,
+    ide_save, ide_load
 };
 
 const device_t ide_isa_2ch_opt_device = {
@@ -2792,7 +2954,8 @@ const device_t ide_isa_2ch_opt_device = {
     DEVICE_ISA | DEVICE_AT,
     3,
     ide_init, ide_close, ide_reset,
-    NULL, NULL, NULL, NULL
+    NULL, NULL, NULL, NULL,
+    ide_save, ide_load
 };
 
 const device_t ide_vlb_device = {
@@ -2800,7 +2963,8 @@ const device_t ide_vlb_device = {
     DEVICE_VLB | DEVICE_AT,
     4,
     ide_init, ide_close, ide_reset,
-    NULL, NULL, NULL, NULL
+    NULL, NULL, NULL, NULL,
+    ide_save, ide_load
 };
 
 const device_t ide_vlb_2ch_device = {
@@ -2808,7 +2972,8 @@ const device_t ide_vlb_2ch_device = {
     DEVICE_VLB | DEVICE_AT,
     6,
     ide_init, ide_close, ide_reset,
-    NULL, NULL, NULL, NULL
+    NULL, NULL, NULL, NULL,
+    ide_save, ide_load
 };
 
 const device_t ide_pci_device = {
@@ -2816,7 +2981,8 @@ const device_t ide_pci_device = {
     DEVICE_PCI | DEVICE_AT,
     8,
     ide_init, ide_close, ide_reset,
-    NULL, NULL, NULL, NULL
+    NULL, NULL, NULL, NULL,
+    ide_save, ide_load
 };
 
 const device_t ide_pci_2ch_device = {
@@ -2824,7 +2990,8 @@ const device_t ide_pci_2ch_device = {
     DEVICE_PCI | DEVICE_AT,
     10,
     ide_init, ide_close, ide_reset,
-    NULL, NULL, NULL, NULL
+    NULL, NULL, NULL, NULL,
+    ide_save, ide_load
 };
 
 static const device_config_t ide_ter_config[] =
@@ -72,6 +72,15 @@ enum {
 #endif
 
 
+/* Hard disk overlay modes. */
+enum {
+    HDD_OVERLAY_NONE = 0,		/* writes go to the image */
+    HDD_OVERLAY_KEEP,			/* overlay is kept between runs */
+    HDD_OVERLAY_DISCARD,		/* overlay is dropped on close */
+    HDD_OVERLAY_COMMIT			/* overlay is merged on close */
+};
+
+
 /* Define the virtual Hard Disk. */
 typedef struct {
     uint8_t	id;
@@ -83,7 +92,8 @@ typedef struct {
     uint8_t	bus,
 		res;			/* Reserved for bus mode */
     uint8_t	wp;			/* Disk has been mounted READ-ONLY */
-    uint8_t	pad, pad0;
+    uint8_t	overlay,		/* Writes go to an overlay file */
+		mmap;			/* Image is accessed through a mapping */
 
     void	*priv;
 
@@ -102,6 +112,21 @@ extern hard_disk_t      hdd[HDD_NUM];
 extern unsigned int	hdd_table[128][3];
 
 
+#define VHD_TYPE_FIXED		2
+#define VHD_TYPE_DYNAMIC	3
+#define VHD_TYPE_DIFF		4
+
+typedef struct _vhd_ vhd_t;
+
+/* Transfer statistics, per image. */
+typedef struct {
+    uint64_t	reads, writes, zeroes,		/* commands */
+		sectors_read, sectors_written,
+		sectors_zeroed,
+		seeks,				/* non-sequential transfers */
+		aio_hits, aio_misses;		/* background reads used/redone */
+} hdd_stats_t;
+
 typedef struct vhd_footer_t
 {
     uint8_t	cookie[8];
@@ -136,6 +161,9 @@ extern void	hdd_image_init(void);
 extern int	hdd_image_load(int id);
 extern void	hdd_image_seek(uint8_t id, uint32_t sector);
 extern void	hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern void	hdd_image_read_async(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern void	hdd_image_read_complete(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern void	hdd_image_wait(uint8_t id);
 extern int	hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
 extern void	hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
 extern int	hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
@@ -144,15 +172,30 @@ extern int	hdd_image_zero_ex(uint8_t id, uint32_t sector, uint32_t count);
 extern uint32_t	hdd_image_get_last_sector(uint8_t id);
 extern uint32_t	hdd_image_get_pos(uint8_t id);
 extern uint8_t	hdd_image_get_type(uint8_t id);
+extern int	hdd_image_resize(uint8_t id, uint32_t sectors);
+extern void	hdd_image_get_stats(uint8_t id, hdd_stats_t *stats);
+extern void	hdd_image_reset_stats(uint8_t id);
 extern void	hdd_image_unload(uint8_t id, int fn_preserve);
 extern void	hdd_image_close(uint8_t id);
 extern void	hdd_image_calc_chs(uint32_t *c, uint32_t *h, uint32_t *s, uint32_t size);
+extern int	hdd_image_overlay_commit(uint8_t id);
+extern int	hdd_image_overlay_discard(uint8_t id);
 
 extern void	vhd_footer_from_bytes(vhd_footer_t *vhd, uint8_t *bytes);
 extern void	vhd_footer_to_bytes(uint8_t *bytes, vhd_footer_t *vhd);
 extern void	new_vhd_footer(vhd_footer_t **vhd);
 extern void	generate_vhd_checksum(vhd_footer_t *vhd);
 
+extern vhd_t	*vhd_open(wchar_t *fn, int ro);
+extern void	vhd_close(vhd_t *vhd);
+extern int	vhd_create(wchar_t *fn, uint64_t size, uint32_t tracks,
+			   uint32_t hpc, uint32_t spt, wchar_t *parent);
+extern uint32_t	vhd_get_sectors(vhd_t *vhd);
+extern void	vhd_get_geometry(vhd_t *vhd, uint32_t *tracks, uint32_t *hpc, uint32_t *spt);
+extern void	vhd_read(vhd_t *vhd, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern void	vhd_write(vhd_t *vhd, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern void	vhd_zero(vhd_t *vhd, uint32_t sector, uint32_t count);
+
 extern int	image_is_hdi(const wchar_t *s);
 extern int	image_is_hdx(const wchar_t *s, int check_signature);
 extern int	image_is_vhd(const wchar_t *s, int check_signature);
@@ -19,6 +19,7 @@
 #define _LARGEFILE_SOURCE
 #define _LARGEFILE64_SOURCE
 #define _GNU_SOURCE
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -34,6 +35,41 @@
 #include "hdd.h"
 
 
+/*
+ * A copy-on-write overlay over an image. The overlay file has a
+ * header, a map with one entry per block of the image (the block
+ * number in the overlay plus one, or zero if the block was never
+ * written), and then the blocks themselves in the order in which
+ * they were first written.
+ */
+#define OVL_MAGIC	"86BoxOVL"
+#define OVL_VERSION	1
+#define OVL_SHIFT	3			/* 8 sectors (4K) per block */
+#define OVL_SECTORS	(1 << OVL_SHIFT)
+#define OVL_MASK	(OVL_SECTORS - 1)
+#define OVL_MAP_POS	512
+
+typedef struct {
+    char	magic[8];
+    uint32_t	version;
+    uint32_t	shift;
+    uint32_t	blocks;				/* blocks in the image */
+    uint32_t	alloc;				/* blocks in the overlay */
+    uint32_t	sectors;			/* sectors in the image */
+    uint32_t	name_hash;			/* hash of the image name */
+} ovl_header_t;
+
+typedef struct {
+    FILE	*file;
+    uint32_t	*map;
+    uint32_t	blocks, alloc,
+		sectors, name_hash;
+    uint64_t	data;				/* file offset of block 0 */
+    int		mode;
+    wchar_t	fn[1024];
+} hdd_overlay_t;
+
+
 typedef struct
 {
     FILE *file;
@@ -41,11 +77,32 @@ typedef struct
     uint32_t pos, last_sector;
     uint8_t type;
     uint8_t loaded;    
+    hdd_overlay_t *ovl;
+    vhd_t *vhd;				/* dynamic and differencing VHD */
+    uint8_t *map;			/* the whole file, if mapped */
+    uint64_t map_size;
+
+    hdd_stats_t stats;
+    uint32_t next_sector;		/* where the last transfer ended */
+
+    /* The read queued to (or completed by) the I/O thread. */
+    volatile int aio_state;
+    uint32_t aio_sector, aio_count;
+    uint8_t *aio_buffer;
 } hdd_image_t;
 
 
+#define AIO_IDLE	0
+#define AIO_QUEUED	1
+#define AIO_DONE	2
+
+
 hdd_image_t hdd_images[HDD_NUM];
 
+static thread_t	*aio_thread;
+static event_t	*aio_wake,
+		*aio_done;
+
 static char empty_sector[512];
 static char *empty_sector_1mb;
 
@@ -95,11 +152,10 @@ image_is_hdi(const wchar_t *s)
 {
     int len;
     wchar_t ext[5] = { 0, 0, 0, 0, 0 };
-    char *ws = (char *) s;
     len = wcslen(s);
     if ((len < 4) || (s[0] == L'.'))
 	return 0;
-    memcpy(ext, ws + ((len - 4) << 1), 8);
+    memcpy(ext, s + (len - 4), 4 * sizeof(wchar_t));
     if (! wcscasecmp(ext, L".HDI"))
 	return 1;
     else
@@ -114,12 +170,11 @@ image_is_hdx(const wchar_t *s, int check_signature)
     FILE *f;
     uint64_t filelen;
     uint64_t signature;
-    char *ws = (char *) s;
     wchar_t ext[5] = { 0, 0, 0, 0, 0 };
     len = wcslen(s);
     if ((len < 4) || (s[0] == L'.'))
 	return 0;
-    memcpy(ext, ws + ((len - 4) << 1), 8);
+    memcpy(ext, s + (len - 4), 4 * sizeof(wchar_t));
     if (wcscasecmp(ext, L".HDX") == 0) {
 	if (check_signature) {
 		f = plat_fopen((wchar_t *)s, L"rb");
@@ -150,12 +205,11 @@ image_is_vhd(const wchar_t *s, int check_signature)
     FILE *f;
     uint64_t filelen;
     uint64_t signature;
-    char *ws = (char *) s;
     wchar_t ext[5] = { 0, 0, 0, 0, 0 };
     len = wcslen(s);
     if ((len < 4) || (s[0] == L'.'))
 	return 0;
-    memcpy(ext, ws + ((len - 4) << 1), 8);
+    memcpy(ext, s + (len - 4), 4 * sizeof(wchar_t));
     if (wcscasecmp(ext, L".VHD") == 0) {
 	if (check_signature) {
 		f = plat_fopen((wchar_t *)s, L"rb");
@@ -391,12 +445,17 @@ new_vhd_footer(vhd_footer_t **vhd)
 void
 generate_vhd_checksum(vhd_footer_t *vhd)
 {
+    uint8_t bytes[512];
     uint32_t chk = 0;
     int i;
-    for (i = 0; i < sizeof(vhd_footer_t); i++) {
+
+    /* The checksum is over the footer as it is stored, big-endian. */
+    memset(bytes, 0x00, sizeof(bytes));
+    vhd_footer_to_bytes(bytes, vhd);
+    for (i = 0; i < sizeof(bytes); i++) {
 	/* We don't include the checksum field in the checksum */
 	if ((i < VHD_OFFSET_CHECKSUM) || (i >= VHD_OFFSET_UUID))
-		chk += ((uint8_t*)vhd)[i];
+		chk += bytes[i];
     }
     vhd->checksum = ~chk;
 }
@@ -443,10 +502,19 @@ hdd_image_calc_chs(uint32_t *c, uint32_t *h, uint32_t *s, uint32_t size)
 static int
 prepare_new_hard_disk(uint8_t id, uint64_t full_size)
 {
-    uint64_t target_size = (full_size + hdd_images[id].base) - ftello64(hdd_images[id].file);
+    uint64_t target_size = full_size + hdd_images[id].base;
+    uint64_t pos = ftello64(hdd_images[id].file);
 
     uint32_t size;
     uint32_t t, i;
+    int ret = 1;
+
+    /* The file may already extend past the new size, for example a
+       raw image that is not a whole number of cylinders. */
+    if (target_size > pos)
+	target_size -= pos;
+    else
+	target_size = 0;
 
     t = (uint32_t) (target_size >> 20);		/* Amount of 1 MB blocks. */
     size = (uint32_t) (target_size & 0xfffff);	/* 1 MB mask. */
@@ -463,16 +531,21 @@ prepare_new_hard_disk(uint8_t id, uint64_t full_size)
     if (t > 0) {
 	for (i = 0; i < t; i++) {
 		fseek(hdd_images[id].file, 0, SEEK_END);
-		fwrite(empty_sector_1mb, 1, 1048576, hdd_images[id].file);
+		if (fwrite(empty_sector_1mb, 1, 1048576, hdd_images[id].file) != 1048576) {
+			ret = 0;
+			break;
+		}
 		pclog("#");
 	}
     }
 
     /* Then, write the remainder. */
-    if (size > 0) {
+    if (ret && (size > 0)) {
 	fseek(hdd_images[id].file, 0, SEEK_END);
-	fwrite(empty_sector_1mb, 1, size, hdd_images[id].file);
-	pclog("#");
+	if (fwrite(empty_sector_1mb, 1, size, hdd_images[id].file) != size)
+		ret = 0;
+	else
+		pclog("#");
     }
     pclog("]\n");
     /* Switch the suppression of seen messages back on. */
@@ -480,6 +553,11 @@ prepare_new_hard_disk(uint8_t id, uint64_t full_size)
 
     free(empty_sector_1mb);
 
+    if (! ret) {
+	hdd_image_log("Unable to write image %i, disk full?\n", id);
+	return 0;
+    }
+
     hdd_images[id].last_sector = (uint32_t) (full_size >> 9) - 1;
 
     hdd_images[id].loaded = 1;
@@ -493,8 +571,10 @@ hdd_image_init(void)
 {
     int i;
 
-    for (i = 0; i < HDD_NUM; i++)
+    for (i = 0; i < HDD_NUM; i++) {
+	hdd_image_wait(i);
 	memset(&hdd_images[i], 0, sizeof(hdd_image_t));
+    }
 }
 
 
@@ -517,8 +597,447 @@ hdd_image_gen_vft(int id, vhd_footer_t **vft, uint64_t full_size)
 }
 
 
+static uint32_t
+ovl_name_hash(wchar_t *fn)
+{
+    uint32_t h = 0x811c9dc5;
+
+    while (*fn != L'\0')
+	h = (h ^ (uint32_t) *fn++) * 0x01000193;
+
+    return h;
+}
+
+
+static void
+ovl_write_header(hdd_overlay_t *ovl)
+{
+    ovl_header_t hdr;
+
+    memset(&hdr, 0x00, sizeof(hdr));
+    memcpy(hdr.magic, OVL_MAGIC, 8);
+    hdr.version = OVL_VERSION;
+    hdr.shift = OVL_SHIFT;
+    hdr.blocks = ovl->blocks;
+    hdr.alloc = ovl->alloc;
+    hdr.sectors = ovl->sectors;
+    hdr.name_hash = ovl->name_hash;
+
+    fseeko64(ovl->file, 0, SEEK_SET);
+    fwrite(&hdr, 1, sizeof(hdr), ovl->file);
+}
+
+
+/* (Re)create an empty overlay file. */
+static int
+ovl_create(hdd_overlay_t *ovl)
+{
+    if (ovl->file != NULL)
+	fclose(ovl->file);
+
+    ovl->file = plat_fopen(ovl->fn, L"wb+");
+    if (ovl->file == NULL)
+	return 0;
+
+    ovl->alloc = 0;
+    memset(ovl->map, 0x00, ovl->blocks * sizeof(uint32_t));
+
+    ovl_write_header(ovl);
+    fseeko64(ovl->file, OVL_MAP_POS, SEEK_SET);
+    fwrite(ovl->map, 1, ovl->blocks * sizeof(uint32_t), ovl->file);
+    fflush(ovl->file);
+
+    return 1;
+}
+
+
+/* Re-use an overlay from an earlier run, if it was made for this image. */
+static int
+ovl_reopen(hdd_overlay_t *ovl)
+{
+    ovl_header_t hdr;
+
+    ovl->file = plat_fopen(ovl->fn, L"rb+");
+    if (ovl->file == NULL)
+	return 0;
+
+    if ((fread(&hdr, 1, sizeof(hdr), ovl->file) != sizeof(hdr)) ||
+	memcmp(hdr.magic, OVL_MAGIC, 8) || (hdr.version != OVL_VERSION) ||
+	(hdr.shift != OVL_SHIFT) || (hdr.blocks != ovl->blocks) ||
+	(hdr.sectors != ovl->sectors) || (hdr.name_hash != ovl->name_hash)) {
+	hdd_image_log("Overlay %ls does not match the image\n", ovl->fn);
+	return 0;
+    }
+
+    fseeko64(ovl->file, OVL_MAP_POS, SEEK_SET);
+    if (fread(ovl->map, 1, ovl->blocks * sizeof(uint32_t), ovl->file) !=
+	(ovl->blocks * sizeof(uint32_t)))
+	return 0;
+
+    ovl->alloc = hdr.alloc;
+
+    return 1;
+}
+
+
+static int
+hdd_image_overlay_open(uint8_t id, int mode)
+{
+    hdd_overlay_t *ovl;
+    wchar_t temp[64];
+
+    ovl = (hdd_overlay_t *) malloc(sizeof(hdd_overlay_t));
+    memset(ovl, 0x00, sizeof(hdd_overlay_t));
+    ovl->mode = mode;
+    ovl->sectors = hdd_images[id].last_sector + 1;
+    ovl->blocks = (ovl->sectors + OVL_MASK) >> OVL_SHIFT;
+    ovl->name_hash = ovl_name_hash(hdd[id].fn);
+    ovl->data = (OVL_MAP_POS + (ovl->blocks * sizeof(uint32_t)) + 4095) & ~4095ULL;
+    ovl->map = (uint32_t *) malloc(ovl->blocks * sizeof(uint32_t));
+
+    /* Throwaway overlays get a name of their own. */
+    if (hdd_overlays) {
+	swprintf(temp, sizeof_w(temp), L"hdd_%02i", id + 1);
+	plat_tempfile(temp, temp, L".ovl");
+    } else
+	swprintf(temp, sizeof_w(temp), L"hdd_%02i.ovl", id + 1);
+    plat_append_filename(ovl->fn, usr_path, temp);
+
+    if ((mode == HDD_OVERLAY_DISCARD) || !ovl_reopen(ovl)) {
+	if (! ovl_create(ovl)) {
+		hdd_image_log("Unable to create overlay %ls\n", ovl->fn);
+		free(ovl->map);
+		free(ovl);
+		return 0;
+	}
+    }
+
+    hdd_image_log("Overlay %ls: %i of %i blocks in use\n",
+		  ovl->fn, ovl->alloc, ovl->blocks);
+
+    hdd_images[id].ovl = ovl;
+
+    return 1;
+}
+
+
+static void
+hdd_image_overlay_close(uint8_t id)
+{
+    hdd_overlay_t *ovl = hdd_images[id].ovl;
+
+    if (ovl == NULL)
+	return;
+
+    if (ovl->mode == HDD_OVERLAY_COMMIT)
+	hdd_image_overlay_commit(id);
+
+    if (ovl->file != NULL)
+	fclose(ovl->file);
+    if (ovl->mode != HDD_OVERLAY_KEEP)
+	plat_remove(ovl->fn);
+
+    free(ovl->map);
+    free(ovl);
+    hdd_images[id].ovl = NULL;
+}
+
+
+/*
+ * Raw images can be mapped, so that a transfer is a single copy from
+ * or to the host's page cache rather than a trip through stdio. Only
+ * the part of a transfer that lies within the file is done, just like
+ * a short fread() would.
+ */
+static void
+hdd_image_map(int id, int ro)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if ((img->file == NULL) || (img->vhd != NULL))
+	return;
+
+    fflush(img->file);
+    fseeko64(img->file, 0, SEEK_END);
+    img->map_size = ftello64(img->file);
+
+    img->map = plat_mmap_image(img->file, img->map_size, ro);
+    if (img->map == NULL)
+	hdd_image_log("Unable to map %ls, using file I/O\n", hdd[id].fn);
+}
+
+
+static void
+hdd_image_unmap(int id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->map == NULL)
+	return;
+
+    plat_munmap_image(img->map, img->map_size);
+    img->map = NULL;
+}
+
+
+static uint32_t
+map_clip(uint8_t id, uint64_t addr, uint32_t len)
+{
+    uint64_t size = hdd_images[id].map_size;
+
+    if (addr >= size)
+	return 0;
+    if (len > (size - addr))
+	return (uint32_t) (size - addr);
+    return len;
+}
+
+
+static void
+map_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    uint64_t addr = ((uint64_t)sector << 9LL) + hdd_images[id].base;
+    uint32_t len = map_clip(id, addr, count << 9);
+
+    memcpy(buffer, hdd_images[id].map + addr, len);
+
+    /* Multi-sector reads are usually followed by the next run. */
+    if (count > 1)
+	plat_mmap_prefetch(hdd_images[id].map + addr + len, map_clip(id, addr + len, len));
+}
+
+
+static void
+map_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    uint64_t addr = ((uint64_t)sector << 9LL) + hdd_images[id].base;
+
+    memcpy(hdd_images[id].map + addr, buffer, map_clip(id, addr, count << 9));
+}
+
+
+/* Read from the image itself; anything past its end reads as zeroes. */
+static void
+hdd_image_base_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    if (hdd_images[id].vhd != NULL) {
+	vhd_read(hdd_images[id].vhd, sector, count, buffer);
+	return;
+    }
+
+    memset(buffer, 0x00, count << 9);
+    if (hdd_images[id].map != NULL) {
+	map_read(id, sector, count, buffer);
+	return;
+    }
+    fseeko64(hdd_images[id].file, ((uint64_t)sector << 9LL) + hdd_images[id].base, SEEK_SET);
+    fread(buffer, 1, count << 9, hdd_images[id].file);
+}
+
+
+static void
+ovl_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_overlay_t *ovl = hdd_images[id].ovl;
+    uint32_t b, n;
+
+    while (count > 0) {
+	b = sector >> OVL_SHIFT;
+	n = OVL_SECTORS - (sector & OVL_MASK);
+	if (n > count)
+		n = count;
+
+	if ((b < ovl->blocks) && ovl->map[b]) {
+		fseeko64(ovl->file, ovl->data + ((uint64_t)(ovl->map[b] - 1) << (OVL_SHIFT + 9)) +
+			 ((sector & OVL_MASK) << 9), SEEK_SET);
+		fread(buffer, 1, n << 9, ovl->file);
+	} else {
+		/* Read a run of untouched blocks from the image in one go. */
+		while ((n < count) && (((sector + n) >> OVL_SHIFT) < ovl->blocks) &&
+		       !ovl->map[(sector + n) >> OVL_SHIFT])
+			n += ((count - n) > OVL_SECTORS) ? OVL_SECTORS : (count - n);
+		hdd_image_base_read(id, sector, n, buffer);
+	}
+
+	sector += n;
+	count -= n;
+	buffer += (n << 9);
+    }
+}
+
+
+static void
+ovl_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_overlay_t *ovl = hdd_images[id].ovl;
+    uint8_t blk[OVL_SECTORS << 9];
+    uint32_t b, n, off;
+
+    while (count > 0) {
+	b = sector >> OVL_SHIFT;
+	off = sector & OVL_MASK;
+	n = OVL_SECTORS - off;
+	if (n > count)
+		n = count;
+
+	if (b >= ovl->blocks)
+		break;
+
+	if (ovl->map[b]) {
+		fseeko64(ovl->file, ovl->data + ((uint64_t)(ovl->map[b] - 1) << (OVL_SHIFT + 9)) +
+			 (off << 9), SEEK_SET);
+		fwrite(buffer, 1, n << 9, ovl->file);
+	} else {
+		/* First write to this block, copy it up from the image. */
+		if (n != OVL_SECTORS)
+			hdd_image_base_read(id, b << OVL_SHIFT, OVL_SECTORS, blk);
+		memcpy(blk + (off << 9), buffer, n << 9);
+
+		fseeko64(ovl->file, ovl->data + ((uint64_t)ovl->alloc << (OVL_SHIFT + 9)), SEEK_SET);
+		fwrite(blk, 1, OVL_SECTORS << 9, ovl->file);
+
+		ovl->map[b] = ++ovl->alloc;
+		fseeko64(ovl->file, OVL_MAP_POS + (b * sizeof(uint32_t)), SEEK_SET);
+		fwrite(&ovl->map[b], 1, sizeof(uint32_t), ovl->file);
+		ovl_write_header(ovl);
+	}
+
+	sector += n;
+	count -= n;
+	buffer += (n << 9);
+    }
+}
+
+
+static void
+ovl_zero(uint8_t id, uint32_t sector, uint32_t count)
+{
+    uint8_t blk[OVL_SECTORS << 9];
+    uint32_t n;
+
+    memset(blk, 0x00, sizeof(blk));
+
+    while (count > 0) {
+	n = OVL_SECTORS - (sector & OVL_MASK);
+	if (n > count)
+		n = count;
+	ovl_write(id, sector, n, blk);
+	sector += n;
+	count -= n;
+    }
+}
+
+
+/* Merge the overlay into the image, and start a new, empty one. */
 int
-hdd_image_load(int id)
+hdd_image_overlay_commit(uint8_t id)
+{
+    hdd_overlay_t *ovl = hdd_images[id].ovl;
+    uint8_t blk[OVL_SECTORS << 9];
+    uint32_t b, n;
+    FILE *f;
+
+    if (ovl == NULL)
+	return 0;
+
+    hdd_image_wait(id);
+
+    /* The image was opened read-only. */
+    if (hdd_images[id].vhd != NULL) {
+	vhd_close(hdd_images[id].vhd);
+	hdd_images[id].vhd = vhd_open(hdd[id].fn, 0);
+	if (hdd_images[id].vhd == NULL) {
+		hdd_image_log("Overlay: unable to open %ls for writing\n", hdd[id].fn);
+		hdd_images[id].vhd = vhd_open(hdd[id].fn, 1);
+		return 0;
+	}
+	f = NULL;
+    } else {
+	f = plat_fopen(hdd[id].fn, L"rb+");
+	if (f == NULL) {
+		hdd_image_log("Overlay: unable to open %ls for writing\n", hdd[id].fn);
+		return 0;
+	}
+	fclose(hdd_images[id].file);
+	hdd_images[id].file = f;
+    }
+
+    for (b = 0; b < ovl->blocks; b++) {
+	if (! ovl->map[b])
+		continue;
+
+	fseeko64(ovl->file, ovl->data + ((uint64_t)(ovl->map[b] - 1) << (OVL_SHIFT + 9)), SEEK_SET);
+	fread(blk, 1, OVL_SECTORS << 9, ovl->file);
+
+	n = ovl->sectors - (b << OVL_SHIFT);
+	if (n > OVL_SECTORS)
+		n = OVL_SECTORS;
+	if (f == NULL) {
+		vhd_write(hdd_images[id].vhd, b << OVL_SHIFT, n, blk);
+		continue;
+	}
+	fseeko64(f, ((uint64_t)b << (OVL_SHIFT + 9)) + hdd_images[id].base, SEEK_SET);
+	fwrite(blk, 1, n << 9, f);
+    }
+    if (f != NULL)
+	fflush(f);
+
+    hdd_image_log("Overlay: committed %i blocks to %ls\n", ovl->alloc, hdd[id].fn);
+
+    return hdd_image_overlay_discard(id);
+}
+
+
+/* Throw away everything written since the overlay was started. */
+int
+hdd_image_overlay_discard(uint8_t id)
+{
+    hdd_overlay_t *ovl = hdd_images[id].ovl;
+
+    if (ovl == NULL)
+	return 0;
+
+    hdd_image_wait(id);
+
+    return ovl_create(ovl);
+}
+
+
+/* Dynamic and differencing VHD images are handled by hdd_vhd.c. */
+static int
+hdd_image_load_vhd(int id, int ro)
+{
+    uint32_t tracks, hpc, spt;
+
+    if (hdd_images[id].file != NULL) {
+	fclose(hdd_images[id].file);
+	hdd_images[id].file = NULL;
+    }
+
+    hdd_images[id].vhd = vhd_open(hdd[id].fn, ro || hdd[id].wp);
+    if (hdd_images[id].vhd == NULL) {
+	memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
+	return 0;
+    }
+
+    vhd_get_geometry(hdd_images[id].vhd, &tracks, &hpc, &spt);
+    hdd[id].tracks = tracks;
+    hdd[id].hpc = hpc;
+    hdd[id].spt = spt;
+    hdd_images[id].type = 4;
+    hdd_images[id].last_sector = vhd_get_sectors(hdd_images[id].vhd) - 1;
+    hdd_images[id].loaded = 1;
+
+    return 1;
+}
+
+
+/*
+ * Open the image itself. With an overlay on top (ro set), it is
+ * opened read-only, must already exist, and is never extended.
+ */
+static int
+hdd_image_load_base(int id, int ro)
 {
     uint32_t sector_size = 512;
     uint32_t zero = 0;
@@ -537,6 +1056,11 @@ hdd_image_load(int id)
     hdd_images[id].base = 0;
 
     if (hdd_images[id].loaded) {
+	hdd_image_unmap(id);
+	if (hdd_images[id].vhd) {
+		vhd_close(hdd_images[id].vhd);
+		hdd_images[id].vhd = NULL;
+	}
 	if (hdd_images[id].file) {
 		fclose(hdd_images[id].file);
 		hdd_images[id].file = NULL;
@@ -558,18 +1082,31 @@ hdd_image_load(int id)
 	memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
 	return 0;
     }
-    hdd_images[id].file = plat_fopen(fn, L"rb+");
+    hdd_images[id].file = plat_fopen(fn, ro ? L"rb" : L"rb+");
     if (hdd_images[id].file == NULL) {
 	/* Failed to open existing hard disk image */
 	if (errno == ENOENT) {
 		/* Failed because it does not exist,
 		   so try to create new file */
-		if (hdd[id].wp) {
+		if (hdd[id].wp || ro) {
 			hdd_image_log("A write-protected image must exist\n");
 			memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
 			return 0;
 		}
 
+		/* New VHD images are dynamic, so there is nothing to fill in. */
+		if (is_vhd[0]) {
+			full_size = ((uint64_t) hdd[id].spt) *
+				    ((uint64_t) hdd[id].hpc) *
+				    ((uint64_t) hdd[id].tracks) << 9LL;
+			if (! vhd_create(fn, full_size, hdd[id].tracks, hdd[id].hpc, hdd[id].spt, NULL)) {
+				hdd_image_log("Unable to create VHD image\n");
+				memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
+				return 0;
+			}
+			return hdd_image_load_vhd(id, ro);
+		}
+
 		hdd_images[id].file = plat_fopen(fn, L"wb+");
 		if (hdd_images[id].file == NULL) {
 			hdd_image_log("Unable to open image\n");
@@ -680,15 +1217,11 @@ hdd_image_load(int id)
 		fread(empty_sector, 1, 512, hdd_images[id].file);
 		new_vhd_footer(&vft);
 		vhd_footer_from_bytes(vft, (uint8_t *) empty_sector);
-		if (vft->type != 2) {
-			/* VHD is not fixed size */
-			hdd_image_log("VHD: Image is not fixed size\n");
+		if (vft->type != VHD_TYPE_FIXED) {
+			/* VHD is dynamic or differencing */
 			free(vft);
 			vft = NULL;
-			fclose(hdd_images[id].file);
-			hdd_images[id].file = NULL;
-			memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
-			return 0;
+			return hdd_image_load_vhd(id, ro);
 		}
 		full_size = vft->orig_size;
 		hdd[id].tracks = vft->geom.cyl;
@@ -713,15 +1246,16 @@ hdd_image_load(int id)
 
     fseeko64(hdd_images[id].file, 0, SEEK_END);
     s = ftello64(hdd_images[id].file);
-    if (s < (full_size + hdd_images[id].base))
+    if (!ro && (s < (full_size + hdd_images[id].base)))
 	ret = prepare_new_hard_disk(id, full_size);
     else {
+	/* A short image under an overlay reads as zeroes past its end. */
 	hdd_images[id].last_sector = (uint32_t) (full_size >> 9) - 1;
 	hdd_images[id].loaded = 1;
 	ret = 1;
     }
 
-    if (is_vhd[0]) {
+    if (is_vhd[0] && !ro) {
 	fseeko64(hdd_images[id].file, 0, SEEK_END);
 	s = ftello64(hdd_images[id].file);
 	if (s == (full_size + hdd_images[id].base)) {
@@ -734,31 +1268,200 @@ hdd_image_load(int id)
 }
 
 
+int
+hdd_image_load(int id)
+{
+    int mode = hdd_overlays ? HDD_OVERLAY_DISCARD : hdd[id].overlay;
+
+    hdd_image_wait(id);
+    hdd_image_overlay_close(id);
+
+    memset(&hdd_images[id].stats, 0, sizeof(hdd_stats_t));
+    hdd_images[id].next_sector = 0;
+
+    if (! hdd_image_load_base(id, mode != HDD_OVERLAY_NONE))
+	return 0;
+
+    if ((mode != HDD_OVERLAY_NONE) && !hdd_image_overlay_open(id, mode)) {
+	hdd_image_close(id);
+	memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
+	return 0;
+    }
+
+    if (hdd[id].mmap)
+	hdd_image_map(id, mode != HDD_OVERLAY_NONE);
+
+    return 1;
+}
+
+
 void
 hdd_image_seek(uint8_t id, uint32_t sector)
 {
     off64_t addr = sector;
     addr = (uint64_t)sector << 9LL;
 
+    hdd_image_wait(id);
+
     hdd_images[id].pos = sector;
-    fseeko64(hdd_images[id].file, addr + hdd_images[id].base, SEEK_SET);
+    if (hdd_images[id].file != NULL)
+	fseeko64(hdd_images[id].file, addr + hdd_images[id].base, SEEK_SET);
 }
 
 
-void
-hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+/* Count a transfer, and whether the drive had to seek for it. */
+static void
+hdd_image_account(uint8_t id, uint64_t *cmds, uint64_t *sectors, uint32_t sector, uint32_t count)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (sector != img->next_sector)
+	img->stats.seeks++;
+    img->next_sector = sector + count;
+
+    (*cmds)++;
+    *sectors += count;
+}
+
+
+/* The actual read, counted by whoever asked for it. */
+static void
+hdd_image_do_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
     hdd_images[id].pos = sector;
+    if (hdd_images[id].ovl != NULL) {
+	ovl_read(id, sector, count, buffer);
+	return;
+    }
+    if (hdd_images[id].vhd != NULL) {
+	vhd_read(hdd_images[id].vhd, sector, count, buffer);
+	return;
+    }
+    if (hdd_images[id].map != NULL) {
+	map_read(id, sector, count, buffer);
+	return;
+    }
     fseeko64(hdd_images[id].file, ((uint64_t)sector << 9LL) + hdd_images[id].base, SEEK_SET);
     fread(buffer, 1, count << 9, hdd_images[id].file);
 }
 
 
+/*
+ * The I/O thread. Reads are queued by the disk controllers when a
+ * command is issued and collected when the command's emulated seek
+ * and transfer time is up, so that the host's latency is hidden in
+ * the latency we model anyway. Each drive has at most one request
+ * outstanding, and any other access to the drive waits for it.
+ */
+static void
+hdd_image_aio_thread(void *param)
+{
+    hdd_image_t *img;
+    int id;
+
+    while (1) {
+	thread_wait_event(aio_wake, -1);
+
+	for (id = 0; id < HDD_NUM; id++) {
+		img = &hdd_images[id];
+		if (img->aio_state != AIO_QUEUED)
+			continue;
+
+		hdd_image_do_read(id, img->aio_sector, img->aio_count, img->aio_buffer);
+
+		img->aio_state = AIO_DONE;
+		thread_set_event(aio_done);
+	}
+    }
+}
+
+
+/* Wait for the drive's background read, if any, to finish. */
+void
+hdd_image_wait(uint8_t id)
+{
+    while (hdd_images[id].aio_state == AIO_QUEUED)
+	thread_wait_event(aio_done, -1);
+}
+
+
+/* Start reading sectors in the background. */
+void
+hdd_image_read_async(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    hdd_image_wait(id);
+    img->aio_state = AIO_IDLE;
+
+    if (! img->loaded)
+	return;
+
+    if (aio_thread == NULL) {
+	aio_wake = thread_create_event();
+	aio_done = thread_create_event();
+	aio_thread = thread_create(hdd_image_aio_thread, NULL);
+	if (aio_thread == NULL) {
+		/* Everything will simply be read when it is collected. */
+		hdd_image_log("Unable to start the I/O thread\n");
+		return;
+	}
+    }
+
+    img->aio_sector = sector;
+    img->aio_count = count;
+    img->aio_buffer = buffer;
+    img->aio_state = AIO_QUEUED;
+    thread_set_event(aio_wake);
+}
+
+
+/*
+ * Collect a read started by hdd_image_read_async(). If the request
+ * does not match what was queued (or nothing was), it is done now.
+ */
+void
+hdd_image_read_complete(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_t *img = &hdd_images[id];
+    int done;
+
+    hdd_image_wait(id);
+
+    done = (img->aio_state == AIO_DONE) && (img->aio_sector == sector) &&
+	   (img->aio_count == count) && (img->aio_buffer == buffer);
+    img->aio_state = AIO_IDLE;
+
+    /* One request, counted once, whichever way it was served. */
+    hdd_image_account(id, &img->stats.reads, &img->stats.sectors_read, sector, count);
+
+    if (done) {
+	img->stats.aio_hits++;
+	img->pos = sector;
+    } else {
+	img->stats.aio_misses++;
+	hdd_image_do_read(id, sector, count, buffer);
+    }
+}
+
+
+void
+hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_wait(id);
+    hdd_image_account(id, &hdd_images[id].stats.reads, &hdd_images[id].stats.sectors_read, sector, count);
+    hdd_image_do_read(id, sector, count, buffer);
+}
+
+
+/* The capacity is validated when the image is loaded, so just return it. */
 uint32_t
 hdd_sectors(uint8_t id)
 {
-    fseeko64(hdd_images[id].file, 0, SEEK_END);
-    return (uint32_t) ((ftello64(hdd_images[id].file) - hdd_images[id].base) >> 9);
+    if (! hdd_images[id].loaded)
+	return 0;
+
+    return hdd_images[id].last_sector + 1;
 }
 
 
@@ -768,7 +1471,9 @@ hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     uint32_t transfer_sectors = count;
     uint32_t sectors = hdd_sectors(id);
 
-    if ((sectors - sector) < transfer_sectors)
+    if (sector >= sectors)
+	transfer_sectors = 0;
+    else if ((sectors - sector) < transfer_sectors)
 	transfer_sectors = sectors - sector;
 
     hdd_image_read(id, sector, transfer_sectors, buffer);
@@ -782,7 +1487,23 @@ hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 void
 hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
+    hdd_image_wait(id);
+
+    hdd_image_account(id, &hdd_images[id].stats.writes, &hdd_images[id].stats.sectors_written, sector, count);
+
     hdd_images[id].pos = sector;
+    if (hdd_images[id].ovl != NULL) {
+	ovl_write(id, sector, count, buffer);
+	return;
+    }
+    if (hdd_images[id].vhd != NULL) {
+	vhd_write(hdd_images[id].vhd, sector, count, buffer);
+	return;
+    }
+    if (hdd_images[id].map != NULL) {
+	map_write(id, sector, count, buffer);
+	return;
+    }
     fseeko64(hdd_images[id].file, ((uint64_t)sector << 9LL) + hdd_images[id].base, SEEK_SET);
     fwrite(buffer, count << 9, 1, hdd_images[id].file);
 }
@@ -794,7 +1515,9 @@ hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     uint32_t transfer_sectors = count;
     uint32_t sectors = hdd_sectors(id);
 
-    if ((sectors - sector) < transfer_sectors)
+    if (sector >= sectors)
+	transfer_sectors = 0;
+    else if ((sectors - sector) < transfer_sectors)
 	transfer_sectors = sectors - sector;
 
     hdd_image_write(id, sector, transfer_sectors, buffer);
@@ -810,9 +1533,33 @@ hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
 {
     uint32_t i = 0;
 
+    hdd_image_wait(id);
+
+    hdd_image_account(id, &hdd_images[id].stats.zeroes, &hdd_images[id].stats.sectors_zeroed, sector, count);
+
     hdd_images[id].pos = sector;
-    fseeko64(hdd_images[id].file, ((uint64_t)sector << 9LL) + hdd_images[id].base, SEEK_SET);
     memset(empty_sector, 0, 512);
+    if (hdd_images[id].ovl != NULL) {
+	ovl_zero(id, sector, count);
+	return;
+    }
+    if (hdd_images[id].vhd != NULL) {
+	vhd_zero(hdd_images[id].vhd, sector, count);
+	return;
+    }
+
+    /* Within the image, let the host drop the blocks instead. */
+    if (((sector + count) <= (hdd_images[id].last_sector + 1)) &&
+	plat_punch_hole(hdd_images[id].file, ((uint64_t)sector << 9LL) + hdd_images[id].base,
+			(uint64_t)count << 9LL))
+	return;
+
+    if (hdd_images[id].map != NULL) {
+	for (i = 0; i < count; i++)
+		map_write(id, sector + i, 1, (uint8_t *) empty_sector);
+	return;
+    }
+    fseeko64(hdd_images[id].file, ((uint64_t)sector << 9LL) + hdd_images[id].base, SEEK_SET);
     for (i = 0; i < count; i++)
 	fwrite(empty_sector, 512, 1, hdd_images[id].file);
 }
@@ -824,7 +1571,9 @@ hdd_image_zero_ex(uint8_t id, uint32_t sector, uint32_t count)
     uint32_t transfer_sectors = count;
     uint32_t sectors = hdd_sectors(id);
 
-    if ((sectors - sector) < transfer_sectors)
+    if (sector >= sectors)
+	transfer_sectors = 0;
+    else if ((sectors - sector) < transfer_sectors)
 	transfer_sectors = sectors - sector;
 
     hdd_image_zero(id, sector, transfer_sectors);
@@ -856,13 +1605,126 @@ hdd_image_get_type(uint8_t id)
 }
 
 
+/*
+ * Grow an image to the given number of sectors. The geometry is up
+ * to the caller, and is written to the image's header or footer.
+ * Shrinking, and resizing an image that is under an overlay or is a
+ * dynamic VHD, is not supported. If the image cannot be grown, it is
+ * left at its old size (a fixed VHD gets its old footer back.)
+ */
+int
+hdd_image_resize(uint8_t id, uint32_t sectors)
+{
+    hdd_image_t *img = &hdd_images[id];
+    uint64_t full_size = (uint64_t)sectors << 9LL;
+    uint64_t old_size;
+    vhd_footer_t *vft = NULL;
+    uint8_t footer[512];
+    uint32_t size32;
+    int mapped;
+
+    hdd_image_wait(id);
+
+    if (!img->loaded || (img->file == NULL) || (img->ovl != NULL) || hdd[id].wp)
+	return 0;
+    if (sectors <= (img->last_sector + 1))
+	return (sectors == (img->last_sector + 1));
+    if ((img->type == 1) && (full_size >= 0x100000000ll))
+	return 0;
+
+    mapped = (img->map != NULL);
+    hdd_image_unmap(id);
+
+    old_size = ((uint64_t)(img->last_sector + 1) << 9LL) + img->base;
+    if (img->type == 3) {
+	/* The old footer becomes part of the data. */
+	fseeko64(img->file, old_size, SEEK_SET);
+	fread(footer, 1, 512, img->file);
+	memset(empty_sector, 0, 512);
+	fseeko64(img->file, old_size, SEEK_SET);
+	fwrite(empty_sector, 1, 512, img->file);
+    }
+    fseeko64(img->file, 0, SEEK_END);
+    if (! prepare_new_hard_disk(id, full_size)) {
+	if (img->type == 3) {
+		/* The footer is found at the end of the file. */
+		fseeko64(img->file, 0, SEEK_END);
+		fwrite(footer, 1, 512, img->file);
+	}
+	fflush(img->file);
+	if (mapped)
+		hdd_image_map(id, 0);
+	return 0;
+    }
+
+    switch (img->type) {
+	case 1:		/* HDI */
+		size32 = (uint32_t) full_size;
+		fseeko64(img->file, 0xC, SEEK_SET);
+		fwrite(&size32, 1, 4, img->file);
+		fseeko64(img->file, 0x14, SEEK_SET);
+		fwrite(&(hdd[id].spt), 1, 4, img->file);
+		fwrite(&(hdd[id].hpc), 1, 4, img->file);
+		fwrite(&(hdd[id].tracks), 1, 4, img->file);
+		break;
+
+	case 2:		/* HDX */
+		fseeko64(img->file, 0x8, SEEK_SET);
+		fwrite(&full_size, 1, 8, img->file);
+		fseeko64(img->file, 0x14, SEEK_SET);
+		fwrite(&(hdd[id].spt), 1, 4, img->file);
+		fwrite(&(hdd[id].hpc), 1, 4, img->file);
+		fwrite(&(hdd[id].tracks), 1, 4, img->file);
+		break;
+
+	case 3:		/* fixed VHD */
+		hdd_image_gen_vft(id, &vft, full_size);
+		break;
+    }
+    fflush(img->file);
+
+    if (mapped)
+	hdd_image_map(id, 0);
+
+    hdd_image_log("Image %i resized to %u sectors\n", id, sectors);
+
+    return 1;
+}
+
+
+void
+hdd_image_get_stats(uint8_t id, hdd_stats_t *stats)
+{
+    hdd_image_wait(id);
+
+    memcpy(stats, &hdd_images[id].stats, sizeof(hdd_stats_t));
+}
+
+
+void
+hdd_image_reset_stats(uint8_t id)
+{
+    hdd_image_wait(id);
+
+    memset(&hdd_images[id].stats, 0, sizeof(hdd_stats_t));
+}
+
+
 void
 hdd_image_unload(uint8_t id, int fn_preserve)
 {
     if (wcslen(hdd[id].fn) == 0)
 	return;
 
+    hdd_image_wait(id);
+
     if (hdd_images[id].loaded) {
+	hdd_image_overlay_close(id);
+	hdd_image_unmap(id);
+	if (hdd_images[id].vhd != NULL) {
+		vhd_close(hdd_images[id].vhd);
+		hdd_images[id].vhd = NULL;
+	}
 	if (hdd_images[id].file != NULL) {
 		fclose(hdd_images[id].file);
 		hdd_images[id].file = NULL;
@@ -887,6 +1749,27 @@ hdd_image_close(uint8_t id)
     if (!hdd_images[id].loaded)
 	return;
 
+    hdd_image_wait(id);
+
+    hdd_image_log("Image %i: %" PRIu64 " reads (%" PRIu64 " sectors), "
+		  "%" PRIu64 " writes (%" PRIu64 " sectors), "
+		  "%" PRIu64 " zeroes (%" PRIu64 " sectors), %" PRIu64 " seeks, "
+		  "%" PRIu64 "/%" PRIu64 " background reads used\n", id,
+		  hdd_images[id].stats.reads, hdd_images[id].stats.sectors_read,
+		  hdd_images[id].stats.writes, hdd_images[id].stats.sectors_written,
+		  hdd_images[id].stats.zeroes, hdd_images[id].stats.sectors_zeroed,
+		  hdd_images[id].stats.seeks, hdd_images[id].stats.aio_hits,
+		  hdd_images[id].stats.aio_hits + hdd_images[id].stats.aio_misses);
+
+    hdd_image_overlay_close(id);
+
+    hdd_image_unmap(id);
+
+    if (hdd_images[id].vhd != NULL) {
+	vhd_close(hdd_images[id].vhd);
+	hdd_images[id].vhd = NULL;
+    }
+
     if (hdd_images[id].file != NULL) {
 	fclose(hdd_images[id].file);
 	hdd_images[id].file = NULL;
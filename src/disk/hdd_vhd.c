@@ -0,0 +1,756 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Handling of dynamic and differencing VHD images.
+ *
+ *		These keep a block allocation table (BAT) after a dynamic
+ *		disk header, and only store the blocks that were written
+ *		to. Each block starts with a bitmap of the sectors in it
+ *		that hold data; for a differencing image, the others come
+ *		from the parent image.
+ *
+ * Version:	@(#)hdd_vhd.c	1.0.0	2026/10/18
+ *
+ * Author:	agent, <agent@local>
+ *
+ *		Copyright 2026 agent.
+ */
+#define _LARGEFILE_SOURCE
+#define _LARGEFILE64_SOURCE
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include "../86box.h"
+#include "../plat.h"
+#include "hdd.h"
+
+
+#define VHD_DYN_COOKIE		"cxsparse"
+#define VHD_DYN_SIZE		1024		/* dynamic disk header */
+#define VHD_BLOCK_SIZE		0x200000	/* 2 MB, the default */
+#define VHD_MAX_BLOCK_SIZE	0x10000000	/* 256 MB, sanity limit */
+#define VHD_BAT_UNUSED		0xffffffff
+#define VHD_MAX_DEPTH		16		/* parent chain limit */
+
+/* Offsets in the dynamic disk header. */
+#define DYN_OFFSET_COOKIE	0
+#define DYN_OFFSET_DATA_OFFSET	8
+#define DYN_OFFSET_TABLE_OFFSET	16
+#define DYN_OFFSET_VERSION	24
+#define DYN_OFFSET_MAX_ENTRIES	28
+#define DYN_OFFSET_BLOCK_SIZE	32
+#define DYN_OFFSET_CHECKSUM	36
+#define DYN_OFFSET_PARENT_UUID	40
+#define DYN_OFFSET_PARENT_TIME	56
+#define DYN_OFFSET_PARENT_NAME	64
+#define DYN_OFFSET_LOCATORS	576
+#define DYN_LOCATOR_SIZE	24
+
+
+struct _vhd_ {
+    FILE	*f;
+    int		type,
+		ro;
+    uint32_t	sectors;
+
+    /* Dynamic and differencing images only. */
+    uint64_t	bat_pos,
+		end;				/* where the footer is */
+    uint32_t	*bat,
+		bat_entries,
+		block_sectors,
+		bitmap_size;
+    int64_t	bm_block;			/* block in bitmap[] */
+    uint8_t	*bitmap;
+    uint8_t	footer[512];
+    vhd_t	*parent;
+};
+
+
+static vhd_t	*vhd_open_ex(wchar_t *fn, int ro, int depth);
+
+
+#ifdef ENABLE_VHD_LOG
+int vhd_do_log = ENABLE_VHD_LOG;
+
+
+static void
+vhd_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (vhd_do_log) {
+	va_start(ap, fmt);
+	pclog_ex(fmt, ap);
+	va_end(ap);
+    }
+}
+#else
+#define vhd_log(fmt, ...)
+#endif
+
+
+static uint32_t
+get_be32(uint8_t *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+	   ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+
+static uint64_t
+get_be64(uint8_t *p)
+{
+    return ((uint64_t) get_be32(p) << 32) | get_be32(p + 4);
+}
+
+
+static void
+put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+
+static void
+put_be64(uint8_t *p, uint64_t v)
+{
+    put_be32(p, (uint32_t) (v >> 32));
+    put_be32(p + 4, (uint32_t) v);
+}
+
+
+/* Ones' complement of the byte sum, with the checksum field left out. */
+static uint32_t
+vhd_checksum(uint8_t *p, int len, int chk_offset)
+{
+    uint32_t sum = 0;
+    int i;
+
+    for (i = 0; i < len; i++) {
+	if ((i < chk_offset) || (i >= (chk_offset + 4)))
+		sum += p[i];
+    }
+
+    return ~sum;
+}
+
+
+static void
+vhd_write_zeroes(FILE *f, uint64_t pos, uint64_t len)
+{
+    uint8_t buf[4096];
+    uint32_t n;
+
+    memset(buf, 0x00, sizeof(buf));
+
+    fseeko64(f, pos, SEEK_SET);
+    while (len > 0) {
+	n = (len > sizeof(buf)) ? sizeof(buf) : len;
+	fwrite(buf, 1, n, f);
+	len -= n;
+    }
+}
+
+
+/* Make a candidate parent path absolute, relative to the child's directory. */
+static void
+vhd_parent_path(wchar_t *dest, wchar_t *child, wchar_t *name)
+{
+    wchar_t *p;
+
+    if ((name[0] == L'.') && ((name[1] == L'\\') || (name[1] == L'/')))
+	name += 2;
+
+#ifndef _WIN32
+    for (p = name; *p != L'\0'; p++) {
+	if (*p == L'\\')
+		*p = L'/';
+    }
+#endif
+
+    if (plat_path_abs(name)) {
+	wcscpy(dest, name);
+	return;
+    }
+
+    wcscpy(dest, child);
+    p = plat_get_filename(dest);
+    *p = L'\0';
+    wcscat(dest, name);
+}
+
+
+/* Find and open the parent of a differencing image. */
+static int
+vhd_open_parent(vhd_t *vhd, wchar_t *fn, uint8_t *dyn, int depth)
+{
+    wchar_t name[512], path[1024];
+    uint8_t *loc, buf[1024];
+    uint32_t len, i, j;
+    uint64_t pos;
+
+    /* First try the Windows path locators, relative ones first. */
+    for (j = 0; j < 2; j++) {
+	for (i = 0; i < 8; i++) {
+		loc = dyn + DYN_OFFSET_LOCATORS + (i * DYN_LOCATOR_SIZE);
+		if (memcmp(loc, j ? "W2ku" : "W2ru", 4))
+			continue;
+
+		len = get_be32(loc + 8);
+		pos = get_be64(loc + 16);
+		if ((len == 0) || (len > sizeof(buf)))
+			continue;
+
+		fseeko64(vhd->f, pos, SEEK_SET);
+		if (fread(buf, 1, len, vhd->f) != len)
+			continue;
+
+		/* Locators are stored in UTF-16LE. */
+		len >>= 1;
+		for (pos = 0; pos < len; pos++)
+			name[pos] = buf[pos << 1] | (buf[(pos << 1) + 1] << 8);
+		name[len] = L'\0';
+
+		vhd_parent_path(path, fn, name);
+		vhd->parent = vhd_open_ex(path, 1, depth + 1);
+		if (vhd->parent != NULL)
+			return 1;
+	}
+    }
+
+    /* Then the parent name (UTF-16BE) from the header, next to us. */
+    for (i = 0; i < 255; i++) {
+	name[i] = (dyn[DYN_OFFSET_PARENT_NAME + (i << 1)] << 8) |
+		  dyn[DYN_OFFSET_PARENT_NAME + (i << 1) + 1];
+	if (name[i] == L'\0')
+		break;
+    }
+    name[i] = L'\0';
+
+    vhd_parent_path(path, fn, plat_get_filename(name));
+    vhd->parent = vhd_open_ex(path, 1, depth + 1);
+
+    return(vhd->parent != NULL);
+}
+
+
+static vhd_t *
+vhd_open_ex(wchar_t *fn, int ro, int depth)
+{
+    uint8_t dyn[VHD_DYN_SIZE];
+    vhd_footer_t ft;
+    uint64_t size;
+    vhd_t *vhd;
+    uint32_t i;
+
+    if (depth > VHD_MAX_DEPTH) {
+	vhd_log("VHD: parent chain too deep at %ls\n", fn);
+	return(NULL);
+    }
+
+    vhd = (vhd_t *) malloc(sizeof(vhd_t));
+    if (vhd == NULL)
+	return(NULL);
+    memset(vhd, 0x00, sizeof(vhd_t));
+    vhd->ro = ro;
+    vhd->bm_block = -1;
+
+    vhd->f = plat_fopen(fn, ro ? L"rb" : L"rb+");
+    if (vhd->f == NULL) {
+	vhd_log("VHD: unable to open %ls\n", fn);
+	free(vhd);
+	return(NULL);
+    }
+
+    fseeko64(vhd->f, 0, SEEK_END);
+    size = ftello64(vhd->f);
+    fseeko64(vhd->f, -512, SEEK_END);
+    if ((size < 512) || (fread(vhd->footer, 1, 512, vhd->f) != 512) ||
+	memcmp(vhd->footer, "conectix", 8)) {
+	vhd_log("VHD: %ls has no footer\n", fn);
+	goto fail;
+    }
+
+    vhd_footer_from_bytes(&ft, vhd->footer);
+    vhd->type = ft.type;
+    vhd->sectors = (uint32_t) (ft.curr_size >> 9);
+    vhd->end = size - 512;
+
+    if (vhd->type == VHD_TYPE_FIXED)
+	return(vhd);
+
+    if ((vhd->type != VHD_TYPE_DYNAMIC) && (vhd->type != VHD_TYPE_DIFF)) {
+	vhd_log("VHD: %ls has unknown type %i\n", fn, vhd->type);
+	goto fail;
+    }
+
+    fseeko64(vhd->f, ft.offset, SEEK_SET);
+    if ((fread(dyn, 1, VHD_DYN_SIZE, vhd->f) != VHD_DYN_SIZE) ||
+	memcmp(dyn + DYN_OFFSET_COOKIE, VHD_DYN_COOKIE, 8)) {
+	vhd_log("VHD: %ls has no dynamic disk header\n", fn);
+	goto fail;
+    }
+
+    vhd->bat_pos = get_be64(dyn + DYN_OFFSET_TABLE_OFFSET);
+    vhd->bat_entries = get_be32(dyn + DYN_OFFSET_MAX_ENTRIES);
+    vhd->block_sectors = get_be32(dyn + DYN_OFFSET_BLOCK_SIZE) >> 9;
+    if ((vhd->block_sectors < 8) || (vhd->block_sectors > (VHD_MAX_BLOCK_SIZE >> 9)) ||
+	(vhd->block_sectors & (vhd->block_sectors - 1))) {
+	vhd_log("VHD: %ls has a bad block size\n", fn);
+	goto fail;
+    }
+
+    /*
+     * Only the entries that cover the disk are of any use, and the
+     * table has to fit in the file, so a corrupt header can't make
+     * us allocate more than that.
+     */
+    i = (uint32_t) (((uint64_t) vhd->sectors + vhd->block_sectors - 1) / vhd->block_sectors);
+    if (vhd->bat_entries > i)
+	vhd->bat_entries = i;
+    if ((vhd->bat_pos > size) ||
+	(((uint64_t) vhd->bat_entries << 2) > (size - vhd->bat_pos))) {
+	vhd_log("VHD: %ls has a short BAT\n", fn);
+	goto fail;
+    }
+
+    vhd->bitmap_size = ((vhd->block_sectors >> 3) + 511) & ~511;
+    vhd->bitmap = (uint8_t *) malloc(vhd->bitmap_size);
+    vhd->bat = (uint32_t *) malloc(vhd->bat_entries * sizeof(uint32_t));
+    if ((vhd->bitmap == NULL) || (vhd->bat == NULL)) {
+	vhd_log("VHD: out of memory for %ls\n", fn);
+	goto fail;
+    }
+
+    fseeko64(vhd->f, vhd->bat_pos, SEEK_SET);
+    if (fread(vhd->bat, 1, vhd->bat_entries * sizeof(uint32_t), vhd->f) !=
+	(vhd->bat_entries * sizeof(uint32_t))) {
+	vhd_log("VHD: %ls has a short BAT\n", fn);
+	goto fail;
+    }
+    for (i = 0; i < vhd->bat_entries; i++)
+	vhd->bat[i] = get_be32((uint8_t *) &vhd->bat[i]);
+
+    if ((vhd->type == VHD_TYPE_DIFF) && !vhd_open_parent(vhd, fn, dyn, depth)) {
+	vhd_log("VHD: unable to find the parent of %ls\n", fn);
+	goto fail;
+    }
+
+    vhd_log("VHD: %ls: %s, %i blocks of %i sectors\n", fn,
+	    (vhd->type == VHD_TYPE_DIFF) ? "differencing" : "dynamic",
+	    vhd->bat_entries, vhd->block_sectors);
+
+    return(vhd);
+
+fail:
+    vhd_close(vhd);
+    return(NULL);
+}
+
+
+vhd_t *
+vhd_open(wchar_t *fn, int ro)
+{
+    return(vhd_open_ex(fn, ro, 0));
+}
+
+
+void
+vhd_close(vhd_t *vhd)
+{
+    if (vhd == NULL)
+	return;
+
+    if (vhd->parent != NULL)
+	vhd_close(vhd->parent);
+    if (vhd->f != NULL)
+	fclose(vhd->f);
+    if (vhd->bat != NULL)
+	free(vhd->bat);
+    if (vhd->bitmap != NULL)
+	free(vhd->bitmap);
+    free(vhd);
+}
+
+
+uint32_t
+vhd_get_sectors(vhd_t *vhd)
+{
+    return(vhd->sectors);
+}
+
+
+void
+vhd_get_geometry(vhd_t *vhd, uint32_t *tracks, uint32_t *hpc, uint32_t *spt)
+{
+    vhd_footer_t ft;
+
+    vhd_footer_from_bytes(&ft, vhd->footer);
+    *tracks = ft.geom.cyl;
+    *hpc = ft.geom.heads;
+    *spt = ft.geom.spt;
+}
+
+
+static uint64_t
+vhd_block_pos(vhd_t *vhd, uint32_t blk)
+{
+    return(((uint64_t) vhd->bat[blk]) << 9);
+}
+
+
+static void
+vhd_load_bitmap(vhd_t *vhd, uint32_t blk)
+{
+    if (vhd->bm_block == blk)
+	return;
+
+    fseeko64(vhd->f, vhd_block_pos(vhd, blk), SEEK_SET);
+    if (fread(vhd->bitmap, 1, vhd->bitmap_size, vhd->f) != vhd->bitmap_size)
+	memset(vhd->bitmap, 0x00, vhd->bitmap_size);
+    vhd->bm_block = blk;
+}
+
+
+static int
+vhd_sector_present(vhd_t *vhd, uint32_t off)
+{
+    return(vhd->bitmap[off >> 3] & (0x80 >> (off & 7)));
+}
+
+
+/* Sectors that are not in the image come from the parent, or are zero. */
+static void
+vhd_read_missing(vhd_t *vhd, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    if (vhd->parent != NULL)
+	vhd_read(vhd->parent, sector, count, buffer);
+    else
+	memset(buffer, 0x00, count << 9);
+}
+
+
+void
+vhd_read(vhd_t *vhd, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    uint32_t blk, off, n, run;
+    int present;
+
+    if (vhd->type == VHD_TYPE_FIXED) {
+	memset(buffer, 0x00, count << 9);
+	fseeko64(vhd->f, (uint64_t) sector << 9, SEEK_SET);
+	fread(buffer, 1, count << 9, vhd->f);
+	return;
+    }
+
+    while (count > 0) {
+	blk = sector / vhd->block_sectors;
+	off = sector % vhd->block_sectors;
+	n = vhd->block_sectors - off;
+	if (n > count)
+		n = count;
+
+	if ((blk >= vhd->bat_entries) || (vhd->bat[blk] == VHD_BAT_UNUSED)) {
+		vhd_read_missing(vhd, sector, n, buffer);
+	} else {
+		vhd_load_bitmap(vhd, blk);
+
+		/* Handle runs of sectors that are all present, or all not. */
+		while (n > 0) {
+			present = vhd_sector_present(vhd, off);
+			for (run = 1; (run < n) && (!!vhd_sector_present(vhd, off + run) == !!present); run++)
+				;
+
+			if (present) {
+				fseeko64(vhd->f, vhd_block_pos(vhd, blk) + vhd->bitmap_size +
+					 ((uint64_t) off << 9), SEEK_SET);
+				fread(buffer, 1, run << 9, vhd->f);
+			} else
+				vhd_read_missing(vhd, sector, run, buffer);
+
+			sector += run;
+			off += run;
+			count -= run;
+			buffer += (run << 9);
+			n -= run;
+		}
+		continue;
+	}
+
+	sector += n;
+	count -= n;
+	buffer += (n << 9);
+    }
+}
+
+
+/* Add a new, empty block at the end of the image, and move the footer. */
+static int
+vhd_alloc_block(vhd_t *vhd, uint32_t blk)
+{
+    uint8_t be[4];
+    uint64_t pos = vhd->end;
+
+    vhd_write_zeroes(vhd->f, pos, vhd->bitmap_size + (vhd->block_sectors << 9));
+
+    vhd->end = pos + vhd->bitmap_size + (vhd->block_sectors << 9);
+    fseeko64(vhd->f, vhd->end, SEEK_SET);
+    fwrite(vhd->footer, 1, 512, vhd->f);
+
+    vhd->bat[blk] = (uint32_t) (pos >> 9);
+    put_be32(be, vhd->bat[blk]);
+    fseeko64(vhd->f, vhd->bat_pos + (blk << 2), SEEK_SET);
+    fwrite(be, 1, 4, vhd->f);
+
+    memset(vhd->bitmap, 0x00, vhd->bitmap_size);
+    vhd->bm_block = blk;
+
+    return(1);
+}
+
+
+/* Mark sectors of the current block as present, and write the bitmap back. */
+static void
+vhd_mark_sectors(vhd_t *vhd, uint32_t blk, uint32_t off, uint32_t n)
+{
+    uint32_t i;
+
+    for (i = off; i < (off + n); i++)
+	vhd->bitmap[i >> 3] |= (0x80 >> (i & 7));
+    fseeko64(vhd->f, vhd_block_pos(vhd, blk) + ((off >> 3) & ~511), SEEK_SET);
+    fwrite(vhd->bitmap + ((off >> 3) & ~511), 1,
+	   (((off + n - 1) >> 3) & ~511) - ((off >> 3) & ~511) + 512, vhd->f);
+}
+
+
+void
+vhd_write(vhd_t *vhd, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    uint32_t blk, off, n;
+
+    if (vhd->ro)
+	return;
+
+    if (vhd->type == VHD_TYPE_FIXED) {
+	fseeko64(vhd->f, (uint64_t) sector << 9, SEEK_SET);
+	fwrite(buffer, 1, count << 9, vhd->f);
+	return;
+    }
+
+    while (count > 0) {
+	blk = sector / vhd->block_sectors;
+	off = sector % vhd->block_sectors;
+	n = vhd->block_sectors - off;
+	if (n > count)
+		n = count;
+
+	if (blk >= vhd->bat_entries)
+		break;
+
+	if (vhd->bat[blk] == VHD_BAT_UNUSED)
+		vhd_alloc_block(vhd, blk);
+	else
+		vhd_load_bitmap(vhd, blk);
+
+	fseeko64(vhd->f, vhd_block_pos(vhd, blk) + vhd->bitmap_size +
+		 ((uint64_t) off << 9), SEEK_SET);
+	fwrite(buffer, 1, n << 9, vhd->f);
+
+	vhd_mark_sectors(vhd, blk, off, n);
+
+	sector += n;
+	count -= n;
+	buffer += (n << 9);
+    }
+}
+
+
+/*
+ * Zero a range of sectors, a block at a time. Blocks of a dynamic
+ * image that were never allocated already read as zeroes, so leave
+ * them be rather than grow the image; a differencing image still
+ * has to hide its parent's data. New blocks come zeroed already.
+ */
+void
+vhd_zero(vhd_t *vhd, uint32_t sector, uint32_t count)
+{
+    uint32_t blk, off, n;
+
+    if (vhd->ro)
+	return;
+
+    if (vhd->type == VHD_TYPE_FIXED) {
+	vhd_write_zeroes(vhd->f, (uint64_t) sector << 9, (uint64_t) count << 9);
+	return;
+    }
+
+    while (count > 0) {
+	blk = sector / vhd->block_sectors;
+	off = sector % vhd->block_sectors;
+	n = vhd->block_sectors - off;
+	if (n > count)
+		n = count;
+
+	if (blk >= vhd->bat_entries)
+		break;
+
+	if (vhd->bat[blk] == VHD_BAT_UNUSED) {
+		if (vhd->parent != NULL) {
+			vhd_alloc_block(vhd, blk);
+			vhd_mark_sectors(vhd, blk, off, n);
+		}
+	} else {
+		vhd_load_bitmap(vhd, blk);
+		vhd_write_zeroes(vhd->f, vhd_block_pos(vhd, blk) + vhd->bitmap_size +
+				 ((uint64_t) off << 9), n << 9);
+		vhd_mark_sectors(vhd, blk, off, n);
+	}
+
+	sector += n;
+	count -= n;
+    }
+}
+
+
+/* Write the parent locators of a new differencing image. */
+static uint64_t
+vhd_write_locators(FILE *f, uint8_t *dyn, uint64_t pos, wchar_t *parent)
+{
+    wchar_t rel[512], *name;
+    uint8_t buf[1024];
+    wchar_t *s;
+    int i, j, len;
+
+    name = plat_get_filename(parent);
+    swprintf(rel, sizeof_w(rel), L".\\%ls", name);
+
+    for (j = 0; j < 2; j++) {
+	s = j ? parent : rel;
+	len = wcslen(s);
+	if (len > 511)
+		len = 511;
+
+	memset(buf, 0x00, sizeof(buf));
+	for (i = 0; i < len; i++) {
+		buf[i << 1] = s[i] & 0xff;
+		buf[(i << 1) + 1] = (s[i] >> 8) & 0xff;
+	}
+
+	memcpy(dyn + DYN_OFFSET_LOCATORS + (j * DYN_LOCATOR_SIZE), j ? "W2ku" : "W2ru", 4);
+	put_be32(dyn + DYN_OFFSET_LOCATORS + (j * DYN_LOCATOR_SIZE) + 4, sizeof(buf));
+	put_be32(dyn + DYN_OFFSET_LOCATORS + (j * DYN_LOCATOR_SIZE) + 8, len << 1);
+	put_be64(dyn + DYN_OFFSET_LOCATORS + (j * DYN_LOCATOR_SIZE) + 16, pos);
+
+	fseeko64(f, pos, SEEK_SET);
+	fwrite(buf, 1, sizeof(buf), f);
+	pos += sizeof(buf);
+    }
+
+    /* The parent name itself, in UTF-16BE. */
+    len = wcslen(name);
+    if (len > 255)
+	len = 255;
+    for (i = 0; i < len; i++) {
+	dyn[DYN_OFFSET_PARENT_NAME + (i << 1)] = (name[i] >> 8) & 0xff;
+	dyn[DYN_OFFSET_PARENT_NAME + (i << 1) + 1] = name[i] & 0xff;
+    }
+
+    return(pos);
+}
+
+
+/*
+ * Create a new dynamic image of the given size, or, if a parent
+ * is given, a differencing image on top of it. Either way, only
+ * the headers are written, so this takes no time at all.
+ */
+int
+vhd_create(wchar_t *fn, uint64_t size, uint32_t tracks, uint32_t hpc, uint32_t spt, wchar_t *parent)
+{
+    uint8_t footer[512], dyn[VHD_DYN_SIZE];
+    vhd_footer_t *ft = NULL;
+    vhd_t *pvhd = NULL;
+    uint32_t entries, bat_size, i;
+    uint64_t pos;
+    FILE *f;
+
+    if (parent != NULL) {
+	pvhd = vhd_open(parent, 1);
+	if (pvhd == NULL)
+		return(0);
+	size = (uint64_t) pvhd->sectors << 9;
+	vhd_get_geometry(pvhd, &tracks, &hpc, &spt);
+    }
+
+    f = plat_fopen(fn, L"wb");
+    if (f == NULL) {
+	vhd_close(pvhd);
+	return(0);
+    }
+
+    entries = (uint32_t) ((size + VHD_BLOCK_SIZE - 1) / VHD_BLOCK_SIZE);
+    bat_size = ((entries << 2) + 511) & ~511;
+
+    /* The footer, with a copy at the start of the file. */
+    new_vhd_footer(&ft);
+    ft->offset = 512;
+    ft->orig_size = ft->curr_size = size;
+    ft->geom.cyl = tracks;
+    ft->geom.heads = hpc;
+    ft->geom.spt = spt;
+    ft->type = (pvhd != NULL) ? VHD_TYPE_DIFF : VHD_TYPE_DYNAMIC;
+    generate_vhd_checksum(ft);
+    memset(footer, 0x00, sizeof(footer));
+    vhd_footer_to_bytes(footer, ft);
+    free(ft);
+
+    memset(dyn, 0x00, sizeof(dyn));
+    memcpy(dyn + DYN_OFFSET_COOKIE, VHD_DYN_COOKIE, 8);
+    put_be64(dyn + DYN_OFFSET_DATA_OFFSET, 0xffffffffffffffffULL);
+    put_be64(dyn + DYN_OFFSET_TABLE_OFFSET, 512 + VHD_DYN_SIZE);
+    put_be32(dyn + DYN_OFFSET_VERSION, 0x00010000);
+    put_be32(dyn + DYN_OFFSET_MAX_ENTRIES, entries);
+    put_be32(dyn + DYN_OFFSET_BLOCK_SIZE, VHD_BLOCK_SIZE);
+
+    /* The BAT, with all blocks unallocated. */
+    fseeko64(f, 512 + VHD_DYN_SIZE, SEEK_SET);
+    for (i = 0; i < (bat_size >> 2); i++)
+	fwrite("\xff\xff\xff\xff", 1, 4, f);
+    pos = 512 + VHD_DYN_SIZE + bat_size;
+
+    if (pvhd != NULL) {
+	vhd_footer_t pft;
+
+	vhd_footer_from_bytes(&pft, pvhd->footer);
+	memcpy(dyn + DYN_OFFSET_PARENT_UUID, pft.uuid, 16);
+	put_be32(dyn + DYN_OFFSET_PARENT_TIME, pft.timestamp);
+	pos = vhd_write_locators(f, dyn, pos, parent);
+	vhd_close(pvhd);
+    }
+
+    put_be32(dyn + DYN_OFFSET_CHECKSUM, vhd_checksum(dyn, VHD_DYN_SIZE, DYN_OFFSET_CHECKSUM));
+
+    fseeko64(f, 0, SEEK_SET);
+    fwrite(footer, 1, 512, f);
+    fwrite(dyn, 1, VHD_DYN_SIZE, f);
+    fseeko64(f, pos, SEEK_SET);
+    fwrite(footer, 1, 512, f);
+
+    fclose(f);
+
+    return(1);
+}
@@ -48,6 +48,7 @@
 #include "mem.h"
 #include "io.h"
 #include "dma.h"
+#include "snapshot.h"
 
 
 dma_t		dma[8];
@@ -915,3 +916,39 @@ DMAPageWrite(uint32_t PhysAddress, const uint8_t *DataWrite, uint32_t TotalSize)
     mem_invalidate_range(PhysAddress, PhysAddress + TotalSize - 1);
 #endif
 }
+
+
+void
+dma_state_save(snapshot_t *s)
+{
+    snapshot_write_var(s, dma);
+    snapshot_write_var(s, dmaregs);
+    snapshot_write_var(s, dma16regs);
+    snapshot_write_var(s, dmapages);
+    snapshot_write_var(s, dma_wp);
+    snapshot_write_var(s, dma16_wp);
+    snapshot_write_var(s, dma_m);
+    snapshot_write_var(s, dma_stat);
+    snapshot_write_var(s, dma_stat_rq);
+    snapshot_write_var(s, dma_command);
+    snapshot_write_var(s, dma16_command);
+    snapshot_write_var(s, dma_ps2);
+}
+
+
+void
+dma_state_load(snapshot_t *s)
+{
+    snapshot_read_var(s, dma);
+    snapshot_read_var(s, dmaregs);
+    snapshot_read_var(s, dma16regs);
+    snapshot_read_var(s, dmapages);
+    snapshot_read_var(s, dma_wp);
+    snapshot_read_var(s, dma16_wp);
+    snapshot_read_var(s, dma_m);
+    snapshot_read_var(s, dma_stat);
+    snapshot_read_var(s, dma_stat_rq);
+    snapshot_read_var(s, dma_command);
+    snapshot_read_var(s, dma16_command);
+    snapshot_read_var(s, dma_ps2);
+}
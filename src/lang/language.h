@@ -93,6 +93,9 @@
 #define IDS_2117	2117		// "Floppy %i (%s): %ls"
 #define IDS_2118	2118		// "All floppy images (*.0??;*.."
 #define IDS_2119	2119		// "You must save the settings.."
+#define IDS_2120	2120		// "Snapshots (*.86S)\0*.86S\0.."
+#define IDS_2121	2121		// "Unable to save the snapshot"
+#define IDS_2122	2122		// "Unable to load the snapshot.."
 
 #define IDS_4096	4096		// "Hard disk (%s)"
 #define IDS_4097	4097		// "%01i:%01i"
@@ -171,7 +174,7 @@
 
 #define IDS_LANG_ENUS	IDS_7168
 
-#define STR_NUM_2048	72
+#define STR_NUM_2048	75
 #define STR_NUM_3072	11
 #define STR_NUM_4096	18
 #define STR_NUM_4352	7
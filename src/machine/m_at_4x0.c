@@ -27,6 +27,7 @@
 #include "../rom.h"
 #include "../pci.h"
 #include "../device.h"
+#include "../snapshot.h"
 #include "../disk/hdc.h"
 #include "../disk/hdc_ide.h"
 #include "../keyboard.h"
@@ -211,6 +212,25 @@ i4x0_reset(void *priv)
 }
 
 
+/* The shadow RAM state these registers select is restored with memory. */
+static void
+i4x0_save(void *priv, snapshot_t *s)
+{
+    i4x0_t *i4x0 = (i4x0_t *)priv;
+
+    snapshot_write(s, i4x0->regs, sizeof(i4x0->regs));
+}
+
+
+static void
+i4x0_load(void *priv, snapshot_t *s)
+{
+    i4x0_t *i4x0 = (i4x0_t *)priv;
+
+    snapshot_read(s, i4x0->regs, sizeof(i4x0->regs));
+}
+
+
 static void
 i4x0_close(void *p)
 {
@@ -332,7 +352,9 @@ const device_t i430lx_device =
     NULL,
     NULL,
     NULL,
-    NULL
+    NULL,
+    i4x0_save,
+    i4x0_load
 };
 
 
@@ -347,7 +369,9 @@ const device_t i430nx_device =
     NULL,
     NULL,
     NULL,
-    NULL
+    NULL,
+    i4x0_save,
+    i4x0_load
 };
 
 
@@ -362,7 +386,9 @@ const device_t i430fx_device =
     NULL,
     NULL,
     NULL,
-    NULL
+    NULL,
+    i4x0_save,
+    i4x0_load
 };
 
 
@@ -377,7 +403,9 @@ const device_t i430fx_pb640_device =
     NULL,
     NULL,
     NULL,
-    NULL
+    NULL,
+    i4x0_save,
+    i4x0_load
 };
 
 
@@ -392,7 +420,9 @@ const device_t i430hx_device =
     NULL,
     NULL,
     NULL,
-    NULL
+    NULL,
+    i4x0_save,
+    i4x0_load
 };
 
 
@@ -407,7 +437,9 @@ const device_t i430vx_device =
     NULL,
     NULL,
     NULL,
-    NULL
+    NULL,
+    i4x0_save,
+    i4x0_load
 };
 
 
@@ -423,7 +455,9 @@ const device_t i440fx_device =
     NULL,
     NULL,
     NULL,
-    NULL
+    NULL,
+    i4x0_save,
+    i4x0_load
 };
 #endif
 
@@ -57,6 +57,8 @@
 #include "io.h"
 #include "mem.h"
 #include "rom.h"
+#include "plat.h"
+#include "snapshot.h"
 #ifdef USE_DYNAREC
 # include "cpu/codegen.h"
 #else
@@ -116,8 +118,6 @@ int			readlnum = 0,
 int			pctrans = 0;
 int			cachesize = 256;
 
-uint32_t		ram_mapped_addr[64];
-
 uint32_t		get_phys_virt,
 			get_phys_phys;
 
@@ -127,20 +127,27 @@ int			mem_a20_key = 0,
 
 int			mmuflush = 0;
 int			mmu_perm = 4;
+int			mmu_tlb_hits = 0,
+			mmu_tlb_misses = 0,
+			mmu_tlb_flushes = 0;
+
 
+/*
+ * Physical page descriptors.
+ *
+ * One entry per 4K page of the physical address space, built by
+ * mem_mapping_recalc(). A slow-path access does a single lookup here
+ * to find the host memory behind the page (if any) and the mappings
+ * that serve reads and writes to it; the handlers and their private
+ * data are taken from the mapping itself.
+ */
+typedef struct {
+    uint8_t		*exec;			/* host memory, or NULL */
+    mem_mapping_t	*read,			/* mapping serving reads */
+			*write;			/* mapping serving writes */
+} mem_desc_t;
 
-/* FIXME: re-do this with a 'mem_ops' struct. */
-static uint8_t		(*_mem_read_b[0x40000])(uint32_t addr, void *priv);
-static uint16_t		(*_mem_read_w[0x40000])(uint32_t addr, void *priv);
-static uint32_t		(*_mem_read_l[0x40000])(uint32_t addr, void *priv);
-static void		(*_mem_write_b[0x40000])(uint32_t addr, uint8_t  val, void *priv);
-static void		(*_mem_write_w[0x40000])(uint32_t addr, uint16_t val, void *priv);
-static void		(*_mem_write_l[0x40000])(uint32_t addr, uint32_t val, void *priv);
-static uint8_t		*_mem_exec[0x40000];
-static void		*_mem_priv_r[0x40000];
-static void		*_mem_priv_w[0x40000];
-static mem_mapping_t	*_mem_mapping_r[0x40000];
-static mem_mapping_t	*_mem_mapping_w[0x40000];
+static mem_desc_t	mem_desc[0x100000];
 static int		_mem_state[0x40000];
 
 #if FIXME
@@ -149,8 +156,40 @@ static uint8_t		ff_array[0x1000];
 static uint8_t		ff_pccache[4] = { 0xff, 0xff, 0xff, 0xff };
 #endif
 
+/*
+ * Software TLB.
+ *
+ * Every miss in the readlookup2/writelookup2 rings used to walk the
+ * guest page tables again. The result of a successful walk is now kept
+ * here, in a small set-associative table indexed by the linear page.
+ * The U/S and R/W bits of the walk are stored with the entry and are
+ * re-checked against the current CPL on every hit, so an entry is good
+ * at any privilege level and a CPL change does not have to flush it.
+ * An entry is only used for a write once its walk has set the dirty
+ * bit in the PTE, so the guest still sees A/D updates as before.
+ */
+#define MMU_TLB_SETS	64
+#define MMU_TLB_WAYS	4
+
+#define MMU_TLB_VALID	0x01
+#define MMU_TLB_DIRTY	0x02			/* D bit set, writes OK */
+#define MMU_TLB_GLOBAL	0x04			/* G bit, survives CR3 load */
+
+typedef struct {
+    uint32_t	page;				/* linear page (addr >> 12) */
+    uint32_t	phys;				/* physical page base */
+    uint8_t	flags,
+		perm,				/* PDE&PTE U/S and R/W bits */
+		user;				/* PTE U/S bit, for mmu_perm */
+} mmu_tlb_t;
+
+static mmu_tlb_t	mmu_tlb[MMU_TLB_SETS][MMU_TLB_WAYS];
+static uint8_t		mmu_tlb_next[MMU_TLB_SETS];
+
 static int		port_92_reg = 0;
 
+static uint32_t		ram_alloc_size = 0;
+
 
 #ifdef ENABLE_MEM_LOG
 int mem_do_log = ENABLE_MEM_LOG;
@@ -207,6 +246,8 @@ mem_log("MEM: reset_lookup: pages=%08lx, lookup=%08lx, pages_sz=%i\n", pages, pa
     readlnext = 0;
     writelnext = 0;
     pccache = 0xffffffff;
+
+    mmu_tlb_flush(1);
 }
 
 
@@ -228,6 +269,8 @@ flushmmucache(void)
     }
     mmuflush++;
 
+    mmu_tlb_flush(0);
+
     pccache = (uint32_t)0xffffffff;
     pccache2 = (uint8_t *)0xffffffff;
 
@@ -253,6 +296,10 @@ flushmmucache_nopc(void)
 		writelookup[c] = 0xffffffff;
 	}
     }
+
+#ifdef USE_DYNAREC
+    codegen_flush();
+#endif
 }
 
 
@@ -272,6 +319,10 @@ flushmmucache_cr3(void)
 		writelookup[c] = 0xffffffff;
 	}
     }
+
+#ifdef USE_DYNAREC
+    codegen_flush();
+#endif
 }
 
 
@@ -281,9 +332,10 @@ mem_flush_write_page(uint32_t addr, uint32_t virt)
     page_t *page_target = &pages[addr >> 12];
     int c;
 
+    /* Catch every linear alias of the page, not only 'virt'. */
     for (c = 0; c < 256; c++) {
 	if (writelookup[c] != (int) 0xffffffff) {
-		uintptr_t target = (uintptr_t)&ram[(uintptr_t)(addr & ~0xfff) - (virt & ~0xfff)];
+		uintptr_t target = (uintptr_t)&ram[(uintptr_t)(addr & ~0xfff) - ((uint32_t)writelookup[c] << 12)];
 
 		if (writelookup2[writelookup[c]] == target || page_lookup[writelookup[c]] == page_target) {
 			writelookup2[writelookup[c]] = -1;
@@ -295,18 +347,86 @@ mem_flush_write_page(uint32_t addr, uint32_t virt)
 }
 
 
+/* Drop all entries, or only the non-global ones, from the TLB. */
+void
+mmu_tlb_flush(int global)
+{
+    mmu_tlb_t *e;
+    int c;
+
+    e = &mmu_tlb[0][0];
+    for (c = 0; c < (MMU_TLB_SETS * MMU_TLB_WAYS); c++, e++) {
+	if (global || !(e->flags & MMU_TLB_GLOBAL))
+		e->flags = 0;
+    }
+
+    mmu_tlb_flushes++;
+}
+
+
+static mmu_tlb_t *
+mmu_tlb_find(uint32_t page)
+{
+    mmu_tlb_t *e = mmu_tlb[page & (MMU_TLB_SETS - 1)];
+    int c;
+
+    for (c = 0; c < MMU_TLB_WAYS; c++, e++) {
+	if ((e->flags & MMU_TLB_VALID) && (e->page == page))
+		return(e);
+    }
+
+    return(NULL);
+}
+
+
+static void
+mmu_tlb_fill(uint32_t addr, uint32_t phys, int perm, int user, int flags)
+{
+    uint32_t page = addr >> 12;
+    int set = page & (MMU_TLB_SETS - 1);
+    mmu_tlb_t *e;
+
+    /* Refill in place, or take the next way round-robin. */
+    if ((e = mmu_tlb_find(page)) == NULL) {
+	e = &mmu_tlb[set][mmu_tlb_next[set]];
+	mmu_tlb_next[set] = (mmu_tlb_next[set] + 1) & (MMU_TLB_WAYS - 1);
+    }
+
+    e->page = page;
+    e->phys = phys & ~0xfff;
+    e->perm = perm & 6;
+    e->user = user & 4;
+    e->flags = MMU_TLB_VALID | flags;
+}
+
+
 #define mmutranslate_read(addr) mmutranslatereal(addr,0)
 #define mmutranslate_write(addr) mmutranslatereal(addr,1)
-#define rammap(x)	((uint32_t *)(_mem_exec[(x) >> 14]))[((x) >> 2) & 0xfff]
+#define rammap(x)	((uint32_t *)(mem_desc[(x) >> 12].exec))[((x) >> 2) & 0x3ff]
 
 uint32_t
 mmutranslatereal(uint32_t addr, int rw)
 {
     uint32_t temp,temp2,temp3;
     uint32_t addr2;
+    mmu_tlb_t *e;
 
     if (cpu_state.abrt) return -1;
 
+    /*
+     * On a permission failure, or a write to a page not yet marked
+     * dirty, fall through to the walk, which faults or sets D.
+     */
+    e = mmu_tlb_find(addr >> 12);
+    if ((e != NULL) && !(CPL==3 && !(e->perm&4) && !cpl_override) &&
+	!(rw && !(e->perm&2) && ((CPL == 3 && !cpl_override) || cr0&WP_FLAG)) &&
+	(!rw || (e->flags & MMU_TLB_DIRTY))) {
+	mmu_tlb_hits++;
+	mmu_perm = e->user;
+	return e->phys + (addr & 0xfff);
+    }
+    mmu_tlb_misses++;
+
     addr2 = ((cr3 & ~0xfff) + ((addr >> 20) & 0xffc));
     temp = temp2 = rammap(addr2);
     if (! (temp&1)) {
@@ -337,6 +457,10 @@ mmutranslatereal(uint32_t addr, int rw)
 	mmu_perm = temp & 4;
 	rammap(addr2) |= 0x20;
 
+	mmu_tlb_fill(addr, (temp & ~0x3fffff) + (addr & 0x3ff000),
+		     temp, temp, MMU_TLB_DIRTY |
+		     (((cr4 & CR4_PGE) && (temp & 0x100)) ? MMU_TLB_GLOBAL : 0));
+
 	return (temp & ~0x3fffff) + (addr & 0x3fffff);
     }
 
@@ -356,6 +480,10 @@ mmutranslatereal(uint32_t addr, int rw)
     rammap(addr2) |= 0x20;
     rammap((temp2 & ~0xfff) + ((addr >> 10) & 0xffc)) |= (rw?0x60:0x20);
 
+    mmu_tlb_fill(addr, temp, temp3, temp,
+		 ((rw || (temp & 0x40)) ? MMU_TLB_DIRTY : 0) |
+		 (((cr4 & CR4_PGE) && (temp & 0x100)) ? MMU_TLB_GLOBAL : 0));
+
     return (temp&~0xfff)+(addr&0xfff);
 }
 
@@ -365,10 +493,18 @@ mmutranslate_noabrt(uint32_t addr, int rw)
 {
     uint32_t temp,temp2,temp3;
     uint32_t addr2;
+    mmu_tlb_t *e;
 
     if (cpu_state.abrt) 
 	return -1;
 
+    if ((e = mmu_tlb_find(addr >> 12)) != NULL) {
+	if ((CPL==3 && !(e->perm&4) && !cpl_override) || (rw && !(e->perm&2) && (CPL==3 || cr0&WP_FLAG)))
+		return -1;
+
+	return e->phys + (addr & 0xfff);
+    }
+
     addr2 = ((cr3 & ~0xfff) + ((addr >> 20) & 0xffc));
     temp = temp2 = rammap(addr2);
 
@@ -396,6 +532,12 @@ mmutranslate_noabrt(uint32_t addr, int rw)
 void
 mmu_invalidate(uint32_t addr)
 {
+    mmu_tlb_t *e;
+
+    /* INVLPG drops the page even if it is global. */
+    if ((e = mmu_tlb_find(addr >> 12)) != NULL)
+	e->flags = 0;
+
     flushmmucache_cr3();
 }
 
@@ -454,9 +596,9 @@ addwritelookup(uint32_t virt, uint32_t phys)
     }
 
 #ifdef USE_DYNAREC
-    if (pages[phys >> 12].block[0] || pages[phys >> 12].block[1] || pages[phys >> 12].block[2] || pages[phys >> 12].block[3] || (phys & ~0xfff) == recomp_page)
+    if (pages[phys >> 12].block[0] || pages[phys >> 12].block[1] || pages[phys >> 12].block[2] || pages[phys >> 12].block[3] || (phys & ~0xfff) == recomp_page || pages[phys >> 12].pdc)
 #else
-    if (pages[phys >> 12].block[0] || pages[phys >> 12].block[1] || pages[phys >> 12].block[2] || pages[phys >> 12].block[3])
+    if (pages[phys >> 12].block[0] || pages[phys >> 12].block[1] || pages[phys >> 12].block[2] || pages[phys >> 12].block[3] || pages[phys >> 12].pdc)
 #endif
 	page_lookup[virt >> 12] = &pages[phys >> 12];
       else
@@ -473,17 +615,11 @@ addwritelookup(uint32_t virt, uint32_t phys)
 uint8_t *
 getpccache(uint32_t a)
 {
+    mem_desc_t *d;
     uint32_t a2;
 
     a2 = a;
 
-    if (a2 < 0x100000 && ram_mapped_addr[a2 >> 14]) {
-	a = (ram_mapped_addr[a2 >> 14] & MEM_MAP_TO_SHADOW_RAM_MASK) ? a2 : (ram_mapped_addr[a2 >> 14] & ~0x3FFF) + (a2 & 0x3FFF);
-	return &ram[(uintptr_t)(a & 0xFFFFF000) - (uintptr_t)(a2 & ~0xFFF)];
-    }
-
-    a2 = a;
-
     if (cr0 >> 31) {
 	pctrans=1;
 	a = mmutranslate_read(a);
@@ -493,13 +629,14 @@ getpccache(uint32_t a)
     }
     a &= rammask;
 
-    if (_mem_exec[a >> 14]) {
-	if (_mem_mapping_r[a >> 14]->flags & MEM_MAPPING_ROM)
+    d = &mem_desc[a >> 12];
+    if (d->exec) {
+	if (d->read->flags & MEM_MAPPING_ROM)
 		cpu_prefetch_cycles = cpu_rom_prefetch_cycles;
 	else
 		cpu_prefetch_cycles = cpu_mem_prefetch_cycles;
 	
-	return &_mem_exec[a >> 14][(uintptr_t)(a & 0x3000) - (uintptr_t)(a2 & ~0xfff)];
+	return &d->exec[-(uintptr_t)(a2 & ~0xfff)];
     }
 
     mem_log("Bad getpccache %08X\n", a);
@@ -515,13 +652,10 @@ getpccache(uint32_t a)
 uint8_t
 readmembl(uint32_t addr)
 {
+    mem_mapping_t *map;
+
     mem_logical_addr = addr;
 
-    if (addr < 0x100000 && ram_mapped_addr[addr >> 14]) {
-	addr = (ram_mapped_addr[addr >> 14] & MEM_MAP_TO_SHADOW_RAM_MASK) ? addr : (ram_mapped_addr[addr >> 14] & ~0x3fff) + (addr & 0x3fff);
-	if(addr < (uint32_t) (mem_size * 1024)) return ram[addr];
-	return 0xff;
-    }
 
     if (cr0 >> 31) {
 	addr = mmutranslate_read(addr);
@@ -529,8 +663,9 @@ readmembl(uint32_t addr)
     }
     addr &= rammask;
 
-    if (_mem_read_b[addr >> 14])
-	return _mem_read_b[addr >> 14](addr, _mem_priv_r[addr >> 14]);
+    map = mem_desc[addr >> 12].read;
+    if (map && map->read_b)
+	return map->read_b(addr, map->p);
 
     return 0xff;
 }
@@ -539,14 +674,10 @@ readmembl(uint32_t addr)
 void
 writemembl(uint32_t addr, uint8_t val)
 {
+    mem_mapping_t *map;
+
     mem_logical_addr = addr;
 
-    if (addr < 0x100000 && ram_mapped_addr[addr >> 14]) {
-	addr = (ram_mapped_addr[addr >> 14] & MEM_MAP_TO_SHADOW_RAM_MASK) ? addr : (ram_mapped_addr[addr >> 14] & ~0x3fff) + (addr & 0x3fff);
-	if (addr < (uint32_t) (mem_size * 1024))
-		ram[addr] = val;
-	return;
-    }
 
     if (page_lookup[addr>>12]) {
 	page_lookup[addr>>12]->write_b(addr, val, page_lookup[addr>>12]);
@@ -560,14 +691,17 @@ writemembl(uint32_t addr, uint8_t val)
     }
     addr &= rammask;
 
-    if (_mem_write_b[addr >> 14])
-	_mem_write_b[addr >> 14](addr, val, _mem_priv_w[addr >> 14]);
+    map = mem_desc[addr >> 12].write;
+    if (map && map->write_b)
+	map->write_b(addr, val, map->p);
 }
 
 
 uint8_t
 readmemb386l(uint32_t seg, uint32_t addr)
 {
+    mem_mapping_t *map;
+
     if (seg == (uint32_t) -1) {
 	x86gpf("NULL segment", 0);
 
@@ -575,12 +709,6 @@ readmemb386l(uint32_t seg, uint32_t addr)
     }
 
     mem_logical_addr = addr = addr + seg;
-    if (addr < 0x100000 && ram_mapped_addr[addr >> 14]) {
-	addr = (ram_mapped_addr[addr >> 14] & MEM_MAP_TO_SHADOW_RAM_MASK) ? addr : (ram_mapped_addr[addr >> 14] & ~0x3fff) + (addr & 0x3fff);
-	if (addr < (uint32_t) (mem_size * 1024))
-		return ram[addr];
-	return 0xff;
-    }
 
     if (cr0 >> 31) {
 	addr = mmutranslate_read(addr);
@@ -590,8 +718,9 @@ readmemb386l(uint32_t seg, uint32_t addr)
 
     addr &= rammask;
 
-    if (_mem_read_b[addr >> 14])
-	return _mem_read_b[addr >> 14](addr, _mem_priv_r[addr >> 14]);
+    map = mem_desc[addr >> 12].read;
+    if (map && map->read_b)
+	return map->read_b(addr, map->p);
 
     return 0xff;
 }
@@ -600,18 +729,14 @@ readmemb386l(uint32_t seg, uint32_t addr)
 void
 writememb386l(uint32_t seg, uint32_t addr, uint8_t val)
 {
+    mem_mapping_t *map;
+
     if (seg == (uint32_t) -1) {
 	x86gpf("NULL segment", 0);
 	return;
     }
 
     mem_logical_addr = addr = addr + seg;
-    if (addr < 0x100000 && ram_mapped_addr[addr >> 14]) {
-	addr = (ram_mapped_addr[addr >> 14] & MEM_MAP_TO_SHADOW_RAM_MASK) ? addr : (ram_mapped_addr[addr >> 14] & ~0x3fff) + (addr & 0x3fff);
-	if (addr < (uint32_t) (mem_size * 1024))
-		ram[addr] = val;
-	return;
-    }
 
     if (page_lookup[addr>>12]) {
 	page_lookup[addr>>12]->write_b(addr, val, page_lookup[addr>>12]);
@@ -626,8 +751,9 @@ writememb386l(uint32_t seg, uint32_t addr, uint8_t val)
 
     addr &= rammask;
 
-    if (_mem_write_b[addr >> 14])
-	_mem_write_b[addr >> 14](addr, val, _mem_priv_w[addr >> 14]);
+    map = mem_desc[addr >> 12].write;
+    if (map && map->write_b)
+	map->write_b(addr, val, map->p);
 }
 
 
@@ -635,6 +761,7 @@ uint16_t
 readmemwl(uint32_t seg, uint32_t addr)
 {
     uint32_t addr2 = mem_logical_addr = seg + addr;
+    mem_mapping_t *map;
 
     if (seg == (uint32_t) -1) {
 	x86gpf("NULL segment", 0);
@@ -656,12 +783,6 @@ readmemwl(uint32_t seg, uint32_t addr)
 		return *(uint16_t *)(readlookup2[addr2 >> 12] + addr2);
     }
 
-    if (addr2 < 0x100000 && ram_mapped_addr[addr2 >> 14]) {
-	addr = (ram_mapped_addr[addr2 >> 14] & MEM_MAP_TO_SHADOW_RAM_MASK) ? addr2 : (ram_mapped_addr[addr2 >> 14] & ~0x3fff) + (addr2 & 0x3fff);
-	if (addr < (uint32_t) (mem_size * 1024))
-		return *((uint16_t *)&ram[addr]);
-	return 0xffff;
-    }
 
     if (cr0 >> 31) {
 	addr2 = mmutranslate_read(addr2);
@@ -671,16 +792,17 @@ readmemwl(uint32_t seg, uint32_t addr)
 
 	addr2 &= rammask;
 
-	if (_mem_read_w[addr2 >> 14])
-		return _mem_read_w[addr2 >> 14](addr2, _mem_priv_r[addr2 >> 14]);
+	map = mem_desc[addr2 >> 12].read;
+	if (map && map->read_w)
+		return map->read_w(addr2, map->p);
 
-	if (_mem_read_b[addr2 >> 14]) {
+	if (map && map->read_b) {
 		if (AT)
-			return _mem_read_b[addr2 >> 14](addr2, _mem_priv_r[addr2 >> 14]) |
-			       ((uint16_t) (_mem_read_b[(addr2 + 1) >> 14](addr2 + 1, _mem_priv_r[addr2 >> 14])) << 8);
+			return map->read_b(addr2, map->p) |
+			       ((uint16_t) (mem_desc[(addr2 + 1) >> 12].read->read_b(addr2 + 1, map->p)) << 8);
 		else
-			return _mem_read_b[addr2 >> 14](addr2, _mem_priv_r[addr2 >> 14]) |
-			       ((uint16_t) (_mem_read_b[(seg + ((addr + 1) & 0xffff)) >> 14](seg + ((addr + 1) & 0xffff), _mem_priv_r[addr2 >> 14])) << 8);
+			return map->read_b(addr2, map->p) |
+			       ((uint16_t) (mem_desc[(seg + ((addr + 1) & 0xffff)) >> 12].read->read_b(seg + ((addr + 1) & 0xffff), map->p)) << 8);
     }
 
     return 0xffff;
@@ -691,18 +813,13 @@ void
 writememwl(uint32_t seg, uint32_t addr, uint16_t val)
 {
     uint32_t addr2 = mem_logical_addr = seg + addr;
+    mem_mapping_t *map;
 
     if (seg == (uint32_t) -1) {
 	x86gpf("NULL segment", 0);
 	return;
     }
 
-    if (addr2 < 0x100000 && ram_mapped_addr[addr2 >> 14]) {
-	addr = (ram_mapped_addr[addr2 >> 14] & MEM_MAP_TO_SHADOW_RAM_MASK) ? addr2 : (ram_mapped_addr[addr2 >> 14] & ~0x3fff) + (addr2 & 0x3fff);
-	if (addr < mem_size * 1024)
-		*((uint16_t *)&ram[addr]) = val;
-	return;
-    }
 
     if (addr2 & 1) {
 	if (!cpu_cyrix_alignment || (addr2 & 7) == 7)
@@ -743,14 +860,15 @@ writememwl(uint32_t seg, uint32_t addr, uint16_t val)
 	   mem_log("writememwl %08X %02X\n", addr2, val);
 #endif
 
-    if (_mem_write_w[addr2 >> 14]) {
-	_mem_write_w[addr2 >> 14](addr2, val, _mem_priv_w[addr2 >> 14]);
+    map = mem_desc[addr2 >> 12].write;
+    if (map && map->write_w) {
+	map->write_w(addr2, val, map->p);
 	return;
     }
 
-    if (_mem_write_b[addr2 >> 14]) {
-	_mem_write_b[addr2 >> 14](addr2, val, _mem_priv_w[addr2 >> 14]);
-	_mem_write_b[(addr2 + 1) >> 14](addr2 + 1, val >> 8, _mem_priv_w[addr2 >> 14]);
+    if (map && map->write_b) {
+	map->write_b(addr2, val, map->p);
+	mem_desc[(addr2 + 1) >> 12].write->write_b(addr2 + 1, val >> 8, map->p);
 	return;
     }
 }
@@ -760,18 +878,13 @@ uint32_t
 readmemll(uint32_t seg, uint32_t addr)
 {
     uint32_t addr2 = mem_logical_addr = seg + addr;
+    mem_mapping_t *map;
 
     if (seg == (uint32_t) -1) {
 	x86gpf("NULL segment", 0);
 	return -1;
     }
 
-    if (addr2 < 0x100000 && ram_mapped_addr[addr2 >> 14]) {
-	addr = (ram_mapped_addr[addr2 >> 14] & MEM_MAP_TO_SHADOW_RAM_MASK) ? addr2 : (ram_mapped_addr[addr2 >> 14] & ~0x3fff) + (addr2 & 0x3fff);
-	if (addr < mem_size * 1024)
-		return *((uint32_t *)&ram[addr]);
-	return 0xffffffff;
-    }
 
     if (addr2 & 3) {
 	if (!cpu_cyrix_alignment || (addr2 & 7) > 4)
@@ -794,18 +907,19 @@ readmemll(uint32_t seg, uint32_t addr)
 
     addr2 &= rammask;
 
-    if (_mem_read_l[addr2 >> 14])
-	return _mem_read_l[addr2 >> 14](addr2, _mem_priv_r[addr2 >> 14]);
+    map = mem_desc[addr2 >> 12].read;
+    if (map && map->read_l)
+	return map->read_l(addr2, map->p);
 
-    if (_mem_read_w[addr2 >> 14])
-	return _mem_read_w[addr2 >> 14](addr2, _mem_priv_r[addr2 >> 14]) |
-	       ((uint32_t) (_mem_read_w[addr2 >> 14](addr2 + 2, _mem_priv_r[addr2 >> 14])) << 16);
+    if (map && map->read_w)
+	return map->read_w(addr2, map->p) |
+	       ((uint32_t) (map->read_w(addr2 + 2, map->p)) << 16);
 
-    if (_mem_read_b[addr2 >> 14])
-	return _mem_read_b[addr2 >> 14](addr2, _mem_priv_r[addr2 >> 14]) |
-	       ((uint32_t) (_mem_read_b[addr2 >> 14](addr2 + 1, _mem_priv_r[addr2 >> 14])) << 8) |
-	       ((uint32_t) (_mem_read_b[addr2 >> 14](addr2 + 2, _mem_priv_r[addr2 >> 14])) << 16) |
-	       ((uint32_t) (_mem_read_b[addr2 >> 14](addr2 + 3, _mem_priv_r[addr2 >> 14])) << 24);
+    if (map && map->read_b)
+	return map->read_b(addr2, map->p) |
+	       ((uint32_t) (map->read_b(addr2 + 1, map->p)) << 8) |
+	       ((uint32_t) (map->read_b(addr2 + 2, map->p)) << 16) |
+	       ((uint32_t) (map->read_b(addr2 + 3, map->p)) << 24);
 
     return 0xffffffff;
 }
@@ -815,18 +929,13 @@ void
 writememll(uint32_t seg, uint32_t addr, uint32_t val)
 {
     uint32_t addr2 = mem_logical_addr = seg + addr;
+    mem_mapping_t *map;
 
     if (seg == (uint32_t) -1) {
 	x86gpf("NULL segment", 0);
 	return;
     }
 
-    if (addr2 < 0x100000 && ram_mapped_addr[addr2 >> 14]) {
-	addr = (ram_mapped_addr[addr2 >> 14] & MEM_MAP_TO_SHADOW_RAM_MASK) ? addr2 : (ram_mapped_addr[addr2 >> 14] & ~0x3fff) + (addr2 & 0x3fff);
-	if (addr < mem_size * 1024)
-		*((uint32_t *)&ram[addr]) = val;
-	return;
-    }
 
     if (addr2 & 3) {
 	if (!cpu_cyrix_alignment || (addr2 & 7) > 4)
@@ -857,20 +966,21 @@ writememll(uint32_t seg, uint32_t addr, uint32_t val)
 
     addr2 &= rammask;
 
-    if (_mem_write_l[addr2 >> 14]) {
-	_mem_write_l[addr2 >> 14](addr2, val,	   _mem_priv_w[addr2 >> 14]);
+    map = mem_desc[addr2 >> 12].write;
+    if (map && map->write_l) {
+	map->write_l(addr2, val,	   map->p);
 	return;
     }
-    if (_mem_write_w[addr2 >> 14]) {
-	_mem_write_w[addr2 >> 14](addr2,     val,       _mem_priv_w[addr2 >> 14]);
-	_mem_write_w[addr2 >> 14](addr2 + 2, val >> 16, _mem_priv_w[addr2 >> 14]);
+    if (map && map->write_w) {
+	map->write_w(addr2,     val,       map->p);
+	map->write_w(addr2 + 2, val >> 16, map->p);
 	return;
     }
-    if (_mem_write_b[addr2 >> 14]) {
-	_mem_write_b[addr2 >> 14](addr2,     val,       _mem_priv_w[addr2 >> 14]);
-	_mem_write_b[addr2 >> 14](addr2 + 1, val >> 8,  _mem_priv_w[addr2 >> 14]);
-	_mem_write_b[addr2 >> 14](addr2 + 2, val >> 16, _mem_priv_w[addr2 >> 14]);
-	_mem_write_b[addr2 >> 14](addr2 + 3, val >> 24, _mem_priv_w[addr2 >> 14]);
+    if (map && map->write_b) {
+	map->write_b(addr2,     val,       map->p);
+	map->write_b(addr2 + 1, val >> 8,  map->p);
+	map->write_b(addr2 + 2, val >> 16, map->p);
+	map->write_b(addr2 + 3, val >> 24, map->p);
 	return;
     }
 }
@@ -880,18 +990,13 @@ uint64_t
 readmemql(uint32_t seg, uint32_t addr)
 {
     uint32_t addr2 = mem_logical_addr = seg + addr;
+    mem_mapping_t *map;
 
     if (seg == (uint32_t) -1) {
 	x86gpf("NULL segment", 0);
 	return -1;
     }
 
-    if (addr2 < 0x100000 && ram_mapped_addr[addr2 >> 14]) {
-	addr = (ram_mapped_addr[addr2 >> 14] & MEM_MAP_TO_SHADOW_RAM_MASK) ? addr2 : (ram_mapped_addr[addr2 >> 14] & ~0x3fff) + (addr2 & 0x3fff);
-	if (addr < mem_size * 1024)
-		return *((uint64_t *)&ram[addr]);
-	return -1;
-    }
 
     if (addr2 & 7) {
 	cycles -= timing_misaligned;
@@ -913,9 +1018,10 @@ readmemql(uint32_t seg, uint32_t addr)
 
     addr2 &= rammask;
 
-    if (_mem_read_l[addr2 >> 14])
-	return _mem_read_l[addr2 >> 14](addr2, _mem_priv_r[addr2 >> 14]) |
-			 ((uint64_t)_mem_read_l[addr2 >> 14](addr2 + 4, _mem_priv_r[addr2 >> 14]) << 32);
+    map = mem_desc[addr2 >> 12].read;
+    if (map && map->read_l)
+	return map->read_l(addr2, map->p) |
+			 ((uint64_t)map->read_l(addr2 + 4, map->p) << 32);
 
     return readmemll(seg,addr) | ((uint64_t)readmemll(seg,addr+4)<<32);
 }
@@ -925,18 +1031,13 @@ void
 writememql(uint32_t seg, uint32_t addr, uint64_t val)
 {
     uint32_t addr2 = mem_logical_addr = seg + addr;
+    mem_mapping_t *map;
 
     if (seg == (uint32_t) -1) {
 	x86gpf("NULL segment", 0);
 	return;
     }
 
-    if (addr2 < 0x100000 && ram_mapped_addr[addr2 >> 14]) {
-	addr = (ram_mapped_addr[addr2 >> 14] & MEM_MAP_TO_SHADOW_RAM_MASK) ? addr2 : (ram_mapped_addr[addr2 >> 14] & ~0x3fff) + (addr2 & 0x3fff);
-	if (addr < mem_size * 1024)
-		*((uint64_t *)&ram[addr]) = val;
-	return;
-    }
 
     if (addr2 & 7) {
 	cycles -= timing_misaligned;
@@ -967,27 +1068,28 @@ writememql(uint32_t seg, uint32_t addr, uint64_t val)
 
     addr2 &= rammask;
 
-    if (_mem_write_l[addr2 >> 14]) {
-	_mem_write_l[addr2 >> 14](addr2,   val,       _mem_priv_w[addr2 >> 14]);
-	_mem_write_l[addr2 >> 14](addr2+4, val >> 32, _mem_priv_w[addr2 >> 14]);
+    map = mem_desc[addr2 >> 12].write;
+    if (map && map->write_l) {
+	map->write_l(addr2,   val,       map->p);
+	map->write_l(addr2+4, val >> 32, map->p);
 	return;
     }
-    if (_mem_write_w[addr2 >> 14]) {
-	_mem_write_w[addr2 >> 14](addr2,     val,       _mem_priv_w[addr2 >> 14]);
-	_mem_write_w[addr2 >> 14](addr2 + 2, val >> 16, _mem_priv_w[addr2 >> 14]);
-	_mem_write_w[addr2 >> 14](addr2 + 4, val >> 32, _mem_priv_w[addr2 >> 14]);
-	_mem_write_w[addr2 >> 14](addr2 + 6, val >> 48, _mem_priv_w[addr2 >> 14]);
+    if (map && map->write_w) {
+	map->write_w(addr2,     val,       map->p);
+	map->write_w(addr2 + 2, val >> 16, map->p);
+	map->write_w(addr2 + 4, val >> 32, map->p);
+	map->write_w(addr2 + 6, val >> 48, map->p);
 	return;
     }
-    if (_mem_write_b[addr2 >> 14]) {
-	_mem_write_b[addr2 >> 14](addr2,     val,       _mem_priv_w[addr2 >> 14]);
-	_mem_write_b[addr2 >> 14](addr2 + 1, val >> 8,  _mem_priv_w[addr2 >> 14]);
-	_mem_write_b[addr2 >> 14](addr2 + 2, val >> 16, _mem_priv_w[addr2 >> 14]);
-	_mem_write_b[addr2 >> 14](addr2 + 3, val >> 24, _mem_priv_w[addr2 >> 14]);
-	_mem_write_b[addr2 >> 14](addr2 + 4, val >> 32, _mem_priv_w[addr2 >> 14]);
-	_mem_write_b[addr2 >> 14](addr2 + 5, val >> 40, _mem_priv_w[addr2 >> 14]);
-	_mem_write_b[addr2 >> 14](addr2 + 6, val >> 48, _mem_priv_w[addr2 >> 14]);
-	_mem_write_b[addr2 >> 14](addr2 + 7, val >> 56, _mem_priv_w[addr2 >> 14]);
+    if (map && map->write_b) {
+	map->write_b(addr2,     val,       map->p);
+	map->write_b(addr2 + 1, val >> 8,  map->p);
+	map->write_b(addr2 + 2, val >> 16, map->p);
+	map->write_b(addr2 + 3, val >> 24, map->p);
+	map->write_b(addr2 + 4, val >> 32, map->p);
+	map->write_b(addr2 + 5, val >> 40, map->p);
+	map->write_b(addr2 + 6, val >> 48, map->p);
+	map->write_b(addr2 + 7, val >> 56, map->p);
 	return;
     }
 }
@@ -996,10 +1098,12 @@ writememql(uint32_t seg, uint32_t addr, uint64_t val)
 uint8_t
 mem_readb_phys(uint32_t addr)
 {
+    mem_mapping_t *map = mem_desc[addr >> 12].read;
+
     mem_logical_addr = 0xffffffff;
 
-    if (_mem_read_b[addr >> 14]) 
-	return _mem_read_b[addr >> 14](addr, _mem_priv_r[addr >> 14]);
+    if (map && map->read_b) 
+	return map->read_b(addr, map->p);
 
     return 0xff;
 }
@@ -1016,10 +1120,12 @@ mem_readb_phys_dma(uint32_t addr)
     mem_logical_addr = 0xffffffff;
 #endif
 
-    if (_mem_exec[addr >> 14])
-	return _mem_exec[addr >> 14][addr & 0x3fff];
-    else if (_mem_read_b[addr >> 14])
-       	return _mem_read_b[addr >> 14](addr, _mem_priv_r[addr >> 14]);
+    mem_desc_t *d = &mem_desc[addr >> 12];
+
+    if (d->exec)
+	return d->exec[addr & 0xfff];
+    else if (d->read && d->read->read_b)
+       	return d->read->read_b(addr, d->read->p);
     else
 	return 0xff;
 }
@@ -1028,10 +1134,12 @@ mem_readb_phys_dma(uint32_t addr)
 uint16_t
 mem_readw_phys(uint32_t addr)
 {
+    mem_mapping_t *map = mem_desc[addr >> 12].read;
+
     mem_logical_addr = 0xffffffff;
 
-    if (_mem_read_w[addr >> 14]) 
-	return _mem_read_w[addr >> 14](addr, _mem_priv_r[addr >> 14]);
+    if (map && map->read_w) 
+	return map->read_w(addr, map->p);
 
     return 0xff;
 }
@@ -1040,10 +1148,12 @@ mem_readw_phys(uint32_t addr)
 void
 mem_writeb_phys(uint32_t addr, uint8_t val)
 {
+    mem_mapping_t *map = mem_desc[addr >> 12].write;
+
     mem_logical_addr = 0xffffffff;
 
-    if (_mem_write_b[addr >> 14]) 
-	_mem_write_b[addr >> 14](addr, val, _mem_priv_w[addr >> 14]);
+    if (map && map->write_b) 
+	map->write_b(addr, val, map->p);
 }
 
 
@@ -1058,20 +1168,116 @@ mem_writeb_phys_dma(uint32_t addr, uint8_t val)
     mem_logical_addr = 0xffffffff;
 #endif
 
-    if (_mem_exec[addr >> 14])
-	_mem_exec[addr >> 14][addr & 0x3fff] = val;
-    else if (_mem_write_b[addr >> 14])
-       	_mem_write_b[addr >> 14](addr, val, _mem_priv_w[addr >> 14]);
+    mem_desc_t *d = &mem_desc[addr >> 12];
+
+    if (d->exec)
+	d->exec[addr & 0xfff] = val;
+    else if (d->write && d->write->write_b)
+       	d->write->write_b(addr, val, d->write->p);
 }
 
 
 void
 mem_writew_phys(uint32_t addr, uint16_t val)
 {
+    mem_mapping_t *map = mem_desc[addr >> 12].write;
+
     mem_logical_addr = 0xffffffff;
 
-    if (_mem_write_w[addr >> 14])
-	_mem_write_w[addr >> 14](addr, val, _mem_priv_w[addr >> 14]);
+    if (map && map->write_w)
+	map->write_w(addr, val, map->p);
+}
+
+
+/*
+ * Physical accesses of any width up to 8 bytes, for CPU backends that
+ * trap accesses to memory without host backing. Accesses that fit the
+ * handler of the mapping are passed on whole, others go byte by byte.
+ */
+void
+mem_read_phys(void *dest, uint32_t addr, int len)
+{
+    mem_mapping_t *map = mem_desc[addr >> 12].read;
+    uint8_t *p = (uint8_t *)dest;
+    int c;
+
+    mem_logical_addr = 0xffffffff;
+
+    if (map && ((addr & 0xfff) <= (0x1000 - len))) {
+	if (len == 4 && map->read_l) {
+		*(uint32_t *)p = map->read_l(addr, map->p);
+		return;
+	}
+	if (len == 2 && map->read_w) {
+		*(uint16_t *)p = map->read_w(addr, map->p);
+		return;
+	}
+    }
+
+    for (c = 0; c < len; c++)
+	p[c] = mem_readb_phys(addr + c);
+}
+
+
+void
+mem_write_phys(void *src, uint32_t addr, int len)
+{
+    mem_mapping_t *map = mem_desc[addr >> 12].write;
+    uint8_t *p = (uint8_t *)src;
+    int c;
+
+    mem_logical_addr = 0xffffffff;
+
+    if (map && ((addr & 0xfff) <= (0x1000 - len))) {
+	if (len == 4 && map->write_l) {
+		map->write_l(addr, *(uint32_t *)p, map->p);
+		return;
+	}
+	if (len == 2 && map->write_w) {
+		map->write_w(addr, *(uint16_t *)p, map->p);
+		return;
+	}
+    }
+
+    for (c = 0; c < len; c++)
+	mem_writeb_phys(addr + c, p[c]);
+}
+
+
+/*
+ * Return the host memory behind a physical page, or NULL if reads
+ * from it have to go through a handler. Sets *ro if writes to the
+ * page do not simply land in that memory.
+ */
+uint8_t *
+mem_page_host(uint32_t addr, int *ro)
+{
+    mem_desc_t *d = &mem_desc[addr >> 12];
+
+    *ro = (d->write != d->read) || (d->read && (d->read->flags & MEM_MAPPING_ROM));
+
+    return(d->exec);
+}
+
+
+/*
+ * Return the host memory behind a page of the system BIOS, or NULL if
+ * the page holds anything else. BIOS reads have no side effects and
+ * return exactly what is in that memory, so instruction fetches from
+ * it can skip the mapping handlers.
+ */
+uint8_t *
+mem_fetch_host(uint32_t addr)
+{
+    mem_desc_t *d;
+
+    if (cr0 >> 31) return(NULL);
+
+    d = &mem_desc[(addr & rammask) >> 12];
+    if (d->read && (d->read->read_b == mem_read_bios))
+	return(d->exec);
+
+    return(NULL);
 }
 
 
@@ -1113,6 +1319,8 @@ mem_write_ramb_page(uint32_t addr, uint8_t val, page_t *p)
 	uint64_t mask = (uint64_t)1 << ((addr >> PAGE_MASK_SHIFT) & PAGE_MASK_MASK);
 	p->dirty_mask[(addr >> PAGE_MASK_INDEX_SHIFT) & PAGE_MASK_INDEX_MASK] |= mask;
 	p->mem[addr & 0xfff] = val;
+	if (p->pdc)
+		x386_pdc_invalidate(p->pdc, addr, 1);
     }
 }
 
@@ -1130,6 +1338,8 @@ mem_write_ramw_page(uint32_t addr, uint16_t val, page_t *p)
 		mask |= (mask << 1);
 	p->dirty_mask[(addr >> PAGE_MASK_INDEX_SHIFT) & PAGE_MASK_INDEX_MASK] |= mask;
 	*(uint16_t *)&p->mem[addr & 0xfff] = val;
+	if (p->pdc)
+		x386_pdc_invalidate(p->pdc, addr, 2);
     }
 }
 
@@ -1147,6 +1357,8 @@ mem_write_raml_page(uint32_t addr, uint32_t val, page_t *p)
 		mask |= (mask << 1);
 	p->dirty_mask[(addr >> PAGE_MASK_INDEX_SHIFT) & PAGE_MASK_INDEX_MASK] |= mask;
 	*(uint32_t *)&p->mem[addr & 0xfff] = val;
+	if (p->pdc)
+		x386_pdc_invalidate(p->pdc, addr, 4);
     }
 }
 
@@ -1315,8 +1527,11 @@ mem_invalidate_range(uint32_t start_addr, uint32_t end_addr)
 	/* Do nothing if the pages array is empty or DMA reads/writes to/from PCI device memory addresses
 	   may crash the emulator. */
 	cur_addr = (start_addr >> 12);
-	if (cur_addr < pages_sz)
+	if (cur_addr < pages_sz) {
 		pages[cur_addr].dirty_mask[(start_addr >> PAGE_MASK_INDEX_SHIFT) & PAGE_MASK_INDEX_MASK] |= mask;
+		if (pages[cur_addr].pdc)
+			x386_pdc_invalidate(pages[cur_addr].pdc, start_addr, 1 << PAGE_MASK_SHIFT);
+	}
     }
 }
 
@@ -1371,17 +1586,10 @@ mem_mapping_recalc(uint64_t base, uint64_t size)
     if (! size) return;
 
     /* Clear out old mappings. */
-    for (c = base; c < base + size; c += 0x4000) {
-	_mem_read_b[c >> 14] = NULL;
-	_mem_read_w[c >> 14] = NULL;
-	_mem_read_l[c >> 14] = NULL;
-	_mem_priv_r[c >> 14] = NULL;
-	_mem_mapping_r[c >> 14] = NULL;
-	_mem_write_b[c >> 14] = NULL;
-	_mem_write_w[c >> 14] = NULL;
-	_mem_write_l[c >> 14] = NULL;
-	_mem_priv_w[c >> 14] = NULL;
-	_mem_mapping_w[c >> 14] = NULL;
+    for (c = base; c < base + size; c += 0x1000) {
+	mem_desc[c >> 12].exec = NULL;
+	mem_desc[c >> 12].read = NULL;
+	mem_desc[c >> 12].write = NULL;
     }
 
     /* Walk mapping list. */
@@ -1393,32 +1601,31 @@ mem_mapping_recalc(uint64_t base, uint64_t size)
 		if (start < map->base)
 			start = map->base;
 
-		for (c = start; c < end; c += 0x4000) {
+		for (c = start; c < end; c += 0x1000) {
 			if ((map->read_b || map->read_w || map->read_l) &&
 			     mem_mapping_read_allowed(map->flags, _mem_state[c >> 14])) {
-				_mem_read_b[c >> 14] = map->read_b;
-				_mem_read_w[c >> 14] = map->read_w;
-				_mem_read_l[c >> 14] = map->read_l;
 				if (map->exec)
-					_mem_exec[c >> 14] = map->exec + (c - map->base);
+					mem_desc[c >> 12].exec = map->exec + (c - map->base);
 				else
-					_mem_exec[c >> 14] = NULL;
-				_mem_priv_r[c >> 14] = map->p;
-				_mem_mapping_r[c >> 14] = map;
+					mem_desc[c >> 12].exec = NULL;
+				mem_desc[c >> 12].read = map;
 			}
 			if ((map->write_b || map->write_w || map->write_l) &&
-			     mem_mapping_write_allowed(map->flags, _mem_state[c >> 14])) {
-				_mem_write_b[c >> 14] = map->write_b;
-				_mem_write_w[c >> 14] = map->write_w;
-				_mem_write_l[c >> 14] = map->write_l;
-				_mem_priv_w[c >> 14] = map->p;
-				_mem_mapping_w[c >> 14] = map;
-			}
+			     mem_mapping_write_allowed(map->flags, _mem_state[c >> 14]))
+				mem_desc[c >> 12].write = map;
 		}
 	}
 	map = map->next;
     }
 
+#ifdef USE_KVM
+    if (cpu_kvm_active)
+	kvm_remap();
+#endif
+
+    /* Pages may now run from other memory, drop any predecoded code. */
+    x386_pdc_flush();
+
     flushmmucache_cr3();
 }
 
@@ -1689,6 +1896,9 @@ mem_reset(void)
 {
     uint32_t c, m;
 
+    /* The page table and RAM get replaced, forget the predecoded code. */
+    x386_pdc_flush();
+
     /* Free the ROM memory and reset size mask. */
     if (rom != NULL) {
 	free(rom);
@@ -1696,13 +1906,20 @@ mem_reset(void)
     }
     biosmask = 0xffff;
 
+    /*
+     * The RAM block comes straight from the platform, page-aligned,
+     * so that a snapshot can map a saved RAM image right over it.
+     */
     m = 1024UL * mem_size;
     if (ram != NULL) {
-	free(ram);
+	plat_munmap(ram, ram_alloc_size);
 	ram = NULL;
     }
-    ram = (uint8_t *)malloc(m);		/* allocate and clear the RAM block */
+    ram = (uint8_t *)plat_mmap(m, 0);	/* allocate and clear the RAM block */
+    if (ram == NULL)
+	fatal("MEM: unable to allocate %u KB of RAM\n", mem_size);
     memset(ram, 0x00, m);
+    ram_alloc_size = m;
 
     /*
      * Allocate the page table based on how much RAM we have.
@@ -1773,13 +1990,7 @@ mem_log("MEM: reset: new pages=%08lx, pages_sz=%i\n", pages, pages_sz);
 	pages[c].write_l = mem_write_raml_page;
     }
 
-    memset(_mem_read_b,  0x00, sizeof(_mem_read_b));
-    memset(_mem_read_w,  0x00, sizeof(_mem_read_w));
-    memset(_mem_read_l,  0x00, sizeof(_mem_read_l));
-    memset(_mem_write_b, 0x00, sizeof(_mem_write_b));
-    memset(_mem_write_w, 0x00, sizeof(_mem_write_w));
-    memset(_mem_write_l, 0x00, sizeof(_mem_write_l));
-    memset(_mem_exec,    0x00, sizeof(_mem_exec));
+    memset(mem_desc, 0x00, sizeof(mem_desc));
 
     memset(&base_mapping, 0x00, sizeof(base_mapping));
 
@@ -1852,8 +2063,6 @@ mem_init(void)
     writelookup2 = malloc((1<<20)*sizeof(uintptr_t));
 #endif
 
-    memset(ram_mapped_addr, 0x00, 64 * sizeof(uint32_t));
-
 #if FIXME
     memset(ff_array, 0xff, sizeof(ff_array));
 #endif
@@ -1863,6 +2072,40 @@ mem_init(void)
 }
 
 
+/* Save the memory controller state; the RAM itself is done elsewhere. */
+void
+mem_state_save(snapshot_t *s)
+{
+    snapshot_write_var(s, rammask);
+    snapshot_write_var(s, mem_a20_key);
+    snapshot_write_var(s, mem_a20_alt);
+    snapshot_write_var(s, mem_a20_state);
+    snapshot_write_var(s, port_92_reg);
+    snapshot_write_var(s, shadowbios);
+    snapshot_write_var(s, shadowbios_write);
+    snapshot_write(s, _mem_state, sizeof(_mem_state));
+}
+
+
+void
+mem_state_load(snapshot_t *s)
+{
+    snapshot_read_var(s, rammask);
+    snapshot_read_var(s, mem_a20_key);
+    snapshot_read_var(s, mem_a20_alt);
+    snapshot_read_var(s, mem_a20_state);
+    snapshot_read_var(s, port_92_reg);
+    snapshot_read_var(s, shadowbios);
+    snapshot_read_var(s, shadowbios_write);
+    snapshot_read(s, _mem_state, sizeof(_mem_state));
+
+    /* Rebuild the page tables for the (shadow) memory states. */
+    mem_mapping_recalc(0x000000000ULL, 0x100000000ULL);
+
+    flushmmucache();
+}
+
+
 void
 mem_remap_top(int kb)
 {
@@ -43,9 +43,6 @@
 #define MEM_MAPPING_ROM		4	/* Executing from ROM may involve
 					 * additional wait states. */
 
-#define MEM_MAP_TO_SHADOW_RAM_MASK 1
-#define MEM_MAP_TO_RAM_ADDR_MASK   2
-
 #define MEM_READ_ANY		0x00
 #define MEM_READ_INTERNAL	0x10
 #define MEM_READ_EXTERNAL	0x20
@@ -96,6 +93,9 @@ typedef struct _page_ {
 
     /*Head of codeblock tree associated with this page*/
     struct codeblock_t *head;
+
+    /* Predecoded instructions of the interpreter (386.c), if any. */
+    struct x386_pdc_t *pdc;
 } page_t;
 
 
@@ -114,7 +114,6 @@ extern int		writelookup[256],
 			writelookupp[256];
 extern uintptr_t	*writelookup2;
 extern int		writelnext;
-extern uint32_t		ram_mapped_addr[64];
 
 mem_mapping_t		base_mapping,
 			ram_low_mapping,
@@ -131,6 +130,7 @@ extern uint32_t		mem_logical_addr;
 
 extern page_t		*pages,
 			**page_lookup;
+extern uint32_t		pages_sz;
 
 extern uint32_t		get_phys_virt,get_phys_phys;
 
@@ -143,6 +143,9 @@ extern int		nopageerrors;
 extern int		memspeed[11];
 
 extern int		mmu_perm;
+extern int		mmu_tlb_hits,
+			mmu_tlb_misses,
+			mmu_tlb_flushes;
 
 extern int		mem_a20_state,
 			mem_a20_alt,
@@ -213,6 +216,10 @@ extern uint32_t	mem_readl_phys(uint32_t addr);
 extern void	mem_writeb_phys(uint32_t addr, uint8_t val);
 extern void	mem_writeb_phys_dma(uint32_t addr, uint8_t val);
 extern void	mem_writew_phys(uint32_t addr, uint16_t val);
+extern void	mem_read_phys(void *dest, uint32_t addr, int len);
+extern void	mem_write_phys(void *src, uint32_t addr, int len);
+extern uint8_t	*mem_page_host(uint32_t addr, int *ro);
+extern uint8_t	*mem_fetch_host(uint32_t addr);
 extern void	mem_writel_phys(uint32_t addr, uint32_t val);
 
 extern uint8_t	mem_read_ram(uint32_t addr, void *priv);
@@ -249,6 +256,7 @@ extern void     flushmmucache(void);
 extern void     flushmmucache_cr3(void);
 extern void	flushmmucache_nopc(void);
 extern void     mmu_invalidate(uint32_t addr);
+extern void	mmu_tlb_flush(int global);
 
 extern void	mem_a20_recalc(void);
 
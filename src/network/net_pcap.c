@@ -82,10 +82,14 @@ struct bpf_program {
 
 typedef struct pcap_if	pcap_if_t; 
 
+#ifdef _WIN32
 typedef struct timeval {
     long		tv_sec;
     long		tv_usec;
 } timeval;
+#else
+# include <sys/time.h>
+#endif
 
 #define PCAP_ERRBUF_SIZE	256
 
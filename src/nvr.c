@@ -165,8 +165,6 @@ void
 nvr_init(nvr_t *nvr)
 {
     char temp[64];
-    struct tm *tm;
-    time_t now;
     int c;
 
     /* Set up the NVR file's name. */
@@ -178,15 +176,8 @@ nvr_init(nvr_t *nvr)
     /* Initialize the internal clock as needed. */
     memset(&intclk, 0x00, sizeof(intclk));
     if (time_sync & TIME_SYNC_ENABLED) {
-	/* Get the current time of day, and convert to local time. */
-	(void)time(&now);
-	if(time_sync & TIME_SYNC_UTC)
-		tm = gmtime(&now);
-	else
-		tm = localtime(&now);
-
-	/* Set the internal clock. */
-	nvr_time_set(tm);
+	/* Set the internal clock from the host. */
+	nvr_time_sync();
     } else {
 	/* Reset the internal clock to 1980/01/01 00:00. */
 	intclk.tm_mon = 1;
@@ -363,6 +354,35 @@ nvr_time_set(struct tm *tm)
 }
 
 
+/*
+ * Re-synchronize the internal clock with the host.
+ *
+ * After that, the clock is only advanced by the (emulated)
+ * one-second timer, so it runs ahead of the host clock when
+ * the machine runs faster than real time. Chips that follow
+ * the internal clock pick up the new time on their next
+ * update cycle.
+ */
+void
+nvr_time_sync(void)
+{
+    struct tm *tm;
+    time_t now;
+
+    if (! (time_sync & TIME_SYNC_ENABLED)) return;
+
+    /* Get the current time of day, and convert to local time. */
+    (void)time(&now);
+    if (time_sync & TIME_SYNC_UTC)
+	tm = gmtime(&now);
+      else
+	tm = localtime(&now);
+
+    /* Set the internal clock. */
+    nvr_time_set(tm);
+}
+
+
 /* Open or create a file in the NVR area. */
 FILE *
 nvr_fopen(wchar_t *str, wchar_t *mode)
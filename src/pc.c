@@ -70,9 +70,11 @@
 #include "sound/midi.h"
 #include "sound/snd_speaker.h"
 #include "video/video.h"
+#include "video/vid_voodoo.h"
 #include "ui.h"
 #include "plat.h"
 #include "plat_midi.h"
+#include "snapshot.h"
 
 
 /* Commandline options. */
@@ -86,11 +88,20 @@ int	force_debug = 0;			/* (O) force debug output */
 int	video_fps = RENDER_FPS;			/* (O) render speed in fps */
 #endif
 int	settings_only = 0;			/* (O) show only the settings dialog */
+int	headless = 0;				/* (O) run unthrottled, no display */
+int	turbo_mode = 0;				/* (O) run slices back to back */
+int	frames_max = 0;				/* (O) exit after this many frames */
+int	hdd_overlays = 0;			/* (O) throwaway hard disk overlays */
+#ifdef USE_KVM
+int	force_kvm = 0;				/* (O) run the cpu under KVM */
+#endif
 #ifdef _WIN32
 uint64_t	unique_id = 0;
 uint64_t	source_hwnd = 0;
 #endif
 wchar_t log_path[1024] = { L'\0'};		/* (O) full path of logfile */
+wchar_t snap_load_path[1024] = { L'\0'};	/* (O) snapshot to start from */
+wchar_t snap_save_path[1024] = { L'\0'};	/* (O) snapshot to write on exit */
 
 /* Configuration values. */
 int	window_w, window_h,			/* (C) window size and */
@@ -121,6 +132,7 @@ int	sound_is_float = 1,			/* (C) sound uses FP values */
 uint32_t mem_size = 0;				/* (C) memory size */
 int	cpu_manufacturer = 0,			/* (C) cpu manufacturer */
 	cpu_use_dynarec = 0,			/* (C) cpu uses/needs Dyna */
+	cpu_use_kvm = 0,			/* (C) cpu runs under KVM */
 	cpu = 3,				/* (C) cpu type */
 	enable_external_fpu = 0;		/* (C) enable external FPU */
 int	time_sync = 0;			/* (C) enable time sync */
@@ -128,10 +140,16 @@ int	time_sync = 0;			/* (C) enable time sync */
 /* Statistics. */
 extern int
 	mmuflush,
+	mmu_tlb_hits,
+	mmu_tlb_misses,
+	mmu_tlb_flushes,
+	pdc_hits,
+	pdc_misses,
 	readlnum,
 	writelnum;
 
 int	fps, framecount;			/* emulator % */
+int	framecount_total;			/* frames run since start */
 
 int	CPUID;
 int	output;
@@ -309,7 +327,9 @@ pc_init(int argc, wchar_t *argv[])
     struct tm *info;
     time_t now;
     int c;
+#ifdef _WIN32
     uint32_t *uid, *shwnd;
+#endif
 
     /* Grab the executable's full path. */
     plat_get_exe_name(exe_path, sizeof(exe_path)-1);
@@ -343,6 +363,17 @@ usage:
 		printf("-L or --logfile path - set 'path' to be the logfile\n");
 		printf("-P or --vmpath path  - set 'path' to be root for vm\n");
 		printf("-S or --settings     - show only the settings dialog\n");
+		printf("-T or --turbo        - run as fast as the host allows\n");
+		printf("--loadsnap path      - resume from the snapshot in 'path'\n");
+		printf("--savesnap path      - save a snapshot to 'path' on exit\n");
+		printf("--overlay            - do not write to the hard disk images\n");
+#ifdef USE_KVM
+		printf("--kvm                - run the cpu under KVM if possible\n");
+#endif
+#ifdef UNIX
+		printf("--headless           - run as fast as possible\n");
+		printf("--frames N           - exit after N frames of 10ms\n");
+#endif
 #ifdef _WIN32
 		printf("-H or --hwnd id,hwnd - sends back the main dialog's hwnd\n");
 #endif
@@ -372,6 +403,23 @@ usage:
 	} else if (!wcscasecmp(argv[c], L"--settings") ||
 		   !wcscasecmp(argv[c], L"-S")) {
 		settings_only = 1;
+	} else if (!wcscasecmp(argv[c], L"--turbo") ||
+		   !wcscasecmp(argv[c], L"-T")) {
+		turbo_mode = 1;
+	} else if (!wcscasecmp(argv[c], L"--loadsnap")) {
+		if ((c+1) == argc) goto usage;
+
+		wcscpy(snap_load_path, argv[++c]);
+	} else if (!wcscasecmp(argv[c], L"--savesnap")) {
+		if ((c+1) == argc) goto usage;
+
+		wcscpy(snap_save_path, argv[++c]);
+	} else if (!wcscasecmp(argv[c], L"--overlay")) {
+		hdd_overlays = 1;
+#ifdef USE_KVM
+	} else if (!wcscasecmp(argv[c], L"--kvm")) {
+		force_kvm = 1;
+#endif
 #ifdef _WIN32
 	} else if (!wcscasecmp(argv[c], L"--hwnd") ||
 		   !wcscasecmp(argv[c], L"-H")) {
@@ -382,6 +430,16 @@ usage:
 		uid = (uint32_t *) &unique_id;
 		shwnd = (uint32_t *) &source_hwnd;
 		sscanf(temp, "%08X%08X,%08X%08X", uid + 1, uid, shwnd + 1, shwnd);
+#endif
+#ifdef UNIX
+	} else if (!wcscasecmp(argv[c], L"--headless")) {
+		headless = 1;
+		turbo_mode = 1;
+	} else if (!wcscasecmp(argv[c], L"--frames")) {
+		if ((c+1) == argc) goto usage;
+
+		frames_max = wcstol(argv[++c], NULL, 10);
+		if (frames_max < 0) goto usage;
 #endif
 	} else if (!wcscasecmp(argv[c], L"--test")) {
 		/* some (undocumented) test function here.. */
@@ -824,6 +882,9 @@ pc_reset_hard_init(void)
     dma_reset();
     pic_reset();
     cpu_cache_int_enabled = cpu_cache_ext_enabled = 0;
+#ifdef USE_KVM
+    kvm_reset();
+#endif
 
     pc_full_speed();
 
@@ -897,10 +958,15 @@ pc_close(thread_t *ptr)
 	dumppic();
     dumpregs(0);
 
-    video_close();
+#ifdef USE_KVM
+    kvm_close();
+#endif
 
+    /* Video cards may still be drawing into the video buffers. */
     device_close_all();
 
+    video_close();
+
     scsi_device_close_all();
 
     midi_close();
@@ -939,19 +1005,34 @@ pc_thread(void *param)
 
     main_time = 0;
     framecountx = 0;
+    framecount_total = 0;
     title_update = 1;
     old_time = plat_get_ticks();
     done = drawits = frames = 0;
+
+    /* Resume from a snapshot if we were asked to. */
+    if (snap_load_path[0] != L'\0') {
+	startblit();
+	if (! snapshot_load(snap_load_path))
+		pc_log("PC: unable to load snapshot '%ls'\n", snap_load_path);
+	endblit();
+    }
+
     while (! *quitp) {
 	/* See if it is time to run a frame of code. */
 	new_time = plat_get_ticks();
 	drawits += (new_time - old_time);
 	old_time = new_time;
-	if (drawits > 0 && !dopause) {
-		/* Yes, so do one frame now. */
+	if ((drawits > 0 || turbo_mode) && !dopause) {
+		/*
+		 * Yes, so do one frame now. In turbo mode we do not
+		 * look at the host clock at all, and just run frames
+		 * back to back; everything else (sound, RTC, video)
+		 * follows the emulated time, so it will keep up.
+		 */
 		start_time = plat_timer_read();
 		drawits -= 10;
-		if (drawits > 50)
+		if (drawits > 50 || turbo_mode)
 			drawits = 0;
 
 		/* Run a block of code. */
@@ -959,6 +1040,11 @@ pc_thread(void *param)
 		clockrate = machines[machine].cpu[cpu_manufacturer].cpus[cpu_effective].rspeed;
 
 		if (is386) {
+#ifdef USE_KVM
+			if (cpu_kvm_active)
+				exec386_kvm(clockrate/100);
+			  else
+#endif
 #ifdef USE_DYNAREC
 			if (cpu_use_dynarec)
 				exec386_dynarec(clockrate/100);
@@ -985,6 +1071,16 @@ pc_thread(void *param)
 			readlnum = writelnum = 0;
 			egareads = egawrites = 0;
 			mmuflush = 0;
+			mmu_tlb_hits = mmu_tlb_misses = 0;
+			mmu_tlb_flushes = 0;
+			pdc_hits = pdc_misses = 0;
+#ifdef USE_DYNAREC
+			cpu_recomp_deferred_latched = cpu_recomp_deferred;
+			cpu_recomp_deferred = 0;
+			if (cpu_recomp_deferred_latched)
+				pc_log("PC: %i hot blocks over the compile budget\n",
+				       cpu_recomp_deferred_latched);
+#endif
 			frames = 0;
 		}
 
@@ -993,8 +1089,10 @@ pc_thread(void *param)
 			mbstowcs(wcpu, machines[machine].cpu[cpu_manufacturer].cpus[cpu_effective].name,
 				 strlen(machines[machine].cpu[cpu_manufacturer].cpus[cpu_effective].name)+1);
 			swprintf(temp, sizeof_w(temp),
-				 L"%ls v%ls - %i%% - %ls - %ls - %ls",
-				 EMU_NAME_W,EMU_VERSION_W,fps,wmachine,wcpu,
+				 L"%ls v%ls - %i%%%ls%ls - %ls - %ls - %ls",
+				 EMU_NAME_W,EMU_VERSION_W,fps,
+				 voodoo_jit_stats[0] ? L" - " : L"",voodoo_jit_stats,
+				 wmachine,wcpu,
 				 (!mouse_capture) ? plat_get_string(IDS_2077)
 				  : (mouse_get_buttons() > 2) ? plat_get_string(IDS_2078) : plat_get_string(IDS_2079));
 
@@ -1006,6 +1104,11 @@ pc_thread(void *param)
 		/* One more frame done! */
 		done++;
 
+		/* Batch runs stop by themselves. */
+		framecount_total++;
+		if (frames_max && (framecount_total >= frames_max))
+			*quitp = 1;
+
 		/* Every 200 frames we save the machine status. */
 		if (++frames >= 200 && nvr_dosave) {
 			nvr_save();
@@ -1028,6 +1131,13 @@ pc_thread(void *param)
 	}
     }
 
+    if (snap_save_path[0] != L'\0') {
+	startblit();
+	if (! snapshot_save(snap_save_path))
+		pc_log("PC: unable to save snapshot '%ls'\n", snap_save_path);
+	endblit();
+    }
+
     pc_log("PC: main thread done.\n");
 }
 
@@ -1043,6 +1153,70 @@ pc_onesec(void)
 }
 
 
+/* Switch turbo (unthrottled) mode on or off. */
+void
+pc_set_turbo(int on)
+{
+    if (turbo_mode == !!on) return;
+
+    pc_log("PC: turbo mode %s\n", on ? "on" : "off");
+
+    turbo_mode = !!on;
+
+    /*
+     * The guest clock ran ahead of the host while in turbo
+     * mode; if it is supposed to follow the host clock, get
+     * it back in step now.
+     */
+    if (! turbo_mode)
+	nvr_time_sync();
+}
+
+
+/* Save the running machine to a snapshot file. */
+int
+pc_snapshot_save(wchar_t *fn)
+{
+    int ret;
+
+    plat_pause(1);
+
+    plat_delay_ms(100);
+
+    ret = snapshot_save(fn);
+
+    plat_pause(0);
+
+    return(ret);
+}
+
+
+/*
+ * Restore the machine from a snapshot file. The machine is hard
+ * reset first, so devices without a load handler come back in
+ * their power-on state, as does a machine whose load failed.
+ */
+int
+pc_snapshot_load(wchar_t *fn)
+{
+    int ret;
+
+    plat_pause(1);
+
+    plat_delay_ms(100);
+
+    nvr_save();
+
+    pc_reset_hard();
+
+    ret = snapshot_load(fn);
+
+    plat_pause(0);
+
+    return(ret);
+}
+
+
 void
 set_screen_size(int x, int y)
 {
@@ -33,6 +33,7 @@
 #include "device.h"
 #include "pci.h"
 #include "piix.h"
+#include "snapshot.h"
 #include "keyboard.h"
 
 
@@ -728,3 +729,38 @@ pci_add_card(uint8_t add_type, uint8_t (*read)(int func, int addr, void *priv),
 
     return 0xff;
 }
+
+
+/* Save the bus state; the cards on it save their own. */
+void
+pci_state_save(snapshot_t *s)
+{
+    snapshot_write_var(s, elcr);
+    snapshot_write_var(s, pci_irqs);
+    snapshot_write_var(s, pci_irq_hold);
+    snapshot_write_var(s, pci_mirqs);
+    snapshot_write_var(s, pci_index);
+    snapshot_write_var(s, pci_func);
+    snapshot_write_var(s, pci_card);
+    snapshot_write_var(s, pci_bus);
+    snapshot_write_var(s, pci_enable);
+    snapshot_write_var(s, pci_key);
+    snapshot_write_var(s, trc_reg);
+}
+
+
+void
+pci_state_load(snapshot_t *s)
+{
+    snapshot_read_var(s, elcr);
+    snapshot_read_var(s, pci_irqs);
+    snapshot_read_var(s, pci_irq_hold);
+    snapshot_read_var(s, pci_mirqs);
+    snapshot_read_var(s, pci_index);
+    snapshot_read_var(s, pci_func);
+    snapshot_read_var(s, pci_card);
+    snapshot_read_var(s, pci_bus);
+    snapshot_read_var(s, pci_enable);
+    snapshot_read_var(s, pci_key);
+    snapshot_read_var(s, trc_reg);
+}
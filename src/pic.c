@@ -26,6 +26,7 @@
 #include "pci.h"
 #include "pic.h"
 #include "pit.h"
+#include "snapshot.h"
 
 
 int output;
@@ -533,3 +534,23 @@ dumppic()
     if (AT)
 	pic_log("PIC2 : MASK %02X PEND %02X INS %02X LEVEL %02X VECTOR %02X CASCADE %02X\n", pic2.mask, pic2.pend, pic2.ins, (pic2.icw1 & 8) ? 1 : 0, pic2.vector, pic2.icw3);
 }
+
+
+void
+pic_state_save(snapshot_t *s)
+{
+    snapshot_write_var(s, pic);
+    snapshot_write_var(s, pic2);
+    snapshot_write_var(s, pic_current);
+    snapshot_write_var(s, pic_intpending);
+}
+
+
+void
+pic_state_load(snapshot_t *s)
+{
+    snapshot_read_var(s, pic);
+    snapshot_read_var(s, pic2);
+    snapshot_read_var(s, pic_current);
+    snapshot_read_var(s, pic_intpending);
+}
@@ -17,6 +17,7 @@
 #include "ppi.h"
 #include "device.h"
 #include "timer.h"
+#include "snapshot.h"
 #include "machine/machine.h"
 #include "sound/sound.h"
 #include "sound/snd_speaker.h"
@@ -650,3 +651,39 @@ void pit_ps2_init()
         pit_set_out_func(&pit, 0, pit_irq0_ps2);
         pit_set_out_func(&pit2, 0, pit_nmi_ps2);
 }
+
+
+void pit_state_save(snapshot_t *s)
+{
+        snapshot_write_var(s, pit);
+        snapshot_write_var(s, pit2);
+        snapshot_write_var(s, ppi);
+        snapshot_write_var(s, ppispeakon);
+        snapshot_write_var(s, speaker_gated);
+        snapshot_write_var(s, speaker_enable);
+        snapshot_write_var(s, was_speaker_enable);
+}
+
+/*The output handlers and back pointers were set up by pit_init(), keep them.*/
+static void pit_load_one(snapshot_t *s, PIT *pit)
+{
+	void (*old_set_out_funcs[3])(int new_out, int old_out);
+	PIT_nr old_pit_nr[3];
+
+	memcpy(old_set_out_funcs, pit->set_out_funcs, 3 * sizeof(void *));
+	memcpy(old_pit_nr, pit->pit_nr, 3 * sizeof(PIT_nr));
+        snapshot_read(s, pit, sizeof(PIT));
+	memcpy(pit->set_out_funcs, old_set_out_funcs, 3 * sizeof(void *));
+	memcpy(pit->pit_nr, old_pit_nr, 3 * sizeof(PIT_nr));
+}
+
+void pit_state_load(snapshot_t *s)
+{
+        pit_load_one(s, &pit);
+        pit_load_one(s, &pit2);
+        snapshot_read_var(s, ppi);
+        snapshot_read_var(s, ppispeakon);
+        snapshot_read_var(s, speaker_gated);
+        snapshot_read_var(s, speaker_enable);
+        snapshot_read_var(s, was_speaker_enable);
+}
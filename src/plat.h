@@ -69,6 +69,7 @@ GLOBAL int	unscaled_size_x,		/* current unscaled size X */
 extern wchar_t	*fix_exe_path(wchar_t *str);
 extern FILE	*plat_fopen(wchar_t *path, wchar_t *mode);
 extern void	plat_remove(wchar_t *path);
+extern int	plat_rename(wchar_t *from, wchar_t *to);
 extern int	plat_getcwd(wchar_t *bufp, int max);
 extern int	plat_chdir(wchar_t *path);
 extern void	plat_tempfile(wchar_t *bufp, wchar_t *prefix, wchar_t *suffix);
@@ -84,6 +85,13 @@ extern int	plat_dir_create(wchar_t *path);
 extern uint64_t	plat_timer_read(void);
 extern uint32_t	plat_get_ticks(void);
 extern void	plat_delay_ms(uint32_t count);
+extern void	*plat_mmap(size_t size, uint8_t executable);
+extern void	plat_munmap(void *ptr, size_t size);
+extern int	plat_mmap_file(void *ptr, size_t size, wchar_t *fn, uint64_t offset);
+extern void	*plat_mmap_image(FILE *f, uint64_t size, int ro);
+extern void	plat_munmap_image(void *ptr, uint64_t size);
+extern void	plat_mmap_prefetch(void *ptr, size_t size);
+extern int	plat_punch_hole(FILE *f, uint64_t offset, uint64_t size);
 extern void	plat_pause(int p);
 extern void	plat_mouse_capture(int on);
 extern int	plat_vidapi(char *name);
@@ -0,0 +1,420 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Save and restore the state of the whole machine.
+ *
+ *		A snapshot file starts with a header identifying the
+ *		format version and the machine configuration, followed
+ *		by a series of chunks, each with a 4-character ID, an
+ *		instance number and the size of its data. The core
+ *		modules (timers, CPU, memory, PIC, PIT, DMA and PCI)
+ *		have fixed chunk IDs; devices get a "DEV " chunk with
+ *		their slot number as the instance if they provide save
+ *		and load handlers. Unknown chunks are skipped, and a
+ *		handler that reads past the end of its chunk gets zeroes,
+ *		so older snapshots stay loadable as the format grows.
+ *
+ *		The RAM image is stored page-aligned in the file, so the
+ *		platform can map it straight into the RAM block, which
+ *		makes restoring (cloning) a large machine nearly free.
+ *
+ *		Snapshots must be taken and restored between two slices
+ *		of CPU execution, on a machine with the same config.
+ *
+ * Version:	@(#)snapshot.c	1.0.0	2026/10/18
+ *
+ * Author:	agent, <agent@local>
+ *
+ *		Copyright 2026 agent.
+ */
+#define _LARGEFILE_SOURCE
+#define _LARGEFILE64_SOURCE
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include "86box.h"
+#include "cpu/cpu.h"
+#include "machine/machine.h"
+#include "mem.h"
+#include "plat.h"
+#include "snapshot.h"
+
+
+#define SNAPSHOT_MAGIC		"86BoxSNP"
+#define SNAPSHOT_ALIGN		65536		/* RAM image alignment */
+
+
+#pragma pack(push,1)
+typedef struct {
+    char	magic[8];
+    uint32_t	version;
+    uint32_t	flags;
+    char	machine[32];
+    int32_t	cpu_manufacturer,
+		cpu;
+    uint32_t	mem_size;			/* in KB */
+    uint8_t	pad[12];
+} snap_hdr_t;
+
+typedef struct {
+    char	id[4];
+    uint32_t	inst;
+    uint64_t	size;
+} snap_chunk_t;
+#pragma pack(pop)
+
+
+struct _snapshot_ {
+    FILE	*fp;
+    int		version;
+    int		error;
+
+    uint64_t	chunk_pos;			/* file offset of header */
+    uint64_t	chunk_size;			/* size of the data */
+    uint64_t	chunk_used;			/* data read so far */
+};
+
+
+#ifdef ENABLE_SNAPSHOT_LOG
+int snapshot_do_log = ENABLE_SNAPSHOT_LOG;
+
+
+static void
+snapshot_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (snapshot_do_log) {
+	va_start(ap, fmt);
+	pclog_ex(fmt, ap);
+	va_end(ap);
+    }
+}
+#else
+#define snapshot_log(fmt, ...)
+#endif
+
+
+int
+snapshot_version(snapshot_t *s)
+{
+    return(s->version);
+}
+
+
+/* Start a new chunk; its size is filled in by snapshot_chunk_end(). */
+void
+snapshot_chunk_begin(snapshot_t *s, const char *id, uint32_t inst)
+{
+    snap_chunk_t chunk;
+
+    memcpy(chunk.id, id, 4);
+    chunk.inst = inst;
+    chunk.size = 0;
+
+    s->chunk_pos = ftello64(s->fp);
+    if (fwrite(&chunk, 1, sizeof(chunk), s->fp) != sizeof(chunk))
+	s->error = 1;
+}
+
+
+void
+snapshot_chunk_end(snapshot_t *s)
+{
+    uint64_t end, size;
+
+    end = ftello64(s->fp);
+    size = end - s->chunk_pos - sizeof(snap_chunk_t);
+
+    fseeko64(s->fp, s->chunk_pos + 8, SEEK_SET);
+    if (fwrite(&size, 1, sizeof(size), s->fp) != sizeof(size))
+	s->error = 1;
+    fseeko64(s->fp, end, SEEK_SET);
+}
+
+
+void
+snapshot_write(snapshot_t *s, const void *p, uint32_t len)
+{
+    if (fwrite(p, 1, len, s->fp) != len)
+	s->error = 1;
+}
+
+
+/* Read chunk data; anything past the end of the chunk reads as zero. */
+void
+snapshot_read(snapshot_t *s, void *p, uint32_t len)
+{
+    uint64_t avail;
+    uint32_t n;
+
+    avail = s->chunk_size - s->chunk_used;
+    n = (len > avail) ? (uint32_t)avail : len;
+
+    if (n && (fread(p, 1, n, s->fp) != n)) {
+	s->error = 1;
+	n = 0;
+    }
+    if (n < len)
+	memset((uint8_t *)p + n, 0x00, len - n);
+
+    s->chunk_used += n;
+}
+
+
+/* Write the RAM image, aligned so that it can be mapped back in. */
+static void
+snapshot_save_ram(snapshot_t *s)
+{
+    uint32_t size, offset;
+    uint64_t pos;
+    uint8_t pad[256];
+
+    size = mem_size * 1024;
+
+    snapshot_chunk_begin(s, "RAM ", 0);
+
+    pos = s->chunk_pos + sizeof(snap_chunk_t) + 8;
+    offset = 8 + (uint32_t)(((pos + SNAPSHOT_ALIGN - 1) & ~((uint64_t)SNAPSHOT_ALIGN - 1)) - pos);
+    snapshot_write_var(s, size);
+    snapshot_write_var(s, offset);
+
+    memset(pad, 0x00, sizeof(pad));
+    pos = offset - 8;
+    while (pos > 0) {
+	snapshot_write(s, pad, (pos > sizeof(pad)) ? sizeof(pad) : (uint32_t)pos);
+	pos -= (pos > sizeof(pad)) ? sizeof(pad) : pos;
+    }
+
+    snapshot_write(s, ram, size);
+
+    snapshot_chunk_end(s);
+}
+
+
+static void
+snapshot_load_ram(snapshot_t *s, wchar_t *fn)
+{
+    uint32_t size, offset;
+    uint64_t pos;
+
+    snapshot_read_var(s, size);
+    snapshot_read_var(s, offset);
+    if (size != (mem_size * 1024)) {
+	s->error = 1;
+	return;
+    }
+
+    pos = s->chunk_pos + sizeof(snap_chunk_t) + offset;
+
+    /* Try to map the image, or else read it the slow way. */
+    if (! plat_mmap_file(ram, size, fn, pos)) {
+	fseeko64(s->fp, pos, SEEK_SET);
+	if (fread(ram, 1, size, s->fp) != size)
+		s->error = 1;
+    } else
+	snapshot_log("SNAPSHOT: RAM image mapped from file\n");
+}
+
+
+/*
+ * Save the current machine state to a snapshot file.
+ *
+ * The RAM may still be mapped from the snapshot we are replacing,
+ * so write a new file next to it and rename it into place, rather
+ * than truncating the pages the guest is running on.
+ */
+int
+snapshot_save(wchar_t *fn)
+{
+    snapshot_t snap, *s = &snap;
+    snap_hdr_t hdr;
+    wchar_t temp[1024];
+
+    if ((wcslen(fn) + 5) > sizeof_w(temp)) {
+	snapshot_log("SNAPSHOT: path too long '%ls'\n", fn);
+	return(0);
+    }
+    wcscpy(temp, fn);
+    wcscat(temp, L".tmp");
+
+    memset(s, 0x00, sizeof(snapshot_t));
+    s->version = SNAPSHOT_VERSION;
+    s->fp = plat_fopen(temp, L"wb");
+    if (s->fp == NULL) {
+	snapshot_log("SNAPSHOT: unable to create '%ls'\n", temp);
+	return(0);
+    }
+
+    memset(&hdr, 0x00, sizeof(hdr));
+    memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+    hdr.version = SNAPSHOT_VERSION;
+    strncpy(hdr.machine, machine_get_internal_name(), sizeof(hdr.machine) - 1);
+    hdr.cpu_manufacturer = cpu_manufacturer;
+    hdr.cpu = cpu;
+    hdr.mem_size = mem_size;
+    snapshot_write_var(s, hdr);
+
+    /* The timers go first, so loaders can re-arm their events. */
+    snapshot_chunk_begin(s, "TIMR", 0);
+    timer_state_save(s);
+    snapshot_chunk_end(s);
+
+    snapshot_chunk_begin(s, "CPU ", 0);
+    cpu_state_save(s);
+    snapshot_chunk_end(s);
+
+    snapshot_chunk_begin(s, "MEM ", 0);
+    mem_state_save(s);
+    snapshot_chunk_end(s);
+
+    snapshot_chunk_begin(s, "PIC ", 0);
+    pic_state_save(s);
+    snapshot_chunk_end(s);
+
+    snapshot_chunk_begin(s, "PIT ", 0);
+    pit_state_save(s);
+    snapshot_chunk_end(s);
+
+    snapshot_chunk_begin(s, "DMA ", 0);
+    dma_state_save(s);
+    snapshot_chunk_end(s);
+
+    if (PCI) {
+	snapshot_chunk_begin(s, "PCI ", 0);
+	pci_state_save(s);
+	snapshot_chunk_end(s);
+    }
+
+    device_save_all(s);
+
+    snapshot_save_ram(s);
+
+    snapshot_chunk_begin(s, "END ", 0);
+    snapshot_chunk_end(s);
+
+    if (fclose(s->fp) != 0)
+	s->error = 1;
+
+    if (! s->error && ! plat_rename(temp, fn))
+	s->error = 1;
+
+    if (s->error) {
+	snapshot_log("SNAPSHOT: error writing '%ls'\n", fn);
+	plat_remove(temp);
+	return(0);
+    }
+
+    snapshot_log("SNAPSHOT: saved to '%ls'\n", fn);
+
+    return(1);
+}
+
+
+/*
+ * Restore the machine state from a snapshot file.
+ *
+ * The machine must have just been (hard) reset with the same
+ * configuration the snapshot was taken with. Devices without
+ * load handlers are left in their reset state.
+ */
+int
+snapshot_load(wchar_t *fn)
+{
+    snapshot_t snap, *s = &snap;
+    snap_chunk_t chunk;
+    snap_hdr_t hdr;
+    int done = 0;
+
+    memset(s, 0x00, sizeof(snapshot_t));
+    s->fp = plat_fopen(fn, L"rb");
+    if (s->fp == NULL) {
+	snapshot_log("SNAPSHOT: unable to open '%ls'\n", fn);
+	return(0);
+    }
+
+    if ((fread(&hdr, 1, sizeof(hdr), s->fp) != sizeof(hdr)) ||
+	memcmp(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic)) ||
+	(hdr.version == 0) || (hdr.version > SNAPSHOT_VERSION)) {
+	snapshot_log("SNAPSHOT: '%ls' is not a valid snapshot\n", fn);
+	(void)fclose(s->fp);
+	return(0);
+    }
+
+    hdr.machine[sizeof(hdr.machine) - 1] = '\0';
+    if (strcmp(hdr.machine, machine_get_internal_name()) ||
+	(hdr.cpu_manufacturer != cpu_manufacturer) ||
+	(hdr.cpu != cpu) || (hdr.mem_size != mem_size)) {
+	snapshot_log("SNAPSHOT: '%ls' is for a different machine (%s)\n",
+		     fn, hdr.machine);
+	(void)fclose(s->fp);
+	return(0);
+    }
+    s->version = hdr.version;
+
+    while (!done && !s->error) {
+	s->chunk_pos = ftello64(s->fp);
+	if (fread(&chunk, 1, sizeof(chunk), s->fp) != sizeof(chunk)) {
+		s->error = 1;
+		break;
+	}
+	s->chunk_size = chunk.size;
+	s->chunk_used = 0;
+
+	if (! memcmp(chunk.id, "TIMR", 4))
+		timer_state_load(s);
+	else if (! memcmp(chunk.id, "CPU ", 4))
+		cpu_state_load(s);
+	else if (! memcmp(chunk.id, "MEM ", 4))
+		mem_state_load(s);
+	else if (! memcmp(chunk.id, "PIC ", 4))
+		pic_state_load(s);
+	else if (! memcmp(chunk.id, "PIT ", 4))
+		pit_state_load(s);
+	else if (! memcmp(chunk.id, "DMA ", 4))
+		dma_state_load(s);
+	else if (! memcmp(chunk.id, "PCI ", 4))
+		pci_state_load(s);
+	else if (! memcmp(chunk.id, "DEV ", 4))
+		device_load(s, chunk.inst);
+	else if (! memcmp(chunk.id, "RAM ", 4))
+		snapshot_load_ram(s, fn);
+	else if (! memcmp(chunk.id, "END ", 4))
+		done = 1;
+	else
+		snapshot_log("SNAPSHOT: skipping unknown chunk '%.4s'\n", chunk.id);
+
+	/* On to the next chunk, no matter how much was read. */
+	fseeko64(s->fp, s->chunk_pos + sizeof(chunk) + chunk.size, SEEK_SET);
+    }
+
+    (void)fclose(s->fp);
+
+    if (s->error || !done) {
+	snapshot_log("SNAPSHOT: error reading '%ls'\n", fn);
+	return(0);
+    }
+
+    /* The RAM contents changed under our feet. */
+    flushmmucache();
+    mmu_tlb_flush(1);
+    x386_pdc_flush();
+#ifdef USE_DYNAREC
+    codegen_reset();
+#else
+    mem_reset_page_blocks();
+#endif
+
+    snapshot_log("SNAPSHOT: restored from '%ls'\n", fn);
+
+    return(1);
+}
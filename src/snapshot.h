@@ -0,0 +1,67 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Definitions for the machine state snapshot module.
+ *
+ * Version:	@(#)snapshot.h	1.0.0	2026/10/18
+ *
+ * Author:	agent, <agent@local>
+ *
+ *		Copyright 2026 agent.
+ */
+#ifndef EMU_SNAPSHOT_H
+# define EMU_SNAPSHOT_H
+
+
+#define SNAPSHOT_VERSION	1		/* current format version */
+
+
+typedef struct _snapshot_ snapshot_t;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int	snapshot_save(wchar_t *fn);
+extern int	snapshot_load(wchar_t *fn);
+
+/* For use by the save and load handlers. */
+extern int	snapshot_version(snapshot_t *s);
+extern void	snapshot_chunk_begin(snapshot_t *s, const char *id, uint32_t inst);
+extern void	snapshot_chunk_end(snapshot_t *s);
+extern void	snapshot_write(snapshot_t *s, const void *p, uint32_t len);
+extern void	snapshot_read(snapshot_t *s, void *p, uint32_t len);
+
+#define snapshot_write_var(s, v)	snapshot_write((s), &(v), sizeof(v))
+#define snapshot_read_var(s, v)		snapshot_read((s), &(v), sizeof(v))
+
+/* The core modules. */
+extern void	timer_state_save(snapshot_t *s);
+extern void	timer_state_load(snapshot_t *s);
+extern void	cpu_state_save(snapshot_t *s);
+extern void	cpu_state_load(snapshot_t *s);
+extern void	mem_state_save(snapshot_t *s);
+extern void	mem_state_load(snapshot_t *s);
+extern void	pic_state_save(snapshot_t *s);
+extern void	pic_state_load(snapshot_t *s);
+extern void	pit_state_save(snapshot_t *s);
+extern void	pit_state_load(snapshot_t *s);
+extern void	dma_state_save(snapshot_t *s);
+extern void	dma_state_load(snapshot_t *s);
+extern void	pci_state_save(snapshot_t *s);
+extern void	pci_state_load(snapshot_t *s);
+extern void	device_save_all(snapshot_t *s);
+extern void	device_load(snapshot_t *s, int inst);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif	/*EMU_SNAPSHOT_H*/
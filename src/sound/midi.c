@@ -226,7 +226,8 @@ midi_write(uint8_t val)
     if (midi->m_device->write && midi->m_device->write(val))
 	return;
 
-    if (midi->midi_sysex_start) {
+    /* Pace SysEx for real MT-32s, unless we are not real-time anyway. */
+    if (midi->midi_sysex_start && !turbo_mode) {
 	passed_ticks = plat_get_ticks() - midi->midi_sysex_start;
 	if (passed_ticks < midi->midi_sysex_delay)
 		plat_delay_ms(midi->midi_sysex_delay - passed_ticks);
@@ -74,7 +74,8 @@ static int32_t *outbuffer;
 static float *outbuffer_ex;
 static int16_t *outbuffer_ex_int16;
 static int sound_handlers_num;
-static int64_t sound_poll_time = 0LL, sound_poll_latch;
+static pc_timer_t sound_poll_timer;
+static int64_t sound_poll_latch;
 
 static int16_t cd_buffer[CDROM_NUM][CD_BUFLEN * 2];
 static float cd_out_buffer[CD_BUFLEN * 2];
@@ -293,6 +294,9 @@ sound_cd_thread(void *param)
 		}
 	}
 
+	if (turbo_mode)
+		continue;
+
 	if (sound_is_float)
 		givealbuffer_cd(cd_out_buffer);
 	else
@@ -364,7 +368,7 @@ sound_add_handler(void (*get_buffer)(int32_t *buffer, int len, void *p), void *p
 void
 sound_poll(void *priv)
 {
-    sound_poll_time += sound_poll_latch;
+    timer_event_advance(&sound_poll_timer, sound_poll_latch);
 
     midi_poll();
 
@@ -390,10 +394,17 @@ sound_poll(void *priv)
 		}
 	}
 
-	if (sound_is_float)
-		givealbuffer(outbuffer_ex);
-	else
-		givealbuffer(outbuffer_ex_int16);
+	/*
+	 * In turbo mode the cards run faster than the host plays,
+	 * so the buffers are still generated (to keep the cards in
+	 * step with emulated time) but not sent to the host.
+	 */
+	if (! turbo_mode) {
+		if (sound_is_float)
+			givealbuffer(outbuffer_ex);
+		else
+			givealbuffer(outbuffer_ex_int16);
+	}
 
 	if (cd_thread_enable) {
                 cd_buf_update--;
@@ -423,7 +434,8 @@ sound_reset(void)
     midi_device_init();
     inital();
 
-    timer_add(sound_poll, &sound_poll_time, TIMER_ALWAYS_ENABLED, NULL);
+    timer_event_init(&sound_poll_timer, sound_poll, NULL);
+    timer_event_set(&sound_poll_timer, 0LL);
 
     sound_handlers_num = 0;
 
@@ -1,14 +1,20 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 #include "86box.h"
 #include "timer.h"
+#include "snapshot.h"
 
 
 #define TIMERS_MAX 64
 
 
+/*timer_add() timers. Devices still read and write *count and *enable
+  directly, so the counts are kept up to date on every timer_process(), but
+  expiry goes through a heap event per timer, re-armed whenever the count or
+  enable is seen to have changed since the last sync.*/
 static struct
 {
 	int64_t present;
@@ -16,9 +22,29 @@ static struct
 	void *priv;
 	int64_t *enable;
 	int64_t *count;
+
+	pc_timer_t event;
+	int64_t last_enable, last_count;	/*As of the last sync*/
 } timers[TIMERS_MAX];
 
 
+/*Pending events, kept as a binary min-heap ordered on expiry time. It
+  grows as needed, so arming an event never fails.*/
+static pc_timer_t **timer_heap = NULL;
+static int timer_heap_num = 0, timer_heap_size = 0;
+
+/*Set by timer_process() once it has synced the timer_add() timers after
+  its callbacks, so the timer_update_outstanding() that follows can skip
+  doing it again.*/
+static int timer_synced = 0;
+
+/*Set when every timer_add() timer must be re-armed from its count.*/
+static int timer_resync = 0;
+
+/*Emulated time at the last call to timer_process().*/
+static int64_t timer_time = 0;
+
+
 int64_t TIMER_USEC;
 int64_t timers_present = 0;
 int64_t timer_one = 1;
@@ -27,69 +53,195 @@ int64_t timer_count = 0, timer_latch = 0;
 int64_t timer_start = 0;
 
 
+static void
+timer_heap_place(pc_timer_t *timer, int idx)
+{
+        timer_heap[idx] = timer;
+        timer->idx = idx;
+}
+
+
+static void
+timer_heap_up(int idx)
+{
+        pc_timer_t *timer = timer_heap[idx];
+
+        while (idx > 0)
+        {
+                int parent = (idx - 1) >> 1;
+
+                if (timer_heap[parent]->ts <= timer->ts)
+                        break;
+                timer_heap_place(timer_heap[parent], idx);
+                idx = parent;
+        }
+        timer_heap_place(timer, idx);
+}
+
+
+static void
+timer_heap_down(int idx)
+{
+        pc_timer_t *timer = timer_heap[idx];
+
+        while (1)
+        {
+                int child = (idx << 1) + 1;
+
+                if (child >= timer_heap_num)
+                        break;
+                if ((child + 1) < timer_heap_num && timer_heap[child + 1]->ts < timer_heap[child]->ts)
+                        child++;
+                if (timer->ts <= timer_heap[child]->ts)
+                        break;
+                timer_heap_place(timer_heap[child], idx);
+                idx = child;
+        }
+        timer_heap_place(timer, idx);
+}
+
+
+static void
+timer_heap_remove(pc_timer_t *timer)
+{
+        int idx = timer->idx;
+
+        timer->idx = -1;
+        timer_heap_num--;
+        if (idx == timer_heap_num)
+                return;
+
+        timer_heap_place(timer_heap[timer_heap_num], idx);
+        if (idx > 0 && timer_heap[idx]->ts < timer_heap[(idx - 1) >> 1]->ts)
+                timer_heap_up(idx);
+        else
+                timer_heap_down(idx);
+}
+
+
+static void
+timer_heap_insert(pc_timer_t *timer)
+{
+        if (timer_event_enabled(timer))
+        {
+                /*Already pending - just restore heap order around the new expiry time.*/
+                timer_heap_remove(timer);
+        }
+
+        if (timer_heap_num >= timer_heap_size)
+        {
+                timer_heap_size = timer_heap_size ? (timer_heap_size << 1) : 64;
+                timer_heap = realloc(timer_heap, timer_heap_size * sizeof(pc_timer_t *));
+                if (timer_heap == NULL)
+                        fatal("timer: out of memory for %i events\n", timer_heap_size);
+        }
+
+        timer_heap[timer_heap_num] = timer;
+        timer_heap_up(timer_heap_num++);
+}
+
+
+/*Re-arm timer_add() timer c if the device changed its count or enable
+  since the last sync. Counts are relative to timer_time.*/
+static void
+timer_legacy_sync(int c, int force)
+{
+        int64_t enable, count;
+
+	/* This is needed to avoid timer crashes on hard reset. */
+        if ((timers[c].enable == NULL) || (timers[c].count == NULL))
+                return;
+
+        enable = *timers[c].enable;
+        count = *timers[c].count;
+        if (!force && (enable == timers[c].last_enable) && (count == timers[c].last_count))
+                return;
+
+        timers[c].last_enable = enable;
+        timers[c].last_count = count;
+        if (enable)
+        {
+                timers[c].event.ts = timer_time + count;
+                timer_heap_insert(&timers[c].event);
+        }
+        else
+                timer_event_disable(&timers[c].event);
+}
+
+
+static void
+timer_legacy_sync_all(void)
+{
+        int c;
+
+        for (c = 0; c < timers_present; c++)
+                timer_legacy_sync(c, timer_resync);
+        timer_resync = 0;
+}
+
+
+static void
+timer_legacy_callback(void *priv)
+{
+        int c = (int)((intptr_t)priv);
+
+        timers[c].callback(timers[c].priv);
+
+        /*The event has left the heap; put it back even if the callback
+          left the count alone.*/
+        if (c < timers_present)
+                timer_legacy_sync(c, 1);
+}
+
+
 void timer_process(void)
 {
 	int64_t c;
-	int64_t process = 0;
 	/*Get actual elapsed time*/
 	int64_t diff = timer_latch - timer_count;
-	int64_t enable[TIMERS_MAX];
-
-	timer_latch = 0;
+	pc_timer_t *event;
 
+        /*Pick up changes made since the last sync while the counts are
+          still relative to the old time, then count them down.*/
         for (c = 0; c < timers_present; c++)
         {
-		/* This is needed to avoid timer crashes on hard reset. */
-		if ((timers[c].enable == NULL) || (timers[c].count == NULL))
-		{
-			continue;
-		}
-                enable[c] = *timers[c].enable;
-                if (*timers[c].enable)
+                timer_legacy_sync(c, timer_resync);
+                if ((timers[c].enable != NULL) && (timers[c].count != NULL) && *timers[c].enable)
                 {
-                        *timers[c].count = *timers[c].count - diff;
-                        if (*timers[c].count <= 0)
-                                process = 1;
+                        *timers[c].count -= diff;
+                        timers[c].last_count = *timers[c].count;
                 }
         }
-        
-        if (!process)
-                return;
+        timer_resync = 0;
 
-        while (1)
+	timer_time += diff;
+	timer_latch = timer_count = 0;
+
+        while (timer_heap_num && timer_heap[0]->ts <= timer_time)
         {
-                int64_t lowest = 1, lowest_c;
-                
-                for (c = 0; c < timers_present; c++)
+                while (timer_heap_num && timer_heap[0]->ts <= timer_time)
                 {
-                        if (enable[c])
-                        {
-                                if (*timers[c].count < lowest)
-                                {
-                                        lowest = *timers[c].count;
-                                        lowest_c = c;
-                                }
-                        }
+                        event = timer_heap[0];
+                        timer_heap_remove(event);
+                        event->callback(event->priv);
                 }
-                
-                if (lowest > 0)
-                        break;
 
-                timers[lowest_c].callback(timers[lowest_c].priv);
-                enable[lowest_c] = *timers[lowest_c].enable;
-        }              
+                /*Callbacks may have changed other devices' timers too.*/
+                timer_legacy_sync_all();
+        }
+        timer_synced = 1;
 }
 
 
 void timer_update_outstanding(void)
 {
-	int64_t c;
+	if (!timer_synced)
+		timer_legacy_sync_all();
+	timer_synced = 0;
+
 	timer_latch = 0x7fffffffffffffff;
-	for (c = 0; c < timers_present; c++)
-	{
-		if (*timers[c].enable && *timers[c].count < timer_latch)
-			timer_latch = *timers[c].count;
-	}
+	if (timer_heap_num)
+		timer_latch = timer_heap[0]->ts - timer_time;
 	timer_count = timer_latch = (timer_latch + ((1 << TIMER_SHIFT) - 1));
 }
 
@@ -98,6 +250,13 @@ void timer_reset(void)
 {
 	timers_present = 0;
 	timer_latch = timer_count = 0;
+
+	/* Events may belong to devices that have already been freed, so
+	   only drop the heap itself; timer_event_enabled() validates the
+	   slot index before trusting it. */
+	timer_heap_num = 0;
+	timer_time = 0;
+	timer_synced = 0;
 }
 
 
@@ -124,6 +283,8 @@ int64_t timer_add(void (*callback)(void *priv), int64_t *count, int64_t *enable,
 		timers[timers_present].priv = priv;
 		timers[timers_present].count = count;
 		timers[timers_present].enable = enable;
+		timer_event_init(&timers[timers_present].event, timer_legacy_callback, (void *)((intptr_t)timers_present));
+		timer_legacy_sync(timers_present, 1);
 		timers_present++;
 		return timers_present - 1;
 	}
@@ -135,3 +296,112 @@ void timer_set_callback(int64_t timer, void (*callback)(void *priv))
 {
 	timers[timer].callback = callback;
 }
+
+
+int64_t timer_get_time(void)
+{
+	/*timer_latch - timer_count is the time elapsed since the last
+	  timer_process()/timer_update_outstanding() pair.*/
+	return timer_time + (timer_latch - timer_count);
+}
+
+
+/*If an event was scheduled ahead of the next outstanding expiry, pull
+  timer_count in so the CPU loop comes back to timer_process() on time.*/
+static void timer_event_update_latch(pc_timer_t *timer)
+{
+	int64_t remaining = timer->ts - timer_get_time();
+
+	if (timer_event_enabled(timer) && remaining < timer_count)
+	{
+		timer_latch -= (timer_count - remaining);
+		timer_count = remaining;
+	}
+}
+
+
+void timer_event_init(pc_timer_t *timer, void (*callback)(void *priv), void *priv)
+{
+	if (timer_event_enabled(timer))
+		timer_heap_remove(timer);
+
+	memset(timer, 0, sizeof(pc_timer_t));
+	timer->callback = callback;
+	timer->priv = priv;
+	timer->idx = -1;
+}
+
+
+int timer_event_enabled(pc_timer_t *timer)
+{
+	return (timer->idx >= 0) && (timer->idx < timer_heap_num) &&
+	       (timer_heap[timer->idx] == timer);
+}
+
+
+void timer_event_set(pc_timer_t *timer, int64_t delay)
+{
+	timer->ts = timer_get_time() + delay;
+	timer_heap_insert(timer);
+	timer_event_update_latch(timer);
+}
+
+
+void timer_event_advance(pc_timer_t *timer, int64_t delay)
+{
+	timer->ts += delay;
+	timer_heap_insert(timer);
+	timer_event_update_latch(timer);
+}
+
+
+void timer_event_disable(pc_timer_t *timer)
+{
+	if (timer_event_enabled(timer))
+		timer_heap_remove(timer);
+	else
+		timer->idx = -1;
+}
+
+
+int64_t timer_event_remaining(pc_timer_t *timer)
+{
+	if (!timer_event_enabled(timer))
+		return 0;
+
+	return timer->ts - timer_get_time();
+}
+
+
+void timer_state_save(snapshot_t *s)
+{
+	snapshot_write_var(s, timer_time);
+	snapshot_write_var(s, timer_count);
+	snapshot_write_var(s, timer_latch);
+	snapshot_write_var(s, timer_start);
+}
+
+
+/*The legacy timers keep their counts relative to the last timer_process(),
+  so restoring those (in the devices) is enough for them. Pending events
+  hold absolute times from before the restore, so move them along with the
+  clock; devices that saved their own events re-arm them afterwards.*/
+void timer_state_load(snapshot_t *s)
+{
+	int64_t old_time = timer_get_time();
+	int64_t new_time;
+	int c;
+
+	snapshot_read_var(s, timer_time);
+	snapshot_read_var(s, timer_count);
+	snapshot_read_var(s, timer_latch);
+	snapshot_read_var(s, timer_start);
+
+	new_time = timer_get_time();
+	for (c = 0; c < timer_heap_num; c++)
+		timer_heap[c]->ts += (new_time - old_time);
+
+	/*The devices restore their timer_add() counts themselves.*/
+	timer_resync = 1;
+	timer_synced = 0;
+}
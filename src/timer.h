@@ -4,6 +4,19 @@
 
 extern int64_t timer_start;
 
+
+/*Scheduled event, kept in a min-heap ordered on absolute expiry time and
+  (re)armed through the timer_event_*() calls below. timer_add() timers are
+  wrapped in one of these each, re-armed from their count/enable pointers
+  whenever those change.*/
+typedef struct pc_timer_t
+{
+	int64_t ts;			/*Absolute expiry time, in TIMER_SHIFT units*/
+	int idx;			/*Slot in the event heap, -1 if not pending*/
+	void (*callback)(void *priv);
+	void *priv;
+} pc_timer_t;
+
 #define timer_start_period(cycles)                      \
         timer_start = cycles;
 
@@ -45,6 +58,16 @@ extern void timer_reset(void);
 extern int64_t timer_add(void (*callback)(void *priv), int64_t *count, int64_t *enable, void *priv);
 extern void timer_set_callback(int64_t timer, void (*callback)(void *priv));
 
+extern int64_t timer_get_time(void);
+extern void timer_event_init(pc_timer_t *timer, void (*callback)(void *priv), void *priv);
+extern int timer_event_enabled(pc_timer_t *timer);
+/*Expire delay units from now.*/
+extern void timer_event_set(pc_timer_t *timer, int64_t delay);
+/*Expire delay units after the previous expiry time, for drift-free periodic events.*/
+extern void timer_event_advance(pc_timer_t *timer, int64_t delay);
+extern void timer_event_disable(pc_timer_t *timer);
+extern int64_t timer_event_remaining(pc_timer_t *timer);
+
 #define TIMER_ALWAYS_ENABLED &timer_one
 
 extern int64_t timer_count;
@@ -0,0 +1,92 @@
+#!/bin/sh
+#
+# 86Box		A hypervisor and IBM PC system emulator that specializes in
+#		running old operating systems and software designed for IBM
+#		PC systems and compatibles from 1981 through fairly recent
+#		system designs based on the PCI bus.
+#
+#		This file is part of the 86Box distribution.
+#
+#		KVM boot time benchmark.
+#
+#		Boots the same machine headless for a fixed number of
+#		frames, once on the regular CPU core and once with --kvm,
+#		and prints the wall time of each, the best of a few runs.
+#		Run from the src/ directory as
+#
+#		  make -f unix/Makefile.linux kvmbench BENCHCFG=path/86box.cfg
+#
+#		or directly as
+#
+#		  sh unix/bench_kvm.sh [-f frames] [-r runs] 86Box path/86box.cfg
+#
+#		The config must not set cpu_use_kvm, or both runs would
+#		use KVM. Under KVM, guest time is charged from host time,
+#		so a guest that never halts takes about 10 ms per frame
+#		however fast it runs; pick a frame count that covers the
+#		boot on the slower of the two.
+#
+# Version:	@(#)bench_kvm.sh	1.0.0	2026/10/18
+#
+# Author:	agent, <agent@local>
+#
+#		Copyright 2026 agent.
+#
+
+frames=1000
+runs=3
+
+while getopts f:r: opt; do
+	case $opt in
+	f)	frames=$OPTARG ;;
+	r)	runs=$OPTARG ;;
+	*)	exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -ne 2 ]; then
+	echo "Usage: $0 [-f frames] [-r runs] 86Box cfg-file" >&2
+	exit 1
+fi
+prog=$1
+cfg=$2
+
+if [ ! -x "$prog" ] || [ ! -f "$cfg" ]; then
+	echo "$0: need an 86Box binary and a config file" >&2
+	exit 1
+fi
+if grep -q '^[[:space:]]*cpu_use_kvm[[:space:]]*=[[:space:]]*[1-9]' "$cfg"; then
+	echo "$0: $cfg sets cpu_use_kvm, remove it first" >&2
+	exit 1
+fi
+
+# Print the best wall time of $runs boots; $1 is the label, the rest options.
+bench()
+{
+	label=$1
+	shift
+
+	best=
+	kvm=no
+	i=0
+	while [ $i -lt $runs ]; do
+		out=$("$prog" --headless --frames $frames "$@" "$cfg" 2>&1)
+		t=$(echo "$out" | sed -n 's/^[0-9]* frames in \([0-9.]*\) seconds.*/\1/p')
+		if [ -z "$t" ]; then
+			echo "$label: no timing line, did the machine start?" >&2
+			return 1
+		fi
+		echo "$out" | grep -q '^CPU ran under KVM' && kvm=yes
+		if [ -z "$best" ] || [ $(echo "$t < $best" | awk '{ print ($1 < $3) }') -eq 1 ]; then
+			best=$t
+		fi
+		i=$((i + 1))
+	done
+
+	printf "%-14s %6d frames in %8.3f seconds (best of %d, KVM %s)\n" \
+	       "$label:" $frames $best $runs $kvm
+}
+
+bench "regular core"
+bench "KVM" --kvm
@@ -0,0 +1,187 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		SVGA scanline renderer microbenchmark.
+ *
+ *		Runs each packed pixel renderer over whole frames of
+ *		random VRAM at the common resolutions and reports the
+ *		host time per line and per frame, taking the best of a
+ *		few runs to ride out scheduling noise. Built by
+ *		'make -f unix/Makefile.linux bench'.
+ *
+ * Version:	@(#)bench_render.c	1.0.0	2026/10/18
+ *
+ * Author:	agent, <agent@local>
+ *
+ *		Copyright 2026 agent.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+#include "../86box.h"
+#include "../mem.h"
+#include "../timer.h"
+#include "../video/video.h"
+#include "../video/vid_svga.h"
+#include "../video/vid_svga_render.h"
+
+
+#define VRAM_SIZE	(8 << 20)
+#define FRAMES		20
+#define RUNS		5
+
+
+typedef struct {
+    const char	*name;
+    void	(*render)(svga_t *svga);
+    int		bytes;
+} bench_renderer_t;
+
+typedef struct {
+    int		w, h;
+} bench_mode_t;
+
+
+static const bench_renderer_t renderers[] = {
+    { "8bpp_lowres",	   svga_render_8bpp_lowres,	  1 },
+    { "8bpp_highres",	   svga_render_8bpp_highres,	  1 },
+    { "15bpp_lowres",	   svga_render_15bpp_lowres,	  2 },
+    { "15bpp_highres",	   svga_render_15bpp_highres,	  2 },
+    { "16bpp_lowres",	   svga_render_16bpp_lowres,	  2 },
+    { "16bpp_highres",	   svga_render_16bpp_highres,	  2 },
+    { "24bpp_lowres",	   svga_render_24bpp_lowres,	  3 },
+    { "24bpp_highres",	   svga_render_24bpp_highres,	  3 },
+    { "32bpp_lowres",	   svga_render_32bpp_lowres,	  4 },
+    { "32bpp_highres",	   svga_render_32bpp_highres,	  4 },
+    { "ABGR8888_highres",  svga_render_ABGR8888_highres,  4 },
+    { "RGBA8888_highres",  svga_render_RGBA8888_highres,  4 },
+    { NULL }
+};
+
+static const bench_mode_t modes[] = {
+    {  640,  480 },
+    {  800,  600 },
+    { 1024,  768 },
+    { 1280, 1024 },
+    { 1600, 1200 },
+    { 0 }
+};
+
+
+/* vid_svga_render.c only needs these from the rest of the emulator. */
+bitmap_t	*buffer32;
+uint8_t		edatlookup[4][4];
+int		enable_overscan, overscan_y;
+dbcs_font_t	*fontdatksc5601, *fontdatksc5601_user;
+uint32_t	*video_15to32, *video_16to32;
+
+
+static double
+bench_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return(ts.tv_sec + (ts.tv_nsec / 1000000000.0));
+}
+
+
+/* The same tables video.c builds. */
+static void
+bench_tables(void)
+{
+    int c, r, g, b;
+
+    video_15to32 = malloc(sizeof(uint32_t) * 65536);
+    video_16to32 = malloc(sizeof(uint32_t) * 65536);
+
+    for (c = 0; c < 65536; c++) {
+	b = c & 31;
+	g = (c >> 5) & 31;
+	r = (c >> 10) & 31;
+	video_15to32[c] = ((b * 255) / 31) | (((g * 255) / 31) << 8) | (((r * 255) / 31) << 16);
+
+	g = (c >> 5) & 63;
+	r = (c >> 11) & 31;
+	video_16to32[c] = ((b * 255) / 31) | (((g * 255) / 63) << 8) | (((r * 255) / 31) << 16);
+    }
+}
+
+
+static void
+bench_run(svga_t *svga, const bench_renderer_t *rend, const bench_mode_t *mode)
+{
+    double start, t, elapsed = 0.0;
+    uint32_t pitch = (mode->w * rend->bytes + 7) & ~7;
+    int run, frame, line;
+
+    svga->render = rend->render;
+    svga->hdisp = mode->w;
+
+    for (run = 0; run < RUNS; run++) {
+	start = bench_time();
+	for (frame = 0; frame < FRAMES; frame++) {
+		for (line = 0; line < mode->h; line++) {
+			svga->ma = line * pitch;
+			svga->displine = line;
+			svga->render(svga);
+		}
+	}
+	t = bench_time() - start;
+	if (!run || (t < elapsed))
+		elapsed = t;
+    }
+
+    printf("%-18s %4ix%-4i %7.1f ns/line %8.1f us/frame\n",
+	   rend->name, mode->w, mode->h,
+	   (elapsed * 1000000000.0) / (FRAMES * mode->h),
+	   (elapsed * 1000000.0) / FRAMES);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    static svga_t svga;
+    const bench_renderer_t *rend;
+    const bench_mode_t *mode;
+    int c;
+
+    bench_tables();
+
+    /* Room for a 1600 wide line doubled, plus the left border. */
+    buffer32 = malloc(sizeof(bitmap_t));
+    buffer32->w = 4096;
+    buffer32->h = 2048;
+    buffer32->dat = malloc(buffer32->w * buffer32->h * 4);
+    for (c = 0; c < buffer32->h; c++)
+	buffer32->line[c] = &buffer32->dat[c * buffer32->w * 4];
+
+    svga.vram = malloc(VRAM_SIZE);
+    svga.changedvram = calloc(VRAM_SIZE >> 12, 1);
+    svga.vram_max = VRAM_SIZE;
+    svga.vram_display_mask = svga.vram_mask = VRAM_SIZE - 1;
+    svga.fullchange = 1;
+
+    srand(1);
+    for (c = 0; c < VRAM_SIZE; c++)
+	svga.vram[c] = rand();
+    for (c = 0; c < 256; c++)
+	svga.pallook[c] = rand() & 0xffffff;
+
+    for (rend = renderers; rend->name; rend++) {
+	for (mode = modes; mode->w; mode++)
+		bench_run(&svga, rend, mode);
+    }
+
+    return(0);
+}
@@ -0,0 +1,179 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Timer scheduler microbenchmark.
+ *
+ *		Drives timer.c the way the CPU loop does, with a mix of
+ *		timer_add() timers and heap events on different periods,
+ *		and reports the host time per event fired. Built by
+ *		'make -f unix/Makefile.linux bench'.
+ *
+ * Version:	@(#)bench_timer.c	1.0.0	2026/10/18
+ *
+ * Author:	agent, <agent@local>
+ *
+ *		Copyright 2026 agent.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+#include "../86box.h"
+#include "../timer.h"
+#include "../snapshot.h"
+
+
+#define LEGACY_MAX	64
+#define EVENTS_MAX	256
+#define FIRE_COUNT	4000000
+
+
+typedef struct {
+    int64_t	count, enable, period;
+} legacy_t;
+
+typedef struct {
+    pc_timer_t	timer;
+    int64_t	period;
+} event_t;
+
+
+static legacy_t	legacy[LEGACY_MAX];
+static event_t	events[EVENTS_MAX];
+static uint64_t	fired;
+
+
+/* timer.c only needs these from the rest of the emulator. */
+void
+fatal(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    exit(1);
+}
+
+
+void
+snapshot_write(snapshot_t *s, const void *p, uint32_t len)
+{
+}
+
+
+void
+snapshot_read(snapshot_t *s, void *p, uint32_t len)
+{
+}
+
+
+static void
+legacy_callback(void *priv)
+{
+    legacy_t *l = (legacy_t *)priv;
+
+    l->count += l->period;
+    fired++;
+}
+
+
+static void
+event_callback(void *priv)
+{
+    event_t *e = (event_t *)priv;
+
+    timer_event_advance(&e->timer, e->period);
+    fired++;
+}
+
+
+static double
+bench_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return(ts.tv_sec + (ts.tv_nsec / 1000000000.0));
+}
+
+
+/* Periods spread between about 1us and 1ms, like PIT, sound and video. */
+static int64_t
+bench_period(int c)
+{
+    static const int64_t periods[] = { 3, 7, 20, 61, 150, 400, 977, 15 };
+
+    return((periods[c & 7] + c) * TIMER_USEC);
+}
+
+
+static void
+bench_run(const char *name, int nr_legacy, int nr_events)
+{
+    uint64_t ticks = 0;
+    uint32_t seed = 1;
+    double start, elapsed;
+    int c;
+
+    timer_reset();
+    fired = 0;
+
+    for (c = 0; c < nr_legacy; c++) {
+	legacy[c].period = bench_period(c);
+	legacy[c].count = legacy[c].period;
+	legacy[c].enable = 1;
+	timer_add(legacy_callback, &legacy[c].count, &legacy[c].enable, &legacy[c]);
+    }
+    for (c = 0; c < nr_events; c++) {
+	events[c].period = bench_period(c + 3);
+	timer_event_init(&events[c].timer, event_callback, &events[c]);
+	timer_event_set(&events[c].timer, events[c].period);
+    }
+    timer_update_outstanding();
+
+    start = bench_time();
+    while (fired < FIRE_COUNT) {
+	/* Instructions of 1 to 32 cycles, as timer_end_period() sees them. */
+	seed = (seed * 1103515245) + 12345;
+	timer_count -= (((seed >> 16) & 31) + 1) << TIMER_SHIFT;
+	if (timer_count <= 0) {
+		timer_process();
+		timer_update_outstanding();
+		ticks++;
+	}
+    }
+    elapsed = bench_time() - start;
+
+    printf("%-26s %3i timers %3i events: %7.1f ns/event, %7.1f ns/expiry\n",
+	   name, nr_legacy, nr_events,
+	   (elapsed * 1000000000.0) / fired, (elapsed * 1000000000.0) / ticks);
+
+    for (c = 0; c < nr_events; c++)
+	timer_event_disable(&events[c].timer);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    TIMER_USEC = 1ULL << TIMER_SHIFT;
+
+    bench_run("timer_add() only", 16, 0);
+    bench_run("timer_add() only, full", LEGACY_MAX, 0);
+    bench_run("events only", 0, 64);
+    bench_run("events only, many", 0, EVENTS_MAX);
+    bench_run("mixed", 16, 48);
+    bench_run("mixed, full", LEGACY_MAX, EVENTS_MAX);
+
+    return(0);
+}
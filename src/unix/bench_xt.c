@@ -0,0 +1,285 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		8088 interpreter microbenchmark.
+ *
+ *		Runs a small integer and string loop on the 808x core at
+ *		4.77 MHz, once out of RAM and once out of the BIOS ROM,
+ *		with the real memory mappings and timer but no devices,
+ *		and reports the host time per emulated cycle and per
+ *		instruction, taking the best of a few runs to ride out
+ *		scheduling noise. Built by 'make -f unix/Makefile.linux
+ *		bench'.
+ *
+ * Version:	@(#)bench_xt.c	1.0.0	2026/10/18
+ *
+ * Author:	agent, <agent@local>
+ *
+ *		Copyright 2026 agent.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+#include "../86box.h"
+#include "../cpu/cpu.h"
+#include "../cpu/x86.h"
+#include "../machine/machine.h"
+#include "../io.h"
+#include "../mem.h"
+#include "../rom.h"
+#include "../nmi.h"
+#include "../pic.h"
+#include "../timer.h"
+#include "../plat.h"
+#include "../snapshot.h"
+
+
+#define XT_CLOCK	4772728
+#define SECONDS		4
+#define RUNS		5
+#define PROG_RAM	0x1000		/* 0000:1000 */
+#define PROG_ROM	0xe000		/* F000:E000 */
+#define RESET_VEC	0xfff0		/* FFFF:0000 in the ROM */
+
+
+/*
+ * The workload: a word copy/add/shift/divide loop over a 256 word
+ * table, a REP MOVSW of the result and a near call doing a push,
+ * multiply and pop, forever. Position independent.
+ */
+static const uint8_t prog[] = {
+    0xb9, 0x00, 0x01,		/* start: mov cx,0100h */
+    0xbe, 0x00, 0x00,		/*	  mov si,0 */
+    0xbf, 0x00, 0x10,		/*	  mov di,1000h */
+    0x8b, 0x04,			/* loop:  mov ax,[si] */
+    0x03, 0xc3,			/*	  add ax,bx */
+    0x89, 0x05,			/*	  mov [di],ax */
+    0xd1, 0xe0,			/*	  shl ax,1 */
+    0x33, 0xd2,			/*	  xor dx,dx */
+    0xf7, 0xf1,			/*	  div cx */
+    0x46, 0x46, 0x47, 0x47,	/*	  inc si; inc si; inc di; inc di */
+    0xe2, 0xee,			/*	  loop loop */
+    0xbe, 0x00, 0x00,		/*	  mov si,0 */
+    0xbf, 0x00, 0x20,		/*	  mov di,2000h */
+    0xb9, 0x80, 0x00,		/*	  mov cx,0080h */
+    0xfc,			/*	  cld */
+    0xf3, 0xa5,			/*	  rep movsw */
+    0xe8, 0x02, 0x00,		/*	  call sub */
+    0xeb, 0xd4,			/*	  jmp start */
+    0x50,			/* sub:	  push ax */
+    0xb0, 0x07,			/*	  mov al,7 */
+    0xf6, 0xe3,			/*	  mul bl */
+    0x58,			/*	  pop ax */
+    0xc3			/*	  ret */
+};
+
+
+extern void	makeznptable(void);
+extern void	makemod1table(void);
+
+static pc_timer_t	tick;
+
+
+/* 808x.c, mem.c and timer.c only need these from the rest of the emulator. */
+int		AT, is386, is486, cpu_16bitbus, cpu_cache_int_enabled;
+int		cpu_cyrix_alignment, cgate32, cpl_override, nmi_enable, nmi_mask;
+int		cpu_prefetch_cycles, cpu_rom_prefetch_cycles,
+		cpu_mem_prefetch_cycles, prefetch_prefixes;
+int		timing_misaligned, dump_on_exit, romset;
+int		inscounts[256];
+uint32_t	mem_size, cr2, cr3, cr4, cpu_cur_status, abrt_error;
+uint16_t	flags, eflags;
+uint32_t	oldds, oldss;
+x86seg		_cs, _ds, _es, _ss, _fs, _gs, gdt, ldt, idt, tr;
+msr_t		msr;
+cr0_t		CR0;
+PIC		pic;
+wchar_t		usr_path[1024];
+#ifdef USE_DYNAREC
+int		codegen_in_recompile;
+uint32_t	recomp_page = -1;
+#endif
+#ifdef USE_KVM
+int		cpu_kvm_active;
+#endif
+
+
+void
+fatal(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    exit(1);
+}
+
+
+void
+loadcs(uint16_t seg)
+{
+    CS = seg;
+    cs = seg << 4;
+}
+
+
+void
+loadseg(uint16_t seg, x86seg *s)
+{
+    s->seg = seg;
+    s->base = seg << 4;
+}
+
+
+uint8_t		inb(uint16_t port)		{ return(0xff); }
+void		outb(uint16_t port, uint8_t val)	{ }
+void		io_sethandler(uint16_t base, int size,
+			uint8_t (*inb)(uint16_t addr, void *priv),
+			uint16_t (*inw)(uint16_t addr, void *priv),
+			uint32_t (*inl)(uint16_t addr, void *priv),
+			void (*outb)(uint16_t addr, uint8_t val, void *priv),
+			void (*outw)(uint16_t addr, uint16_t val, void *priv),
+			void (*outl)(uint16_t addr, uint32_t val, void *priv),
+			void *priv)		{ }
+void		io_removehandler(uint16_t base, int size,
+			uint8_t (*inb)(uint16_t addr, void *priv),
+			uint16_t (*inw)(uint16_t addr, void *priv),
+			uint32_t (*inl)(uint16_t addr, void *priv),
+			void (*outb)(uint16_t addr, uint8_t val, void *priv),
+			void (*outw)(uint16_t addr, uint16_t val, void *priv),
+			void (*outl)(uint16_t addr, uint32_t val, void *priv),
+			void *priv)		{ }
+uint8_t		picinterrupt(void)		{ return(0xff); }
+void		x86gpf(char *s, uint16_t error)	{ }
+void		x86seg_reset(void)		{ }
+void		x87_reset(void)			{ }
+void		x87_dumpregs(void)		{ }
+void		cpu_set_edx(void)		{ }
+void		cpu_update_waitstates(void)	{ }
+void		resetmcr(void)			{ }
+void		x386_pdc_flush(void)		{ }
+void		x386_pdc_invalidate(struct x386_pdc_t *pdc, uint32_t addr, int len) { }
+void		snapshot_write(snapshot_t *s, const void *p, uint32_t len) { }
+void		snapshot_read(snapshot_t *s, void *p, uint32_t len) { }
+int		plat_chdir(wchar_t *path)	{ return(0); }
+#ifdef USE_DYNAREC
+void		codegen_reset(void)		{ }
+void		codegen_flush(void)		{ }
+#endif
+#ifdef USE_KVM
+void		kvm_remap(void)			{ }
+#endif
+
+
+void *
+plat_mmap(size_t size, uint8_t executable)
+{
+    return(calloc(size, 1));
+}
+
+
+void
+plat_munmap(void *ptr, size_t size)
+{
+    free(ptr);
+}
+
+
+static double
+bench_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return(ts.tv_sec + (ts.tv_nsec / 1000000000.0));
+}
+
+
+/* Keeps the timer heap busy the way the PIT would, every millisecond. */
+static void
+tick_callback(void *priv)
+{
+    timer_event_advance(&tick, 1000LL * TIMER_USEC);
+}
+
+
+static void
+bench_run(const char *name, uint16_t seg, uint16_t off)
+{
+    double start, t, elapsed = 0.0;
+    int run, frame, count = 0;
+
+    /* Start the way a real BIOS does, with a far jump at the reset vector. */
+    rom[RESET_VEC] = 0xea;
+    rom[RESET_VEC + 1] = off & 0xff;
+    rom[RESET_VEC + 2] = off >> 8;
+    rom[RESET_VEC + 3] = seg & 0xff;
+    rom[RESET_VEC + 4] = seg >> 8;
+
+    for (run = 0; run < RUNS; run++) {
+	resetx86();
+	loadseg(0x2000, &_ds);
+	loadseg(0x2000, &_es);
+	loadseg(0x3000, &_ss);
+	SP = 0xfffe;
+	BX = 0x1234;
+	cycles = 0;
+
+	start = bench_time();
+	for (frame = 0; frame < (SECONDS * 100); frame++)
+		execx86(XT_CLOCK / 100);
+	t = bench_time() - start;
+	if (!run || (t < elapsed)) {
+		elapsed = t;
+		count = ins;
+	}
+    }
+
+    printf("%-6s %6.2f ns/cycle %7.2f ns/instruction %6.1fx real time\n",
+	   name,
+	   (elapsed * 1000000000.0) / ((double)XT_CLOCK * SECONDS),
+	   (elapsed * 1000000000.0) / count,
+	   SECONDS / elapsed);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    AT = 0;
+    mem_size = 640;
+    xt_cpu_multi = (int)((14318184.0 * (double)(1 << TIMER_SHIFT)) / (double)XT_CLOCK);
+    TIMER_USEC = (int64_t)((14318184.0 / 1000000.0) * (1 << TIMER_SHIFT));
+
+    mem_init();
+    rom = malloc(0x10000);
+    memset(rom, 0xff, 0x10000);
+    biosmask = 0xffff;
+    mem_add_bios();
+
+    memcpy(&ram[PROG_RAM], prog, sizeof(prog));
+    memcpy(&rom[PROG_ROM], prog, sizeof(prog));
+
+    makeznptable();
+    makemod1table();
+
+    timer_reset();
+    timer_event_init(&tick, tick_callback, NULL);
+    timer_event_set(&tick, 1000LL * TIMER_USEC);
+
+    bench_run("RAM", 0x0000, PROG_RAM);
+    bench_run("ROM", 0xf000, PROG_ROM);
+
+    return(0);
+}
@@ -0,0 +1,664 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Platform main support module for headless POSIX hosts.
+ *
+ *		There is no display: the blitter just hands the frame
+ *		buffer back, so the machine can run on a build farm or
+ *		in batch jobs. Use --headless (or --turbo) to also drop
+ *		the real-time pacing, and --frames N to exit after N
+ *		10ms frames.
+ *
+ * Version:	@(#)unix.c	1.0.0	2026/10/18
+ *
+ * Authors:	Sarah Walker, <http://pcem-emulator.co.uk/>
+ *		Miran Grca, <mgrca8@gmail.com>
+ *		Fred N. van Kempen, <decwiz@yahoo.com>
+ *		agent, <agent@local>
+ *
+ *		Copyright 2008-2018 Sarah Walker.
+ *		Copyright 2016-2018 Miran Grca.
+ *		Copyright 2017,2018 Fred N. van Kempen.
+ *		Copyright 2026 agent.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <locale.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include "../86box.h"
+#include "../config.h"
+#include "../cpu/cpu.h"
+#include "../device.h"
+#include "../video/video.h"
+#define GLOBAL
+#include "../plat.h"
+#include "../ui.h"
+
+
+typedef struct {
+    int		id;
+    wchar_t	*str;
+} unix_str_t;
+
+
+/* The few resource strings the platform-independent code asks for. */
+static const unix_str_t	unix_strings[] = {
+    { IDS_STRINGS,	L"86Box"					},
+    { IDS_2049,		L"86Box Error"					},
+    { IDS_2050,		L"86Box Fatal Error"				},
+    { IDS_2056,		L"No usable ROM images found!"			},
+    { IDS_2063,		L"Configured ROM set not available.\nDefaulting to an available ROM set." },
+    { IDS_2064,		L"Configured video BIOS not available.\nDefaulting to an available video BIOS." },
+    { IDS_2077,		L"Click to capture mouse"			},
+    { IDS_2078,		L"Press F8+F12 to release mouse"		},
+    { IDS_2079,		L"Press F8+F12 or middle button to release mouse" },
+    { IDS_2081,		L"Unable to initialize FluidSynth"		},
+    { IDS_2102,		L"PCap failed to set up because it may not be initialized" },
+    { IDS_2103,		L"No PCap devices found"			},
+    { IDS_2104,		L"Invalid PCap device"				},
+    { IDS_4099,		L"MFM/RLL or ESDI CD-ROM drives never existed"	},
+    { IDS_4110,		L"USB is not yet supported"			},
+    { 0,		NULL						}
+};
+
+
+/* Local data. */
+static thread_t	*thMain;
+static mutex_t	*blit_mutex;
+static uint64_t	run_start;
+
+
+#ifdef ENABLE_UNIX_LOG
+int unix_do_log = ENABLE_UNIX_LOG;
+
+
+static void
+unix_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (unix_do_log) {
+	va_start(ap, fmt);
+	pclog_ex(fmt, ap);
+	va_end(ap);
+    }
+}
+#else
+#define unix_log(fmt, ...)
+#endif
+
+
+/* Set (or re-set) the language for the application. */
+void
+set_language(int id)
+{
+}
+
+
+wchar_t *
+plat_get_string(int i)
+{
+    static wchar_t temp[64];
+    const unix_str_t *s;
+
+    for (s = unix_strings; s->str != NULL; s++) {
+	if (s->id == i)
+		return(s->str);
+    }
+
+    swprintf(temp, sizeof_w(temp), L"(string %d)", i);
+
+    return(temp);
+}
+
+
+/* Convert a wide string to the host's multibyte encoding. */
+static char *
+unix_path(wchar_t *path, char *buf, int size)
+{
+    if (wcstombs(buf, path, size) == (size_t)-1)
+	buf[0] = '\0';
+    buf[size - 1] = '\0';
+
+    return(buf);
+}
+
+
+/* Ask the emulator thread to stop, e.g. on SIGINT or SIGTERM. */
+static void
+unix_signal(int sig)
+{
+    quited = 1;
+}
+
+
+/* Nothing to draw on, so hand the buffer straight back. */
+static void
+unix_blit(int x, int y, int y1, int y2, int w, int h)
+{
+    video_blit_complete();
+}
+
+
+/* For the POSIX platform, this is the start of the application. */
+int
+main(int argc, char **argv)
+{
+    wchar_t **argw;
+    uint64_t elapsed;
+    uint32_t old_time, new_time;
+    int i, len;
+#ifdef USE_KVM
+    int kvm_used;
+#endif
+
+    /* We want the host's encoding for filenames. */
+    setlocale(LC_ALL, "");
+
+    /* Set this to the default value (windowed mode). */
+    video_fullscreen = 0;
+
+    /* Set the application version ID string. */
+    sprintf(emu_version, "%s v%s", EMU_NAME, EMU_VERSION);
+
+    /* The common code takes wide-character arguments. */
+    argw = (wchar_t **)malloc(sizeof(wchar_t *) * (argc + 1));
+    for (i = 0; i < argc; i++) {
+	len = strlen(argv[i]) + 1;
+	argw[i] = (wchar_t *)malloc(sizeof(wchar_t) * len);
+	mbstowcs(argw[i], argv[i], len);
+    }
+    argw[argc] = NULL;
+
+    /* Pre-initialize the system, this loads the config file. */
+    if (! pc_init(argc, argw))
+	return(1);
+
+    blit_mutex = thread_create_mutex(L"86Box.BlitMutex");
+
+    /* All good, fire up the actual emulated machine. */
+    if (! pc_init_modules()) {
+	ui_msgbox(MBX_ERROR|MBX_FATAL, (wchar_t *)IDS_2056);
+	return(6);
+    }
+
+    /* Initialize the (null) Video API. */
+    plat_setvid(vid_api);
+
+    /* Fire up the machine. */
+    pc_reset_hard_init();
+
+    plat_pause(0);
+
+    signal(SIGINT, unix_signal);
+    signal(SIGTERM, unix_signal);
+
+    do_start();
+
+    /* Nothing to pump, just drive the one-second housekeeping. */
+    old_time = plat_get_ticks();
+    while (! quited) {
+	plat_delay_ms(10);
+
+	new_time = plat_get_ticks();
+	if ((new_time - old_time) >= 1000) {
+		old_time = new_time;
+		pc_onesec();
+	}
+    }
+
+    elapsed = plat_timer_read() - run_start;
+#ifdef USE_KVM
+    kvm_used = cpu_kvm_active;
+#endif
+
+    do_stop();
+
+    /* Each frame is 10ms of emulated time. */
+    if (turbo_mode && elapsed)
+	printf("%d frames in %.3f seconds, %.0f%% speed\n", framecount_total,
+	       (double)elapsed / (double)timer_freq,
+	       ((double)framecount_total * (double)timer_freq) / (double)elapsed);
+
+    /* ..and clockrate/100 cpu cycles, giving the host cost of one. */
+    if (turbo_mode && framecount_total && clockrate)
+	printf("%.2f ns per emulated cpu cycle\n",
+	       ((double)elapsed * 1.0e9 / (double)timer_freq) /
+	       ((double)framecount_total * (double)(clockrate / 100)));
+
+#ifdef USE_KVM
+    if (kvm_used)
+	printf("CPU ran under KVM\n");
+#endif
+
+    return(0);
+}
+
+
+/*
+ * We do this here since there is platform-specific stuff
+ * going on here, and we do it in a function separate from
+ * main() so we can call it from the UI module as well.
+ */
+void
+do_start(void)
+{
+    /* We have not stopped yet. */
+    quited = 0;
+
+    /* Nanosecond resolution monotonic clock. */
+    timer_freq = 1000000000ULL;
+    unix_log("Main timer precision: %llu\n", timer_freq);
+
+    run_start = plat_timer_read();
+
+    /* Start the emulator, really. */
+    thMain = thread_create(pc_thread, &quited);
+}
+
+
+/* Cleanly stop the emulator. */
+void
+do_stop(void)
+{
+    quited = 1;
+
+    /* Let the main thread finish its current frame. */
+    thread_wait(thMain, -1);
+
+    pc_close(NULL);
+
+    thMain = NULL;
+}
+
+
+void
+plat_get_exe_name(wchar_t *s, int size)
+{
+    char temp[1024];
+    ssize_t len;
+
+    len = readlink("/proc/self/exe", temp, sizeof(temp) - 1);
+    if (len < 0)
+	len = 0;
+    temp[len] = '\0';
+
+    mbstowcs(s, temp, size);
+}
+
+
+void
+plat_tempfile(wchar_t *bufp, wchar_t *prefix, wchar_t *suffix)
+{
+    struct timeval tv;
+    struct tm *info;
+    char temp[1024];
+
+    if (prefix != NULL)
+	sprintf(temp, "%ls-", prefix);
+      else
+	strcpy(temp, "");
+
+    gettimeofday(&tv, NULL);
+    info = localtime(&tv.tv_sec);
+    sprintf(&temp[strlen(temp)], "%d%02d%02d-%02d%02d%02d-%03d%ls",
+	info->tm_year + 1900, info->tm_mon + 1, info->tm_mday,
+	info->tm_hour, info->tm_min, info->tm_sec,
+	(int)(tv.tv_usec / 1000),
+	suffix);
+    mbstowcs(bufp, temp, strlen(temp)+1);
+}
+
+
+int
+plat_getcwd(wchar_t *bufp, int max)
+{
+    char temp[1024];
+
+    if (getcwd(temp, sizeof(temp)) == NULL)
+	strcpy(temp, ".");
+
+    mbstowcs(bufp, temp, max);
+
+    return(0);
+}
+
+
+int
+plat_chdir(wchar_t *path)
+{
+    char temp[1024];
+
+    return(chdir(unix_path(path, temp, sizeof(temp))));
+}
+
+
+FILE *
+plat_fopen(wchar_t *path, wchar_t *mode)
+{
+    char temp[1024], tmode[16];
+
+    return(fopen(unix_path(path, temp, sizeof(temp)),
+		 unix_path(mode, tmode, sizeof(tmode))));
+}
+
+
+void
+plat_remove(wchar_t *path)
+{
+    char temp[1024];
+
+    remove(unix_path(path, temp, sizeof(temp)));
+}
+
+
+/* Replace a file with another one, atomically. */
+int
+plat_rename(wchar_t *from, wchar_t *to)
+{
+    char tfrom[1024], tto[1024];
+
+    return(rename(unix_path(from, tfrom, sizeof(tfrom)),
+		  unix_path(to, tto, sizeof(tto))) == 0);
+}
+
+
+/* Make sure a path ends with a trailing slash. */
+void
+plat_path_slash(wchar_t *path)
+{
+    if ((path[wcslen(path)-1] != L'\\') &&
+	(path[wcslen(path)-1] != L'/')) {
+	wcscat(path, L"/");
+    }
+}
+
+
+/* Check if the given path is absolute or not. */
+int
+plat_path_abs(wchar_t *path)
+{
+    return(path[0] == L'/');
+}
+
+
+wchar_t *
+plat_get_filename(wchar_t *s)
+{
+    int c = wcslen(s) - 1;
+
+    while (c > 0) {
+	if (s[c] == L'/' || s[c] == L'\\')
+	   return(&s[c+1]);
+       c--;
+    }
+
+    return(s);
+}
+
+
+wchar_t *
+plat_get_extension(wchar_t *s)
+{
+    int c = wcslen(s) - 1;
+
+    if (c <= 0)
+	return(s);
+
+    while (c && s[c] != L'.')
+		c--;
+
+    if (!c)
+	return(&s[wcslen(s)]);
+
+    return(&s[c+1]);
+}
+
+
+void
+plat_append_filename(wchar_t *dest, wchar_t *s1, wchar_t *s2)
+{
+    wcscat(dest, s1);
+    wcscat(dest, s2);
+}
+
+
+void
+plat_put_backslash(wchar_t *s)
+{
+    int c = wcslen(s) - 1;
+
+    if (s[c] != L'/' && s[c] != L'\\')
+	   s[c] = L'/';
+}
+
+
+int
+plat_dir_check(wchar_t *path)
+{
+    struct stat st;
+    char temp[1024];
+
+    if (stat(unix_path(path, temp, sizeof(temp)), &st) != 0)
+	return(0);
+
+    return(S_ISDIR(st.st_mode) ? 1 : 0);
+}
+
+
+int
+plat_dir_create(wchar_t *path)
+{
+    char temp[1024];
+
+    return(mkdir(unix_path(path, temp, sizeof(temp)), 0755) == 0);
+}
+
+
+uint64_t
+plat_timer_read(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return(((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec);
+}
+
+
+uint32_t
+plat_get_ticks(void)
+{
+    return((uint32_t)(plat_timer_read() / 1000000ULL));
+}
+
+
+void
+plat_delay_ms(uint32_t count)
+{
+    struct timespec ts;
+
+    ts.tv_sec = count / 1000;
+    ts.tv_nsec = (long)(count % 1000) * 1000000L;
+    while ((nanosleep(&ts, &ts) == -1) && (errno == EINTR))
+	;
+}
+
+
+void *
+plat_mmap(size_t size, uint8_t executable)
+{
+    void *ptr;
+
+    ptr = mmap(NULL, size,
+	       PROT_READ | PROT_WRITE | (executable ? PROT_EXEC : 0),
+	       MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+    return((ptr == MAP_FAILED) ? NULL : ptr);
+}
+
+
+void
+plat_munmap(void *ptr, size_t size)
+{
+    munmap(ptr, size);
+}
+
+
+/*
+ * Map part of a file, copy-on-write, over a block we got from
+ * plat_mmap(). Pages are then only read in when touched, and
+ * writes never go back to the file.
+ */
+int
+plat_mmap_file(void *ptr, size_t size, wchar_t *fn, uint64_t offset)
+{
+    char temp[1024];
+    void *p;
+    int fd;
+
+    if (offset & (sysconf(_SC_PAGESIZE) - 1)) return(0);
+
+    fd = open(unix_path(fn, temp, sizeof(temp)), O_RDONLY);
+    if (fd < 0) return(0);
+
+    p = mmap(ptr, size, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_FIXED, fd, (off_t)offset);
+
+    /* The mapping keeps its own reference to the file. */
+    close(fd);
+
+    return(p == ptr);
+}
+
+
+/* Map a whole disk image, so that it is shared with the file. */
+void *
+plat_mmap_image(FILE *f, uint64_t size, int ro)
+{
+    void *p;
+
+    if ((uint64_t)(size_t)size != size) return(NULL);
+
+    p = mmap(NULL, (size_t)size, PROT_READ | (ro ? 0 : PROT_WRITE),
+	     MAP_SHARED, fileno(f), 0);
+
+    return((p == MAP_FAILED) ? NULL : p);
+}
+
+
+void
+plat_munmap_image(void *ptr, uint64_t size)
+{
+    munmap(ptr, (size_t)size);
+}
+
+
+/* Tell the host we are about to read this part of a mapping. */
+void
+plat_mmap_prefetch(void *ptr, size_t size)
+{
+    uintptr_t mask = sysconf(_SC_PAGESIZE) - 1;
+    uintptr_t start = (uintptr_t)ptr & ~mask;
+
+    madvise((void *)start, size + ((uintptr_t)ptr - start), MADV_WILLNEED);
+}
+
+
+/* Give a page-aligned range of a file back to the host. */
+int
+plat_punch_hole(FILE *f, uint64_t offset, uint64_t size)
+{
+#ifdef FALLOC_FL_PUNCH_HOLE
+    fflush(f);
+
+    return(fallocate(fileno(f), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+		     (off_t)offset, (off_t)size) == 0);
+#else
+    return(0);
+#endif
+}
+
+
+/* There is only the null renderer. */
+int
+plat_vidapi(char *name)
+{
+    return(0);
+}
+
+
+char *
+plat_vidapi_name(int api)
+{
+    return("default");
+}
+
+
+int
+plat_setvid(int api)
+{
+    startblit();
+    video_wait_for_blit();
+
+    video_setblit(unix_blit);
+    vid_api = 0;
+
+    endblit();
+
+    device_force_redraw();
+
+    return(1);
+}
+
+
+void
+plat_vidsize(int x, int y)
+{
+}
+
+
+void
+plat_setfullscreen(int on)
+{
+}
+
+
+void
+take_screenshot(void)
+{
+    pclog("Screenshots are not supported without a display\n");
+}
+
+
+void	/* plat_ */
+startblit(void)
+{
+    thread_wait_mutex(blit_mutex);
+}
+
+
+void	/* plat_ */
+endblit(void)
+{
+    thread_release_mutex(blit_mutex);
+}
@@ -0,0 +1,62 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Null sound output for builds without OpenAL.
+ *
+ *		The sound cards are still fully emulated and mixed by
+ *		the sound core, the finished buffers are just dropped.
+ *
+ * Version:	@(#)unix_snd.c	1.0.0	2026/10/18
+ *
+ * Author:	agent, <agent@local>
+ *
+ *		Copyright 2026 agent.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include "../86box.h"
+#include "../sound/sound.h"
+
+
+void
+al_set_midi(int freq, int buf_size)
+{
+}
+
+
+void
+closeal(void)
+{
+}
+
+
+void
+inital(void)
+{
+}
+
+
+void
+givealbuffer(void *buf)
+{
+}
+
+
+void
+givealbuffer_cd(void *buf)
+{
+}
+
+
+void
+givealbuffer_midi(void *buf, uint32_t size)
+{
+}
@@ -0,0 +1,269 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Implement threads and mutexes for the POSIX platform.
+ *
+ *		Events follow the Win32 auto-reset semantics the rest of
+ *		the emulator was written against: a successful wait
+ *		consumes the signal.
+ *
+ * Version:	@(#)unix_thread.c	1.0.0	2026/10/18
+ *
+ * Author:	agent, <agent@local>
+ *
+ *		Copyright 2026 agent.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wchar.h>
+#include "../86box.h"
+#include "../plat.h"
+
+
+typedef struct {
+    pthread_t	thread;
+    int		joined;
+} pt_thread_t;
+
+typedef struct {
+    pthread_mutex_t	mutex;
+    pthread_cond_t	cond;
+    int			state;
+} pt_event_t;
+
+typedef struct {
+    void	(*func)(void *param);
+    void	*param;
+} pt_start_t;
+
+
+static void *
+thread_start(void *arg)
+{
+    pt_start_t start = *(pt_start_t *)arg;
+
+    free(arg);
+
+    start.func(start.param);
+
+    return(NULL);
+}
+
+
+static void
+thread_unlock(void *arg)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)arg);
+}
+
+
+/* Convert a relative timeout in milliseconds into an absolute deadline. */
+static void
+thread_deadline(struct timespec *ts, int timeout)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+
+    ts->tv_sec += timeout / 1000;
+    ts->tv_nsec += (long)(timeout % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+	ts->tv_sec++;
+	ts->tv_nsec -= 1000000000L;
+    }
+}
+
+
+thread_t *
+thread_create(void (*func)(void *param), void *param)
+{
+    pt_thread_t *pt = malloc(sizeof(pt_thread_t));
+    pt_start_t *start = malloc(sizeof(pt_start_t));
+
+    start->func = func;
+    start->param = param;
+
+    memset(pt, 0x00, sizeof(pt_thread_t));
+    if (pthread_create(&pt->thread, NULL, thread_start, start) != 0) {
+	free(start);
+	free(pt);
+	return(NULL);
+    }
+
+    return((thread_t *)pt);
+}
+
+
+void
+thread_kill(void *arg)
+{
+    pt_thread_t *pt = (pt_thread_t *)arg;
+
+    if (arg == NULL) return;
+
+    if (! pt->joined) {
+	pthread_cancel(pt->thread);
+	pthread_join(pt->thread, NULL);
+	pt->joined = 1;
+    }
+}
+
+
+int
+thread_wait(thread_t *arg, int timeout)
+{
+    pt_thread_t *pt = (pt_thread_t *)arg;
+    struct timespec ts;
+
+    if (arg == NULL) return(0);
+
+    if (pt->joined) return(0);
+
+    if (timeout == -1) {
+	pthread_join(pt->thread, NULL);
+    } else {
+	thread_deadline(&ts, timeout);
+	if (pthread_timedjoin_np(pt->thread, NULL, &ts) != 0) return(1);
+    }
+    pt->joined = 1;
+
+    return(0);
+}
+
+
+event_t *
+thread_create_event(void)
+{
+    pt_event_t *ev = malloc(sizeof(pt_event_t));
+
+    pthread_mutex_init(&ev->mutex, NULL);
+    pthread_cond_init(&ev->cond, NULL);
+    ev->state = 0;
+
+    return((event_t *)ev);
+}
+
+
+void
+thread_set_event(event_t *arg)
+{
+    pt_event_t *ev = (pt_event_t *)arg;
+
+    if (arg == NULL) return;
+
+    pthread_mutex_lock(&ev->mutex);
+    ev->state = 1;
+    pthread_cond_signal(&ev->cond);
+    pthread_mutex_unlock(&ev->mutex);
+}
+
+
+void
+thread_reset_event(event_t *arg)
+{
+    pt_event_t *ev = (pt_event_t *)arg;
+
+    if (arg == NULL) return;
+
+    pthread_mutex_lock(&ev->mutex);
+    ev->state = 0;
+    pthread_mutex_unlock(&ev->mutex);
+}
+
+
+int
+thread_wait_event(event_t *arg, int timeout)
+{
+    pt_event_t *ev = (pt_event_t *)arg;
+    struct timespec ts;
+    int ret = 0;
+
+    if (arg == NULL) return(0);
+
+    if (timeout != -1)
+	thread_deadline(&ts, timeout);
+
+    pthread_mutex_lock(&ev->mutex);
+    pthread_cleanup_push(thread_unlock, &ev->mutex);
+    while (! ev->state) {
+	if (timeout == -1)
+		pthread_cond_wait(&ev->cond, &ev->mutex);
+	else if (pthread_cond_timedwait(&ev->cond, &ev->mutex, &ts) == ETIMEDOUT) {
+		ret = 1;
+		break;
+	}
+    }
+    if (! ret)
+	ev->state = 0;
+    pthread_cleanup_pop(1);
+
+    return(ret);
+}
+
+
+void
+thread_destroy_event(event_t *arg)
+{
+    pt_event_t *ev = (pt_event_t *)arg;
+
+    if (arg == NULL) return;
+
+    pthread_cond_destroy(&ev->cond);
+    pthread_mutex_destroy(&ev->mutex);
+
+    free(ev);
+}
+
+
+mutex_t *
+thread_create_mutex(wchar_t *name)
+{
+    pthread_mutex_t *mutex = malloc(sizeof(pthread_mutex_t));
+    pthread_mutexattr_t attr;
+
+    /* Win32 mutexes may be re-entered by their owner. */
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    return((mutex_t *)mutex);
+}
+
+
+void
+thread_close_mutex(mutex_t *mutex)
+{
+    if (mutex == NULL) return;
+
+    pthread_mutex_destroy((pthread_mutex_t *)mutex);
+
+    free(mutex);
+}
+
+
+int
+thread_wait_mutex(mutex_t *mutex)
+{
+    if (mutex == NULL) return(0);
+
+    return(pthread_mutex_lock((pthread_mutex_t *)mutex) == 0);
+}
+
+
+int
+thread_release_mutex(mutex_t *mutex)
+{
+    if (mutex == NULL) return(0);
+
+    return(pthread_mutex_unlock((pthread_mutex_t *)mutex) == 0);
+}
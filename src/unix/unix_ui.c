@@ -0,0 +1,310 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		User interface for the headless POSIX platform.
+ *
+ *		There is no window, status bar or input device here, so
+ *		most of these are no-ops. Messages go to the log, and
+ *		the media functions still do the emulator-side work.
+ *
+ * Version:	@(#)unix_ui.c	1.0.0	2026/10/18
+ *
+ * Authors:	Miran Grca, <mgrca8@gmail.com>
+ *		Fred N. van Kempen, <decwiz@yahoo.com>
+ *		agent, <agent@local>
+ *
+ *		Copyright 2016-2018 Miran Grca.
+ *		Copyright 2017,2018 Fred N. van Kempen.
+ *		Copyright 2026 agent.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include "../86box.h"
+#include "../config.h"
+#include "../mouse.h"
+#include "../disk/hdd.h"
+#include "../scsi/scsi_device.h"
+#include "../cdrom/cdrom.h"
+#include "../disk/zip.h"
+#include "../scsi/scsi_disk.h"
+#include "../game/gameport.h"
+#include "../plat.h"
+#include "../plat_midi.h"
+#include "../ui.h"
+
+
+plat_joystick_t	plat_joystick_state[MAX_PLAT_JOYSTICKS];
+joystick_t	joystick_state[MAX_JOYSTICKS];
+int		joysticks_present = 0;
+
+
+static wchar_t	wtitle[512];
+
+
+int
+ui_msgbox(int flags, void *arg)
+{
+    wchar_t temp[512];
+    wchar_t *str, *cap = NULL;
+
+    switch(flags & 0x1f) {
+	case MBX_INFO:		/* just an informational message */
+	case MBX_QUESTION:	/* question */
+		cap = plat_get_string(IDS_STRINGS);	    /* "86Box" */
+		break;
+
+	case MBX_ERROR:		/* error message */
+		if (flags & MBX_FATAL)
+			cap = plat_get_string(IDS_2050);    /* "Fatal Error"*/
+		else
+			cap = plat_get_string(IDS_2049);    /* "Error" */
+		break;
+    }
+
+    /* If ANSI string, convert it. */
+    str = (wchar_t *)arg;
+    if (flags & MBX_ANSI) {
+	mbstowcs(temp, (char *)arg, strlen((char *)arg)+1);
+	str = temp;
+    } else if (((uintptr_t)arg) < ((uintptr_t)65636)) {
+	/* Low values are string IDs, see win_dialog.c. */
+	str = plat_get_string((intptr_t)arg);
+    }
+
+    fprintf(stderr, "%ls: %ls\n", cap ? cap : L"86Box", str);
+
+    /* Nobody to answer a question, so take the default. */
+    return(0);
+}
+
+
+void
+ui_check_menu_item(int id, int checked)
+{
+}
+
+
+wchar_t *
+ui_window_title(wchar_t *s)
+{
+    if (s != NULL)
+	wcsncpy(wtitle, s, sizeof_w(wtitle) - 1);
+
+    return(wtitle);
+}
+
+
+void
+ui_status_update(void)
+{
+}
+
+
+int
+ui_sb_find_part(int tag)
+{
+    return(-1);
+}
+
+
+void
+ui_sb_set_ready(int ready)
+{
+}
+
+
+void
+ui_sb_update_panes(void)
+{
+}
+
+
+void
+ui_sb_update_tip(int meaning)
+{
+}
+
+
+void
+ui_sb_check_menu_item(int tag, int id, int chk)
+{
+}
+
+
+void
+ui_sb_enable_menu_item(int tag, int id, int val)
+{
+}
+
+
+void
+ui_sb_update_icon(int tag, int val)
+{
+}
+
+
+void
+ui_sb_update_icon_state(int tag, int active)
+{
+}
+
+
+void
+ui_sb_set_text_w(wchar_t *wstr)
+{
+}
+
+
+void
+ui_sb_set_text(char *str)
+{
+}
+
+
+void
+ui_sb_bugui(char *str)
+{
+}
+
+
+void
+ui_sb_mount_floppy_img(uint8_t id, int part, uint8_t wp, wchar_t *file_name)
+{
+}
+
+
+void
+ui_sb_mount_zip_img(uint8_t id, int part, uint8_t wp, wchar_t *file_name)
+{
+}
+
+
+void
+plat_pause(int p)
+{
+    dopause = p;
+}
+
+
+void
+plat_resize(int x, int y)
+{
+}
+
+
+void
+plat_mouse_capture(int on)
+{
+    /* There is no host pointer to capture. */
+    mouse_capture = 0;
+}
+
+
+void
+plat_cdrom_ui_update(uint8_t id, uint8_t reload)
+{
+}
+
+
+void
+zip_eject(uint8_t id)
+{
+    zip_t *dev = (zip_t *) zip_drives[id].priv;
+
+    zip_disk_close(dev);
+    if (zip_drives[id].bus_type) {
+	/* Signal disk change to the emulated machine. */
+	zip_insert(dev);
+    }
+
+    config_save();
+}
+
+
+void
+zip_reload(uint8_t id)
+{
+    zip_t *dev = (zip_t *) zip_drives[id].priv;
+
+    zip_disk_reload(dev);
+
+    config_save();
+}
+
+
+void
+mouse_poll(void)
+{
+}
+
+
+void
+joystick_init(void)
+{
+    joysticks_present = 0;
+}
+
+
+void
+joystick_close(void)
+{
+}
+
+
+void
+joystick_process(void)
+{
+}
+
+
+void
+plat_midi_init(void)
+{
+}
+
+
+void
+plat_midi_close(void)
+{
+}
+
+
+void
+plat_midi_play_msg(uint8_t *msg)
+{
+}
+
+
+void
+plat_midi_play_sysex(uint8_t *sysex, unsigned int len)
+{
+}
+
+
+int
+plat_midi_write(uint8_t val)
+{
+    return(0);
+}
+
+
+int
+plat_midi_get_num_devs(void)
+{
+    return(0);
+}
+
+
+void
+plat_midi_get_dev_name(int num, char *s)
+{
+    strcpy(s, "");
+}
@@ -30,6 +30,7 @@
 #include "../mem.h"
 #include "../rom.h"
 #include "../device.h"
+#include "../timer.h"
 #include "video.h"
 #include "vid_ati28800.h"
 #include "vid_ati_eeprom.h"
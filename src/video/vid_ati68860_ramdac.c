@@ -44,6 +44,7 @@
 #include "../86box.h"
 #include "../device.h"
 #include "../mem.h"
+#include "../timer.h"
 #include "video.h"
 #include "vid_svga.h"
 #include "vid_ati68860_ramdac.h"
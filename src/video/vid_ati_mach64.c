@@ -30,6 +30,7 @@
 #include "../pci.h"
 #include "../rom.h"
 #include "../plat.h"
+#include "../timer.h"
 #include "video.h"
 #include "vid_svga.h"
 #include "vid_svga_render.h"
@@ -1079,6 +1080,8 @@ void mach64_start_line(mach64_t *mach64)
 {
         int x, y;
         
+        svga_render_flush(&mach64->svga);
+
         mach64->accel.dst_x = (mach64->dst_y_x >> 16) & 0xfff;
         mach64->accel.dst_y =  mach64->dst_y_x        & 0xfff;
 
@@ -1219,6 +1222,7 @@ void mach64_blit(uint32_t cpu_dat, int count, mach64_t *mach64)
                 mach64_log("mach64_blit : return as not busy\n");
                 return;
         }
+        svga_render_flush(svga);
         switch (mach64->accel.op)
         {
                 case OP_RECT:
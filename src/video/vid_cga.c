@@ -30,6 +30,7 @@
 #include "../rom.h"
 #include "../timer.h"
 #include "../device.h"
+#include "../snapshot.h"
 #include "video.h"
 #include "vid_cga.h"
 #include "vid_cga_comp.h"
@@ -526,6 +527,65 @@ void cga_speed_changed(void *p)
         cga_recalctimings(cga);
 }
 
+static void cga_save(void *p, snapshot_t *s)
+{
+        cga_t *cga = (cga_t *)p;
+
+        snapshot_write_var(s, cga->crtcreg);
+        snapshot_write(s, cga->crtc, sizeof(cga->crtc));
+        snapshot_write_var(s, cga->cgastat);
+        snapshot_write_var(s, cga->cgamode);
+        snapshot_write_var(s, cga->cgacol);
+        snapshot_write_var(s, cga->linepos);
+        snapshot_write_var(s, cga->displine);
+        snapshot_write_var(s, cga->sc);
+        snapshot_write_var(s, cga->vc);
+        snapshot_write_var(s, cga->cgadispon);
+        snapshot_write_var(s, cga->con);
+        snapshot_write_var(s, cga->coff);
+        snapshot_write_var(s, cga->cursoron);
+        snapshot_write_var(s, cga->cgablink);
+        snapshot_write_var(s, cga->vsynctime);
+        snapshot_write_var(s, cga->vadj);
+        snapshot_write_var(s, cga->ma);
+        snapshot_write_var(s, cga->maback);
+        snapshot_write_var(s, cga->oddeven);
+        snapshot_write_var(s, cga->vidtime);
+        snapshot_write(s, cga->vram, 0x4000);
+}
+
+static void cga_load(void *p, snapshot_t *s)
+{
+        cga_t *cga = (cga_t *)p;
+
+        snapshot_read_var(s, cga->crtcreg);
+        snapshot_read(s, cga->crtc, sizeof(cga->crtc));
+        snapshot_read_var(s, cga->cgastat);
+        snapshot_read_var(s, cga->cgamode);
+        snapshot_read_var(s, cga->cgacol);
+        snapshot_read_var(s, cga->linepos);
+        snapshot_read_var(s, cga->displine);
+        snapshot_read_var(s, cga->sc);
+        snapshot_read_var(s, cga->vc);
+        snapshot_read_var(s, cga->cgadispon);
+        snapshot_read_var(s, cga->con);
+        snapshot_read_var(s, cga->coff);
+        snapshot_read_var(s, cga->cursoron);
+        snapshot_read_var(s, cga->cgablink);
+        snapshot_read_var(s, cga->vsynctime);
+        snapshot_read_var(s, cga->vadj);
+        snapshot_read_var(s, cga->ma);
+        snapshot_read_var(s, cga->maback);
+        snapshot_read_var(s, cga->oddeven);
+        snapshot_read_var(s, cga->vidtime);
+        snapshot_read(s, cga->vram, 0x4000);
+
+        update_cga16_color(cga->cgamode);
+        cga_palette = (cga->rgb_type << 1);
+        cgapal_rebuild();
+        cga_recalctimings(cga);
+}
+
 const device_config_t cga_config[] =
 {
         {
@@ -597,5 +657,7 @@ const device_t cga_device =
         NULL,
         cga_speed_changed,
         NULL,
-        cga_config
+        cga_config,
+        cga_save,
+        cga_load
 };
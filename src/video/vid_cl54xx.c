@@ -34,6 +34,7 @@
 #include "../pci.h"
 #include "../rom.h"
 #include "../device.h"
+#include "../timer.h"
 #include "video.h"
 #include "vid_svga.h"
 #include "vid_svga_render.h"
@@ -370,6 +371,7 @@ gd54xx_out(uint16_t addr, uint8_t val, void *p)
 					svga->vgapal[index].g = svga->dac_g;
 					svga->vgapal[index].b = val; 
 					svga->pallook[index] = makecol32(video_6to8[svga->vgapal[index].r & 0x3f], video_6to8[svga->vgapal[index].g & 0x3f], video_6to8[svga->vgapal[index].b & 0x3f]);
+					svga->render_dirty = 1;
 				}
 				svga->dac_addr = (svga->dac_addr + 1) & 255;
 				svga->dac_pos = 0; 
@@ -961,6 +963,8 @@ gd54xx_blit_dword(gd54xx_t *gd54xx, svga_t *svga)
     /* TODO: add support for reverse direction */
     uint8_t x, pixel;
 
+    svga_render_flush(svga);
+
     for (x=0;x<32;x+=8) {
 	pixel = ((gd54xx->blt.sys_buf & (0xff << x)) >> x);
 	if(gd54xx->blt.pixel_cnt <= gd54xx->blt.width)
@@ -1102,6 +1106,11 @@ static void
 gd54xx_write_modes45(svga_t *svga, uint8_t val, uint32_t addr)
 {
     uint32_t i, j;
+    uint32_t start = addr << ((svga->gdcreg[0xb] & 0x10) ? 2 : 1);
+
+    /* Up to 16 bytes, which may cross a page. */
+    svga_render_sync(svga, start & svga->vram_mask);
+    svga_render_sync(svga, (start + 15) & svga->vram_mask);
 
     switch (svga->writemode) {
 	case 4:
@@ -1850,6 +1859,8 @@ gd54xx_start_blit(uint32_t cpu_dat, int count, gd54xx_t *gd54xx, svga_t *svga)
     int x_max = 0;
 
     int shift = 0, last_x = 0;
+
+    svga_render_flush(svga);
 	
     switch (gd54xx->blt.mode & CIRRUS_BLTMODE_PIXELWIDTHMASK) {
 	case CIRRUS_BLTMODE_PIXELWIDTH8:
@@ -32,6 +32,7 @@
 #include "../rom.h"
 #include "../device.h"
 #include "../plat.h"
+#include "../timer.h"
 #include "video.h"
 #include "vid_svga.h"
 #include "vid_icd2061.h"
@@ -613,6 +614,7 @@ void et4000w32p_mmu_write(uint32_t addr, uint8_t val, void *p)
                 {
                         if ((addr&0x1fff) + et4000->mmu.base[bank] < svga->vram_max)
                         {
+                                svga_render_sync(svga, ((addr & 0x1fff) + et4000->mmu.base[bank]) & svga->vram_mask);
                                 svga->vram[(addr & 0x1fff) + et4000->mmu.base[bank]] = val;
                                 svga->changedvram[((addr & 0x1fff) + et4000->mmu.base[bank]) >> 12] = changeframecount;
                         }
@@ -863,6 +865,7 @@ void et4000w32_blit(int count, uint32_t mix, uint32_t sdat, int cpu_input, et400
         int mixdat;
 
         if (!(et4000->acl.status & ACL_XYST)) return;
+        svga_render_flush(svga);
         if (et4000->acl.internal.xy_dir & 0x80) /*Line draw*/
         {
                 while (count--)
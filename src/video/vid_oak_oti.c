@@ -25,6 +25,7 @@
 #include "../mem.h"
 #include "../rom.h"
 #include "../device.h"
+#include "../timer.h"
 #include "video.h"
 #include "vid_oak_oti.h"
 #include "vid_svga.h"
@@ -28,6 +28,7 @@
 #include "../mem.h"
 #include "../rom.h"
 #include "../device.h"
+#include "../timer.h"
 #include "video.h"
 #include "vid_paradise.h"
 #include "vid_svga.h"
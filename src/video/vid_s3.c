@@ -28,6 +28,7 @@
 #include "../pci.h"
 #include "../rom.h"
 #include "../plat.h"
+#include "../timer.h"
 #include "video.h"
 #include "vid_s3.h"
 #include "vid_svga.h"
@@ -1809,6 +1810,8 @@ void s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat
 	if ((s3->chip == S3_TRIO64) && (s3->accel.cmd & (1 << 11)))
 		cmd |= 8;
 
+	svga_render_flush(svga);
+
 	if (!cpu_input) s3->accel.dat_count = 0;
 	if (cpu_input && (s3->accel.multifunc[0xa] & 0xc0) != 0x80)
 	{
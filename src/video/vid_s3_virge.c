@@ -30,6 +30,7 @@
 #include "../rom.h"
 #include "../device.h"
 #include "../plat.h"
+#include "../timer.h"
 #include "video.h"
 #include "vid_s3_virge.h"
 #include "vid_svga.h"
@@ -1966,6 +1967,8 @@ static void s3_virge_bitblt(virge_t *virge, int count, uint32_t cpu_dat)
 	uint32_t out = 0;
 	int update;
         
+        svga_render_flush(svga);
+
         switch (virge->s3d.cmd_set & CMD_SET_FORMAT_MASK)
         {
                 case CMD_SET_FORMAT_8:
@@ -3229,6 +3232,8 @@ static void s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri)
         uint64_t start_time = plat_timer_read();
         uint64_t end_time;
 
+        svga_render_flush(&virge->svga);
+
         state.tbu = s3d_tri->tbu << 11;
         state.tbv = s3d_tri->tbv << 11;
         
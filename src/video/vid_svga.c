@@ -33,6 +33,8 @@
 #include "../mem.h"
 #include "../rom.h"
 #include "../timer.h"
+#include "../snapshot.h"
+#include "../plat.h"
 #include "video.h"
 #include "vid_svga.h"
 #include "vid_svga_render.h"
@@ -40,6 +42,9 @@
 
 #define svga_output 0
 
+#define SVGA_RENDER_LINES 64	/* lines queued ahead of the render thread */
+#define SVGA_RENDER_BATCH 16	/* lines queued before the thread is woken */
+
 void svga_doblit(int y1, int y2, int wx, int wy, svga_t *svga);
 
 extern int	cyc_total;
@@ -66,9 +71,206 @@ svga_t
 }
 
 
+/* Per-line state handed to the render thread. */
+typedef struct svga_render_line {
+    void	(*render)(struct svga_t *svga);
+    uint32_t	ma, vram_display_mask, vram_max;
+    int		displine, hdisp, scrollcache, fullchange,
+		hwcursor_on, hwcursor_oddeven;
+
+    /* Only filled in on lines with the hardware cursor. The S3 and ViRGE
+       cursors take their 8bpp colours from the CRTC. */
+    hwcursor_t	hwcursor;
+    uint8_t	crtc[128];
+} svga_render_line_t;
+
+
+static void
+svga_render_thread(void *param)
+{
+    svga_t *svga = (svga_t *)param;
+    svga_t *shadow = svga->render_svga;
+    svga_render_line_t *line;
+
+    while (! svga->render_exit) {
+	thread_wait_event(svga->render_wake, -1);
+	thread_reset_event(svga->render_wake);
+
+	while (svga->render_done != svga->render_queued) {
+		line = &svga->render_lines[svga->render_done & (SVGA_RENDER_LINES - 1)];
+
+		shadow->ma = line->ma;
+		shadow->vram_display_mask = line->vram_display_mask;
+		shadow->vram_max = line->vram_max;
+		shadow->displine = line->displine;
+		shadow->hdisp = line->hdisp;
+		shadow->scrollcache = line->scrollcache;
+		shadow->fullchange = line->fullchange;
+		shadow->firstline_draw = 2000;
+		shadow->lastline_draw = 0;
+		line->render(shadow);
+
+		/* The cursor address advances as it is drawn. While lines are
+		   queued only this thread moves it, so carry it back. */
+		if (line->hwcursor_on) {
+			shadow->hwcursor = line->hwcursor;
+			shadow->hwcursor_latch = svga->hwcursor_latch;
+			shadow->hwcursor_on = line->hwcursor_on;
+			shadow->hwcursor_oddeven = line->hwcursor_oddeven;
+			memcpy(shadow->crtc, line->crtc, sizeof(shadow->crtc));
+			shadow->hwcursor_draw(shadow, line->displine);
+			svga->hwcursor_latch.addr = shadow->hwcursor_latch.addr;
+		}
+
+		/* Only this thread touches these while lines are queued. */
+		if (shadow->firstline_draw < svga->firstline_draw)
+			svga->firstline_draw = shadow->firstline_draw;
+		if (shadow->lastline_draw > svga->lastline_draw)
+			svga->lastline_draw = shadow->lastline_draw;
+
+		svga->render_done++;
+		thread_set_event(svga->render_done_event);
+	}
+    }
+}
+
+
+/* Wait until the render thread has drawn queued line number seq. */
+static void
+svga_render_wait(svga_t *svga, uint32_t seq)
+{
+    while ((int32_t)(seq - svga->render_done) > 0) {
+	thread_reset_event(svga->render_done_event);
+	if ((int32_t)(seq - svga->render_done) <= 0)
+		break;
+
+	/* Re-kick the thread in case it went to sleep on a stale count. */
+	thread_set_event(svga->render_wake);
+	thread_wait_event(svga->render_done_event, 1);
+    }
+}
+
+
+/* Wait for every queued line. Accelerators call this before they draw. */
+void
+svga_render_flush(svga_t *svga)
+{
+    if (svga->render_queued != svga->render_done)
+	svga_render_wait(svga, svga->render_queued);
+}
+
+
+/* Bytes per pixel of the packed pixel renderers, which only read VRAM from
+   ma on; zero for anything else, which is drawn in place. */
+static int
+svga_render_bytes(svga_t *svga)
+{
+    if ((svga->render == svga_render_8bpp_lowres) || (svga->render == svga_render_8bpp_highres))
+	return(1);
+    if ((svga->render == svga_render_15bpp_lowres) || (svga->render == svga_render_15bpp_highres) ||
+	(svga->render == svga_render_16bpp_lowres) || (svga->render == svga_render_16bpp_highres))
+	return(2);
+    if ((svga->render == svga_render_24bpp_lowres) || (svga->render == svga_render_24bpp_highres))
+	return(3);
+    if ((svga->render == svga_render_32bpp_lowres) || (svga->render == svga_render_32bpp_highres) ||
+	(svga->render == svga_render_ABGR8888_highres) || (svga->render == svga_render_RGBA8888_highres))
+	return(4);
+
+    return(0);
+}
+
+
+/* Narrow lines are cheaper to draw than to queue. Overlays read too much
+   card state to be drawn anywhere but in place. Without a render thread,
+   everything is. */
+static __inline int
+svga_render_queueable(svga_t *svga)
+{
+    return((svga->render_thread != NULL) && (svga->hdisp >= 640) &&
+	   !svga->overlay_on && svga_render_bytes(svga));
+}
+
+
+/* Record that queued line seq reads VRAM from addr to end. */
+static void
+svga_render_mark(svga_t *svga, uint32_t addr, uint32_t end, uint32_t mask, uint32_t seq)
+{
+    for (addr &= ~0xfff; addr < end; addr += 0x1000)
+	svga->render_page_seq[(addr & mask) >> 12] = seq;
+}
+
+
+/* Hand the current scanline to the render thread. */
+static void
+svga_render_queue(svga_t *svga)
+{
+    uint32_t seq = svga->render_queued + 1;
+    svga_render_line_t *line;
+
+    if (svga->render_dirty) {
+	/* Mode and palette changes are rare, so take a full copy of the
+	   registers once the thread has caught up. */
+	svga_render_flush(svga);
+	memcpy(svga->render_svga, svga, sizeof(svga_t));
+	svga->render_dirty = 0;
+    } else if ((int32_t)(seq - svga->render_done) > SVGA_RENDER_LINES)
+	svga_render_wait(svga, seq - SVGA_RENDER_LINES);
+
+    line = &svga->render_lines[svga->render_queued & (SVGA_RENDER_LINES - 1)];
+    line->render = svga->render;
+    line->ma = svga->ma;
+    line->vram_display_mask = svga->vram_display_mask;
+    line->vram_max = svga->vram_max;
+    line->displine = svga->displine;
+    line->hdisp = svga->hdisp;
+    line->scrollcache = svga->scrollcache;
+    line->fullchange = svga->fullchange;
+    line->hwcursor_on = svga->hwcursor_on;
+    line->hwcursor_oddeven = svga->hwcursor_oddeven;
+
+    /* Packed pixel renderers read hdisp pixels from ma on, plus up to one
+       block of 8 past the end. */
+    svga_render_mark(svga, svga->ma, svga->ma + (svga->hdisp + 8) * svga_render_bytes(svga),
+		     svga->vram_display_mask, seq);
+
+    if (line->hwcursor_on) {
+	line->hwcursor = svga->hwcursor;
+	memcpy(line->crtc, svga->crtc, sizeof(line->crtc));
+
+	/* No cursor image is larger than 1K, plus the mask at 0x80 on the
+	   Cirrus parts. The latch only moves on once the queue drains. */
+	svga_render_mark(svga, svga->hwcursor_latch.addr, svga->hwcursor_latch.addr + 0x480,
+			 svga->vram_mask, seq);
+    }
+
+    /* Waking the thread for every line costs more than drawing it. */
+    svga->render_queued = seq;
+    if ((seq - svga->render_done) == SVGA_RENDER_BATCH)
+	thread_set_event(svga->render_wake);
+}
+
+
+/* Called before a VRAM write: wait for any queued line that reads the page. */
+void
+svga_render_sync(svga_t *svga, uint32_t addr)
+{
+    uint32_t pending = svga->render_queued - svga->render_done;
+    uint32_t seq;
+
+    if (! pending)
+	return;
+
+    /* Stale entries from long gone lines fall outside the pending window. */
+    seq = svga->render_page_seq[addr >> 12];
+    if ((seq - svga->render_done - 1) < pending)
+	svga_render_wait(svga, seq);
+}
+
+
 void
 svga_set_override(svga_t *svga, int val)
 {
+    svga_render_flush(svga);
     if (svga->override && !val)
 	svga->fullchange = changeframecount;
     svga->override = val;
@@ -200,6 +402,7 @@ svga_out(uint16_t addr, uint8_t val, void *p)
 					svga->pallook[index] = makecol32(svga->vgapal[index].r, svga->vgapal[index].g, svga->vgapal[index].b);
 				else
 					svga->pallook[index] = makecol32(video_6to8[svga->vgapal[index].r & 0x3f], video_6to8[svga->vgapal[index].g & 0x3f], video_6to8[svga->vgapal[index].b & 0x3f]);
+				svga->render_dirty = 1;
 				svga->dac_pos = 0; 
 				svga->dac_addr = (svga->dac_addr + 1) & 255; 
 				break;
@@ -377,6 +580,7 @@ svga_set_ramdac_type(svga_t *svga, int type)
 						     (svga->vgapal[c].g & 0x3f) * 4,
 						     (svga->vgapal[c].b & 0x3f) * 4);
 	}
+	svga->render_dirty = 1;
     }
 }
 
@@ -517,6 +721,10 @@ svga_recalctimings(svga_t *svga)
     if (svga->recalctimings_ex) 
 	svga->recalctimings_ex(svga);
 
+    /* Queued lines keep the old mode; the render thread is handed the new
+       one when the next line is queued. */
+    svga->render_dirty = 1;
+
     if (svga->vblankstart < svga->dispend)
 	svga->dispend = svga->vblankstart;
 
@@ -543,7 +751,7 @@ svga_poll(void *p)
 {
     svga_t *svga = (svga_t *)p;
     uint32_t x;
-    int wx, wy;
+    int wx, wy, queued = 0;
 
     if (!svga->linepos) {
 	if (svga->displine == svga->hwcursor_latch.y && svga->hwcursor_latch.ena) {
@@ -567,7 +775,7 @@ svga_poll(void *p)
 		svga->overlay_oddeven = 1;
 	}
 
-	svga->vidtime += svga->dispofftime;
+	timer_event_advance(&svga->timer, svga->dispofftime);
 	svga->cgastat |= 1;
 	svga->linepos = 1;
 
@@ -585,8 +793,15 @@ svga_poll(void *p)
 							    svga->interlace ? 3 : 2;
 		}
 
-		if (!svga->override)
+		if (svga->override)
+			;
+		else if (svga_render_queueable(svga)) {
+			svga_render_queue(svga);
+			queued = 1;
+		} else {
+			svga_render_flush(svga);
 			svga->render(svga);
+		}
 
 		if (svga->overlay_on) {
 			if (!svga->override)
@@ -597,7 +812,8 @@ svga_poll(void *p)
 		}
 
 		if (svga->hwcursor_on) {
-			if (!svga->override)
+			/* The render thread draws the cursor on queued lines. */
+			if (!svga->override && !queued)
 				svga->hwcursor_draw(svga, svga->displine);
 			svga->hwcursor_on--;
 			if (svga->hwcursor_on && svga->interlace)
@@ -617,7 +833,7 @@ svga_poll(void *p)
 	if (svga->displine > 1500)
 		svga->displine = 0;
     } else {
-	svga->vidtime += svga->dispontime;
+	timer_event_advance(&svga->timer, svga->dispontime);
 
 	if (svga->dispon) 
 		svga->cgastat &= ~1;
@@ -656,6 +872,7 @@ svga_poll(void *p)
 			svga->scrollcache = 0;
 	}
 	if (svga->vc == svga->dispend) {
+		svga_render_flush(svga);
 		if (svga->vblank_start)
 			svga->vblank_start(svga);
 		svga->dispon=0;
@@ -688,6 +905,8 @@ svga_poll(void *p)
 		wx = x;
 		wy = svga->lastline - svga->firstline;
 
+		svga_render_flush(svga);
+
 		if (!svga->override)
 			svga_doblit(svga->firstline_draw, svga->lastline_draw + 1, wx, wy, svga);
 
@@ -789,6 +1008,11 @@ svga_init(svga_t *svga, void *p, int memsize,
     svga->decode_mask = 0x7fffff;
     svga->changedvram = malloc(memsize >> 12);
     svga->changedvram = malloc(0x800000 >> 12);
+    svga->render_page_seq = malloc((0x800000 >> 12) * sizeof(uint32_t));
+    memset(svga->render_page_seq, 0, (0x800000 >> 12) * sizeof(uint32_t));
+    svga->render_lines = malloc(SVGA_RENDER_LINES * sizeof(svga_render_line_t));
+    svga->render_svga = malloc(sizeof(svga_t));
+    svga->render_dirty = 1;
     svga->recalctimings_ex = recalctimings_ex;
     svga->video_in  = video_in;
     svga->video_out = video_out;
@@ -803,12 +1027,19 @@ svga_init(svga_t *svga, void *p, int memsize,
 		    svga_write, svga_writew, svga_writel,
 		    NULL, MEM_MAPPING_EXTERNAL, svga);
 
-    timer_add(svga_poll, &svga->vidtime, TIMER_ALWAYS_ENABLED, svga);
+    timer_event_init(&svga->timer, svga_poll, svga);
+    timer_event_set(&svga->timer, 0LL);
 
     svga_pri = svga;
 
     svga->ramdac_type = RAMDAC_6BIT;
 
+    svga->render_wake = thread_create_event();
+    svga->render_done_event = thread_create_event();
+    /* If there is no thread, every line is drawn in place. */
+    if ((svga->render_wake != NULL) && (svga->render_done_event != NULL))
+	svga->render_thread = thread_create(svga_render_thread, svga);
+
     return 0;
 }
 
@@ -816,6 +1047,22 @@ svga_init(svga_t *svga, void *p, int memsize,
 void
 svga_close(svga_t *svga)
 {
+    timer_event_disable(&svga->timer);
+
+    /* Let the thread finish the queue and return on its own, it must not
+       be stopped halfway through a line. */
+    if (svga->render_thread != NULL) {
+	svga_render_flush(svga);
+	svga->render_exit = 1;
+	thread_set_event(svga->render_wake);
+	thread_wait(svga->render_thread, -1);
+    }
+    thread_destroy_event(svga->render_wake);
+    thread_destroy_event(svga->render_done_event);
+    free(svga->render_lines);
+    free(svga->render_svga);
+    free(svga->render_page_seq);
+
     free(svga->changedvram);
     free(svga->vram);
 
@@ -823,6 +1070,176 @@ svga_close(svga_t *svga)
 }
 
 
+/* Save the core SVGA state; the card's own registers are up to its caller. */
+void
+svga_save(svga_t *svga, snapshot_t *s)
+{
+    int64_t remaining;
+
+    svga_render_flush(svga);
+
+    snapshot_write(s, svga->crtc, sizeof(svga->crtc));
+    snapshot_write(s, svga->gdcreg, sizeof(svga->gdcreg));
+    snapshot_write(s, svga->attrregs, sizeof(svga->attrregs));
+    snapshot_write(s, svga->seqregs, sizeof(svga->seqregs));
+    snapshot_write(s, svga->egapal, sizeof(svga->egapal));
+    snapshot_write_var(s, svga->crtcreg);
+    snapshot_write_var(s, svga->gdcaddr);
+    snapshot_write_var(s, svga->attrff);
+    snapshot_write_var(s, svga->attr_palette_enable);
+    snapshot_write_var(s, svga->attraddr);
+    snapshot_write_var(s, svga->seqaddr);
+    snapshot_write_var(s, svga->miscout);
+    snapshot_write_var(s, svga->cgastat);
+    snapshot_write_var(s, svga->scrblank);
+    snapshot_write_var(s, svga->plane_mask);
+    snapshot_write_var(s, svga->writemask);
+    snapshot_write_var(s, svga->colourcompare);
+    snapshot_write_var(s, svga->colournocare);
+    snapshot_write_var(s, svga->dac_mask);
+    snapshot_write_var(s, svga->dac_status);
+    snapshot_write_var(s, svga->dac_addr);
+    snapshot_write_var(s, svga->dac_pos);
+    snapshot_write_var(s, svga->dac_r);
+    snapshot_write_var(s, svga->dac_g);
+    snapshot_write_var(s, svga->readmode);
+    snapshot_write_var(s, svga->writemode);
+    snapshot_write_var(s, svga->readplane);
+    snapshot_write_var(s, svga->chain4);
+    snapshot_write_var(s, svga->chain2_write);
+    snapshot_write_var(s, svga->chain2_read);
+    snapshot_write_var(s, svga->oddeven_page);
+    snapshot_write_var(s, svga->oddeven_chain);
+    snapshot_write_var(s, svga->set_reset_disabled);
+    snapshot_write_var(s, svga->vc);
+    snapshot_write_var(s, svga->sc);
+    snapshot_write_var(s, svga->linepos);
+    snapshot_write_var(s, svga->vslines);
+    snapshot_write_var(s, svga->linecountff);
+    snapshot_write_var(s, svga->oddeven);
+    snapshot_write_var(s, svga->con);
+    snapshot_write_var(s, svga->cursoron);
+    snapshot_write_var(s, svga->blink);
+    snapshot_write_var(s, svga->dispon);
+    snapshot_write_var(s, svga->hdisp_on);
+    snapshot_write_var(s, svga->displine);
+    snapshot_write_var(s, svga->charseta);
+    snapshot_write_var(s, svga->charsetb);
+    snapshot_write_var(s, svga->latch);
+    snapshot_write_var(s, svga->ma_latch);
+    snapshot_write_var(s, svga->ma);
+    snapshot_write_var(s, svga->maback);
+    snapshot_write_var(s, svga->write_bank);
+    snapshot_write_var(s, svga->read_bank);
+    snapshot_write_var(s, svga->ca);
+    snapshot_write_var(s, svga->overscan_color);
+    snapshot_write(s, svga->pallook, sizeof(svga->pallook));
+    snapshot_write(s, svga->vgapal, sizeof(svga->vgapal));
+    snapshot_write_var(s, svga->hwcursor);
+    snapshot_write_var(s, svga->overlay);
+    snapshot_write_var(s, svga->mapping.enable);
+    snapshot_write_var(s, svga->mapping.base);
+    snapshot_write_var(s, svga->mapping.size);
+    remaining = timer_event_enabled(&svga->timer) ? timer_event_remaining(&svga->timer) : -1LL;
+    snapshot_write_var(s, remaining);
+    snapshot_write_var(s, svga->vram_max);
+    snapshot_write(s, svga->vram, svga->vram_max);
+}
+
+
+void
+svga_load(svga_t *svga, snapshot_t *s)
+{
+    int64_t remaining;
+    uint32_t base, size, vram_max;
+    int enable;
+
+    svga_render_flush(svga);
+
+    snapshot_read(s, svga->crtc, sizeof(svga->crtc));
+    snapshot_read(s, svga->gdcreg, sizeof(svga->gdcreg));
+    snapshot_read(s, svga->attrregs, sizeof(svga->attrregs));
+    snapshot_read(s, svga->seqregs, sizeof(svga->seqregs));
+    snapshot_read(s, svga->egapal, sizeof(svga->egapal));
+    snapshot_read_var(s, svga->crtcreg);
+    snapshot_read_var(s, svga->gdcaddr);
+    snapshot_read_var(s, svga->attrff);
+    snapshot_read_var(s, svga->attr_palette_enable);
+    snapshot_read_var(s, svga->attraddr);
+    snapshot_read_var(s, svga->seqaddr);
+    snapshot_read_var(s, svga->miscout);
+    snapshot_read_var(s, svga->cgastat);
+    snapshot_read_var(s, svga->scrblank);
+    snapshot_read_var(s, svga->plane_mask);
+    snapshot_read_var(s, svga->writemask);
+    snapshot_read_var(s, svga->colourcompare);
+    snapshot_read_var(s, svga->colournocare);
+    snapshot_read_var(s, svga->dac_mask);
+    snapshot_read_var(s, svga->dac_status);
+    snapshot_read_var(s, svga->dac_addr);
+    snapshot_read_var(s, svga->dac_pos);
+    snapshot_read_var(s, svga->dac_r);
+    snapshot_read_var(s, svga->dac_g);
+    snapshot_read_var(s, svga->readmode);
+    snapshot_read_var(s, svga->writemode);
+    snapshot_read_var(s, svga->readplane);
+    snapshot_read_var(s, svga->chain4);
+    snapshot_read_var(s, svga->chain2_write);
+    snapshot_read_var(s, svga->chain2_read);
+    snapshot_read_var(s, svga->oddeven_page);
+    snapshot_read_var(s, svga->oddeven_chain);
+    snapshot_read_var(s, svga->set_reset_disabled);
+    snapshot_read_var(s, svga->vc);
+    snapshot_read_var(s, svga->sc);
+    snapshot_read_var(s, svga->linepos);
+    snapshot_read_var(s, svga->vslines);
+    snapshot_read_var(s, svga->linecountff);
+    snapshot_read_var(s, svga->oddeven);
+    snapshot_read_var(s, svga->con);
+    snapshot_read_var(s, svga->cursoron);
+    snapshot_read_var(s, svga->blink);
+    snapshot_read_var(s, svga->dispon);
+    snapshot_read_var(s, svga->hdisp_on);
+    snapshot_read_var(s, svga->displine);
+    snapshot_read_var(s, svga->charseta);
+    snapshot_read_var(s, svga->charsetb);
+    snapshot_read_var(s, svga->latch);
+    snapshot_read_var(s, svga->ma_latch);
+    snapshot_read_var(s, svga->ma);
+    snapshot_read_var(s, svga->maback);
+    snapshot_read_var(s, svga->write_bank);
+    snapshot_read_var(s, svga->read_bank);
+    snapshot_read_var(s, svga->ca);
+    snapshot_read_var(s, svga->overscan_color);
+    snapshot_read(s, svga->pallook, sizeof(svga->pallook));
+    snapshot_read(s, svga->vgapal, sizeof(svga->vgapal));
+    snapshot_read_var(s, svga->hwcursor);
+    snapshot_read_var(s, svga->overlay);
+    snapshot_read_var(s, enable);
+    snapshot_read_var(s, base);
+    snapshot_read_var(s, size);
+    snapshot_read_var(s, remaining);
+    snapshot_read_var(s, vram_max);
+
+    /* A card with a different amount of memory keeps its own VRAM. */
+    if (vram_max == svga->vram_max)
+	snapshot_read(s, svga->vram, svga->vram_max);
+
+    if (enable)
+	mem_mapping_set_addr(&svga->mapping, base, size);
+    else
+	mem_mapping_disable(&svga->mapping);
+
+    svga_recalctimings(svga);
+    svga->fullchange = changeframecount;
+    memset(svga->changedvram, 0xff, 0x800000 >> 12);
+
+    if (remaining >= 0LL)
+	timer_event_set(&svga->timer, remaining);
+    else
+	timer_event_disable(&svga->timer);
+}
+
 void
 svga_write_common(uint32_t addr, uint8_t val, uint8_t linear, void *p)
 {
@@ -884,6 +1301,7 @@ svga_write_common(uint32_t addr, uint8_t val, uint8_t linear, void *p)
 
     addr &= svga->vram_mask;
 
+    svga_render_sync(svga, addr);
     svga->changedvram[addr >> 12] = changeframecount;
 
     /* standard VGA latched access */
@@ -1190,6 +1608,7 @@ svga_writeb_linear(uint32_t addr, uint8_t val, void *p)
     if (addr >= svga->vram_max)
 	return;
     addr &= svga->vram_mask;
+    svga_render_sync(svga, addr);
     svga->changedvram[addr >> 12] = changeframecount;
     *(uint8_t *)&svga->vram[addr] = val;
 }
@@ -1216,6 +1635,7 @@ svga_writew_common(uint32_t addr, uint16_t val, uint8_t linear, void *p)
     if (addr >= svga->vram_max)
 	return;
     addr &= svga->vram_mask;
+    svga_render_sync(svga, addr);
     svga->changedvram[addr >> 12] = changeframecount;
     *(uint16_t *)&svga->vram[addr] = val;
 }
@@ -1259,6 +1679,7 @@ svga_writel_common(uint32_t addr, uint32_t val, uint8_t linear, void *p)
 	return;
     addr &= svga->vram_mask;
 
+    svga_render_sync(svga, addr);
     svga->changedvram[addr >> 12] = changeframecount;
     *(uint32_t *)&svga->vram[addr] = val;
 }
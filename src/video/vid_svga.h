@@ -69,8 +69,9 @@ typedef struct svga_t
 
     PALETTE vgapal;
 
-    int64_t dispontime, dispofftime,
-	    vidtime;
+    int64_t dispontime, dispofftime;
+
+    pc_timer_t timer;
 
     double clock;
 
@@ -110,6 +111,20 @@ typedef struct svga_t
 	    ksc5601_sbyte_mask;
 
     void *ramdac, *clock_gen;
+
+    /*Wide packed pixel scanlines are converted by a render thread. Each
+      queued line records the few registers that change from line to line;
+      the rest is read from render_svga, a copy of this structure that is
+      refreshed with the queue idle whenever render_dirty is set by a mode
+      or palette change. render_page_seq holds, per 4K VRAM page, the last
+      queued line that reads it.*/
+    struct svga_render_line *render_lines;
+    struct svga_t *render_svga;
+    int render_dirty;
+    volatile uint32_t render_queued, render_done;
+    uint32_t *render_page_seq;
+    void *render_thread, *render_wake, *render_done_event;
+    volatile int render_exit;
 } svga_t;
 
 
@@ -147,6 +162,9 @@ uint8_t		svga_in(uint16_t addr, void *p);
 svga_t		*svga_get_pri();
 void		svga_set_override(svga_t *svga, int val);
 
+void		svga_render_flush(svga_t *svga);
+void		svga_render_sync(svga_t *svga, uint32_t addr);
+
 void		svga_set_ramdac_type(svga_t *svga, int type);
 void		svga_close(svga_t *svga);
 
@@ -155,6 +173,10 @@ uint32_t	svga_mask_changedaddr(uint32_t addr, svga_t *svga);
 
 void		svga_doblit(int y1, int y2, int wx, int wy, svga_t *svga);
 
+struct _snapshot_;
+void		svga_save(svga_t *svga, struct _snapshot_ *s);
+void		svga_load(svga_t *svga, struct _snapshot_ *s);
+
 
 enum {
     RAMDAC_6BIT = 0,
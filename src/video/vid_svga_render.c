@@ -22,10 +22,87 @@
 #include <wchar.h>
 #include "../86box.h"
 #include "../mem.h"
+#include "../timer.h"
 #include "video.h"
 #include "vid_svga.h"
 #include "vid_svga_render.h"
 
+/*With SSE2 on the host the packed pixel renderers convert 4 or 8 pixels at
+  a time. Lines that wrap around the end of display memory still go pixel by
+  pixel. Palette lookups stay scalar; 8bpp lowres only vectorises the pixel
+  doubling. The 15/16bpp lowres loops are left alone, as they do not write
+  every pixel of the line and vector code would have to copy that.*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+# define SVGA_RENDER_SSE2
+# include <emmintrin.h>
+#endif
+
+
+#ifdef SVGA_RENDER_SSE2
+/*Nonzero if len bytes from ma on can be read without wrapping.*/
+static __inline int svga_render_linear(svga_t *svga, uint32_t len)
+{
+        return (svga->ma + len) <= MIN(svga->vram_display_mask + 1, svga->vram_max);
+}
+
+/*Each 5 or 6 bit field is widened as (v * 255) / max, exactly as
+  calc_15to32() and calc_16to32() do, by a multiply-high of the field
+  shifted left by 4 (5 bits) or 3 (6 bits).*/
+#define SVGA_RENDER_MUL5 0x839d
+#define SVGA_RENDER_MUL6 0x8187
+
+static __inline void svga_render_pack_sse2(uint32_t *p, __m128i b, __m128i g, __m128i r)
+{
+        __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+
+        _mm_storeu_si128((__m128i *)p, _mm_unpacklo_epi16(bg, r));
+        _mm_storeu_si128((__m128i *)&p[4], _mm_unpackhi_epi16(bg, r));
+}
+
+static __inline void svga_render_15to32_sse2(uint32_t *p, uint8_t *src)
+{
+        __m128i dat = _mm_loadu_si128((__m128i *)src);
+        __m128i mask = _mm_set1_epi16(0x1f0);
+        __m128i mul = _mm_set1_epi16(SVGA_RENDER_MUL5);
+
+        svga_render_pack_sse2(p, _mm_mulhi_epu16(_mm_and_si128(_mm_slli_epi16(dat, 4), mask), mul),
+                                 _mm_mulhi_epu16(_mm_and_si128(_mm_srli_epi16(dat, 1), mask), mul),
+                                 _mm_mulhi_epu16(_mm_and_si128(_mm_srli_epi16(dat, 6), mask), mul));
+}
+
+static __inline void svga_render_16to32_sse2(uint32_t *p, uint8_t *src)
+{
+        __m128i dat = _mm_loadu_si128((__m128i *)src);
+        __m128i mask = _mm_set1_epi16(0x1f0);
+        __m128i mul = _mm_set1_epi16(SVGA_RENDER_MUL5);
+
+        svga_render_pack_sse2(p, _mm_mulhi_epu16(_mm_and_si128(_mm_slli_epi16(dat, 4), mask), mul),
+                                 _mm_mulhi_epu16(_mm_and_si128(_mm_srli_epi16(dat, 2), _mm_set1_epi16(0x1f8)), _mm_set1_epi16(SVGA_RENDER_MUL6)),
+                                 _mm_mulhi_epu16(_mm_and_si128(_mm_srli_epi16(dat, 7), mask), mul));
+}
+
+/*Reads 16 bytes for 4 pixels of 3 bytes each.*/
+static __inline __m128i svga_render_24to32_sse2(uint8_t *src)
+{
+        __m128i dat = _mm_loadu_si128((__m128i *)src);
+        __m128i p01 = _mm_unpacklo_epi32(dat, _mm_srli_si128(dat, 3));
+        __m128i p23 = _mm_unpacklo_epi32(_mm_srli_si128(dat, 6), _mm_srli_si128(dat, 9));
+
+        return _mm_and_si128(_mm_unpacklo_epi64(p01, p23), _mm_set1_epi32(0xffffff));
+}
+
+static __inline __m128i svga_render_32to32_sse2(uint8_t *src)
+{
+        return _mm_and_si128(_mm_loadu_si128((__m128i *)src), _mm_set1_epi32(0xffffff));
+}
+
+static __inline void svga_render_double_sse2(uint32_t *p, __m128i dat)
+{
+        _mm_storeu_si128((__m128i *)p, _mm_unpacklo_epi32(dat, dat));
+        _mm_storeu_si128((__m128i *)&p[4], _mm_unpackhi_epi32(dat, dat));
+}
+#endif
+
 
 void svga_render_blank(svga_t *svga)
 {
@@ -505,8 +582,23 @@ void svga_render_8bpp_lowres(svga_t *svga)
                 if (svga->firstline_draw == 2000) 
                         svga->firstline_draw = svga->displine;
                 svga->lastline_draw = svga->displine;
-                                                                
-                for (x = 0; x <= svga->hdisp; x += 8)
+
+                x = 0;
+#ifdef SVGA_RENDER_SSE2
+                if (svga_render_linear(svga, (svga->hdisp + 8) >> 1))
+                {
+                        for (; x <= svga->hdisp; x += 8)
+                        {
+                                uint32_t dat = *(uint32_t *)(&svga->vram[svga->ma]);
+
+                                svga_render_double_sse2(p, _mm_setr_epi32(svga->pallook[dat & 0xff], svga->pallook[(dat >> 8) & 0xff],
+                                                                          svga->pallook[(dat >> 16) & 0xff], svga->pallook[dat >> 24]));
+                                svga->ma += 4;
+                                p += 8;
+                        }
+                }
+#endif
+                for (; x <= svga->hdisp; x += 8)
                 {
                         uint32_t dat = *(uint32_t *)(&svga->vram[svga->ma & svga->vram_display_mask]);
                         
@@ -606,7 +698,15 @@ void svga_render_15bpp_highres(svga_t *svga)
                         svga->firstline_draw = svga->displine;
                 svga->lastline_draw = svga->displine;
 
-                for (x = 0; x <= svga->hdisp; x += 8)
+                x = 0;
+#ifdef SVGA_RENDER_SSE2
+                if (svga_render_linear(svga, (svga->hdisp + 8) << 1))
+                {
+                        for (; x <= svga->hdisp; x += 8)
+                                svga_render_15to32_sse2(&p[x], &svga->vram[svga->ma + (x << 1)]);
+                }
+#endif
+                for (; x <= svga->hdisp; x += 8)
                 {
                         uint32_t dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1)) & svga->vram_display_mask]);
                         p[x]     = video_15to32[dat & 0xffff];
@@ -676,7 +776,15 @@ void svga_render_16bpp_highres(svga_t *svga)
                         svga->firstline_draw = svga->displine;
                 svga->lastline_draw = svga->displine;
 
-                for (x = 0; x <= svga->hdisp; x += 8)
+                x = 0;
+#ifdef SVGA_RENDER_SSE2
+                if (svga_render_linear(svga, (svga->hdisp + 8) << 1))
+                {
+                        for (; x <= svga->hdisp; x += 8)
+                                svga_render_16to32_sse2(&p[x], &svga->vram[svga->ma + (x << 1)]);
+                }
+#endif
+                for (; x <= svga->hdisp; x += 8)
                 {
                         uint32_t dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1)) & svga->vram_display_mask]);
                         p[x]     = video_16to32[dat & 0xffff];
@@ -715,7 +823,20 @@ void svga_render_24bpp_lowres(svga_t *svga)
 
                 offset = (8 - (svga->scrollcache & 6)) + 24;
 
-                for (x = 0; x <= svga->hdisp; x++)
+                x = 0;
+#ifdef SVGA_RENDER_SSE2
+                if (svga_render_linear(svga, (svga->hdisp + 8) * 3))
+                {
+                        uint32_t *p = &((uint32_t *)buffer32->line[svga->displine + y_add])[offset + x_add];
+
+                        for (; (x + 3) <= svga->hdisp; x += 4)
+                        {
+                                svga_render_double_sse2(&p[x << 1], svga_render_24to32_sse2(&svga->vram[svga->ma]));
+                                svga->ma += 12;
+                        }
+                }
+#endif
+                for (; x <= svga->hdisp; x++)
                 {
                         fg = svga->vram[svga->ma] | (svga->vram[svga->ma + 1] << 8) | (svga->vram[svga->ma + 2] << 16);
                         svga->ma += 3; 
@@ -740,7 +861,18 @@ void svga_render_24bpp_highres(svga_t *svga)
                         svga->firstline_draw = svga->displine;
                 svga->lastline_draw = svga->displine;
 
-                for (x = 0; x <= svga->hdisp; x += 4)
+                x = 0;
+#ifdef SVGA_RENDER_SSE2
+                if (svga_render_linear(svga, (svga->hdisp + 8) * 3))
+                {
+                        for (; x <= svga->hdisp; x += 4)
+                        {
+                                _mm_storeu_si128((__m128i *)&p[x], svga_render_24to32_sse2(&svga->vram[svga->ma]));
+                                svga->ma += 12;
+                        }
+                }
+#endif
+                for (; x <= svga->hdisp; x += 4)
                 {
                         uint32_t dat = *(uint32_t *)(&svga->vram[svga->ma & svga->vram_display_mask]);
                         p[x] = dat & 0xffffff;
@@ -776,7 +908,20 @@ void svga_render_32bpp_lowres(svga_t *svga)
 
                 offset = (8 - (svga->scrollcache & 6)) + 24;
 
-                for (x = 0; x <= svga->hdisp; x++)
+                x = 0;
+#ifdef SVGA_RENDER_SSE2
+                if (svga_render_linear(svga, (svga->hdisp + 8) * 4))
+                {
+                        uint32_t *p = &((uint32_t *)buffer32->line[svga->displine + y_add])[offset + x_add];
+
+                        for (; (x + 3) <= svga->hdisp; x += 4)
+                        {
+                                svga_render_double_sse2(&p[x << 1], svga_render_32to32_sse2(&svga->vram[svga->ma]));
+                                svga->ma += 16;
+                        }
+                }
+#endif
+                for (; x <= svga->hdisp; x++)
                 {
                         fg = svga->vram[svga->ma] | (svga->vram[svga->ma + 1] << 8) | (svga->vram[svga->ma + 2] << 16);
                         svga->ma += 4; 
@@ -803,7 +948,15 @@ void svga_render_32bpp_highres(svga_t *svga)
                         svga->firstline_draw = svga->displine;
                 svga->lastline_draw = svga->displine;
 
-                for (x = 0; x <= svga->hdisp; x++)
+                x = 0;
+#ifdef SVGA_RENDER_SSE2
+                if (svga_render_linear(svga, (svga->hdisp + 8) << 2))
+                {
+                        for (; (x + 3) <= svga->hdisp; x += 4)
+                                _mm_storeu_si128((__m128i *)&p[x], svga_render_32to32_sse2(&svga->vram[svga->ma + (x << 2)]));
+                }
+#endif
+                for (; x <= svga->hdisp; x++)
                 {
                         uint32_t dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 2)) & svga->vram_display_mask]);
                         p[x] = dat & 0xffffff;
@@ -828,7 +981,23 @@ void svga_render_ABGR8888_highres(svga_t *svga)
                         svga->firstline_draw = svga->displine;
                 svga->lastline_draw = svga->displine;
 
-                for (x = 0; x <= svga->hdisp; x++)
+                x = 0;
+#ifdef SVGA_RENDER_SSE2
+                if (svga_render_linear(svga, (svga->hdisp + 8) << 2))
+                {
+                        for (; (x + 3) <= svga->hdisp; x += 4)
+                        {
+                                __m128i dat = _mm_loadu_si128((__m128i *)&svga->vram[svga->ma + (x << 2)]);
+                                __m128i rb = _mm_set1_epi32(0xff);
+
+                                dat = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(dat, 16), rb),
+                                                                _mm_and_si128(dat, _mm_set1_epi32(0xff00))),
+                                                   _mm_slli_epi32(_mm_and_si128(dat, rb), 16));
+                                _mm_storeu_si128((__m128i *)&p[x], dat);
+                        }
+                }
+#endif
+                for (; x <= svga->hdisp; x++)
                 {
                         uint32_t dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 2)) & svga->vram_display_mask]);
                         p[x] = ((dat & 0xff0000) >> 16) | (dat & 0x00ff00) | ((dat & 0x0000ff) << 16);
@@ -853,7 +1022,15 @@ void svga_render_RGBA8888_highres(svga_t *svga)
                         svga->firstline_draw = svga->displine;
                 svga->lastline_draw = svga->displine;
 
-                for (x = 0; x <= svga->hdisp; x++)
+                x = 0;
+#ifdef SVGA_RENDER_SSE2
+                if (svga_render_linear(svga, (svga->hdisp + 8) << 2))
+                {
+                        for (; (x + 3) <= svga->hdisp; x += 4)
+                                _mm_storeu_si128((__m128i *)&p[x], _mm_srli_epi32(_mm_loadu_si128((__m128i *)&svga->vram[svga->ma + (x << 2)]), 8));
+                }
+#endif
+                for (; x <= svga->hdisp; x++)
                 {
                         uint32_t dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 2)) & svga->vram_display_mask]);
                         p[x] = dat >> 8;
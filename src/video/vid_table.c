@@ -28,6 +28,7 @@
 #include "../mem.h"
 #include "../device.h"
 #include "../plat.h"
+#include "../timer.h"
 #include "video.h"
 #include "vid_svga.h"
 
@@ -68,6 +68,7 @@
 #include "../device.h"
 #include "../cpu/cpu.h"
 #include "../plat.h"
+#include "../timer.h"
 #include "video.h"
 #include "vid_svga.h"
 #include "vid_svga_render.h"
@@ -822,6 +823,7 @@ static void tgui_ext_linear_write(uint32_t addr, uint8_t val, void *p)
                 return;
         addr &= svga->vram_mask;
         addr &= ~0x7;
+        svga_render_sync(svga, addr);
         svga->changedvram[addr >> 12] = changeframecount;
         
         switch (tgui->ext_gdc_regs[0] & 0xf)
@@ -891,6 +893,7 @@ static void tgui_ext_linear_writew(uint32_t addr, uint16_t val, void *p)
                 return;
         addr &= svga->vram_mask;
         addr &= ~0xf;
+        svga_render_sync(svga, addr);
         svga->changedvram[addr >> 12] = changeframecount;
         
         val = (val >> 8) | (val << 8);
@@ -1031,6 +1034,8 @@ void tgui_accel_command(int count, uint32_t cpu_dat, tgui_t *tgui)
 	uint16_t trans_col = (tgui->accel.flags & TGUI_TRANSREV) ? tgui->accel.fg_col : tgui->accel.bg_col;
         uint16_t *vram_w = (uint16_t *)svga->vram;
         
+        svga_render_flush(svga);
+
 	if (tgui->accel.bpp == 0)
                 trans_col &= 0xff;
 	
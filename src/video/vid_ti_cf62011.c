@@ -62,6 +62,7 @@
 #include "../mem.h"
 #include "../rom.h"
 #include "../device.h"
+#include "../timer.h"
 #include "../video/video.h"
 #include "../video/vid_vga.h"
 #include "../video/vid_svga.h"
@@ -26,6 +26,7 @@
 #include "../mem.h"
 #include "../rom.h"
 #include "../device.h"
+#include "../timer.h"
 #include "video.h"
 #include "vid_svga.h"
 #include "vid_vga.h"
@@ -183,6 +184,20 @@ void vga_force_redraw(void *p)
         vga->svga.fullchange = changeframecount;
 }
 
+static void vga_save(void *p, struct _snapshot_ *s)
+{
+        vga_t *vga = (vga_t *)p;
+
+        svga_save(&vga->svga, s);
+}
+
+static void vga_load(void *p, struct _snapshot_ *s)
+{
+        vga_t *vga = (vga_t *)p;
+
+        svga_load(&vga->svga, s);
+}
+
 const device_t vga_device =
 {
         "VGA",
@@ -194,7 +209,9 @@ const device_t vga_device =
         vga_available,
         vga_speed_changed,
         vga_force_redraw,
-        NULL
+        NULL,
+        vga_save,
+        vga_load
 };
 
 const device_t ps1vga_device =
@@ -208,7 +225,9 @@ const device_t ps1vga_device =
         vga_available,
         vga_speed_changed,
         vga_force_redraw,
-        NULL
+        NULL,
+        vga_save,
+        vga_load
 };
 
 const device_t ps1vga_mca_device =
@@ -222,5 +241,7 @@ const device_t ps1vga_mca_device =
         vga_available,
         vga_speed_changed,
         vga_force_redraw,
-        NULL
+        NULL,
+        vga_save,
+        vga_load
 };
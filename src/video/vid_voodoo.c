@@ -48,7 +48,13 @@
 
 #define TEX_DIRTY_SHIFT 10
 
-#define TEX_CACHE_MAX 64
+/*Decoded textures are cached per TMU. The cache is bounded by the memory
+  the decoded texels take (TEX_CACHE_SIZE bytes) rather than by entry count;
+  TEX_CACHE_MAX only caps the number of slots.*/
+#define TEX_CACHE_MAX 1024
+#define TEX_CACHE_SIZE (32 * 1024 * 1024)
+#define TEX_HASH_SIZE 1024
+#define TEX_HASH_MASK (TEX_HASH_SIZE-1)
 
 enum
 {
@@ -57,21 +63,6 @@ enum
         VOODOO_2 = 2
 };
 
-static uint32_t texture_offset[LOD_MAX+3] =
-{
-        0,
-        256*256,
-        256*256 + 128*128,
-        256*256 + 128*128 + 64*64,
-        256*256 + 128*128 + 64*64 + 32*32,
-        256*256 + 128*128 + 64*64 + 32*32 + 16*16,
-        256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8,
-        256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4,
-        256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4 + 2*2,
-        256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4 + 2*2 + 1*1,
-        256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4 + 2*2 + 1*1 + 1
-};
-
 static int tris = 0;
 
 typedef union {
@@ -118,12 +109,14 @@ enum
 #define PARAM_MASK (PARAM_SIZE - 1)
 #define PARAM_ENTRY_SIZE (1 << 31)
 
-#define PARAM_ENTRIES_1 (voodoo->params_write_idx - voodoo->params_read_idx[0])
-#define PARAM_ENTRIES_2 (voodoo->params_write_idx - voodoo->params_read_idx[1])
-#define PARAM_FULL_1 ((voodoo->params_write_idx - voodoo->params_read_idx[0]) >= PARAM_SIZE)
-#define PARAM_FULL_2 ((voodoo->params_write_idx - voodoo->params_read_idx[1]) >= PARAM_SIZE)
-#define PARAM_EMPTY_1   (voodoo->params_read_idx[0] == voodoo->params_write_idx)
-#define PARAM_EMPTY_2   (voodoo->params_read_idx[1] == voodoo->params_write_idx)
+/*Render threads. Each one walks every queued triangle, but only draws
+  the scanlines where (y & odd_even_mask) matches its index, so the
+  count must be a power of two.*/
+#define RENDER_THREADS_MAX 8
+
+#define PARAM_ENTRIES(x) (voodoo->params_write_idx - voodoo->params_read_idx[x])
+#define PARAM_FULL(x)    ((voodoo->params_write_idx - voodoo->params_read_idx[x]) >= PARAM_SIZE)
+#define PARAM_EMPTY(x)   (voodoo->params_read_idx[x] == voodoo->params_write_idx)
 
 typedef struct
 {
@@ -208,13 +201,24 @@ typedef struct texture_t
 {
         uint32_t base;
         uint32_t tLOD;
-        volatile int refcount, refcount_r[2];
+        volatile int refcount, refcount_r[RENDER_THREADS_MAX];
         int is16;
         uint32_t palette_checksum;
         uint32_t addr_start[4], addr_end[4];
         uint32_t *data;
+        uint32_t offset[LOD_MAX+1]; /*Start of each LOD within data*/
+        int size;                   /*Bytes allocated for data*/
+        int hash_next;
+        int lru_prev, lru_next;
 } texture_t;
 
+/*Argument handed to each render thread.*/
+typedef struct voodoo_render_t
+{
+        struct voodoo_t *voodoo;
+        int odd_even;
+} voodoo_render_t;
+
 typedef struct voodoo_t
 {
         mem_mapping_t mapping;
@@ -285,21 +289,22 @@ typedef struct voodoo_t
         int ncc_dirty[2];
 
         thread_t *fifo_thread;
-        thread_t *render_thread[2];
+        thread_t *render_thread[RENDER_THREADS_MAX];
+        voodoo_render_t render_data[RENDER_THREADS_MAX];
         event_t *wake_fifo_thread;
         event_t *wake_main_thread;
         event_t *fifo_not_full_event;
-        event_t *render_not_full_event[2];
-        event_t *wake_render_thread[2];
+        event_t *render_not_full_event[RENDER_THREADS_MAX];
+        event_t *wake_render_thread[RENDER_THREADS_MAX];
         
         int voodoo_busy;
-        int render_voodoo_busy[2];
+        int render_voodoo_busy[RENDER_THREADS_MAX];
         
         int render_threads;
         int odd_even_mask;
         
-        int pixel_count[2], texel_count[2], tri_count, frame_count;
-        int pixel_count_old[2], texel_count_old[2];
+        int pixel_count[RENDER_THREADS_MAX], texel_count[RENDER_THREADS_MAX], tri_count, frame_count;
+        int pixel_count_old[RENDER_THREADS_MAX], texel_count_old[RENDER_THREADS_MAX];
         int wr_count, rd_count, tex_count;
         
         int retrace_count;
@@ -323,7 +328,7 @@ typedef struct voodoo_t
 	volatile int cmd_read, cmd_written, cmd_written_fifo;
 
         voodoo_params_t params_buffer[PARAM_SIZE];
-        volatile int params_read_idx[2], params_write_idx;
+        volatile int params_read_idx[RENDER_THREADS_MAX], params_write_idx;
         
         uint32_t cmdfifo_base, cmdfifo_end;
         int cmdfifo_rp;
@@ -409,17 +414,23 @@ typedef struct voodoo_t
         uint16_t purpleline[256][3];
 
         texture_t texture_cache[2][TEX_CACHE_MAX];
-        uint8_t texture_present[2][4096];
-        int texture_last_removed;
+        uint16_t texture_present[2][4096]; /*Cached textures covering each page*/
+        int texture_hash[2][TEX_HASH_SIZE];
+        int texture_lru_head[2], texture_lru_tail[2];
+        int texture_free[2][TEX_CACHE_MAX], texture_nr_free[2];
+        int texture_cache_size[2];
         
         uint32_t palette_checksum[2];
-        int palette_dirty[2];
 
         uint64_t time;
-        int render_time[2];
+        int render_time[RENDER_THREADS_MAX];
         
         int use_recompiler;        
         void *codegen_data;
+        void *codegen_cache;
+        int jit_hits[RENDER_THREADS_MAX], jit_misses[RENDER_THREADS_MAX];
+        int jit_hits_seen, jit_misses_seen;
+        int jit_status_count;
         
         struct voodoo_set_t *set;
 } voodoo_t;
@@ -435,6 +446,20 @@ typedef struct voodoo_set_t
 
 static inline void wait_for_render_thread_idle(voodoo_t *voodoo);
 
+/*A cached texture may only be replaced once every render thread has
+  drawn all the triangles queued against it.*/
+static inline int texture_busy(voodoo_t *voodoo, texture_t *texture)
+{
+        int c;
+
+        for (c = 0; c < voodoo->render_threads; c++)
+        {
+                if (texture->refcount != texture->refcount_r[c])
+                        return 1;
+        }
+        return 0;
+}
+
 enum
 {
         SST_status = 0x000,
@@ -1280,32 +1305,145 @@ static void voodoo_recalc_tex(voodoo_t *voodoo, int tmu)
 
 #define makergba(r, g, b, a)  ((b) | ((g) << 8) | ((r) << 16) | ((a) << 24))
 
-static void use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
+/*The palette checksum is the XOR of a hash of every (index, colour) pair,
+  so each write updates it without rescanning the palette.*/
+static inline uint32_t palette_hash(int p, uint32_t val)
 {
-        int c, d;
-        int lod;
-        int lod_min, lod_max;
-        uint32_t addr = 0, addr_end;
-        uint32_t palette_checksum;
+        uint32_t h = (val ^ (p * 0x9e3779b9)) * 0x85ebca6b;
 
-        lod_min = (params->tLOD[tmu] >> 2) & 15;
-        lod_max = (params->tLOD[tmu] >> 8) & 15;
-        
-        if (params->tformat[tmu] == TEX_PAL8 || params->tformat[tmu] == TEX_APAL8 || params->tformat[tmu] == TEX_APAL88)
+        return h ^ (h >> 13);
+}
+
+static inline void voodoo_set_palette(voodoo_t *voodoo, int tmu, int p, uint32_t val)
+{
+        voodoo->palette_checksum[tmu] ^= palette_hash(p, voodoo->palette[tmu][p].u) ^ palette_hash(p, val);
+        voodoo->palette[tmu][p].u = val;
+}
+
+static inline int texture_hash(uint32_t base, uint32_t tLOD, uint32_t palette_checksum)
+{
+        uint32_t h = (base ^ (tLOD * 0x9e3779b1) ^ palette_checksum) * 0x85ebca6b;
+
+        return (h ^ (h >> 16)) & TEX_HASH_MASK;
+}
+
+static void texture_lru_unlink(voodoo_t *voodoo, int tmu, int c)
+{
+        texture_t *texture = &voodoo->texture_cache[tmu][c];
+
+        if (texture->lru_prev != -1)
+                voodoo->texture_cache[tmu][texture->lru_prev].lru_next = texture->lru_next;
+        else
+                voodoo->texture_lru_head[tmu] = texture->lru_next;
+        if (texture->lru_next != -1)
+                voodoo->texture_cache[tmu][texture->lru_next].lru_prev = texture->lru_prev;
+        else
+                voodoo->texture_lru_tail[tmu] = texture->lru_prev;
+}
+
+static void texture_lru_push(voodoo_t *voodoo, int tmu, int c)
+{
+        texture_t *texture = &voodoo->texture_cache[tmu][c];
+
+        texture->lru_prev = -1;
+        texture->lru_next = voodoo->texture_lru_head[tmu];
+        if (texture->lru_next != -1)
+                voodoo->texture_cache[tmu][texture->lru_next].lru_prev = c;
+        else
+                voodoo->texture_lru_tail[tmu] = c;
+        voodoo->texture_lru_head[tmu] = c;
+}
+
+static void texture_lru_push_tail(voodoo_t *voodoo, int tmu, int c)
+{
+        texture_t *texture = &voodoo->texture_cache[tmu][c];
+
+        texture->lru_next = -1;
+        texture->lru_prev = voodoo->texture_lru_tail[tmu];
+        if (texture->lru_prev != -1)
+                voodoo->texture_cache[tmu][texture->lru_prev].lru_next = c;
+        else
+                voodoo->texture_lru_head[tmu] = c;
+        voodoo->texture_lru_tail[tmu] = c;
+}
+
+/*Add delta to the count of cached textures covering each page of texture
+  memory that texture c was decoded from.*/
+static void texture_mark_pages(voodoo_t *voodoo, int tmu, int c, int delta)
+{
+        texture_t *texture = &voodoo->texture_cache[tmu][c];
+        int d;
+
+        for (d = 0; d < 4; d++)
         {
-                if (voodoo->palette_dirty[tmu])
+                uint32_t addr = texture->addr_start[d];
+                uint32_t addr_end = texture->addr_end[d];
+
+                if (addr_end != 0)
                 {
-                        palette_checksum = 0;
-                        
-                        for (c = 0; c < 256; c++)
-                                palette_checksum ^= voodoo->palette[tmu][c].u;
+                        for (; addr <= addr_end; addr += (1 << TEX_DIRTY_SHIFT))
+                                voodoo->texture_present[tmu][(addr & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] += delta;
+                }
+        }
+}
+
+/*Drop texture c from the hash and page tracking. The entry keeps its data
+  and moves to the LRU tail, so it is the first to be reused.*/
+static void texture_invalidate(voodoo_t *voodoo, int tmu, int c)
+{
+        texture_t *texture = &voodoo->texture_cache[tmu][c];
+        int *prev = &voodoo->texture_hash[tmu][texture_hash(texture->base, texture->tLOD, texture->palette_checksum)];
+
+        while (*prev != c)
+                prev = &voodoo->texture_cache[tmu][*prev].hash_next;
+        *prev = texture->hash_next;
+
+        texture_mark_pages(voodoo, tmu, c, -1);
+        texture->base = -1;
+
+        texture_lru_unlink(voodoo, tmu, c);
+        texture_lru_push_tail(voodoo, tmu, c);
+}
+
+/*Free the least recently used entries that no render thread still
+  references until a slot and size bytes are available.*/
+static void texture_make_room(voodoo_t *voodoo, int tmu, int size)
+{
+        while (!voodoo->texture_nr_free[tmu] || voodoo->texture_cache_size[tmu] + size > TEX_CACHE_SIZE)
+        {
+                int c = voodoo->texture_lru_tail[tmu];
                 
-                        voodoo->palette_checksum[tmu] = palette_checksum;
-                        voodoo->palette_dirty[tmu] = 0;
+                while (c != -1 && texture_busy(voodoo, &voodoo->texture_cache[tmu][c]))
+                        c = voodoo->texture_cache[tmu][c].lru_prev;
+                if (c == -1)
+                {
+                        wait_for_render_thread_idle(voodoo);
+                        continue;
                 }
-                else
-                        palette_checksum = voodoo->palette_checksum[tmu];
+                
+                if (voodoo->texture_cache[tmu][c].base != -1)
+                        texture_invalidate(voodoo, tmu, c);
+                texture_lru_unlink(voodoo, tmu, c);
+                free(voodoo->texture_cache[tmu][c].data);
+                voodoo->texture_cache[tmu][c].data = NULL;
+                voodoo->texture_cache_size[tmu] -= voodoo->texture_cache[tmu][c].size;
+                voodoo->texture_free[tmu][voodoo->texture_nr_free[tmu]++] = c;
         }
+}
+
+static void use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
+{
+        int c, lod;
+        int lod_min, lod_max;
+        uint32_t addr = 0;
+        uint32_t tLOD = params->tLOD[tmu] & 0xf00fff;
+        uint32_t palette_checksum;
+        uint32_t offset[LOD_MAX+1];
+        int hash;
+        int size;
+
+        if (params->tformat[tmu] == TEX_PAL8 || params->tformat[tmu] == TEX_APAL8 || params->tformat[tmu] == TEX_APAL88)
+                palette_checksum = voodoo->palette_checksum[tmu];
         else
                 palette_checksum = 0;
 
@@ -1315,53 +1453,57 @@ static void use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
                 addr = params->texBaseAddr[tmu];
 
         /*Try to find texture in cache*/
-        for (c = 0; c < TEX_CACHE_MAX; c++)
+        hash = texture_hash(addr, tLOD, palette_checksum);
+        for (c = voodoo->texture_hash[tmu][hash]; c != -1; c = voodoo->texture_cache[tmu][c].hash_next)
         {
                 if (voodoo->texture_cache[tmu][c].base == addr &&
-                    voodoo->texture_cache[tmu][c].tLOD == (params->tLOD[tmu] & 0xf00fff) &&
+                    voodoo->texture_cache[tmu][c].tLOD == tLOD &&
                     voodoo->texture_cache[tmu][c].palette_checksum == palette_checksum)
                 {
+                        if (voodoo->texture_lru_head[tmu] != c)
+                        {
+                                texture_lru_unlink(voodoo, tmu, c);
+                                texture_lru_push(voodoo, tmu, c);
+                        }
                         params->tex_entry[tmu] = c;
                         voodoo->texture_cache[tmu][c].refcount++;
                         return;
                 }
         }
-        
-        /*Texture not found, search for unused texture*/
-        do
+
+        lod_min = MIN((params->tLOD[tmu] >> 2) & 15, 8);
+        lod_max = MIN((params->tLOD[tmu] >> 8) & 15, 8);
+
+        /*Texture not found. Lay out every LOD the rasterizer can clamp to,
+          each level sized to its own dimensions.*/
+        size = 0;
+        for (lod = 0; lod <= LOD_MAX; lod++)
         {
-                for (c = 0; c < TEX_CACHE_MAX; c++)
+                offset[lod] = size;
+                if (lod >= MIN(lod_min, lod_max))
                 {
-                        voodoo->texture_last_removed++;
-                        voodoo->texture_last_removed &= (TEX_CACHE_MAX-1);
-                        if (voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[0] &&
-                            (voodoo->render_threads == 1 || voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[1]))
-                                break;
+                        int shift = 8 - params->tex_lod[tmu][lod];
+
+                        size += (voodoo->params.tex_h_mask[tmu][lod] + 1) << ((shift > 0) ? shift : 0);
                 }
-                if (c == TEX_CACHE_MAX)
-                        wait_for_render_thread_idle(voodoo);
-        } while (c == TEX_CACHE_MAX);
-        if (c == TEX_CACHE_MAX)
-                fatal("Texture cache full!\n");
+        }
+        size *= 4;
 
-        c = voodoo->texture_last_removed;
-        
+        texture_make_room(voodoo, tmu, size);
+        c = voodoo->texture_free[tmu][--voodoo->texture_nr_free[tmu]];
+        memcpy(voodoo->texture_cache[tmu][c].offset, offset, sizeof(offset));
+        voodoo->texture_cache[tmu][c].data = malloc(size);
+        voodoo->texture_cache[tmu][c].size = size;
+        voodoo->texture_cache_size[tmu] += size;
 
-        if ((voodoo->params.tLOD[tmu] & LOD_SPLIT) && (voodoo->params.tLOD[tmu] & LOD_ODD) && (voodoo->params.tLOD[tmu] & LOD_TMULTIBASEADDR))
-                voodoo->texture_cache[tmu][c].base = params->texBaseAddr1[tmu];
-        else
-                voodoo->texture_cache[tmu][c].base = params->texBaseAddr[tmu];
-        voodoo->texture_cache[tmu][c].tLOD = params->tLOD[tmu] & 0xf00fff;
+        voodoo->texture_cache[tmu][c].base = addr;
+        voodoo->texture_cache[tmu][c].tLOD = tLOD;
 
-        lod_min = (params->tLOD[tmu] >> 2) & 15;
-        lod_max = (params->tLOD[tmu] >> 8) & 15;
 //        voodoo_log("  add new texture to %i tformat=%i %08x LOD=%i-%i tmu=%i\n", c, voodoo->params.tformat[tmu], params->texBaseAddr[tmu], lod_min, lod_max, tmu);
         
-        lod_min = MIN(lod_min, 8);
-        lod_max = MIN(lod_max, 8);
         for (lod = lod_min; lod <= lod_max; lod++)
         {
-                uint32_t *base = &voodoo->texture_cache[tmu][c].data[texture_offset[lod]];
+                uint32_t *base = &voodoo->texture_cache[tmu][c].data[voodoo->texture_cache[tmu][c].offset[lod]];
                 uint32_t tex_addr = params->tex_base[tmu][lod] & voodoo->texture_mask;
                 int x, y;
                 int shift = 8 - params->tex_lod[tmu][lod];
@@ -1622,69 +1764,54 @@ static void use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
         else        
                 voodoo->texture_cache[tmu][c].addr_start[3] = voodoo->texture_cache[tmu][c].addr_end[3] = 0;
 
-
-        for (d = 0; d < 4; d++)
-        {
-                addr = voodoo->texture_cache[tmu][c].addr_start[d];
-                addr_end = voodoo->texture_cache[tmu][c].addr_end[d];
-
-                if (addr_end != 0)
-                {
-                        for (; addr <= addr_end; addr += (1 << TEX_DIRTY_SHIFT))
-                                voodoo->texture_present[tmu][(addr & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] = 1;
-                }
-        }
+        texture_mark_pages(voodoo, tmu, c, 1);
+        voodoo->texture_cache[tmu][c].hash_next = voodoo->texture_hash[tmu][hash];
+        voodoo->texture_hash[tmu][hash] = c;
+        texture_lru_push(voodoo, tmu, c);
        
         params->tex_entry[tmu] = c;
         voodoo->texture_cache[tmu][c].refcount++;
 }
 
+/*Called when a page holding cached texture data is written. Entries that
+  were decoded from it are invalidated; render threads still drawing with
+  them keep using the decoded copy, which is only freed once idle.*/
 static void flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu)
 {
-        int wait_for_idle = 0;
-        int c;
+        int c = voodoo->texture_lru_head[tmu];
         
-        memset(voodoo->texture_present[tmu], 0, sizeof(voodoo->texture_present[0]));
-//        voodoo_log("Evict %08x %i\n", dirty_addr, sizeof(voodoo->texture_present));
-        for (c = 0; c < TEX_CACHE_MAX; c++)
+//        voodoo_log("Evict %08x\n", dirty_addr);
+        while (c != -1)
         {
-                if (voodoo->texture_cache[tmu][c].base != -1)
+                texture_t *texture = &voodoo->texture_cache[tmu][c];
+                int next = texture->lru_next;
+                int d;
+
+                if (texture->base == -1)
+                        break; /*Invalidated entries are kept at the tail*/
+                        
+                for (d = 0; d < 4; d++)
                 {
-                        int d;
+                        int addr_start = texture->addr_start[d];
+                        int addr_end = texture->addr_end[d];
                         
-                        for (d = 0; d < 4; d++)
+                        if (addr_end != 0)
                         {
-                                int addr_start = voodoo->texture_cache[tmu][c].addr_start[d];
-                                int addr_end = voodoo->texture_cache[tmu][c].addr_end[d];
+                                int addr_start_masked = addr_start & voodoo->texture_mask & ~0x3ff;
+                                int addr_end_masked = ((addr_end & voodoo->texture_mask) + 0x3ff) & ~0x3ff;
                                 
-                                if (addr_end != 0)
+                                if (addr_end_masked < addr_start_masked)
+                                        addr_end_masked = voodoo->texture_mask+1;
+                                if (dirty_addr >= addr_start_masked && dirty_addr < addr_end_masked)
                                 {
-                                        int addr_start_masked = addr_start & voodoo->texture_mask & ~0x3ff;
-                                        int addr_end_masked = ((addr_end & voodoo->texture_mask) + 0x3ff) & ~0x3ff;
-                                        
-                                        if (addr_end_masked < addr_start_masked)
-                                                addr_end_masked = voodoo->texture_mask+1;
-                                        if (dirty_addr >= addr_start_masked && dirty_addr < addr_end_masked)
-                                        {
-//                                voodoo_log("  Evict texture %i %08x\n", c, voodoo->texture_cache[tmu][c].base);
-
-                                                if (voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[0] ||
-                                                    (voodoo->render_threads == 2 && voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[1]))
-                                                        wait_for_idle = 1;
-                                        
-                                                voodoo->texture_cache[tmu][c].base = -1;
-                                        }
-                                        else
-                                        {
-                                                for (; addr_start <= addr_end; addr_start += (1 << TEX_DIRTY_SHIFT))
-                                                        voodoo->texture_present[tmu][(addr_start & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] = 1;
-                                        }
+//                                        voodoo_log("  Evict texture %i %08x\n", c, texture->base);
+                                        texture_invalidate(voodoo, tmu, c);
+                                        break;
                                 }
                         }
                 }
+                c = next;
         }
-        if (wait_for_idle)
-                wait_for_render_thread_idle(voodoo);
 }
 
 typedef struct voodoo_state_t
@@ -2714,8 +2841,8 @@ static void voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, vood
 
         for (c = 0; c <= LOD_MAX; c++)
         {
-                state->tex[0][c] = &voodoo->texture_cache[0][params->tex_entry[0]].data[texture_offset[c]];
-                state->tex[1][c] = &voodoo->texture_cache[1][params->tex_entry[1]].data[texture_offset[c]];
+                state->tex[0][c] = &voodoo->texture_cache[0][params->tex_entry[0]].data[voodoo->texture_cache[0][params->tex_entry[0]].offset[c]];
+                state->tex[1][c] = &voodoo->texture_cache[1][params->tex_entry[1]].data[voodoo->texture_cache[1][params->tex_entry[1]].offset[c]];
         }
         
         state->tformat = params->tformat[0];
@@ -3558,26 +3685,31 @@ static void voodoo_triangle(voodoo_t *voodoo, voodoo_params_t *params, int odd_e
 
 static inline void wake_render_thread(voodoo_t *voodoo)
 {
-        thread_set_event(voodoo->wake_render_thread[0]); /*Wake up render thread if moving from idle*/
-        if (voodoo->render_threads == 2)
-                thread_set_event(voodoo->wake_render_thread[1]); /*Wake up render thread if moving from idle*/
+        int c;
+
+        for (c = 0; c < voodoo->render_threads; c++)
+                thread_set_event(voodoo->wake_render_thread[c]); /*Wake up render thread if moving from idle*/
 }
 
 static inline void wait_for_render_thread_idle(voodoo_t *voodoo)
 {
-        while (!PARAM_EMPTY_1 || (voodoo->render_threads == 2 && !PARAM_EMPTY_2) || voodoo->render_voodoo_busy[0] || (voodoo->render_threads == 2 && voodoo->render_voodoo_busy[1]))
+        int c;
+
+        for (c = 0; c < voodoo->render_threads; c++)
         {
-                wake_render_thread(voodoo);
-                if (!PARAM_EMPTY_1 || voodoo->render_voodoo_busy[0])
-                        thread_wait_event(voodoo->render_not_full_event[0], 1);
-                if (voodoo->render_threads == 2 && (!PARAM_EMPTY_2 || voodoo->render_voodoo_busy[1]))
-                        thread_wait_event(voodoo->render_not_full_event[1], 1);
+                while (!PARAM_EMPTY(c) || voodoo->render_voodoo_busy[c])
+                {
+                        wake_render_thread(voodoo);
+                        thread_wait_event(voodoo->render_not_full_event[c], 1);
+                }
         }
 }
 
-static void render_thread(void *param, int odd_even)
+static void render_thread(void *param)
 {
-        voodoo_t *voodoo = (voodoo_t *)param;
+        voodoo_render_t *render = (voodoo_render_t *)param;
+        voodoo_t *voodoo = render->voodoo;
+        int odd_even = render->odd_even;
         
         while (1)
         {
@@ -3586,7 +3718,7 @@ static void render_thread(void *param, int odd_even)
                 thread_reset_event(voodoo->wake_render_thread[odd_even]);
                 voodoo->render_voodoo_busy[odd_even] = 1;
 
-                while (!(odd_even ? PARAM_EMPTY_2 : PARAM_EMPTY_1))
+                while (!PARAM_EMPTY(odd_even))
                 {
                         uint64_t start_time = plat_timer_read();
                         uint64_t end_time;
@@ -3596,7 +3728,7 @@ static void render_thread(void *param, int odd_even)
 
                         voodoo->params_read_idx[odd_even]++;                                                
                         
-                        if ((odd_even ? PARAM_ENTRIES_2 : PARAM_ENTRIES_1) > (PARAM_SIZE - 10))
+                        if (PARAM_ENTRIES(odd_even) > (PARAM_SIZE - 10))
                                 thread_set_event(voodoo->render_not_full_event[odd_even]);
 
                         end_time = plat_timer_read();
@@ -3607,31 +3739,18 @@ static void render_thread(void *param, int odd_even)
         }
 }
 
-static void render_thread_1(void *param)
-{
-        render_thread(param, 0);
-}
-static void render_thread_2(void *param)
-{
-        render_thread(param, 1);
-}
-
 static inline void queue_triangle(voodoo_t *voodoo, voodoo_params_t *params)
 {
         voodoo_params_t *params_new = &voodoo->params_buffer[voodoo->params_write_idx & PARAM_MASK];
+        int c;
 
-        while (PARAM_FULL_1 || (voodoo->render_threads == 2 && PARAM_FULL_2))
+        for (c = 0; c < voodoo->render_threads; c++)
         {
-                thread_reset_event(voodoo->render_not_full_event[0]);
-                if (voodoo->render_threads == 2)
-                        thread_reset_event(voodoo->render_not_full_event[1]);
-                if (PARAM_FULL_1)
+                while (PARAM_FULL(c))
                 {
-                        thread_wait_event(voodoo->render_not_full_event[0], -1); /*Wait for room in ringbuffer*/
-                }
-                if (voodoo->render_threads == 2 && PARAM_FULL_2)
-                {
-                        thread_wait_event(voodoo->render_not_full_event[1], -1); /*Wait for room in ringbuffer*/
+                        thread_reset_event(voodoo->render_not_full_event[c]);
+                        if (PARAM_FULL(c))
+                                thread_wait_event(voodoo->render_not_full_event[c], -1); /*Wait for room in ringbuffer*/
                 }
         }
         
@@ -3643,8 +3762,14 @@ static inline void queue_triangle(voodoo_t *voodoo, voodoo_params_t *params)
         
         voodoo->params_write_idx++;
         
-        if (PARAM_ENTRIES_1 < 4 || (voodoo->render_threads == 2 && PARAM_ENTRIES_2 < 4))
-                wake_render_thread(voodoo);
+        for (c = 0; c < voodoo->render_threads; c++)
+        {
+                if (PARAM_ENTRIES(c) < 4)
+                {
+                        wake_render_thread(voodoo);
+                        break;
+                }
+        }
 }
 
 static void voodoo_fastfill(voodoo_t *voodoo, voodoo_params_t *params)
@@ -5230,13 +5355,11 @@ static void voodoo_reg_writel(uint32_t addr, uint32_t val, void *p)
                         int p = (val >> 23) & 0xfe;
                         if (chip & CHIP_TREX0)
                         {
-                                voodoo->palette[0][p].u = val | 0xff000000;
-                                voodoo->palette_dirty[0] = 1;
+                                voodoo_set_palette(voodoo, 0, p, val | 0xff000000);
                         }
                         if (chip & CHIP_TREX1)
                         {
-                                voodoo->palette[1][p].u = val | 0xff000000;
-                                voodoo->palette_dirty[1] = 1;
+                                voodoo_set_palette(voodoo, 1, p, val | 0xff000000);
                         }
                 }
                 break;
@@ -5306,13 +5429,11 @@ static void voodoo_reg_writel(uint32_t addr, uint32_t val, void *p)
                         int p = ((val >> 23) & 0xfe) | 0x01;
                         if (chip & CHIP_TREX0)
                         {
-                                voodoo->palette[0][p].u = val | 0xff000000;
-                                voodoo->palette_dirty[0] = 1;
+                                voodoo_set_palette(voodoo, 0, p, val | 0xff000000);
                         }
                         if (chip & CHIP_TREX1)
                         {
-                                voodoo->palette[1][p].u = val | 0xff000000;
-                                voodoo->palette_dirty[1] = 1;
+                                voodoo_set_palette(voodoo, 1, p, val | 0xff000000);
                         }
                 }
                 break;
@@ -7336,6 +7457,43 @@ static void voodoo_filterline_v2(voodoo_t *voodoo, uint8_t *fil, int column, uin
 	fil3[(column-1)*3+2] = voodoo->thefilter	[fil[(column-1)*3+2]][(((src[column] >> 11) & 31) << 3)];
 }
 
+/*Pixel pipeline JIT cache figures for the last interval, appended to the
+  window title by pc_thread; empty while there is nothing to report.*/
+wchar_t voodoo_jit_stats[64];
+
+/*Report the pixel pipeline JIT cache hit rate since the last call. The
+  counters belong to the render threads and are only sampled here, without
+  locking, so the figures are approximate.*/
+static void voodoo_jit_status(voodoo_set_t *set)
+{
+        int hits = 0, misses = 0;
+        int c, d;
+
+        for (c = 0; c < set->nr_cards; c++)
+        {
+                voodoo_t *voodoo = set->voodoos[c];
+                int card_hits = 0, card_misses = 0;
+
+                for (d = 0; d < voodoo->render_threads; d++)
+                {
+                        card_hits += voodoo->jit_hits[d];
+                        card_misses += voodoo->jit_misses[d];
+                }
+                hits += card_hits - voodoo->jit_hits_seen;
+                misses += card_misses - voodoo->jit_misses_seen;
+                voodoo->jit_hits_seen = card_hits;
+                voodoo->jit_misses_seen = card_misses;
+        }
+        if (!hits && !misses)
+        {
+                voodoo_jit_stats[0] = L'\0';
+                return;
+        }
+
+        swprintf(voodoo_jit_stats, sizeof_w(voodoo_jit_stats), L"Voodoo JIT %i/%i, %.1f%%", hits, misses, ((double)hits * 100.0) / (double)(hits + misses));
+        voodoo_log("Voodoo JIT: %i hits, %i misses (%.1f%%)\n", hits, misses, ((double)hits * 100.0) / (double)(hits + misses));
+}
+
 void voodoo_callback(void *p)
 {
         voodoo_t *voodoo = (voodoo_t *)p;
@@ -7460,6 +7618,12 @@ skip_draw:
                         }
                 }
                 voodoo->v_retrace = 1;
+
+                if (voodoo->use_recompiler && voodoo == voodoo->set->voodoos[0] && ++voodoo->jit_status_count >= 60)
+                {
+                        voodoo->jit_status_count = 0;
+                        voodoo_jit_status(voodoo->set);
+                }
         }
         voodoo->line++;
         
@@ -7510,7 +7674,7 @@ static void voodoo_speed_changed(void *p)
 
 void *voodoo_card_init()
 {
-        int c;
+        int c, d;
         voodoo_t *voodoo = malloc(sizeof(voodoo_t));
         memset(voodoo, 0, sizeof(voodoo_t));
 
@@ -7555,17 +7719,18 @@ void *voodoo_card_init()
         voodoo->tex_mem_w[0] = (uint16_t *)voodoo->tex_mem[0];
         voodoo->tex_mem_w[1] = (uint16_t *)voodoo->tex_mem[1];
         
-        for (c = 0; c < TEX_CACHE_MAX; c++)
+        for (d = 0; d < 2; d++)
         {
-                voodoo->texture_cache[0][c].data = malloc((256*256 + 256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4 + 2*2) * 4);
-                voodoo->texture_cache[0][c].base = -1; /*invalid*/
-                voodoo->texture_cache[0][c].refcount = 0;
-                if (voodoo->dual_tmus)
+                /*Texture data is allocated as textures are decoded*/
+                for (c = 0; c < TEX_CACHE_MAX; c++)
                 {
-                        voodoo->texture_cache[1][c].data = malloc((256*256 + 256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4 + 2*2) * 4);
-                        voodoo->texture_cache[1][c].base = -1; /*invalid*/
-                        voodoo->texture_cache[1][c].refcount = 0;
+                        voodoo->texture_cache[d][c].base = -1; /*invalid*/
+                        voodoo->texture_cache[d][c].refcount = 0;
+                        voodoo->texture_free[d][c] = TEX_CACHE_MAX-1 - c;
                 }
+                voodoo->texture_nr_free[d] = TEX_CACHE_MAX;
+                memset(voodoo->texture_hash[d], 0xff, sizeof(voodoo->texture_hash[d]));
+                voodoo->texture_lru_head[d] = voodoo->texture_lru_tail[d] = -1;
         }
 
         timer_add(voodoo_callback, &voodoo->timer_count, TIMER_ALWAYS_ENABLED, voodoo);
@@ -7574,16 +7739,17 @@ void *voodoo_card_init()
         voodoo->fbiInit0 = 0;
 
         voodoo->wake_fifo_thread = thread_create_event();
-        voodoo->wake_render_thread[0] = thread_create_event();
-        voodoo->wake_render_thread[1] = thread_create_event();
         voodoo->wake_main_thread = thread_create_event();
         voodoo->fifo_not_full_event = thread_create_event();
-        voodoo->render_not_full_event[0] = thread_create_event();
-        voodoo->render_not_full_event[1] = thread_create_event();
         voodoo->fifo_thread = thread_create(fifo_thread, voodoo);
-        voodoo->render_thread[0] = thread_create(render_thread_1, voodoo);
-        if (voodoo->render_threads == 2)
-                voodoo->render_thread[1] = thread_create(render_thread_2, voodoo);
+        for (c = 0; c < voodoo->render_threads; c++)
+        {
+                voodoo->wake_render_thread[c] = thread_create_event();
+                voodoo->render_not_full_event[c] = thread_create_event();
+                voodoo->render_data[c].voodoo = voodoo;
+                voodoo->render_data[c].odd_even = c;
+                voodoo->render_thread[c] = thread_create(render_thread, &voodoo->render_data[c]);
+        }
 
         timer_add(voodoo_wake_timer, &voodoo->wake_timer, &voodoo->wake_timer, (void *)voodoo);
         
@@ -7723,21 +7889,20 @@ void voodoo_card_close(voodoo_t *voodoo)
 #endif
 
         thread_kill(voodoo->fifo_thread);
-        thread_kill(voodoo->render_thread[0]);
-        if (voodoo->render_threads == 2)
-                thread_kill(voodoo->render_thread[1]);
+        for (c = 0; c < voodoo->render_threads; c++)
+                thread_kill(voodoo->render_thread[c]);
         thread_destroy_event(voodoo->fifo_not_full_event);
         thread_destroy_event(voodoo->wake_main_thread);
         thread_destroy_event(voodoo->wake_fifo_thread);
-        thread_destroy_event(voodoo->wake_render_thread[0]);
-        thread_destroy_event(voodoo->wake_render_thread[1]);
-        thread_destroy_event(voodoo->render_not_full_event[0]);
-        thread_destroy_event(voodoo->render_not_full_event[1]);
+        for (c = 0; c < voodoo->render_threads; c++)
+        {
+                thread_destroy_event(voodoo->wake_render_thread[c]);
+                thread_destroy_event(voodoo->render_not_full_event[c]);
+        }
 
         for (c = 0; c < TEX_CACHE_MAX; c++)
         {
-                if (voodoo->dual_tmus)
-                        free(voodoo->texture_cache[1][c].data);
+                free(voodoo->texture_cache[1][c].data);
                 free(voodoo->texture_cache[0][c].data);
         }
 #ifndef NO_CODEGEN
@@ -7759,6 +7924,7 @@ void voodoo_close(void *p)
         voodoo_card_close(voodoo_set->voodoos[0]);
         
         free(voodoo_set);
+        voodoo_jit_stats[0] = L'\0';
 }
 
 static const device_config_t voodoo_config[] =
@@ -7853,6 +8019,14 @@ static const device_config_t voodoo_config[] =
                                 .description = "2",
                                 .value = 2
                         },
+                        {
+                                .description = "4",
+                                .value = 4
+                        },
+                        {
+                                .description = "8",
+                                .value = 8
+                        },
                         {
                                 .description = ""
                         }
@@ -1 +1,3 @@
 extern const device_t voodoo_device;
+
+extern wchar_t voodoo_jit_stats[64];
@@ -15,10 +15,12 @@
 
 #include <xmmintrin.h>
 
-#define BLOCK_NUM 8
-#define BLOCK_MASK (BLOCK_NUM-1)
+#define BLOCK_NUM 256 /*Per render thread*/
 #define BLOCK_SIZE 8192
 
+#define BLOCK_HASH_SIZE 512
+#define BLOCK_HASH_MASK (BLOCK_HASH_SIZE-1)
+
 #define LOD_MASK (LOD_TMIRROR_S | LOD_TMIRROR_T)
 
 typedef struct voodoo_x86_data_t
@@ -32,12 +34,20 @@ typedef struct voodoo_x86_data_t
         uint32_t textureMode[2];
         uint32_t tLOD[2];
         uint32_t trexInit1;        
+        uint32_t hash;
+        int hash_next;
+        int lru_prev, lru_next;
 } voodoo_x86_data_t;
 
+typedef struct voodoo_codegen_cache_t
+{
+        int hash[BLOCK_HASH_SIZE];
+        int lru_head, lru_tail; /*Most and least recently used block*/
+        int nr_blocks;
+} voodoo_codegen_cache_t;
+
 //static voodoo_x86_data_t voodoo_x86_data[2][BLOCK_NUM];
 
-static int last_block[2] = {0, 0};
-static int next_block_to_write[2] = {0, 0};
 
 #define addbyte(val)                                    \
         code_block[block_pos++] = val;                  \
@@ -3240,18 +3250,71 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
         addbyte(0xC3); /*RET*/
 }
 static int voodoo_recomp = 0;
+static inline uint32_t voodoo_block_hash(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state)
+{
+        uint32_t h = state->xdir;
+
+        h = (h * 0x9e3779b1) ^ params->alphaMode;
+        h = (h * 0x9e3779b1) ^ params->fbzMode;
+        h = (h * 0x9e3779b1) ^ params->fogMode;
+        h = (h * 0x9e3779b1) ^ params->fbzColorPath;
+        h = (h * 0x9e3779b1) ^ (voodoo->trexInit1[0] & (1 << 18));
+        h = (h * 0x9e3779b1) ^ params->textureMode[0];
+        h = (h * 0x9e3779b1) ^ params->textureMode[1];
+        h = (h * 0x9e3779b1) ^ (params->tLOD[0] & LOD_MASK) ^ ((params->tLOD[1] & LOD_MASK) << 1);
+
+        return h ^ (h >> 15);
+}
+
+static inline void voodoo_block_lru_unlink(voodoo_codegen_cache_t *cache, voodoo_x86_data_t *blocks, int b)
+{
+        if (blocks[b].lru_prev != -1)
+                blocks[blocks[b].lru_prev].lru_next = blocks[b].lru_next;
+        else
+                cache->lru_head = blocks[b].lru_next;
+        if (blocks[b].lru_next != -1)
+                blocks[blocks[b].lru_next].lru_prev = blocks[b].lru_prev;
+        else
+                cache->lru_tail = blocks[b].lru_prev;
+}
+
+static inline void voodoo_block_lru_push(voodoo_codegen_cache_t *cache, voodoo_x86_data_t *blocks, int b)
+{
+        blocks[b].lru_prev = -1;
+        blocks[b].lru_next = cache->lru_head;
+        if (cache->lru_head != -1)
+                blocks[cache->lru_head].lru_prev = b;
+        else
+                cache->lru_tail = b;
+        cache->lru_head = b;
+}
+
+static inline void voodoo_block_hash_unlink(voodoo_codegen_cache_t *cache, voodoo_x86_data_t *blocks, int b)
+{
+        int *prev = &cache->hash[blocks[b].hash & BLOCK_HASH_MASK];
+
+        while (*prev != b)
+                prev = &blocks[*prev].hash_next;
+        *prev = blocks[b].hash_next;
+}
+
+/*Each render thread has its own cache, so lookups and recompiles need no
+  locking. Blocks are found through a hash of the pipeline state and the
+  least recently used one is recompiled once all BLOCK_NUM are in use.*/
 static inline void *voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int odd_even)
 {
-        int c;
-        int b = last_block[odd_even];
-        voodoo_x86_data_t *voodoo_x86_data = voodoo->codegen_data;
+        voodoo_codegen_cache_t *cache = &((voodoo_codegen_cache_t *)voodoo->codegen_cache)[odd_even];
+        voodoo_x86_data_t *blocks = &((voodoo_x86_data_t *)voodoo->codegen_data)[odd_even * BLOCK_NUM];
         voodoo_x86_data_t *data;
-        
-        for (c = 0; c < 8; c++)
+        uint32_t hash = voodoo_block_hash(voodoo, params, state);
+        int b;
+
+        for (b = cache->hash[hash & BLOCK_HASH_MASK]; b != -1; b = data->hash_next)
         {
-                data = &voodoo_x86_data[odd_even + c*2]; //&voodoo_x86_data[odd_even][b];
-                
-                if (state->xdir == data->xdir &&
+                data = &blocks[b];
+
+                if (data->hash == hash &&
+                    state->xdir == data->xdir &&
                     params->alphaMode == data->alphaMode &&
                     params->fbzMode == data->fbzMode &&
                     params->fogMode == data->fogMode &&
@@ -3262,15 +3325,27 @@ static inline void *voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params,
                     (params->tLOD[0] & LOD_MASK) == data->tLOD[0] &&
                     (params->tLOD[1] & LOD_MASK) == data->tLOD[1])
                 {
-                        last_block[odd_even] = b;
+                        if (cache->lru_head != b)
+                        {
+                                voodoo_block_lru_unlink(cache, blocks, b);
+                                voodoo_block_lru_push(cache, blocks, b);
+                        }
+                        voodoo->jit_hits[odd_even]++;
                         return data->code_block;
                 }
-                
-                b = (b + 1) & 7;
         }
+
 voodoo_recomp++;
-        data = &voodoo_x86_data[odd_even + next_block_to_write[odd_even]*2];
-//        code_block = data->code_block;
+        voodoo->jit_misses[odd_even]++;
+        if (cache->nr_blocks < BLOCK_NUM)
+                b = cache->nr_blocks++;
+        else
+        {
+                b = cache->lru_tail;
+                voodoo_block_hash_unlink(cache, blocks, b);
+                voodoo_block_lru_unlink(cache, blocks, b);
+        }
+        data = &blocks[b];
         
         voodoo_generate(data->code_block, voodoo, params, state, depth_op);
 
@@ -3285,7 +3360,10 @@ voodoo_recomp++;
         data->tLOD[0] = params->tLOD[0] & LOD_MASK;
         data->tLOD[1] = params->tLOD[1] & LOD_MASK;
 
-        next_block_to_write[odd_even] = (next_block_to_write[odd_even] + 1) & 7;
+        data->hash = hash;
+        data->hash_next = cache->hash[hash & BLOCK_HASH_MASK];
+        cache->hash[hash & BLOCK_HASH_MASK] = b;
+        voodoo_block_lru_push(cache, blocks, b);
         
         return data->code_block;
 }
@@ -3301,14 +3379,14 @@ static void voodoo_codegen_init(voodoo_t *voodoo)
 #endif
 
 #if WIN64
-        voodoo->codegen_data = VirtualAlloc(NULL, sizeof(voodoo_x86_data_t) * BLOCK_NUM * 2, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+        voodoo->codegen_data = VirtualAlloc(NULL, sizeof(voodoo_x86_data_t) * BLOCK_NUM * voodoo->render_threads, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
 #else
-        voodoo->codegen_data = malloc(sizeof(voodoo_x86_data_t) * BLOCK_NUM * 2);
+        voodoo->codegen_data = malloc(sizeof(voodoo_x86_data_t) * BLOCK_NUM * voodoo->render_threads);
 #endif
 
 #ifdef __linux__
 	start = (void *)((long)voodoo->codegen_data & pagemask);
-	len = ((sizeof(voodoo_x86_data_t) * BLOCK_NUM * 2) + pagesize) & pagemask;
+	len = ((sizeof(voodoo_x86_data_t) * BLOCK_NUM * voodoo->render_threads) + pagesize) & pagemask;
 	if (mprotect(start, len, PROT_READ | PROT_WRITE | PROT_EXEC) != 0)
 	{
 		perror("mprotect");
@@ -3316,6 +3394,16 @@ static void voodoo_codegen_init(voodoo_t *voodoo)
 	}
 #endif
 
+        voodoo->codegen_cache = malloc(sizeof(voodoo_codegen_cache_t) * voodoo->render_threads);
+        for (c = 0; c < voodoo->render_threads; c++)
+        {
+                voodoo_codegen_cache_t *cache = &((voodoo_codegen_cache_t *)voodoo->codegen_cache)[c];
+
+                memset(cache->hash, 0xff, sizeof(cache->hash));
+                cache->lru_head = cache->lru_tail = -1;
+                cache->nr_blocks = 0;
+        }
+
         for (c = 0; c < 256; c++)
         {
                 int d[4];
@@ -3345,5 +3433,6 @@ static void voodoo_codegen_close(voodoo_t *voodoo)
 #else
         free(voodoo->codegen_data);
 #endif
+        free(voodoo->codegen_cache);
 }
 
@@ -299,6 +299,9 @@ video_wait_for_blit(void)
 void
 video_wait_for_buffer(void)
 {
+    /* In turbo mode, never hold up the machine for the host. */
+    if (turbo_mode) return;
+
     while (blit_data.buffer_in_use)
 	thread_wait_event(blit_data.buffer_not_in_use, -1);
     thread_reset_event(blit_data.buffer_not_in_use);
@@ -310,6 +313,14 @@ video_blit_memtoscreen(int x, int y, int y1, int y2, int w, int h)
 {
     if (h <= 0) return;
 
+    /*
+     * In turbo mode, frames are produced at the rate of the
+     * emulated display, which can be far more than the host
+     * can show. Rather than making the machine wait for the
+     * renderer, just drop the frame if it is still busy.
+     */
+    if (turbo_mode && blit_data.busy) return;
+
     video_wait_for_blit();
 
     blit_data.busy = 1;
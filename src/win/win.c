@@ -22,6 +22,7 @@
 #include <windows.h>
 #include <shlobj.h>
 #include <fcntl.h>
+#include <io.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -481,6 +482,14 @@ plat_remove(wchar_t *path)
 }
 
 
+/* Replace a file with another one; _wrename() refuses to overwrite. */
+int
+plat_rename(wchar_t *from, wchar_t *to)
+{
+    return(MoveFileExW(from, to, MOVEFILE_REPLACE_EXISTING) != 0);
+}
+
+
 /* Make sure a path ends with a trailing (back)slash. */
 void
 plat_path_slash(wchar_t *path)
@@ -597,6 +606,78 @@ plat_delay_ms(uint32_t count)
 }
 
 
+void *
+plat_mmap(size_t size, uint8_t executable)
+{
+    return(VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT,
+			executable ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE));
+}
+
+
+void
+plat_munmap(void *ptr, size_t size)
+{
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+
+/*
+ * Windows cannot map a file view over an existing allocation,
+ * so let the caller read the data in instead.
+ */
+int
+plat_mmap_file(void *ptr, size_t size, wchar_t *fn, uint64_t offset)
+{
+    return(0);
+}
+
+
+/* Map a whole disk image, so that it is shared with the file. */
+void *
+plat_mmap_image(FILE *f, uint64_t size, int ro)
+{
+    HANDLE h;
+    void *p;
+
+    if ((uint64_t)(size_t)size != size) return(NULL);
+
+    h = CreateFileMapping((HANDLE)_get_osfhandle(_fileno(f)), NULL,
+			  ro ? PAGE_READONLY : PAGE_READWRITE,
+			  (DWORD)(size >> 32), (DWORD)size, NULL);
+    if (h == NULL) return(NULL);
+
+    p = MapViewOfFile(h, ro ? FILE_MAP_READ : FILE_MAP_WRITE, 0, 0, (size_t)size);
+
+    /* The view keeps its own reference to the mapping. */
+    CloseHandle(h);
+
+    return(p);
+}
+
+
+void
+plat_munmap_image(void *ptr, uint64_t size)
+{
+    FlushViewOfFile(ptr, 0);
+    UnmapViewOfFile(ptr);
+}
+
+
+/* There is no portable prefetch before Windows 8. */
+void
+plat_mmap_prefetch(void *ptr, size_t size)
+{
+}
+
+
+/* Sparse files are not worth the trouble here, just write zeroes. */
+int
+plat_punch_hole(FILE *f, uint64_t offset, uint64_t size)
+{
+    return(0);
+}
+
+
 /* Return the VIDAPI number for the given name. */
 int
 plat_vidapi(char *name)
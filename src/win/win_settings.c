@@ -2522,7 +2522,7 @@ win_settings_hard_disks_add_proc(HWND hdlg, UINT message, WPARAM wParam, LPARAM
     uint32_t temp, i = 0, sector_size = 512;
     uint32_t zero = 0, base = 0x1000;
     uint64_t signature = 0xD778A82044445459ll;
-    uint64_t temp_size, r = 0;
+    uint64_t r = 0;
     char buf[512], *big_buf;
     int b = 0;
     uint8_t channel = 0;
@@ -2657,6 +2657,19 @@ win_settings_hard_disks_add_proc(HWND hdlg, UINT message, WPARAM wParam, LPARAM
 						return TRUE;							
 					}
 
+					if (image_is_vhd(hd_file_name, 0)) {
+						/* VHD images are created dynamic, nothing to fill in. */
+						fclose(f);
+						if (! vhd_create(hd_file_name, size, tracks, hpc, spt, NULL)) {
+							settings_msgbox(MBX_ERROR, (wchar_t *)IDS_4108);
+							return TRUE;
+						}
+						settings_msgbox(MBX_INFO, (wchar_t *)IDS_4113);
+						hard_disk_added = 1;
+						EndDialog(hdlg, 0);
+						return TRUE;
+					}
+
 					if (image_is_hdi(hd_file_name)) {
 						if (size >= 0x100000000ll) {
 							fclose(f);
@@ -2688,8 +2701,6 @@ win_settings_hard_disks_add_proc(HWND hdlg, UINT message, WPARAM wParam, LPARAM
 
 					memset(buf, 0, 512);
 
-					temp_size = size;
-
 					r = size >> 20;
 					size &= 0xfffff;
 
@@ -2732,23 +2743,6 @@ win_settings_hard_disks_add_proc(HWND hdlg, UINT message, WPARAM wParam, LPARAM
 						free(big_buf);
 					}
 
-					if (image_is_vhd(hd_file_name, 0)) {
-						/* VHD image. */
-						/* Generate new footer. */
-						new_vhd_footer(&vft);
-						vft->orig_size = vft->curr_size = temp_size;
-						vft->geom.cyl = tracks;
-						vft->geom.heads = hpc;
-						vft->geom.spt = spt;
-						generate_vhd_checksum(vft);
-						memset(buf, 0, 512);
-						vhd_footer_to_bytes((uint8_t *) buf, vft);
-						fwrite(buf, 1, 512, f);
-						memset(buf, 0, 512);
-						free(vft);
-						vft = NULL;
-					}
-
 					fclose(f);
 					settings_msgbox(MBX_INFO, (wchar_t *)IDS_4113);	                        
 				}
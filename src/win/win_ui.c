@@ -184,6 +184,7 @@ ResetAllMenus(void)
     CheckMenuItem(menuMain, IDM_VID_GRAY_RGB+4, MF_UNCHECKED);
 
     CheckMenuItem(menuMain, IDM_ACTION_RCTRL_IS_LALT, rctrl_is_lalt ? MF_CHECKED : MF_UNCHECKED);
+    CheckMenuItem(menuMain, IDM_ACTION_TURBO, turbo_mode ? MF_CHECKED : MF_UNCHECKED);
 
     CheckMenuItem(menuMain, IDM_UPDATE_ICONS, update_icons ? MF_CHECKED : MF_UNCHECKED);
 
@@ -314,6 +315,25 @@ MainWindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 				CheckMenuItem(menuMain, IDM_ACTION_PAUSE, dopause ? MF_CHECKED : MF_UNCHECKED);
 				break;
 
+			case IDM_ACTION_TURBO:
+				pc_set_turbo(turbo_mode ^ 1);
+				CheckMenuItem(menuMain, IDM_ACTION_TURBO, turbo_mode ? MF_CHECKED : MF_UNCHECKED);
+				break;
+
+			case IDM_ACTION_SNAP_SAVE:
+				if (! file_dlg_w_st(hwnd, IDS_2120, L"", 1)) {
+					if (! pc_snapshot_save(wopenfilestring))
+						ui_msgbox(MBX_ERROR, (wchar_t *)IDS_2121);
+				}
+				break;
+
+			case IDM_ACTION_SNAP_LOAD:
+				if (! file_dlg_w_st(hwnd, IDS_2120, L"", 0)) {
+					if (! pc_snapshot_load(wopenfilestring))
+						ui_msgbox(MBX_ERROR, (wchar_t *)IDS_2122);
+				}
+				break;
+
 			case IDM_CONFIG:
 				win_settings_open(hwnd);
 				break;